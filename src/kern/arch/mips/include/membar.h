@@ -0,0 +1,54 @@
+/*
+ * MIPS memory barriers.
+ */
+
+#ifndef _MIPS_MEMBAR_H_
+#define _MIPS_MEMBAR_H_
+
+/*
+ * MIPS has just the one barrier, SYNC, which orders everything; the
+ * finer-grained ones are all SYNC too. (System/161 doesn't reorder
+ * memory accesses, but the compiler does, and real multiprocessor
+ * MIPS hardware may.)
+ */
+
+void membar_any_any(void);
+void membar_store_store(void);
+void membar_load_load(void);
+void membar_load_store(void);
+
+MEMBAR_INLINE
+void
+membar_any_any(void)
+{
+	__asm volatile(
+		".set push;"		/* save assembler mode */
+		".set mips32;"		/* allow MIPS32 instructions */
+		"sync;"			/* do it */
+		".set pop"		/* restore assembler mode */
+		: : : "memory");
+}
+
+MEMBAR_INLINE
+void
+membar_store_store(void)
+{
+	membar_any_any();
+}
+
+MEMBAR_INLINE
+void
+membar_load_load(void)
+{
+	membar_any_any();
+}
+
+MEMBAR_INLINE
+void
+membar_load_store(void)
+{
+	membar_any_any();
+}
+
+
+#endif /* _MIPS_MEMBAR_H_ */
@@ -39,6 +39,8 @@
 #include <vm.h>
 #include <mainbus.h>
 #include <syscall.h>
+#include <region.h>
+#include <softirq.h>
 
 
 /* in exception.S */
@@ -66,6 +68,22 @@ static const char *const trapcodenames[NTRAPCODES] = {
 	"Arithmetic overflow",
 };
 
+/*
+ * Call vm_fault, timed as a measurement region.
+ */
+static
+int
+trap_vmfault(int faulttype, vaddr_t faultaddress)
+{
+	uint64_t start;
+	int result;
+
+	start = REGION_BEGIN(RG_VM_FAULT);
+	result = vm_fault(faulttype, faultaddress);
+	REGION_END(RG_VM_FAULT, start);
+	return result;
+}
+
 /*
  * Function called when user-level code hits a fatal fault.
  */
@@ -156,6 +174,10 @@ mips_trap(struct trapframe *tf)
 		old_in = curthread->t_in_interrupt;
 		curthread->t_in_interrupt = 1;
 
+		/* Where we were interrupted, for the sampling profiler */
+		curcpu->c_intrpc = tf->tf_epc;
+		curcpu->c_intruser = !iskern;
+
 		/*
 		 * The processor has turned interrupts off; if the
 		 * currently recorded interrupt state is interrupts on
@@ -191,6 +213,13 @@ mips_trap(struct trapframe *tf)
 			KASSERT(curthread->t_iplhigh_count == 1);
 			curthread->t_iplhigh_count--;
 			curthread->t_curspl = 0;
+
+			/*
+			 * What we interrupted had interrupts on, so it
+			 * holds no spinlocks; finish the work the
+			 * handlers deferred now.
+			 */
+			softirq_dispatch();
 		}
 
 		curthread->t_in_interrupt = old_in;
@@ -231,17 +260,17 @@ mips_trap(struct trapframe *tf)
 	 */
 	switch (code) {
 	case EX_MOD:
-		if (vm_fault(VM_FAULT_READONLY, tf->tf_vaddr)==0) {
+		if (trap_vmfault(VM_FAULT_READONLY, tf->tf_vaddr)==0) {
 			goto done;
 		}
 		break;
 	case EX_TLBL:
-		if (vm_fault(VM_FAULT_READ, tf->tf_vaddr)==0) {
+		if (trap_vmfault(VM_FAULT_READ, tf->tf_vaddr)==0) {
 			goto done;
 		}
 		break;
 	case EX_TLBS:
-		if (vm_fault(VM_FAULT_WRITE, tf->tf_vaddr)==0) {
+		if (trap_vmfault(VM_FAULT_WRITE, tf->tf_vaddr)==0) {
 			goto done;
 		}
 		break;
@@ -31,10 +31,12 @@
 #include <kern/errno.h>
 #include <kern/syscall.h>
 #include <lib.h>
+#include <copyinout.h>
 #include <mips/trapframe.h>
 #include <thread.h>
 #include <current.h>
 #include <syscall.h>
+#include <trace.h>
 #include <kern/wait.h> /* New include of wait macros for _exit */
 
 /*
@@ -80,6 +82,8 @@ syscall(struct trapframe *tf)
 {
 	int callno;
 	int32_t retval;
+	off_t pos;
+	int whence;
 	int err;
 
 	KASSERT(curthread != NULL);
@@ -87,6 +91,7 @@ syscall(struct trapframe *tf)
 	KASSERT(curthread->t_iplhigh_count == 0);
 
 	callno = tf->tf_v0;
+	TRACE(TP_SYSCALL, callno, tf->tf_a0, tf->tf_a1, tf->tf_a2);
 
 	/*
 	 * Initialize retval to 0. Many of the system calls don't
@@ -109,6 +114,11 @@ syscall(struct trapframe *tf)
 				     (userptr_t)tf->tf_a1);
 		    break;
 
+	    case SYS_nanosleep:
+		    err = sys_nanosleep((userptr_t)tf->tf_a0,
+					(userptr_t)tf->tf_a1);
+		    break;
+
             /* ASST1: These implementations of read and write only work for
              * console I/O (stdin, stdout and stderr file descriptors)
              */
@@ -122,6 +132,58 @@ syscall(struct trapframe *tf)
                                 &retval);
                 break;
 
+	    case SYS_open:
+		    err = sys_open((userptr_t)tf->tf_a0, tf->tf_a1, tf->tf_a2,
+				   &retval);
+		    break;
+
+	    case SYS_close:
+		    err = sys_close(tf->tf_a0);
+		    break;
+
+	    case SYS_lseek:
+		    /* pos is in a2/a3; whence is on the stack */
+		    err = copyin((const_userptr_t)(tf->tf_sp + 16), &whence,
+				 sizeof(int));
+		    if (err) {
+			    break;
+		    }
+		    err = sys_lseek(tf->tf_a0,
+				    ((off_t)tf->tf_a2 << 32) | tf->tf_a3,
+				    whence, &pos);
+		    if (!err) {
+			    /* 64-bit result in v0/v1 */
+			    retval = (uint32_t)(pos >> 32);
+			    tf->tf_v1 = (uint32_t)pos;
+		    }
+		    break;
+
+	    case SYS_fsync:
+		    err = sys_fsync(tf->tf_a0);
+		    break;
+
+	    case SYS_fstat:
+		    err = sys_fstat(tf->tf_a0, (userptr_t)tf->tf_a1);
+		    break;
+
+	    case SYS_stat:
+		    err = sys_stat((userptr_t)tf->tf_a0, (userptr_t)tf->tf_a1);
+		    break;
+
+	    case SYS_remove:
+		    err = sys_remove((userptr_t)tf->tf_a0);
+		    break;
+
+	    case SYS_ioring_setup:
+		    err = sys_ioring_setup(tf->tf_a0, tf->tf_a1,
+					   (userptr_t)tf->tf_a2);
+		    break;
+
+	    case SYS_ioring_enter:
+		    err = sys_ioring_enter(tf->tf_a0, tf->tf_a1, tf->tf_a2,
+					   &retval);
+		    break;
+
 	    /* process calls */
 	
 	    case SYS__exit:
@@ -134,6 +196,29 @@ syscall(struct trapframe *tf)
 		    	err = sys_fork(tf, &retval);
 		    break;
 
+	    case SYS_execv:
+		    err = sys_execv((userptr_t)tf->tf_a0,
+				    (userptr_t)tf->tf_a1);
+		    break;
+
+	    case SYS_sbrk:
+		    err = sys_sbrk((intptr_t)tf->tf_a0, &retval);
+		    break;
+
+	    case SYS___vmstat:
+		    err = sys___vmstat(tf->tf_a0, (userptr_t)tf->tf_a1);
+		    break;
+
+	    case SYS___threadlist:
+		    err = sys___threadlist((userptr_t)tf->tf_a0, tf->tf_a1,
+					   &retval);
+		    break;
+
+	    case SYS___threadfork:
+		    err = sys___threadfork(tf, (userptr_t)tf->tf_a0,
+					   (userptr_t)tf->tf_a1, &retval);
+		    break;
+
             /* ASST1 - You need to fill in the code for each of these cases */
             case SYS_getpid:
             	retval = sys_getpid();
@@ -153,6 +238,8 @@ syscall(struct trapframe *tf)
 	}
 
 
+	TRACE(TP_SYSRET, callno, err, retval, 0);
+
 	if (err) {
 		/*
 		 * Return the error code. This gets converted at
@@ -211,3 +298,23 @@ enter_forked_process(void *data1, unsigned long unused)
 
 	mips_usermode(&local_tf);
 }
+
+/*
+ * enter_new_thread
+ * Like enter_forked_process, but the trapframe was built by
+ * sys___threadfork to start at the thread's entry point, so the PC
+ * is not advanced.
+ */
+void
+enter_new_thread(void *data1, unsigned long data2)
+{
+	struct trapframe local_tf;
+
+	local_tf = *(struct trapframe *)data1;
+	kfree(data1);
+
+	/* Remember our user stack so thread_exit can give it back */
+	curthread->t_ustack = data2;
+
+	mips_usermode(&local_tf);
+}
@@ -34,9 +34,11 @@
 #include <spinlock.h>
 #include <thread.h>
 #include <current.h>
+#include <cpu.h>
 #include <mips/tlb.h>
 #include <addrspace.h>
 #include <vm.h>
+#include <trace.h>
 
 /*
  * Dumb MIPS-only "VM system" that is intended to only be just barely
@@ -45,8 +47,48 @@
  * assignment, this file is not included in your kernel!
  */
 
-/* under dumbvm, always have 48k of user stack */
+/*
+ * under dumbvm, have 48k of user stack, or when exec arguments are big
+ * enough to need it (see as_reserve_stack), 16k more than they take,
+ * up to 80k: room for a full ARG_MAX. Address space below the stack is
+ * laid out for the largest.
+ */
 #define DUMBVM_STACKPAGES    12
+#define DUMBVM_STACKSLACK    4
+#define DUMBVM_MAXSTACKPAGES 20
+
+/*
+ * Additional threads get 16k stacks below the main one, each with an
+ * unmapped guard page above it. Shared mappings must stay below all
+ * of them.
+ */
+#define DUMBVM_TSTACKPAGES   4
+#define DUMBVM_TSTACKBASE(i) \
+	(USERSTACK - (DUMBVM_MAXSTACKPAGES + \
+		      ((i)+1) * (DUMBVM_TSTACKPAGES+1)) * PAGE_SIZE)
+#define DUMBVM_SHAREDTOP     DUMBVM_TSTACKBASE(AS_NTHREADSTACKS-1)
+
+/*
+ * The sbrk heap can't grow in place, since pages here are physically
+ * contiguous per region, so it gets a fixed 128k (or the whole first
+ * request, if bigger) the first time it is grown. Processes that never
+ * call sbrk pay nothing.
+ */
+#define DUMBVM_HEAPPAGES     32
+
+/*
+ * Count a VM event against AS (if any) and this cpu. Call at splhigh
+ * so we stay on the same cpu. The address space counts aren't locked,
+ * so threads of one process faulting on two cpus at once can lose a
+ * count; that's fine for statistics.
+ */
+#define VM_COUNT(as, field) \
+	do { \
+		curcpu->c_vmstat.field++; \
+		if ((as) != NULL) { \
+			(as)->as_vmstat.field++; \
+		} \
+	} while (0)
 
 /*
  * Wrap rma_stealmem in a spinlock.
@@ -93,37 +135,116 @@ free_kpages(vaddr_t addr)
 	(void)addr;
 }
 
+/*
+ * dumbvm doesn't track which TLB entries hold what, so any shootdown
+ * flushes the whole TLB, as as_activate does.
+ */
 void
 vm_tlbshootdown_all(void)
 {
-	panic("dumbvm tried to do tlb shootdown?!\n");
+	int i, spl;
+
+	spl = splhigh();
+	for (i=0; i<NUM_TLB; i++) {
+		tlb_write(TLBHI_INVALID(i), TLBLO_INVALID(), i);
+	}
+	splx(spl);
 }
 
 void
 vm_tlbshootdown(const struct tlbshootdown *ts)
 {
 	(void)ts;
-	panic("dumbvm tried to do tlb shootdown?!\n");
+	vm_tlbshootdown_all();
+}
+
+/*
+ * Look up FAULTADDRESS in the shared mappings. Hands back the
+ * physical address and the TLBLO_DIRTY bit to use.
+ */
+static
+int
+as_find_shared(struct addrspace *as, vaddr_t faultaddress,
+	       paddr_t *paddr, uint32_t *dirty)
+{
+	vaddr_t base, top;
+	int i;
+
+	for (i=0; i<AS_NSHARED; i++) {
+		base = as->as_shared[i].sm_vbase;
+		if (base == 0) {
+			continue;
+		}
+		top = base + as->as_shared[i].sm_npages * PAGE_SIZE;
+		if (faultaddress >= base && faultaddress < top) {
+			*paddr = (faultaddress - base) +
+				as->as_shared[i].sm_pbase;
+			*dirty = as->as_shared[i].sm_writeable ?
+				TLBLO_DIRTY : 0;
+			return 0;
+		}
+	}
+	return EFAULT;
+}
+
+/*
+ * Look up FAULTADDRESS in the extra thread stacks.
+ */
+static
+int
+as_find_tstack(struct addrspace *as, vaddr_t faultaddress, paddr_t *paddr)
+{
+	vaddr_t base;
+	int i;
+
+	if (faultaddress < DUMBVM_SHAREDTOP ||
+	    faultaddress >= USERSTACK - DUMBVM_MAXSTACKPAGES * PAGE_SIZE) {
+		return EFAULT;
+	}
+
+	for (i=0; i<AS_NTHREADSTACKS; i++) {
+		if (!as->as_tstacks[i].ts_inuse) {
+			continue;
+		}
+		base = DUMBVM_TSTACKBASE(i);
+		if (faultaddress >= base &&
+		    faultaddress < base + DUMBVM_TSTACKPAGES * PAGE_SIZE) {
+			*paddr = (faultaddress - base) +
+				as->as_tstacks[i].ts_pbase;
+			return 0;
+		}
+	}
+	return EFAULT;
 }
 
 int
 vm_fault(int faulttype, vaddr_t faultaddress)
 {
-	vaddr_t vbase1, vtop1, vbase2, vtop2, stackbase, stacktop;
+	vaddr_t vbase1, vtop1, vbase2, vtop2, stackbase, stacktop, heaptop;
 	paddr_t paddr;
 	int i;
-	uint32_t ehi, elo;
+	uint32_t ehi, elo, dirty;
 	struct addrspace *as;
 	int spl;
 
 	faultaddress &= PAGE_FRAME;
 
 	DEBUG(DB_VM, "dumbvm: fault: 0x%x\n", faultaddress);
+	TRACE(TP_VM_FAULT, faulttype, faultaddress, 0, 0);
+
+	as = curthread->t_addrspace;
+
+	spl = splhigh();
+	VM_COUNT(as, vs_faults);
+	splx(spl);
 
 	switch (faulttype) {
 	    case VM_FAULT_READONLY:
-		/* We always create pages read-write, so we can't get this */
-		panic("dumbvm: got VM_FAULT_READONLY\n");
+		/*
+		 * Only read-only shared mappings (as_map_shared) are
+		 * entered without TLBLO_DIRTY; writing one is an error.
+		 */
+		return EFAULT;
 	    case VM_FAULT_READ:
 	    case VM_FAULT_WRITE:
 		break;
@@ -131,7 +252,6 @@ vm_fault(int faulttype, vaddr_t faultaddress)
 		return EINVAL;
 	}
 
-	as = curthread->t_addrspace;
 	if (as == NULL) {
 		/*
 		 * No address space set up. This is probably a kernel
@@ -159,9 +279,11 @@ vm_fault(int faulttype, vaddr_t faultaddress)
 	vtop1 = vbase1 + as->as_npages1 * PAGE_SIZE;
 	vbase2 = as->as_vbase2;
 	vtop2 = vbase2 + as->as_npages2 * PAGE_SIZE;
-	stackbase = USERSTACK - DUMBVM_STACKPAGES * PAGE_SIZE;
+	stackbase = USERSTACK - as->as_stackpages * PAGE_SIZE;
 	stacktop = USERSTACK;
+	heaptop = (as->as_heapend + PAGE_SIZE - 1) & PAGE_FRAME;
 
+	dirty = TLBLO_DIRTY;
 	if (faultaddress >= vbase1 && faultaddress < vtop1) {
 		paddr = (faultaddress - vbase1) + as->as_pbase1;
 	}
@@ -171,7 +293,13 @@ vm_fault(int faulttype, vaddr_t faultaddress)
 	else if (faultaddress >= stackbase && faultaddress < stacktop) {
 		paddr = (faultaddress - stackbase) + as->as_stackpbase;
 	}
-	else {
+	else if (faultaddress >= as->as_heapbase && faultaddress < heaptop) {
+		paddr = (faultaddress - as->as_heapbase) + as->as_heappbase;
+	}
+	else if (as_find_tstack(as, faultaddress, &paddr) == 0) {
+		/* paddr set */
+	}
+	else if (as_find_shared(as, faultaddress, &paddr, &dirty) != 0) {
 		return EFAULT;
 	}
 
@@ -183,25 +311,32 @@ vm_fault(int faulttype, vaddr_t faultaddress)
 
 	for (i=0; i<NUM_TLB; i++) {
 		tlb_read(&ehi, &elo, i);
-		if (elo & TLBLO_VALID) {
-			continue;
+		if (!(elo & TLBLO_VALID)) {
+			break;
 		}
-		ehi = faultaddress;
-		elo = paddr | TLBLO_DIRTY | TLBLO_VALID;
-		DEBUG(DB_VM, "dumbvm: 0x%x -> 0x%x\n", faultaddress, paddr);
+	}
+
+	ehi = faultaddress;
+	elo = paddr | dirty | TLBLO_VALID;
+	DEBUG(DB_VM, "dumbvm: 0x%x -> 0x%x\n", faultaddress, paddr);
+	if (i < NUM_TLB) {
 		tlb_write(ehi, elo, i);
-		splx(spl);
-		return 0;
 	}
+	else {
+		/* TLB full; throw out a random entry */
+		tlb_random(ehi, elo);
+		VM_COUNT(as, vs_tlbevicts);
+	}
+	VM_COUNT(as, vs_tlbfills);
 
-	kprintf("dumbvm: Ran out of TLB entries - cannot handle page fault\n");
 	splx(spl);
-	return EFAULT;
+	return 0;
 }
 
 struct addrspace *
 as_create(void)
 {
+	int i;
 	struct addrspace *as = kmalloc(sizeof(struct addrspace));
 	if (as==NULL) {
 		return NULL;
@@ -214,6 +349,21 @@ as_create(void)
 	as->as_pbase2 = 0;
 	as->as_npages2 = 0;
 	as->as_stackpbase = 0;
+	as->as_stackpages = DUMBVM_STACKPAGES;
+	as->as_heapbase = 0;
+	as->as_heapend = 0;
+	as->as_heappbase = 0;
+	as->as_heappages = 0;
+	for (i=0; i<AS_NSHARED; i++) {
+		as->as_shared[i].sm_vbase = 0;
+	}
+	for (i=0; i<AS_NTHREADSTACKS; i++) {
+		as->as_tstacks[i].ts_pbase = 0;
+		as->as_tstacks[i].ts_inuse = false;
+	}
+	bzero(&as->as_vmstat, sizeof(as->as_vmstat));
+	spinlock_init(&as->as_reflock);
+	as->as_refcount = 1;
 
 	return as;
 }
@@ -221,26 +371,69 @@ as_create(void)
 void
 as_destroy(struct addrspace *as)
 {
+	KASSERT(as->as_refcount <= 1);
+	spinlock_cleanup(&as->as_reflock);
 	kfree(as);
 }
 
+void
+as_incref(struct addrspace *as)
+{
+	spinlock_acquire(&as->as_reflock);
+	KASSERT(as->as_refcount > 0);
+	as->as_refcount++;
+	spinlock_release(&as->as_reflock);
+}
+
+unsigned
+as_decref(struct addrspace *as)
+{
+	unsigned ret;
+
+	spinlock_acquire(&as->as_reflock);
+	KASSERT(as->as_refcount > 0);
+	ret = --as->as_refcount;
+	spinlock_release(&as->as_reflock);
+	return ret;
+}
+
 void
 as_activate(struct addrspace *as)
 {
 	int i, spl;
 
-	(void)as;
-
 	/* Disable interrupts on this CPU while frobbing the TLB. */
 	spl = splhigh();
 
 	for (i=0; i<NUM_TLB; i++) {
 		tlb_write(TLBHI_INVALID(i), TLBLO_INVALID(), i);
 	}
+	VM_COUNT(as, vs_tlbflushes);
 
 	splx(spl);
 }
 
+void
+vm_getstat(struct addrspace *as, struct vmstat *vs)
+{
+	struct cpu *c;
+	unsigned i;
+
+	if (as != NULL) {
+		*vs = as->as_vmstat;
+		return;
+	}
+
+	bzero(vs, sizeof(*vs));
+	for (i=0; i<cpu_numcpus(); i++) {
+		c = cpu_getcpu(i);
+		vs->vs_faults += c->c_vmstat.vs_faults;
+		vs->vs_tlbfills += c->c_vmstat.vs_tlbfills;
+		vs->vs_tlbevicts += c->c_vmstat.vs_tlbevicts;
+		vs->vs_tlbflushes += c->c_vmstat.vs_tlbflushes;
+	}
+}
+
 int
 as_define_region(struct addrspace *as, vaddr_t vaddr, size_t sz,
 		 int readable, int writeable, int executable)
@@ -304,14 +497,14 @@ as_prepare_load(struct addrspace *as)
 		return ENOMEM;
 	}
 
-	as->as_stackpbase = getppages(DUMBVM_STACKPAGES);
+	as->as_stackpbase = getppages(as->as_stackpages);
 	if (as->as_stackpbase == 0) {
 		return ENOMEM;
 	}
 	
 	as_zero_region(as->as_pbase1, as->as_npages1);
 	as_zero_region(as->as_pbase2, as->as_npages2);
-	as_zero_region(as->as_stackpbase, DUMBVM_STACKPAGES);
+	as_zero_region(as->as_stackpbase, as->as_stackpages);
 
 	return 0;
 }
@@ -319,7 +512,30 @@ as_prepare_load(struct addrspace *as)
 int
 as_complete_load(struct addrspace *as)
 {
-	(void)as;
+	vaddr_t top1, top2;
+
+	/* The heap starts empty, just above the program */
+	top1 = as->as_vbase1 + as->as_npages1 * PAGE_SIZE;
+	top2 = as->as_vbase2 + as->as_npages2 * PAGE_SIZE;
+	as->as_heapbase = top1 > top2 ? top1 : top2;
+	as->as_heapend = as->as_heapbase;
+	return 0;
+}
+
+int
+as_reserve_stack(struct addrspace *as, size_t bytes)
+{
+	size_t npages;
+
+	KASSERT(as->as_stackpbase == 0);
+
+	npages = (bytes + PAGE_SIZE - 1) / PAGE_SIZE + DUMBVM_STACKSLACK;
+	if (npages > DUMBVM_MAXSTACKPAGES) {
+		return E2BIG;
+	}
+	if (npages > as->as_stackpages) {
+		as->as_stackpages = npages;
+	}
 	return 0;
 }
 
@@ -332,10 +548,175 @@ as_define_stack(struct addrspace *as, vaddr_t *stackptr)
 	return 0;
 }
 
+int
+as_map_shared(struct addrspace *as, vaddr_t vaddr, paddr_t paddr,
+	      size_t npages, int writeable)
+{
+	vaddr_t top;
+	int i, slot;
+
+	KASSERT((vaddr & PAGE_FRAME) == vaddr);
+	KASSERT((paddr & PAGE_FRAME) == paddr);
+	KASSERT(npages > 0);
+
+	top = vaddr + npages * PAGE_SIZE;
+	if (top <= vaddr || top > DUMBVM_SHAREDTOP) {
+		return EINVAL;
+	}
+
+	slot = -1;
+	for (i=0; i<AS_NSHARED; i++) {
+		if (as->as_shared[i].sm_vbase == vaddr) {
+			return EEXIST;
+		}
+		if (slot < 0 && as->as_shared[i].sm_vbase == 0) {
+			slot = i;
+		}
+	}
+	if (slot < 0) {
+		kprintf("dumbvm: Warning: too many shared mappings\n");
+		return ENOMEM;
+	}
+
+	as->as_shared[slot].sm_vbase = vaddr;
+	as->as_shared[slot].sm_pbase = paddr;
+	as->as_shared[slot].sm_npages = npages;
+	as->as_shared[slot].sm_writeable = writeable;
+	return 0;
+}
+
+paddr_t
+as_unmap_shared(struct addrspace *as, vaddr_t vaddr)
+{
+	const struct tlbshootdown ts = { 0 };
+	int i;
+
+	for (i=0; i<AS_NSHARED; i++) {
+		if (as->as_shared[i].sm_vbase == vaddr) {
+			as->as_shared[i].sm_vbase = 0;
+			if (as == curthread->t_addrspace) {
+				as_activate(as);
+			}
+			/*
+			 * Other threads in AS may be on other CPUs. The
+			 * flush is asynchronous, but dumbvm never reuses
+			 * the pages, so until it lands a stale entry only
+			 * reaches memory nobody else owns.
+			 */
+			if (as->as_refcount > 1) {
+				ipi_tlbshootdown_broadcast(&ts);
+			}
+			return as->as_shared[i].sm_pbase;
+		}
+	}
+	return 0;
+}
+
+/*
+ * Thread stacks are handed out under this lock, since other threads
+ * in the address space may be doing the same.
+ */
+static struct spinlock tstack_lock = SPINLOCK_INITIALIZER;
+
+int
+as_define_thread_stack(struct addrspace *as, vaddr_t *stackptr, int *slot)
+{
+	paddr_t pbase;
+	int i;
+
+	spinlock_acquire(&tstack_lock);
+	for (i=0; i<AS_NTHREADSTACKS; i++) {
+		if (!as->as_tstacks[i].ts_inuse) {
+			break;
+		}
+	}
+	if (i == AS_NTHREADSTACKS) {
+		spinlock_release(&tstack_lock);
+		return ENOMEM;
+	}
+	as->as_tstacks[i].ts_inuse = true;
+	pbase = as->as_tstacks[i].ts_pbase;
+	spinlock_release(&tstack_lock);
+
+	/* dumbvm never frees memory, so a slot keeps its pages for reuse */
+	if (pbase == 0) {
+		pbase = getppages(DUMBVM_TSTACKPAGES);
+		if (pbase == 0) {
+			spinlock_acquire(&tstack_lock);
+			as->as_tstacks[i].ts_inuse = false;
+			spinlock_release(&tstack_lock);
+			return ENOMEM;
+		}
+		as->as_tstacks[i].ts_pbase = pbase;
+	}
+	as_zero_region(pbase, DUMBVM_TSTACKPAGES);
+
+	*stackptr = DUMBVM_TSTACKBASE(i) + DUMBVM_TSTACKPAGES * PAGE_SIZE;
+	*slot = i;
+	return 0;
+}
+
+void
+as_release_thread_stack(struct addrspace *as, int slot)
+{
+	KASSERT(slot >= 0 && slot < AS_NTHREADSTACKS);
+
+	spinlock_acquire(&tstack_lock);
+	KASSERT(as->as_tstacks[slot].ts_inuse);
+	as->as_tstacks[slot].ts_inuse = false;
+	spinlock_release(&tstack_lock);
+}
+
+/*
+ * Like libc's malloc, this assumes the program's threads don't call
+ * it at the same time.
+ */
+int
+as_sbrk(struct addrspace *as, intptr_t amount, vaddr_t *oldbreak)
+{
+	size_t used, npages;
+
+	if (as->as_heapbase == 0) {
+		/* No program loaded */
+		return EINVAL;
+	}
+
+	used = as->as_heapend - as->as_heapbase;
+	if (amount < 0 && (size_t)-amount > used) {
+		return EINVAL;
+	}
+
+	if (amount > 0 && as->as_heappbase == 0) {
+		npages = ((size_t)amount + PAGE_SIZE - 1) / PAGE_SIZE;
+		if (npages < DUMBVM_HEAPPAGES) {
+			npages = DUMBVM_HEAPPAGES;
+		}
+		as->as_heappbase = getppages(npages);
+		if (as->as_heappbase == 0) {
+			return ENOMEM;
+		}
+		as_zero_region(as->as_heappbase, npages);
+		as->as_heappages = npages;
+	}
+	if (amount > 0 &&
+	    (size_t)amount > as->as_heappages * PAGE_SIZE - used) {
+		return ENOMEM;
+	}
+
+	*oldbreak = as->as_heapend;
+	as->as_heapend += amount;
+	if (amount < 0) {
+		/* Drop any TLB entries for the pages given back */
+		as_activate(as);
+	}
+	return 0;
+}
+
 int
 as_copy(struct addrspace *old, struct addrspace **ret)
 {
 	struct addrspace *new;
+	int i;
 
 	new = as_create();
 	if (new==NULL) {
@@ -346,6 +727,11 @@ as_copy(struct addrspace *old, struct addrspace **ret)
 	new->as_npages1 = old->as_npages1;
 	new->as_vbase2 = old->as_vbase2;
 	new->as_npages2 = old->as_npages2;
+	new->as_heapbase = old->as_heapbase;
+	new->as_heapend = old->as_heapend;
+	new->as_heappages = old->as_heappages;
+	new->as_stackpages = old->as_stackpages;
+	/* Shared mappings belong to their owner and are not inherited. */
 
 	/* (Mis)use as_prepare_load to allocate some physical memory. */
 	if (as_prepare_load(new)) {
@@ -367,7 +753,38 @@ as_copy(struct addrspace *old, struct addrspace **ret)
 
 	memmove((void *)PADDR_TO_KVADDR(new->as_stackpbase),
 		(const void *)PADDR_TO_KVADDR(old->as_stackpbase),
-		DUMBVM_STACKPAGES*PAGE_SIZE);
+		old->as_stackpages*PAGE_SIZE);
+
+	if (old->as_heappbase != 0) {
+		new->as_heappbase = getppages(old->as_heappages);
+		if (new->as_heappbase == 0) {
+			as_destroy(new);
+			return ENOMEM;
+		}
+		memmove((void *)PADDR_TO_KVADDR(new->as_heappbase),
+			(const void *)PADDR_TO_KVADDR(old->as_heappbase),
+			old->as_heappages*PAGE_SIZE);
+	}
+
+	/*
+	 * The forking thread may be running on one of the extra stacks;
+	 * copy that one, which thread_fork gives the child as its
+	 * t_ustack. The other threads don't exist in the child, so
+	 * their slots stay free.
+	 */
+	i = curthread->t_ustack;
+	if (i >= 0) {
+		KASSERT(old->as_tstacks[i].ts_inuse);
+		new->as_tstacks[i].ts_pbase = getppages(DUMBVM_TSTACKPAGES);
+		if (new->as_tstacks[i].ts_pbase == 0) {
+			as_destroy(new);
+			return ENOMEM;
+		}
+		new->as_tstacks[i].ts_inuse = true;
+		memmove((void *)PADDR_TO_KVADDR(new->as_tstacks[i].ts_pbase),
+			(const void *)PADDR_TO_KVADDR(old->as_tstacks[i].ts_pbase),
+			DUMBVM_TSTACKPAGES*PAGE_SIZE);
+	}
 	
 	*ret = new;
 	return 0;
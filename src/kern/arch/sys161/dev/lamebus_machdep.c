@@ -73,6 +73,49 @@ mips_timer_set(uint32_t count)
 		:: "r" (count));
 }
 
+/*
+ * Read c0_count. With the timer set up as above it counts cycles
+ * since the last timer interrupt.
+ */
+static
+uint32_t
+mips_timer_get(void)
+{
+	uint32_t count;
+
+	/* $9 == c0_count */
+	__asm volatile(
+		".set push;"
+		".set mips32;"
+		"mfc0 %0, $9;"
+		".set pop"
+		: "=r" (count));
+	return count;
+}
+
+/*
+ * Cycles so far: whole hardclock periods plus how far we are into
+ * the current one.
+ */
+uint64_t
+mainbus_cycles(void)
+{
+	uint64_t cycles;
+	int spl;
+
+	spl = splhigh();
+	cycles = (uint64_t)curcpu->c_hardclocks * (CPU_FREQUENCY / HZ)
+		+ mips_timer_get();
+	splx(spl);
+	return cycles;
+}
+
+uint32_t
+mainbus_cyclefreq(void)
+{
+	return CPU_FREQUENCY;
+}
+
 /*
  * LAMEbus data for the system. (We have only one LAMEbus per system.)
  * This does not need to be locked, because it's constant once
@@ -242,6 +285,27 @@ mainbus_send_ipi(struct cpu *target)
 	lamebus_assert_ipi(lamebus, target);
 }
 
+/*
+ * Interrupt statistics.
+ */
+void
+mainbus_intrstats(void)
+{
+	lamebus_intrstats(lamebus);
+}
+
+void
+mainbus_intrreset(void)
+{
+	lamebus_intrreset(lamebus);
+}
+
+int
+mainbus_intrroute(uint32_t cpus)
+{
+	return lamebus_intrroute(lamebus, cpus);
+}
+
 /*
  * Interrupt dispatcher.
  */
@@ -0,0 +1,20 @@
+#!/bin/sh
+#
+# mkksyms.sh - emit ksyms.c, the kernel's table of text symbols, from
+#              "nm -n" output on standard input. Given no input, it
+#              emits an empty table, for the first link pass.
+#
+# Usage: $(NM) -n kernel | mkksyms.sh > ksyms.c
+#        mkksyms.sh < /dev/null > ksyms.c
+#
+
+echo '/* Automatically generated by mkksyms.sh; do not edit. */'
+echo '#include <types.h>'
+echo '#include <ksyms.h>'
+echo ''
+echo 'const struct ksym ksyms[] = {'
+awk '$2 == "T" || $2 == "t" { printf "\t{ 0x%s, \"%s\" },\n", $1, $3 }'
+echo '	{ 0, NULL }'
+echo '};'
+echo ''
+echo 'const unsigned ksyms_count = sizeof(ksyms) / sizeof(ksyms[0]) - 1;'
@@ -140,39 +140,35 @@ int
 getch_intr(struct con_softc *cs)
 {
 	unsigned char ret;
+	bool got;
 
 	P(cs->cs_rsem);
-	ret = cs->cs_gotchars[cs->cs_gotchars_tail];
-	cs->cs_gotchars_tail =
-		(cs->cs_gotchars_tail + 1) % CONSOLE_INPUT_BUFFER_SIZE;
+	got = mpscring_get(&cs->cs_gotchars, &ret);
+	KASSERT(got);
 	return ret;
 }
 
 /*
  * Called from underlying device when a read-ready interrupt occurs.
  *
- * Note: if gotchars_head == gotchars_tail, the buffer is empty. Thus
- * if gotchars_head+1 == gotchars_tail, the buffer is full. A slightly
- * tidier way to implement this check (that avoids wasting a slot,
- * too) would be with a second semaphore used with a nonblocking P,
- * but we don't have that in OS/161.
+ * Interrupts can be taken on more than one CPU, so this is a
+ * multiple-producer ring; getch, the consumer, takes characters out
+ * without locking against us. Each character in the ring gets a V on
+ * cs_rsem, from con_wakeup, so getch only tries to take one that's
+ * there.
  */
 void
 con_input(void *vcs, int ch)
 {
 	struct con_softc *cs = vcs;
-	unsigned nexthead;
+	unsigned char c = ch;
 
-	nexthead = (cs->cs_gotchars_head + 1) % CONSOLE_INPUT_BUFFER_SIZE;
-	if (nexthead == cs->cs_gotchars_tail) {
+	if (!mpscring_put(&cs->cs_gotchars, &c)) {
 		/* overflow; drop character */
 		return;
 	}
-
-	cs->cs_gotchars[cs->cs_gotchars_head] = ch;
-	cs->cs_gotchars_head = nexthead;
-		
-	V(cs->cs_rsem);
+	cs->cs_nread++;
+	softirq_raise(&cs->cs_softirq);
 }
 
 /*
@@ -183,7 +179,28 @@ con_start(void *vcs)
 {
 	struct con_softc *cs = vcs;
 
-	V(cs->cs_wsem);
+	cs->cs_nwritten++;
+	softirq_raise(&cs->cs_softirq);
+}
+
+/*
+ * Softirq: wake up readers and writers for what the interrupts above
+ * counted.
+ */
+static
+void
+con_wakeup(void *vcs)
+{
+	struct con_softc *cs = vcs;
+
+	while (cs->cs_nreadwoken != cs->cs_nread) {
+		cs->cs_nreadwoken++;
+		V(cs->cs_rsem);
+	}
+	while (cs->cs_nwrittenwoken != cs->cs_nwritten) {
+		cs->cs_nwrittenwoken++;
+		V(cs->cs_wsem);
+	}
 }
 
 //////////////////////////////////////////////////
@@ -386,8 +403,11 @@ config_con(struct con_softc *cs, int unit)
 
 	cs->cs_rsem = rsem; 
 	cs->cs_wsem = wsem; 
-	cs->cs_gotchars_head = 0;
-	cs->cs_gotchars_tail = 0;
+	mpscring_init(&cs->cs_gotchars, cs->cs_gotcharsbuf,
+		      CONSOLE_INPUT_BUFFER_SIZE, 1);
+	cs->cs_nread = cs->cs_nwritten = 0;
+	cs->cs_nreadwoken = cs->cs_nwrittenwoken = 0;
+	softirq_init(&cs->cs_softirq, "con", con_wakeup, cs);
 
 	the_console = cs;
 	con_userlock_read = rlk;
@@ -37,7 +37,10 @@
  * device, and are to be initialized by the attach routine.
  */
 
-#define CONSOLE_INPUT_BUFFER_SIZE 32
+#include <ring.h>
+#include <softirq.h>
+
+#define CONSOLE_INPUT_BUFFER_SIZE 32	/* must be a power of 2 */
 
 struct con_softc {
 	/* initialized by attach routine */
@@ -48,9 +51,16 @@ struct con_softc {
 	/* initialized by config routine */
 	struct semaphore *cs_rsem;
 	struct semaphore *cs_wsem;
-	unsigned char cs_gotchars[CONSOLE_INPUT_BUFFER_SIZE];
-	unsigned cs_gotchars_head;	/* next slot to put a char in */
-	unsigned cs_gotchars_tail;	/* next slot to take a char out */
+	struct mpscring cs_gotchars;	/* input, from interrupts */
+	unsigned char cs_gotcharsbuf[CONSOLE_INPUT_BUFFER_SIZE];
+
+	/*
+	 * The interrupt side counts characters in and writes done; the
+	 * softirq does a V for each one it hasn't done yet.
+	 */
+	struct softirq cs_softirq;
+	volatile unsigned cs_nread, cs_nwritten;	/* interrupt's */
+	unsigned cs_nreadwoken, cs_nwrittenwoken;	/* softirq's */
 };
 
 /*
@@ -52,6 +52,8 @@
 #include <platform/bus.h>
 #include <vfs.h>
 #include <emufs.h>
+#include <bootjob.h>
+#include <trace.h>
 #include "autoconf.h"
 
 /* Register offsets */
@@ -128,6 +130,18 @@ emu_irq(void *dev)
 	sc->e_result = emu_rreg(sc, REG_RESULT);
 	emu_wreg(sc, REG_RESULT, 0);
 
+	softirq_raise(&sc->e_softirq);
+}
+
+/*
+ * Softirq: wake up the thread waiting for the result.
+ */
+static
+void
+emu_wakeup(void *dev)
+{
+	struct emu_softc *sc = dev;
+
 	V(sc->e_sem);
 }
 
@@ -167,6 +181,7 @@ int
 emu_waitdone(struct emu_softc *sc)
 {
 	P(sc->e_sem);
+	TRACE(TP_EMU_WAITDONE, sc->e_unit, sc->e_result, 0, 0);
 	return translate_err(sc, sc->e_result);
 }
 
@@ -1324,16 +1339,28 @@ emufs_addtovfs(struct emu_softc *sc, const char *devname)
 //
 ////////////////////////////////////////////////////////////
 
+/*
+ * Boot job: add ourselves to the VFS layer.
+ */
+static
+int
+emu_attachfs(void *vsc)
+{
+	struct emu_softc *sc = vsc;
+	char name[32];
+
+	snprintf(name, sizeof(name), "emu%d", sc->e_unit);
+	return emufs_addtovfs(sc, name);
+}
+
 /*
  * Config routine called by autoconf stuff.
  *
- * Initialize our data, then add ourselves to the VFS layer.
+ * Initialize our data, then arrange to add ourselves to the VFS layer.
  */
 int
 config_emu(struct emu_softc *sc, int emuno)
 {
-	char name[32];
-
 	sc->e_lock = lock_create("emufs-lock");
 	if (sc->e_lock == NULL) {
 		return ENOMEM;
@@ -1346,7 +1373,13 @@ config_emu(struct emu_softc *sc, int emuno)
 	}
 	sc->e_iobuf = bus_map_area(sc->e_busdata, sc->e_buspos, EMU_BUFFER);
 
-	snprintf(name, sizeof(name), "emu%d", emuno);
+	softirq_init(&sc->e_softirq, "emu", emu_wakeup, sc);
 
-	return emufs_addtovfs(sc, name);
+	/*
+	 * Looking up the root directory means a round trip to the
+	 * device, so leave that to run alongside everything else once
+	 * the other cpus are up.
+	 */
+	bootjob_add("emu", emuno, emu_attachfs, sc);
+	return 0;
 }
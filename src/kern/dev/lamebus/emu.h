@@ -30,6 +30,7 @@
 #ifndef _LAMEBUS_EMU_H_
 #define _LAMEBUS_EMU_H_
 
+#include <softirq.h>
 
 #define EMU_MAXIO       16384
 #define EMU_ROOTHANDLE  0
@@ -49,6 +50,7 @@ struct emu_softc {
 	/* Initialized by config_emu() */
 	struct lock *e_lock;
 	struct semaphore *e_sem;
+	struct softirq e_softirq;	/* V()s e_sem */
 	void *e_iobuf;
 
 	/* Written by the interrupt handler */
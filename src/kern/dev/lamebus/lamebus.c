@@ -32,10 +32,12 @@
  */
 
 #include <types.h>
+#include <kern/errno.h>
 #include <lib.h>
 #include <cpu.h>
 #include <spinlock.h>
 #include <current.h>
+#include <mainbus.h>
 #include <lamebus/lamebus.h>
 
 /* Register offsets within each config region */
@@ -129,6 +131,7 @@ lamebus_find_cpus(struct lamebus_softc *lamebus)
 	uint32_t cpumask, self, bit, val;
 	unsigned i, numcpus, bootcpu;
 	unsigned hwnum[32];
+	struct cpu *c;
 
 	cpumask = read_ctl_register(lamebus, CTLREG_CPUS);
 	self = read_ctl_register(lamebus, CTLREG_SELF);
@@ -147,17 +150,20 @@ lamebus_find_cpus(struct lamebus_softc *lamebus)
 		}
 	}
 
+	lamebus->ls_cpuhwnum[0] = hwnum[bootcpu];
 	for (i=0; i<numcpus; i++) {
 		if (i != bootcpu) {
-			cpu_create(hwnum[i]);
+			c = cpu_create(hwnum[i]);
+			lamebus->ls_cpuhwnum[c->c_number] = hwnum[i];
 		}
 	}
+	lamebus->ls_ncpus = numcpus;
 
 	/*
-	 * By default, route all interrupts only to the boot cpu. We
-	 * could be arbitrarily more elaborate, up to things like
-	 * dynamic load balancing.
+	 * Until the other CPUs are running, route all interrupts only
+	 * to the boot cpu. lamebus_start_cpus moves them.
 	 */
+	lamebus->ls_irqcpus = 1;
 
 	for (i=0; i<numcpus; i++) {
 		if (i != bootcpu) {
@@ -168,6 +174,16 @@ lamebus_find_cpus(struct lamebus_softc *lamebus)
 		}
 		write_ctlcpu_register(lamebus, hwnum[i], CTLCPU_CIRQE, val);
 	}
+
+	lamebus->ls_irqstats = kmalloc(numcpus * LB_NSLOTS *
+				       sizeof(*lamebus->ls_irqstats));
+	if (lamebus->ls_irqstats == NULL) {
+		kprintf("lamebus: no memory for interrupt statistics\n");
+		return;
+	}
+	bzero(lamebus->ls_irqstats,
+	      numcpus * LB_NSLOTS * sizeof(*lamebus->ls_irqstats));
+	lamebus->ls_nirqstatcpus = numcpus;
 }
 
 /*
@@ -211,6 +227,57 @@ lamebus_start_cpus(struct lamebus_softc *lamebus)
 
 	/* Now, enable them all. */
 	write_ctl_register(lamebus, CTLREG_CPUE, cpumask);
+
+	/*
+	 * Move device interrupts off the boot cpu, which runs the menu
+	 * and whatever it starts, to the last one; so a disk or network
+	 * transfer doesn't keep interrupting the thread that's waiting
+	 * for the console. The new cpu takes them as soon as it turns
+	 * interrupts on; until then they just stay pending.
+	 */
+	if (lamebus->ls_ncpus > 1) {
+		lamebus_intrroute(lamebus,
+				  (uint32_t)1 << (lamebus->ls_ncpus - 1));
+	}
+}
+
+/*
+ * Change which CPUs take device interrupts. Turn on the new ones
+ * before turning off the old ones, so that there's never a moment
+ * when nobody is listening; with level-triggered interrupts that
+ * would only delay things, but there's no reason to.
+ */
+int
+lamebus_intrroute(struct lamebus_softc *lamebus, uint32_t cpus)
+{
+	uint32_t old;
+	unsigned i;
+
+	if (cpus == 0) {
+		return EINVAL;
+	}
+	if (lamebus->ls_ncpus < 32 && (cpus >> lamebus->ls_ncpus) != 0) {
+		return EINVAL;
+	}
+
+	spinlock_acquire(&lamebus->ls_lock);
+	old = lamebus->ls_irqcpus;
+	for (i=0; i<lamebus->ls_ncpus; i++) {
+		if ((cpus & ~old) & ((uint32_t)1 << i)) {
+			write_ctlcpu_register(lamebus, lamebus->ls_cpuhwnum[i],
+					      CTLCPU_CIRQE, 0xffffffff);
+		}
+	}
+	for (i=0; i<lamebus->ls_ncpus; i++) {
+		if ((old & ~cpus) & ((uint32_t)1 << i)) {
+			write_ctlcpu_register(lamebus, lamebus->ls_cpuhwnum[i],
+					      CTLCPU_CIRQE, 0);
+		}
+	}
+	lamebus->ls_irqcpus = cpus;
+	spinlock_release(&lamebus->ls_lock);
+
+	return 0;
 }
 
 /*
@@ -409,19 +476,29 @@ lamebus_interrupt(struct lamebus_softc *lamebus)
 	/*
 	 * Note that despite the fact that "spl" stands for "set
 	 * priority level", we don't actually support interrupt
-	 * priorities. When an interrupt happens, we look through the
-	 * slots to find the first interrupting device and call its
-	 * interrupt routine, no matter what that device is.
+	 * priorities. When an interrupt happens, we call the handler
+	 * of every slot that is interrupting, lowest slot first, no
+	 * matter what the devices are.
 	 *
 	 * Note that the entire LAMEbus uses only one on-cpu interrupt line. 
 	 * Thus, we do not use any on-cpu interrupt priority system either.
+	 *
+	 * If device interrupts are routed to more than one CPU, they all
+	 * get interrupted at once, and they all go through here. Only one
+	 * runs a given slot's handler at a time (ls_slotsbusy); the others
+	 * skip that slot, and if it's still asserting its interrupt when
+	 * they return, they come right back. By the time a CPU reads
+	 * the IRQ register, another one may have dealt with everything,
+	 * so finding nothing is only odd when there's just one CPU.
 	 */
 
 	int slot;
-	uint32_t mask;
 	uint32_t irqs;
 	void (*handler)(void *);
 	void *data;
+	struct lamebus_irqstat *stats, *st;
+	uint64_t start;
+	uint32_t cycles;
 
 	/* For keeping track of how many bogus things happen in a row. */
 	static int duds = 0;
@@ -430,22 +507,30 @@ lamebus_interrupt(struct lamebus_softc *lamebus)
 	/* and we better have a valid bus instance. */
 	KASSERT(lamebus != NULL);
 
-	/* Lock the softc */
-	spinlock_acquire(&lamebus->ls_lock);
+	stats = NULL;
+	if (lamebus->ls_irqstats != NULL) {
+		KASSERT(curcpu->c_number < lamebus->ls_nirqstatcpus);
+		stats = &lamebus->ls_irqstats[curcpu->c_number * LB_NSLOTS];
+	}
 
 	/*
 	 * Read the LAMEbus controller register that tells us which
-	 * slots are asserting an interrupt condition.
+	 * slots are asserting an interrupt condition. This is just a
+	 * register read; it needs no lock.
 	 */
 	irqs = read_ctl_register(lamebus, CTLREG_IRQS);
 
+	if (irqs == 0 && (lamebus->ls_irqcpus & (lamebus->ls_irqcpus - 1))) {
+		/* Another cpu got there first. */
+		return;
+	}
+
 	if (irqs == 0) {
 		/*
 		 * Huh? None of them? Must be a glitch.
 		 */
 		kprintf("lamebus: stray interrupt on cpu %u\n",
 			curcpu->c_number);
-		duds++;
 		duds_this_time++;
 
 		/*
@@ -462,61 +547,71 @@ lamebus_interrupt(struct lamebus_softc *lamebus)
 	}
 
 	/*
-	 * Go through the bits in the value we got back to see which
-	 * ones are set.
+	 * Take the pending slots lowest first, clearing each one's bit
+	 * as we go. Slots that start interrupting meanwhile will
+	 * interrupt again as soon as we return; LAMEbus interrupts
+	 * are level-triggered.
 	 */
-
-	for (mask=1, slot=0; slot<LB_NSLOTS; mask<<=1, slot++) {
-		if ((irqs & mask) == 0) {
-			/* Nope. */
-			continue;
-		}
+	while (irqs != 0) {
+		slot = ctz32(irqs);
+		irqs &= irqs - 1;
 
 		/*
-		 * This slot is signalling an interrupt.
+		 * Get the handler. The lock covers only this, so that
+		 * other CPUs can be handling other slots meanwhile.
 		 */
-			
-		if ((lamebus->ls_slotsinuse & mask)==0) {
+		spinlock_acquire(&lamebus->ls_lock);
+		if (lamebus->ls_slotsbusy & ((uint32_t)1 << slot)) {
+			/* Another cpu is in the handler already. */
+			spinlock_release(&lamebus->ls_lock);
+			continue;
+		}
+		if ((lamebus->ls_slotsinuse & ((uint32_t)1 << slot)) == 0) {
 			/*
 			 * No device driver is using this slot.
 			 */
-			duds++;
-			duds_this_time++;
-			continue;
+			handler = NULL;
 		}
-
-		if (lamebus->ls_irqfuncs[slot]==NULL) {
+		else {
 			/*
-			 * The device driver hasn't installed an interrupt
-			 * handler.
+			 * NULL if the device driver hasn't installed an
+			 * interrupt handler.
 			 */
-			duds++;
-			duds_this_time++;
-			continue;
+			handler = lamebus->ls_irqfuncs[slot];
 		}
-
-		/*
-		 * Call the interrupt handler. Release the spinlock
-		 * while we do so, in case other CPUs are handling
-		 * interrupts on other devices.
-		 */
-		handler = lamebus->ls_irqfuncs[slot];
 		data = lamebus->ls_devdata[slot];
+		if (handler != NULL) {
+			lamebus->ls_slotsbusy |= (uint32_t)1 << slot;
+		}
 		spinlock_release(&lamebus->ls_lock);
 
+		if (handler == NULL) {
+			duds_this_time++;
+			continue;
+		}
+
+		start = mainbus_cycles();
 		handler(data);
+		cycles = mainbus_cycles() - start;
 
 		spinlock_acquire(&lamebus->ls_lock);
+		lamebus->ls_slotsbusy &= ~((uint32_t)1 << slot);
+		spinlock_release(&lamebus->ls_lock);
 
-		/*
-		 * Reload the mask of pending IRQs - if we just called
-		 * hardclock, we might not have come back to this
-		 * context for some time, and it might have changed.
-		 */
-
-		irqs = read_ctl_register(lamebus, CTLREG_IRQS);
+		if (stats != NULL) {
+			st = &stats[slot];
+			st->li_count++;
+			st->li_cycles += cycles;
+			if (cycles > st->li_maxcycles) {
+				st->li_maxcycles = cycles;
+			}
+		}
 	}
 
+	if (duds_this_time == 0 && duds == 0) {
+		/* The usual case. (Reading duds unlocked is harmless.) */
+		return;
+	}
 
 	/*
 	 * If we get interrupts for a slot with no driver or no
@@ -536,6 +631,9 @@ lamebus_interrupt(struct lamebus_softc *lamebus)
 	 * clear the dud count.
 	 */
 
+	spinlock_acquire(&lamebus->ls_lock);
+	duds += duds_this_time;
+
 	if (duds_this_time == 0 && duds > 0) {
 		kprintf("lamebus: %d dud interrupts\n", duds);
 		duds = 0;
@@ -545,10 +643,109 @@ lamebus_interrupt(struct lamebus_softc *lamebus)
 		panic("lamebus: too many (%d) dud interrupts\n", duds);
 	}
 
-	/* Unlock the softc */
 	spinlock_release(&lamebus->ls_lock);
 }
 
+/*
+ * Print a cycle count as microseconds.
+ */
+static
+void
+lamebus_printus(uint64_t cycles, uint32_t mhz)
+{
+	uint64_t us;
+
+	us = cycles / mhz;
+	if (us > 0xffffffff) {
+		kprintf(" %10s", ">4G");
+	}
+	else {
+		kprintf(" %10u", (uint32_t)us);
+	}
+}
+
+/*
+ * Report interrupt statistics: for each slot that has taken any, the
+ * count, the mean and longest handler times, and how many each CPU
+ * took; then each CPU's totals.
+ */
+void
+lamebus_intrstats(struct lamebus_softc *lamebus)
+{
+	struct lamebus_irqstat sum, *st;
+	unsigned cpu, ncpus;
+	uint32_t mhz;
+	int slot;
+
+	ncpus = lamebus->ls_nirqstatcpus;
+	if (lamebus->ls_irqstats == NULL) {
+		kprintf("lamebus: no interrupt statistics\n");
+		return;
+	}
+	mhz = mainbus_cyclefreq() / 1000000;
+
+	kprintf("device interrupts go to cpu");
+	for (cpu=0; cpu<ncpus; cpu++) {
+		if (lamebus->ls_irqcpus & ((uint32_t)1 << cpu)) {
+			kprintf(" %u", cpu);
+		}
+	}
+	kprintf("\n");
+	kprintf("%-4s %-10s %10s %10s %10s  %s\n", "slot", "handler",
+		"count", "mean(us)", "max(us)", "per cpu");
+	for (slot=0; slot<LB_NSLOTS; slot++) {
+		bzero(&sum, sizeof(sum));
+		for (cpu=0; cpu<ncpus; cpu++) {
+			st = &lamebus->ls_irqstats[cpu * LB_NSLOTS + slot];
+			sum.li_count += st->li_count;
+			sum.li_cycles += st->li_cycles;
+			if (st->li_maxcycles > sum.li_maxcycles) {
+				sum.li_maxcycles = st->li_maxcycles;
+			}
+		}
+		if (sum.li_count == 0) {
+			continue;
+		}
+		kprintf("%-4d %10p %10u", slot, lamebus->ls_irqfuncs[slot],
+			sum.li_count);
+		lamebus_printus(sum.li_cycles / sum.li_count, mhz);
+		lamebus_printus(sum.li_maxcycles, mhz);
+		kprintf(" ");
+		for (cpu=0; cpu<ncpus; cpu++) {
+			st = &lamebus->ls_irqstats[cpu * LB_NSLOTS + slot];
+			kprintf(" %u", st->li_count);
+		}
+		kprintf("\n");
+	}
+
+	kprintf("%-4s %10s %10s\n", "cpu", "count", "total(us)");
+	for (cpu=0; cpu<ncpus; cpu++) {
+		bzero(&sum, sizeof(sum));
+		for (slot=0; slot<LB_NSLOTS; slot++) {
+			st = &lamebus->ls_irqstats[cpu * LB_NSLOTS + slot];
+			sum.li_count += st->li_count;
+			sum.li_cycles += st->li_cycles;
+		}
+		kprintf("%-4u %10u", cpu, sum.li_count);
+		lamebus_printus(sum.li_cycles, mhz);
+		kprintf("\n");
+	}
+}
+
+/*
+ * Zero the statistics. Interrupts on other CPUs may be updating them
+ * meanwhile, so the first few numbers after this may be slightly off.
+ */
+void
+lamebus_intrreset(struct lamebus_softc *lamebus)
+{
+	if (lamebus->ls_irqstats == NULL) {
+		return;
+	}
+	bzero(lamebus->ls_irqstats, lamebus->ls_nirqstatcpus * LB_NSLOTS *
+	      sizeof(*lamebus->ls_irqstats));
+}
+
 /*
  * Have the bus controller power the system off.
  */
@@ -626,6 +823,11 @@ lamebus_init(void)
 		lamebus->ls_devdata[i] = NULL;
 		lamebus->ls_irqfuncs[i] = NULL;
 	}
+	lamebus->ls_slotsbusy = 0;
+	lamebus->ls_ncpus = 0;
+	lamebus->ls_irqcpus = 0;
+	lamebus->ls_irqstats = NULL;
+	lamebus->ls_nirqstatcpus = 0;
 
 	return lamebus;
 }
@@ -78,6 +78,15 @@ typedef void (*lb_irqfunc)(void *devdata);
 /*
  * Driver data
  */
+/*
+ * Interrupt statistics for one slot on one CPU.
+ */
+struct lamebus_irqstat {
+	unsigned li_count;		/* interrupts handled */
+	uint32_t li_maxcycles;		/* longest handler run */
+	uint64_t li_cycles;		/* total time in the handler */
+};
+
 struct lamebus_softc {
 	struct spinlock ls_lock;
 
@@ -85,6 +94,24 @@ struct lamebus_softc {
 	uint32_t     ls_slotsinuse;
 	void        *ls_devdata[LB_NSLOTS];
 	lb_irqfunc   ls_irqfuncs[LB_NSLOTS];
+	uint32_t     ls_slotsbusy;	/* handler running on some CPU */
+
+	/*
+	 * Interrupt routing. Each CPU either takes every device
+	 * interrupt or none; ls_irqcpus has bit N set if CPU number N
+	 * does. Synchronized with ls_lock.
+	 */
+	unsigned     ls_ncpus;
+	uint32_t     ls_cpuhwnum[32];	/* hardware number by CPU number */
+	uint32_t     ls_irqcpus;
+
+	/*
+	 * LB_NSLOTS of these per CPU, by CPU number. Each CPU only
+	 * updates its own, in lamebus_interrupt, so they need no lock.
+	 * NULL until lamebus_find_cpus knows how many CPUs there are.
+	 */
+	struct lamebus_irqstat *ls_irqstats;
+	unsigned     ls_nirqstatcpus;
 };
 
 /*
@@ -143,6 +170,20 @@ void lamebus_unmask_interrupt(struct lamebus_softc *, int slot);
  */
 void lamebus_interrupt(struct lamebus_softc *);
 
+/*
+ * Print interrupt counts and handler times, by slot and by CPU; or
+ * zero them.
+ */
+void lamebus_intrstats(struct lamebus_softc *);
+void lamebus_intrreset(struct lamebus_softc *);
+
+/*
+ * Send device interrupts to the CPUs whose numbers are set in CPUS,
+ * and no others. Returns EINVAL if CPUS is empty or names a CPU that
+ * doesn't exist.
+ */
+int lamebus_intrroute(struct lamebus_softc *, uint32_t cpus);
+
 /*
  * Have the LAMEbus controller power the system off.
  */
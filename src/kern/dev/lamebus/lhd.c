@@ -39,6 +39,7 @@
 #include <platform/bus.h>
 #include <vfs.h>
 #include <lamebus/lhd.h>
+#include <trace.h>
 #include "autoconf.h"
 
 /* Registers (offsets within slot) */
@@ -95,14 +96,26 @@ int lhd_code_to_errno(struct lhd_softc *lh, int code)
 }
 
 /*
- * Record that an I/O has completed: save the result and poke the
- * completion semaphore.
+ * Record that an I/O has completed: save the result, and have the
+ * completion semaphore poked once we're out of the interrupt.
  */
 static
 void
 lhd_iodone(struct lhd_softc *lh, int err)
 {
 	lh->lh_result = err;
+	softirq_raise(&lh->lh_softirq);
+}
+
+/*
+ * Softirq for lhd: wake up the thread waiting for the I/O.
+ */
+static
+void
+lhd_wakeup(void *vlh)
+{
+	struct lhd_softc *lh = vlh;
+
 	V(lh->lh_done);
 }
 
@@ -220,6 +233,8 @@ lhd_io(struct device *d, struct uio *uio)
 		return EINVAL;
 	}
 
+	TRACE(TP_LHD_IO, lh->lh_unit, sector, len, uio->uio_rw == UIO_WRITE);
+
 	/* Set up the value to write into the status register. */
 	if (uio->uio_rw==UIO_WRITE) {
 		statval |= LHD_ISWRITE;
@@ -300,6 +315,7 @@ config_lhd(struct lhd_softc *lh, int lhdno)
 		lh->lh_clear = NULL;
 		return ENOMEM;
 	}
+	softirq_init(&lh->lh_softirq, "lhd", lhd_wakeup, lh);
 
 	/* Set up the VFS device structure. */
 	lh->lh_dev.d_open = lhd_open;
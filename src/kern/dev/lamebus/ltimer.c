@@ -34,6 +34,7 @@
 #include <lib.h>
 #include <spl.h>
 #include <clock.h>
+#include <hrtimer.h>
 #include <platform/bus.h>
 #include <lamebus/ltimer.h>
 #include "autoconf.h"
@@ -46,11 +47,20 @@
 #define LT_REG_COUNT  16    /* Time for countdown timer (usec) */
 #define LT_REG_SPKR   20    /* Beep control */
 
-/* Granularity of countdown timer (usec) */
-#define LT_GRANULARITY   1000000
-
 static bool havetimerclock;
 
+/*
+ * Start the countdown; it interrupts once, USECS from now.
+ */
+static
+void
+ltimer_arm(void *vlt, uint32_t usecs)
+{
+	struct ltimer_softc *lt = vlt;
+
+	bus_write_register(lt->lt_bus, lt->lt_buspos, LT_REG_COUNT, usecs);
+}
+
 /*
  * Setup routine called by autoconf stuff when an ltimer is found.
  */
@@ -85,16 +95,16 @@ config_ltimer(struct ltimer_softc *lt, int ltimerno)
 
 	/*
 	 * We do, however, use ltimer for the timer clock, since the
-	 * on-chip timer can't do that.
+	 * on-chip timer can't do that. The countdown runs one-shot,
+	 * set by the hrtimer code for the next timer due; timerclock
+	 * is one of those timers.
 	 */
 	if (!havetimerclock) {
 		havetimerclock = true;
 		lt->lt_timerclock = 1;
 
-		/* Wire it to go off once every second. */
-		bus_write_register(lt->lt_bus, lt->lt_buspos, LT_REG_ROE, 1);
-		bus_write_register(lt->lt_bus, lt->lt_buspos, LT_REG_COUNT,
-				   LT_GRANULARITY);
+		bus_write_register(lt->lt_bus, lt->lt_buspos, LT_REG_ROE, 0);
+		hrtimer_attach(lt, ltimer_arm, ltimer_gettime);
 	}
 	
 	return 0;
@@ -119,10 +129,10 @@ ltimer_irq(void *vlt)
 			hardclock();
 		}
 		/*
-		 * Likewise for timerclock.
+		 * Likewise for timerclock, which is now the hrtimers.
 		 */
 		if (lt->lt_timerclock) {
-			timerclock();
+			hrtimer_interrupt();
 		}
 	}
 }
@@ -36,10 +36,19 @@
 
 
 #include <vm.h>
+#include <spinlock.h>
+#include <kern/vmstat.h>
+#include <regionmap.h>
 #include "opt-dumbvm.h"
 
 struct vnode;
 
+/* Number of kernel-supplied shared mappings an address space can hold */
+#define AS_NSHARED 4
+
+/* Number of extra user stacks, for threads beyond the first */
+#define AS_NTHREADSTACKS 16
+
 
 /* 
  * Address space - data structure associated with the virtual memory
@@ -57,9 +66,31 @@ struct addrspace {
         paddr_t as_pbase2;
         size_t as_npages2;
         paddr_t as_stackpbase;
+        size_t as_stackpages;		/* see as_reserve_stack */
+        vaddr_t as_heapbase;		/* just above the higher region */
+        vaddr_t as_heapend;		/* current break */
+        paddr_t as_heappbase;		/* 0 until the heap is first grown */
+        size_t as_heappages;		/* pages at as_heappbase */
+        struct {
+                vaddr_t sm_vbase;	/* 0 if slot unused */
+                paddr_t sm_pbase;
+                size_t sm_npages;
+                int sm_writeable;
+        } as_shared[AS_NSHARED];	/* see as_map_shared */
+        struct {
+                paddr_t ts_pbase;	/* 0 if never allocated */
+                bool ts_inuse;
+        } as_tstacks[AS_NTHREADSTACKS];	/* see as_define_thread_stack */
 #else
         /* Put stuff here for your VM system */
+        struct regionmap as_regions;	/* see as_findregion */
 #endif
+        /* Fault and TLB events, for __vmstat; see vm_getstat */
+        struct vmstat as_vmstat;
+
+        /* Threads sharing this address space; see as_incref/as_decref */
+        struct spinlock as_reflock;
+        unsigned as_refcount;
 };
 
 /*
@@ -79,8 +110,14 @@ struct addrspace {
  *                "seen" by the processor. Argument might be NULL, 
  *                meaning "no particular address space".
  *
- *    as_destroy - dispose of an address space. You may need to change
- *                the way this works if implementing user-level threads.
+ *    as_destroy - dispose of an address space. Only for an address
+ *                space nothing else refers to: either one that was
+ *                never shared, or one whose as_decref returned 0.
+ *
+ *    as_incref - add a reference, for another thread sharing AS.
+ *
+ *    as_decref - drop a reference; returns the number remaining. The
+ *                caller destroys the address space when it hits 0.
  *
  *    as_define_region - set up a region of memory within the address
  *                space.
@@ -91,15 +128,43 @@ struct addrspace {
  *    as_complete_load - this is called when loading from an executable
  *                is complete.
  *
+ *    as_reserve_stack - make room on the stack for BYTES of exec
+ *                arguments as well as the program's own use. Call
+ *                before as_prepare_load. Fails with E2BIG if it can't.
+ *
  *    as_define_stack - set up the stack region in the address space.
  *                (Normally called *after* as_complete_load().) Hands
  *                back the initial stack pointer for the new process.
+ *
+ *    as_map_shared - map NPAGES of physically contiguous kernel memory
+ *                at PADDR into the address space at VADDR, read-only
+ *                unless WRITEABLE. The memory stays owned by the
+ *                caller; shared mappings are not inherited by as_copy.
+ *
+ *    as_unmap_shared - remove a mapping made by as_map_shared. Returns
+ *                the physical address it mapped, or 0 if none.
+ *
+ *    as_define_thread_stack - set up a user stack for an additional
+ *                thread. Hands back the initial stack pointer and a
+ *                slot number for as_release_thread_stack.
+ *
+ *    as_release_thread_stack - give back a stack from
+ *                as_define_thread_stack when its thread exits.
+ *
+ *    as_sbrk   - move the heap break by AMOUNT bytes, handing back the
+ *                old break.
+ *
+ *    as_findregion - return the region containing VADDR, or NULL, for
+ *                the fault handler. Not in dumbvm, which has a fixed
+ *                handful of regions.
  */
 
 struct addrspace *as_create(void);
 int               as_copy(struct addrspace *src, struct addrspace **ret);
 void              as_activate(struct addrspace *);
 void              as_destroy(struct addrspace *);
+void              as_incref(struct addrspace *);
+unsigned          as_decref(struct addrspace *);
 
 int               as_define_region(struct addrspace *as, 
                                    vaddr_t vaddr, size_t sz,
@@ -108,7 +173,20 @@ int               as_define_region(struct addrspace *as,
                                    int executable);
 int               as_prepare_load(struct addrspace *as);
 int               as_complete_load(struct addrspace *as);
+int               as_reserve_stack(struct addrspace *as, size_t bytes);
 int               as_define_stack(struct addrspace *as, vaddr_t *initstackptr);
+int               as_map_shared(struct addrspace *as, vaddr_t vaddr,
+                                paddr_t paddr, size_t npages,
+                                int writeable);
+paddr_t           as_unmap_shared(struct addrspace *as, vaddr_t vaddr);
+int               as_define_thread_stack(struct addrspace *as,
+                                         vaddr_t *initstackptr, int *slot);
+void              as_release_thread_stack(struct addrspace *as, int slot);
+int               as_sbrk(struct addrspace *as, intptr_t amount,
+                          vaddr_t *oldbreak);
+#if !OPT_DUMBVM
+struct region    *as_findregion(struct addrspace *as, vaddr_t vaddr);
+#endif
 
 
 /*
@@ -0,0 +1,38 @@
+/*
+ * Exec argument vectors, packed into one kernel buffer in the layout
+ * they will have on the new user stack: argc+1 pointers followed by
+ * the strings, each NUL-terminated and padded to a word boundary.
+ * Until argblock_copyout the pointer slots hold offsets into the
+ * block, so the whole thing goes out with a single copyout.
+ *
+ * The buffer starts small and doubles as needed, up to ARG_MAX, so
+ * the usual handful of short arguments doesn't cost 64k of memory
+ * (which under dumbvm is never given back).
+ *
+ * Used by runprogram and execv.
+ */
+
+#ifndef _ARGBLOCK_H_
+#define _ARGBLOCK_H_
+
+struct argblock {
+	char *ab_buf;
+	size_t ab_size;		/* bytes allocated, at most ARG_MAX */
+	size_t ab_len;		/* bytes in use */
+	int ab_argc;
+};
+
+/* Fill AB from a user argv array, or from a kernel one. */
+int argblock_copyin(struct argblock *ab, userptr_t uargv);
+int argblock_kinit(struct argblock *ab, char **args, int nargs);
+
+/*
+ * Put the block on the user stack below *STACKPTR, updating it, and
+ * return the user address of argv in *UARGV.
+ */
+int argblock_copyout(struct argblock *ab, vaddr_t *stackptr,
+		     userptr_t *uargv);
+
+void argblock_cleanup(struct argblock *ab);
+
+#endif /* _ARGBLOCK_H_ */
@@ -38,9 +38,16 @@
  *                      Returns NULL on error.
  *     bitmap_getdata - return pointer to raw bit data (for I/O).
  *     bitmap_alloc   - locate a cleared bit, set it, and return its index.
+ *                      Searches from near the last bit allocated.
+ *     bitmap_alloc_range - locate N contiguous cleared bits, set them, and
+ *                      return the index of the first. Returns the
+ *                      lowest such run.
  *     bitmap_mark    - set a clear bit by its index.
  *     bitmap_unmark  - clear a set bit by its index.
  *     bitmap_isset   - return whether a particular bit is set or not.
+ *     bitmap_rescan  - rebuild the search index; call after changing
+ *                      the bits through bitmap_getdata (e.g. reading
+ *                      them from disk).
  *     bitmap_destroy - destroy bitmap.
  */
 
@@ -50,9 +57,12 @@ struct bitmap;  /* Opaque. */
 struct bitmap *bitmap_create(unsigned nbits);
 void          *bitmap_getdata(struct bitmap *);
 int            bitmap_alloc(struct bitmap *, unsigned *index);
+int            bitmap_alloc_range(struct bitmap *, unsigned n,
+                                  unsigned *index);
 void           bitmap_mark(struct bitmap *, unsigned index);
 void           bitmap_unmark(struct bitmap *, unsigned index);
 int            bitmap_isset(struct bitmap *, unsigned index);
+void           bitmap_rescan(struct bitmap *);
 void           bitmap_destroy(struct bitmap *);
 
 
@@ -0,0 +1,26 @@
+/*
+ * Deferred attach work.
+ *
+ * Device setup that has to wait on the device, such as emu looking up
+ * its root directory, can be handed to bootjob_add by the device's
+ * config routine instead of being done inline. Once the secondary
+ * cpus are up, boot calls bootjob_runall, which runs each job in its
+ * own thread, spreads the threads over the cpus, and waits for all
+ * of them before anything gets mounted. So devices attach
+ * concurrently, instead of one after another with the boot cpu
+ * waiting on each.
+ *
+ * A job's result is reported as "NAMEUNIT: error" if it fails. After
+ * bootjob_runall, bootjob_add runs the job right away.
+ */
+
+#ifndef _BOOTJOB_H_
+#define _BOOTJOB_H_
+
+#define BOOTJOB_MAX	16
+
+void bootjob_add(const char *name, int unit, int (*func)(void *), void *data);
+void bootjob_runall(void);
+
+
+#endif /* _BOOTJOB_H_ */
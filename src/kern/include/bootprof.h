@@ -0,0 +1,31 @@
+/*
+ * Boot-time profile.
+ *
+ * boot() marks the start of each phase with bootprof_phase; a phase
+ * lasts until the next mark, and a NULL name ends the last one. The
+ * generated autoconf code times each device's config_* routine with
+ * bootprof_now/bootprof_device, and deferred attach jobs (<bootjob.h>)
+ * are timed the same way, noting which cpu ran them. bootprof_report
+ * prints both tables, in microseconds.
+ *
+ * Times come from mainbus_cycles(), so nothing before thread_bootstrap
+ * can be timed, and times taken on different cpus only roughly agree.
+ * bootprof_now's value records its cpu; a device whose start and end
+ * were taken on different cpus is reported without a time.
+ * Entries past the table sizes are dropped.
+ */
+
+#ifndef _BOOTPROF_H_
+#define _BOOTPROF_H_
+
+#define BOOTPROF_MAXPHASES	24
+#define BOOTPROF_MAXDEVICES	32
+
+uint64_t bootprof_now(void);
+void bootprof_phase(const char *name);
+void bootprof_device(const char *name, int unit, uint64_t start,
+		     bool deferred);
+void bootprof_report(void);
+
+
+#endif /* _BOOTPROF_H_ */
@@ -73,5 +73,12 @@ void getinterval(time_t secs1, uint32_t nsecs,
  */
 void clocksleep(int seconds);
 
+/*
+ * clock_nsleep() suspends execution for at least SECS seconds plus
+ * NSECS nanoseconds. It uses an hrtimer (<hrtimer.h>), so the
+ * resolution is a microsecond or so, or 1/HZ without a timer device.
+ */
+void clock_nsleep(time_t secs, uint32_t nsecs);
+
 
 #endif /* _CLOCK_H_ */
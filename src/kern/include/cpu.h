@@ -34,6 +34,7 @@
 #include <spinlock.h>
 #include <threadlist.h>
 #include <machine/vm.h>  /* for TLBSHOOTDOWN_MAX */
+#include <kern/vmstat.h>
 
 
 /*
@@ -60,6 +61,15 @@ struct cpu {
 	struct thread *c_curthread;	/* Current thread on cpu */
 	struct threadlist c_zombies;	/* List of exited threads */
 	unsigned c_hardclocks;		/* Counter of hardclock() calls */
+	vaddr_t c_intrpc;		/* PC the current interrupt came from */
+	bool c_intruser;		/* ...and whether it was user mode */
+	struct profbuf *c_profbuf;	/* Sampling profiler buffer or NULL */
+	struct tracering *c_tracering;	/* Tracepoint records or NULL */
+	struct regionstat *c_regions;	/* Measurement regions or NULL */
+	uint64_t c_switchstart;		/* RG_THREAD_SWITCH start time */
+	struct vmstat c_vmstat;		/* VM events on this cpu */
+	struct softirq *c_softirqs;	/* raised softirqs, oldest first */
+	struct softirq *c_softirqtail;
 
 	/*
 	 * Accessed by other cpus.
@@ -109,6 +119,13 @@ void cpu_machdep_init(struct cpu *);
 /*ASMLINKAGE*/ void cpu_start_secondary(void);
 void cpu_hatch(unsigned software_number);
 
+/*
+ * The number of CPUs, and CPU number N, for code that needs to visit
+ * every CPU.
+ */
+unsigned cpu_numcpus(void);
+struct cpu *cpu_getcpu(unsigned n);
+
 /*
  * Return a string describing the CPU type.
  */
@@ -152,6 +169,7 @@ void cpu_halt(void);
  * ipi_send sends an IPI to one CPU.
  * ipi_broadcast sends an IPI to all CPUs except the current one.
  * ipi_tlbshootdown is like ipi_send but carries TLB shootdown data.
+ * ipi_tlbshootdown_broadcast does that for all CPUs except this one.
  *
  * interprocessor_interrupt is called on the target CPU when an IPI is
  * received.
@@ -166,6 +184,7 @@ void cpu_halt(void);
 void ipi_send(struct cpu *target, int code);
 void ipi_broadcast(int code);
 void ipi_tlbshootdown(struct cpu *target, const struct tlbshootdown *mapping);
+void ipi_tlbshootdown_broadcast(const struct tlbshootdown *mapping);
 
 void interprocessor_interrupt(void);
 
@@ -0,0 +1,70 @@
+/*
+ * Cache of loaded executable images, so that launching the same
+ * program again does not re-read and re-parse it from the file.
+ *
+ * An image is keyed by its vnode plus the file's size and mtime at
+ * the time it was read; anything that writes or truncates the file
+ * also drops its image. load_elf() is the only user.
+ */
+
+#ifndef _EXECCACHE_H_
+#define _EXECCACHE_H_
+
+#include <kern/stat.h>
+
+struct vnode;
+
+#define EXECCACHE_SIZE		8		/* images kept at once */
+#define EXECCACHE_MAXSEGS	4		/* PT_LOAD segments per image */
+#define EXECCACHE_MAXBYTES	(128*1024)	/* total segment data kept */
+
+/* One PT_LOAD segment, with a kernel copy of its file contents. */
+struct execseg {
+	vaddr_t es_vaddr;
+	size_t es_memsize;
+	size_t es_filesize;
+	uint32_t es_flags;		/* PF_R/PF_W/PF_X */
+	void *es_data;			/* es_filesize bytes */
+};
+
+struct execimage {
+	struct vnode *ei_vnode;		/* referenced while cached */
+	time_t ei_mtime;		/* file stamps when read */
+	uint32_t ei_mtimensec;
+	off_t ei_size;
+	vaddr_t ei_entry;		/* initial PC */
+	unsigned ei_nsegs;
+	struct execseg ei_segs[EXECCACHE_MAXSEGS];
+	size_t ei_bytes;		/* sum of es_filesize */
+	unsigned ei_refcount;		/* cache's ref plus loaders' */
+	unsigned ei_lastuse;		/* for LRU replacement */
+};
+
+void execcache_bootstrap(void);
+
+/*
+ * Building an image: create it with the file's current stat, add
+ * segments (which allocates their buffers), then hand it to
+ * execcache_insert, which takes over the caller's reference.
+ */
+struct execimage *execimage_create(struct vnode *v, const struct stat *st,
+				   vaddr_t entry);
+int execimage_addseg(struct execimage *ei, vaddr_t vaddr, size_t memsize,
+		     size_t filesize, uint32_t flags, struct execseg **ret);
+void execcache_insert(struct execimage *ei);
+
+/* Find V's image if it is still current; the caller must release it. */
+struct execimage *execcache_lookup(struct vnode *v, const struct stat *st);
+void execcache_release(struct execimage *ei);
+
+/* Drop V's image, if any (the file is being changed). */
+void execcache_invalidate(struct vnode *v);
+
+/* Drop all images, releasing their vnodes. */
+void execcache_flush(void);
+
+/* Record the time one load_elf took, for the stats. */
+void execcache_account(bool hit, time_t secs, uint32_t nsecs);
+void execcache_printstats(void);
+
+#endif /* _EXECCACHE_H_ */
@@ -0,0 +1,50 @@
+/*
+ * Per-process file descriptor table.
+ * New for the ioring work: read/write/open/close on real files.
+ */
+
+#ifndef _FILE_H_
+#define _FILE_H_
+
+#include <limits.h>
+
+struct vnode;
+struct lock;
+
+/*
+ * An open file. Shared between file tables after fork, so it is
+ * reference counted; of_lock protects the offset and the count.
+ */
+struct openfile {
+	struct vnode *of_vnode;		/* underlying file */
+	struct lock *of_lock;		/* protects offset and refcount */
+	off_t of_offset;		/* current seek position */
+	int of_flags;			/* flags passed to open */
+	int of_refcount;		/* number of fds referring to us */
+};
+
+/*
+ * The descriptor table itself. It is shared by all threads of a
+ * process (and the ioring SQPOLL thread), so it is reference counted
+ * and ft_lock protects ft_files and ft_refcount.
+ */
+struct filetable {
+	struct lock *ft_lock;
+	unsigned ft_refcount;
+	struct openfile *ft_files[OPEN_MAX];
+};
+
+struct filetable *filetable_create(void);
+int filetable_copy(struct filetable *src, struct filetable **ret);
+void filetable_incref(struct filetable *ft);
+void filetable_decref(struct filetable *ft);	/* frees on last ref */
+
+/* Look up FD; on success the caller holds a reference to *RET. */
+int filetable_get(struct filetable *ft, int fd, struct openfile **ret);
+void openfile_decref(struct openfile *of);
+
+/* Open PATH (which may be modified) into the current thread's table. */
+int file_open(char *path, int flags, mode_t mode, int *retfd);
+int file_close(int fd);
+
+#endif /* _FILE_H_ */
@@ -0,0 +1,206 @@
+/*
+ * Intrusive hash table.
+ */
+
+#ifndef _HASHTABLE_H_
+#define _HASHTABLE_H_
+
+#include <cdefs.h>
+#include <spinlock.h>
+
+/*
+ * Entries carry their own link (struct hashlink), so adding one never
+ * allocates. As with threadlistnode, hl_self points back at the entry
+ * so no pointer arithmetic is needed to get from link to entry; set
+ * it up with hashlink_init before first use.
+ *
+ * The table doubles when it averages more than HASH_LOAD entries per
+ * bucket. Rather than rehashing everything then, it keeps the old
+ * bucket array and moves a couple of old buckets into the new one on
+ * each insert, lookup or remove until none are left, so no caller
+ * pays for the whole move. The old array is only freed at the next
+ * doubling, which finishes the move first if it isn't done.
+ *
+ * Locking is optional. With NLOCKS of 0 the table has none and the
+ * caller serializes access, as with struct array. Otherwise NLOCKS (a
+ * power of 2) spinlocks each guard the buckets whose hash is equal to
+ * their number modulo NLOCKS, which stays true across resizes, so
+ * operations on different stripes proceed in parallel. Either way the
+ * table only protects its own structure: keeping a looked-up entry
+ * from being removed and freed is up to the caller.
+ *
+ * Iteration needs the table to hold still; with locks, that means the
+ * caller must stop other threads from changing it.
+ *
+ * Operations:
+ *   hashtable_init - set up a table in space externally allocated.
+ *                    May fail and return ENOMEM.
+ *   hashtable_cleanup - tear one down; it must be empty.
+ *   hashtable_num - return the number of entries.
+ *   hashtable_insert - add LINK with hash HASH. Duplicates are allowed.
+ *   hashtable_remove - remove LINK, which must be in the table.
+ *   hashtable_lookup - return the first entry with hash HASH for which
+ *                    MATCH(entry, KEY) is true, or NULL.
+ *   hashtable_iter_start, hashtable_iter_next - visit every entry in
+ *                    no particular order; next returns NULL at the end.
+ *
+ * hash_string and hash_uint32 are reasonable hash functions.
+ */
+
+#define HASH_LOAD	2	/* entries per bucket before doubling */
+#define HASH_MINBUCKETS	16
+#define HASH_MIGRATE	2	/* old buckets moved per operation */
+
+struct hashlink {
+	struct hashlink *hl_next;
+	void *hl_self;
+	uint32_t hl_hash;
+};
+
+struct hashstripe {
+	struct spinlock hs_lock;	/* unused if the table has no locks */
+	unsigned hs_count;		/* entries in this stripe */
+	unsigned hs_moved;		/* its old buckets moved so far */
+};
+
+struct hashtable {
+	struct hashlink **ht_buckets;
+	unsigned ht_nbuckets;		/* a power of 2 */
+	struct hashlink **ht_old;	/* previous buckets, or NULL */
+	unsigned ht_oldn;
+	struct hashstripe *ht_stripes;
+	unsigned ht_nstripes;		/* a power of 2 */
+	bool ht_locked;
+};
+
+struct hashiter {
+	struct hashtable *hi_ht;
+	bool hi_old;			/* walking ht_old */
+	unsigned hi_bucket;
+	struct hashlink *hi_link;	/* next to return */
+};
+
+void hashlink_init(struct hashlink *hl, void *self);
+
+int hashtable_init(struct hashtable *ht, unsigned nlocks);
+void hashtable_cleanup(struct hashtable *ht);
+unsigned hashtable_num(const struct hashtable *ht);
+void hashtable_insert(struct hashtable *ht, struct hashlink *hl,
+		      uint32_t hash);
+void hashtable_remove(struct hashtable *ht, struct hashlink *hl);
+void *hashtable_lookup(struct hashtable *ht, uint32_t hash,
+		       bool (*match)(const void *entry, const void *key),
+		       const void *key);
+void hashtable_iter_start(struct hashtable *ht, struct hashiter *hi);
+void *hashtable_iter_next(struct hashiter *hi);
+
+uint32_t hash_string(const char *s);
+uint32_t hash_uint32(uint32_t x);
+
+/*
+ * Bits for declaring and defining typed hash tables, in the manner of
+ * DECLARRAY in array.h.
+ *
+ * DECLHASH_BYTYPE(foo, bar) declares "struct foo", a hash table of
+ * "bar", plus the operations on it. DEFHASH_BYTYPE(foo, bar, LINK,
+ * MATCH, INLINE) defines them; LINK is the struct hashlink member of
+ * bar, and MATCH is a function
+ *
+ *	bool MATCH(const bar *entry, const void *key);
+ *
+ * used by foo_lookup. INLINE is as for DEFARRAY.
+ *
+ * DECLHASH(foo) and DEFHASH(foo, LINK, MATCH, INLINE) do the same for
+ * "struct foohash", a table of "struct foo".
+ *
+ * Example, for vnodes found by name:
+ *
+ *	struct vnodeinfo {
+ *		char *vi_name;
+ *		struct hashlink vi_link;
+ *	};
+ *	bool vnodeinfo_match(const struct vnodeinfo *vi, const void *name);
+ *	DECLHASH(vnodeinfo);
+ *	DEFHASH(vnodeinfo, vi_link, vnodeinfo_match, VIINLINE);
+ *
+ *	hashlink_init(&vi->vi_link, vi);
+ *	vnodeinfohash_insert(&table, vi, hash_string(vi->vi_name));
+ *	vi = vnodeinfohash_lookup(&table, hash_string(name), name);
+ */
+
+#define DECLHASH_BYTYPE(HT, T) \
+	struct HT {							\
+		struct hashtable ht;					\
+	};								\
+									\
+	bool HT##_match(const void *entry, const void *key);		\
+	int HT##_init(struct HT *h, unsigned nlocks);			\
+	void HT##_cleanup(struct HT *h);				\
+	unsigned HT##_num(const struct HT *h);				\
+	void HT##_insert(struct HT *h, T *entry, uint32_t hash);	\
+	void HT##_remove(struct HT *h, T *entry);			\
+	T *HT##_lookup(struct HT *h, uint32_t hash, const void *key);	\
+	void HT##_iter_start(struct HT *h, struct hashiter *hi);	\
+	T *HT##_iter_next(struct hashiter *hi)
+
+#define DEFHASH_BYTYPE(HT, T, LINK, MATCH, INLINE) \
+	INLINE bool							\
+	HT##_match(const void *entry, const void *key)			\
+	{								\
+		return MATCH((const T *)entry, key);			\
+	}								\
+									\
+	INLINE int							\
+	HT##_init(struct HT *h, unsigned nlocks)			\
+	{								\
+		return hashtable_init(&h->ht, nlocks);			\
+	}								\
+									\
+	INLINE void							\
+	HT##_cleanup(struct HT *h)					\
+	{								\
+		hashtable_cleanup(&h->ht);				\
+	}								\
+									\
+	INLINE unsigned							\
+	HT##_num(const struct HT *h)					\
+	{								\
+		return hashtable_num(&h->ht);				\
+	}								\
+									\
+	INLINE void							\
+	HT##_insert(struct HT *h, T *entry, uint32_t hash)		\
+	{								\
+		hashtable_insert(&h->ht, &entry->LINK, hash);		\
+	}								\
+									\
+	INLINE void							\
+	HT##_remove(struct HT *h, T *entry)				\
+	{								\
+		hashtable_remove(&h->ht, &entry->LINK);			\
+	}								\
+									\
+	INLINE T *							\
+	HT##_lookup(struct HT *h, uint32_t hash, const void *key)	\
+	{								\
+		return (T *)hashtable_lookup(&h->ht, hash, HT##_match, key); \
+	}								\
+									\
+	INLINE void							\
+	HT##_iter_start(struct HT *h, struct hashiter *hi)		\
+	{								\
+		hashtable_iter_start(&h->ht, hi);			\
+	}								\
+									\
+	INLINE T *							\
+	HT##_iter_next(struct hashiter *hi)				\
+	{								\
+		return (T *)hashtable_iter_next(hi);			\
+	}
+
+#define DECLHASH(T) DECLHASH_BYTYPE(T##hash, struct T)
+#define DEFHASH(T, LINK, MATCH, INLINE) \
+	DEFHASH_BYTYPE(T##hash, struct T, LINK, MATCH, INLINE)
+
+
+#endif /* _HASHTABLE_H_ */
@@ -0,0 +1,58 @@
+/*
+ * High-resolution one-shot timers.
+ *
+ * An hrtimer calls a function at a given time, to the microsecond
+ * rather than the hardclock tick. Times are nanoseconds on the
+ * hrtimer_now() clock, which is the time of day. Pending timers are
+ * kept in order of expiry, and the timer device's countdown is set for
+ * the first one; when it goes off, the expired timers' functions run
+ * from a softirq (see <softirq.h>), so they must not sleep.
+ *
+ * A timer goes off once. To repeat, start it again from its function,
+ * from its old deadline to avoid drift.
+ *
+ * Operations:
+ *   hrtimer_init - set up HT to call FUNC(DATA).
+ *   hrtimer_start - (re)queue HT to go off at WHEN. If WHEN has
+ *                   passed, it goes off right away.
+ *   hrtimer_cancel - dequeue HT. True if it was queued; false if it
+ *                   wasn't, or has gone off, in which case its
+ *                   function may still be running on another cpu.
+ *
+ * The timer device calls hrtimer_attach once, then hrtimer_interrupt
+ * whenever its countdown expires. Without one, timers are checked on
+ * hardclock, so get 1/HZ resolution.
+ */
+
+#ifndef _HRTIMER_H_
+#define _HRTIMER_H_
+
+#define HRT_NSEC	1000000000	/* nanoseconds per second */
+
+struct hrtimer {
+	uint64_t ht_when;		/* deadline */
+	void (*ht_func)(void *);
+	void *ht_data;
+	struct hrtimer *ht_next;	/* queue, soonest first */
+	bool ht_queued;
+};
+
+void hrtimer_bootstrap(void);
+
+uint64_t hrtimer_now(void);
+
+void hrtimer_init(struct hrtimer *ht, void (*func)(void *), void *data);
+void hrtimer_start(struct hrtimer *ht, uint64_t when);
+bool hrtimer_cancel(struct hrtimer *ht);
+
+/* For the timer device. ARM starts its countdown at USECS (> 0). */
+void hrtimer_attach(void *dev, void (*arm)(void *dev, uint32_t usecs),
+		    void (*gettime)(void *dev, time_t *secs,
+				    uint32_t *nsecs));
+void hrtimer_interrupt(void);
+
+/* For hardclock, on one cpu. */
+void hrtimer_hardclock(void);
+
+
+#endif /* _HRTIMER_H_ */
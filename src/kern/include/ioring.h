@@ -0,0 +1,56 @@
+/*
+ * Kernel side of the submission/completion rings.
+ * The user-visible layout is in <kern/ioring.h>.
+ */
+
+#ifndef _IORING_H_
+#define _IORING_H_
+
+#include <kern/ioring.h>
+
+struct lock;
+struct cv;
+struct semaphore;
+
+/* Where ioring_setup maps the ring: 16M below the top of the stack */
+#define IORING_VADDR	(USERSTACK - 0x01000000)
+
+/* Empty SQ polls before the SQPOLL thread goes to sleep */
+#define IORING_SQPOLL_IDLE	64
+
+struct ioring {
+	/* Shared region, via its kernel (KSEG0) address */
+	struct ioring_hdr *ir_hdr;
+	struct ioring_sqe *ir_sqes;
+	struct ioring_cqe *ir_cqes;
+	vaddr_t ir_kvaddr;
+	unsigned ir_npages;
+
+	/*
+	 * Kernel copies of the sizes and of the indexes the kernel
+	 * owns, so that userlevel scribbling on the header cannot
+	 * send us outside the arrays.
+	 */
+	unsigned ir_sqmask;
+	unsigned ir_cqmask;
+	unsigned ir_sqhead;
+	unsigned ir_cqtail;
+
+	struct lock *ir_lock;		/* serializes SQ consumption */
+	struct cv *ir_cqcv;		/* signalled when CQEs are posted */
+
+	/* SQPOLL state */
+	bool ir_sqpoll;
+	volatile bool ir_stopping;
+	struct semaphore *ir_sqwake;	/* V'd to wake the poller */
+	struct semaphore *ir_sqdone;	/* V'd by the poller on exit */
+
+	/* Statistics */
+	unsigned ir_nenter;		/* ioring_enter calls */
+	unsigned ir_nsubmitted;		/* SQEs consumed */
+};
+
+/* Called from thread_exit; stops the poller and unmaps the ring. */
+void ioring_destroy(struct ioring *ring);
+
+#endif /* _IORING_H_ */
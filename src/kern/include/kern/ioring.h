@@ -0,0 +1,67 @@
+/*
+ * Shared submission/completion rings for batched file I/O.
+ * Shared between kernel and userland.
+ *
+ * ioring_setup() maps one region into the caller's address space
+ * and hands back its address. The region starts with a struct
+ * ioring_hdr; the SQE and CQE arrays follow at ir_sqoff and
+ * ir_cqoff bytes from the start. The CQ has twice as many entries
+ * as the SQ.
+ *
+ * Userlevel fills in SQEs, then advances sq_tail. The kernel
+ * consumes entries from sq_head, either during ioring_enter() or
+ * from the SQPOLL thread, and posts one CQE per SQE at cq_tail.
+ * Userlevel reaps CQEs and advances cq_head. Head and tail indexes
+ * run freely and are masked with (entries - 1).
+ */
+
+#ifndef _KERN_IORING_H_
+#define _KERN_IORING_H_
+
+/* Operations (sqe_op) */
+#define IORING_OP_NOP		0
+#define IORING_OP_READ		1	/* read(fd, addr, len) */
+#define IORING_OP_WRITE		2	/* write(fd, addr, len) */
+#define IORING_OP_OPEN		3	/* open(addr, flags) */
+#define IORING_OP_CLOSE		4	/* close(fd) */
+
+/* Flags for ioring_setup */
+#define IORING_SETUP_SQPOLL	1	/* kernel thread polls the SQ */
+
+/* Flags for ioring_enter */
+#define IORING_ENTER_GETEVENTS	1	/* wait for min_complete CQEs */
+#define IORING_ENTER_SQ_WAKEUP	2	/* wake an idle SQPOLL thread */
+
+/* Bits in sq_flags, set by the kernel */
+#define IORING_SQ_NEED_WAKEUP	1	/* SQPOLL thread is asleep */
+
+/* Largest SQ size accepted by ioring_setup */
+#define IORING_MAX_ENTRIES	256
+
+struct ioring_hdr {
+	volatile __u32 sq_head;		/* next SQE to consume (kernel) */
+	volatile __u32 sq_tail;		/* next SQE to fill (user) */
+	volatile __u32 sq_flags;	/* IORING_SQ_* (kernel) */
+	volatile __u32 cq_head;		/* next CQE to reap (user) */
+	volatile __u32 cq_tail;		/* next CQE to post (kernel) */
+	__u32 ir_sqentries;		/* SQ size, power of 2 */
+	__u32 ir_cqentries;		/* CQ size, power of 2 */
+	__u32 ir_sqoff;			/* byte offset of SQE array */
+	__u32 ir_cqoff;			/* byte offset of CQE array */
+};
+
+struct ioring_sqe {
+	__u32 sqe_op;			/* IORING_OP_* */
+	__i32 sqe_fd;			/* file handle */
+	__u32 sqe_addr;			/* user buffer or pathname */
+	__u32 sqe_len;			/* buffer length */
+	__i32 sqe_flags;		/* open flags */
+	__u32 sqe_userdata;		/* passed back in the CQE */
+};
+
+struct ioring_cqe {
+	__u32 cqe_userdata;		/* from the SQE */
+	__i32 cqe_res;			/* result, or -errno */
+};
+
+#endif /* _KERN_IORING_H_ */
@@ -0,0 +1,25 @@
+/*
+ * Allocation trace format, shared between kernel and userland.
+ *
+ * A trace is a file of fixed-size records, one per malloc or free,
+ * in the order they happened. Blocks are named by the address they
+ * had when recorded; a replayer maps each address to its own block
+ * and may see an address reused once its block is freed.
+ *
+ * libc's malloc.c writes traces when built with MALLOCTRACE; the
+ * mallocreplay testbin and the kernel's "kmr" test replay them.
+ */
+
+#ifndef _KERN_MTRACE_H_
+#define _KERN_MTRACE_H_
+
+#define MTRACE_MALLOC	1
+#define MTRACE_FREE	2
+
+struct mtrace_rec {
+	__u32 mt_op;			/* MTRACE_* */
+	__u32 mt_addr;			/* block's address when recorded */
+	__u32 mt_size;			/* bytes requested; 0 for free */
+};
+
+#endif /* _KERN_MTRACE_H_ */
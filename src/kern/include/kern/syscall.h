@@ -197,6 +197,13 @@
 #define SYS_reboot       119
 //#define SYS___sysctl   120
 
+//                              -- Local additions --
+#define SYS_ioring_setup 121
+#define SYS_ioring_enter 122
+#define SYS___threadfork 123
+#define SYS___vmstat     124
+#define SYS___threadlist 125
+
 /*CALLEND*/
 
 
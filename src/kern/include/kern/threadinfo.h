@@ -0,0 +1,36 @@
+/*
+ * Per-thread information, as returned by __threadlist(). Shared
+ * between kernel and userland.
+ *
+ * ti_runms is time actually spent on a cpu, and ti_switches the
+ * number of times the thread has been switched out, for any reason.
+ * Names are cut short to fit.
+ */
+
+#ifndef _KERN_THREADINFO_H_
+#define _KERN_THREADINFO_H_
+
+#define THREADINFO_NAMELEN	16
+
+/* Most entries one __threadlist call copies out */
+#define THREADLIST_MAX		256
+
+/* Values of ti_state */
+#define TI_RUN		0	/* running */
+#define TI_READY	1	/* waiting for a cpu */
+#define TI_SLEEP	2	/* sleeping on ti_wchan */
+#define TI_ZOMBIE	3	/* exited, not yet cleaned up */
+
+struct threadinfo {
+	__u32 ti_id;			/* unique; never reused */
+	__i32 ti_pid;
+	__u32 ti_state;
+	__i32 ti_cpu;			/* or -1 */
+	__u32 ti_switches;
+	__u32 ti_pad;
+	__u64 ti_runms;
+	char ti_name[THREADINFO_NAMELEN];
+	char ti_wchan[THREADINFO_NAMELEN];
+};
+
+#endif /* _KERN_THREADINFO_H_ */
@@ -0,0 +1,27 @@
+/*
+ * Layout of the kernel-maintained read-only pages mapped into every
+ * user address space. Shared between kernel and userland.
+ *
+ * The first page holds the time of day, shared by all processes and
+ * updated from hardclock(). Readers retry while vt_seq is odd or
+ * changes under them. The second page is per process.
+ */
+
+#ifndef _KERN_VDSO_H_
+#define _KERN_VDSO_H_
+
+#define VDSO_VADDR		0x7fc00000	/* struct vdso_time */
+#define VDSO_PROC_VADDR		0x7fc01000	/* struct vdso_proc */
+
+struct vdso_time {
+	volatile __u32 vt_seq;		/* odd while being updated */
+	__u32 vt_pad;
+	volatile __i64 vt_secs;		/* seconds, as from __time */
+	volatile __u32 vt_nsecs;	/* nanoseconds */
+};
+
+struct vdso_proc {
+	__i32 vp_pid;			/* getpid() */
+};
+
+#endif /* _KERN_VDSO_H_ */
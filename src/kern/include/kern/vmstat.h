@@ -0,0 +1,26 @@
+/*
+ * VM event counters, as returned by __vmstat(). Shared between kernel
+ * and userland.
+ *
+ * Every fault the VM system sees is counted in vs_faults; those it
+ * resolves by loading a TLB entry are also counted in vs_tlbfills,
+ * and those that had to throw out a valid entry to do it in
+ * vs_tlbevicts. vs_tlbflushes counts whole-TLB invalidations, as on
+ * each switch to a different address space.
+ */
+
+#ifndef _KERN_VMSTAT_H_
+#define _KERN_VMSTAT_H_
+
+/* Codes for __vmstat's first argument */
+#define VMSTAT_SELF	0	/* the calling process */
+#define VMSTAT_SYSTEM	1	/* all processes since boot */
+
+struct vmstat {
+	__u32 vs_faults;
+	__u32 vs_tlbfills;
+	__u32 vs_tlbevicts;
+	__u32 vs_tlbflushes;
+};
+
+#endif /* _KERN_VMSTAT_H_ */
@@ -0,0 +1,19 @@
+/*
+ * Table of kernel text symbols, sorted by address, for turning PCs
+ * into function names. ksyms.c is generated while linking the kernel
+ * by conf/mkksyms.sh from the kernel's own symbol table; see the
+ * kernel rule in mk/os161.kernel.mk.
+ */
+
+#ifndef _KSYMS_H_
+#define _KSYMS_H_
+
+struct ksym {
+	vaddr_t ks_addr;
+	const char *ks_name;
+};
+
+extern const struct ksym ksyms[];	/* ends with a NULL ks_name */
+extern const unsigned ksyms_count;
+
+#endif /* _KSYMS_H_ */
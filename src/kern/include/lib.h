@@ -202,5 +202,11 @@ void kprintf_bootstrap(void);
 #define DIVROUNDUP(a,b) (((a)+(b)-1)/(b))
 #define ROUNDUP(a,b)    (DIVROUNDUP(a,b)*b)
 
+/*
+ * ctz32 returns the number of trailing zero bits in X, which must be
+ * nonzero; that is, the number of its lowest set bit.
+ */
+unsigned ctz32(uint32_t x);
+
 
 #endif /* _LIB_H_ */
@@ -55,6 +55,21 @@ size_t mainbus_ramsize(void);
 /* Switch on an inter-processor interrupt. (Low-level.) */
 void mainbus_send_ipi(struct cpu *target);
 
+/*
+ * Cycle counter for timestamps: CPU cycles since this CPU's clock
+ * started, and cycles per second. Counts on different CPUs are only
+ * roughly in step.
+ */
+uint64_t mainbus_cycles(void);
+uint32_t mainbus_cyclefreq(void);
+
+/* Print, or zero, per-device and per-CPU interrupt statistics. */
+void mainbus_intrstats(void);
+void mainbus_intrreset(void);
+
+/* Send device interrupts to the CPUs whose numbers are set in CPUS. */
+int mainbus_intrroute(uint32_t cpus);
+
 /*
  * The various ways to shut down the system. (These are very low-level
  * and should generally not be called directly - md_poweroff, for
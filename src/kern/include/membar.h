@@ -0,0 +1,36 @@
+/*
+ * Memory barriers.
+ */
+
+#ifndef _MEMBAR_H_
+#define _MEMBAR_H_
+
+/*
+ * Memory barriers, for code that shares memory between CPUs without
+ * a lock (spinlocks already contain whatever barriers they need).
+ * Each one also keeps the compiler from moving memory accesses across
+ * it.
+ *
+ *    membar_any_any - all loads and stores before it are done before
+ *                     any after it.
+ *    membar_store_store - stores before it are seen before stores
+ *                     after it; for publishing data, then an index.
+ *    membar_load_load - loads before it are done before loads after
+ *                     it; for reading an index, then the data.
+ *    membar_load_store - loads before it are done before stores after
+ *                     it; for finishing reading a slot before handing
+ *                     it back.
+ */
+
+#include <cdefs.h>
+
+/* Inlining support - for making sure an out-of-line copy gets built */
+#ifndef MEMBAR_INLINE
+#define MEMBAR_INLINE INLINE
+#endif
+
+/* Get the machine-dependent bits. */
+#include <machine/membar.h>
+
+
+#endif /* _MEMBAR_H_ */
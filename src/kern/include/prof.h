@@ -0,0 +1,38 @@
+/*
+ * Statistical sampling profiler.
+ *
+ * While running, each hardclock on each CPU records the interrupted
+ * PC, whether it was in user mode, and the current pid in that CPU's
+ * sample buffer. prof_dump attributes kernel samples to functions
+ * using the ksyms table, and user samples to processes.
+ *
+ * Driven from the "prof" menu command.
+ */
+
+#ifndef _PROF_H_
+#define _PROF_H_
+
+#define PROF_NSAMPLES	2048	/* samples per CPU per run */
+
+struct profsample {
+	vaddr_t ps_pc;
+	pid_t ps_pid;
+	bool ps_user;
+};
+
+struct profbuf {
+	unsigned pb_count;		/* samples taken */
+	unsigned pb_dropped;		/* samples lost to a full buffer */
+	struct profsample pb_samples[PROF_NSAMPLES];
+};
+
+/* Called from hardclock with interrupts off. */
+void prof_hardclock(void);
+
+int prof_start(void);
+void prof_stop(void);
+
+/* Report on the last run; with PID >= 0, that process's user PCs. */
+int prof_dump(pid_t pid);
+
+#endif /* _PROF_H_ */
@@ -0,0 +1,73 @@
+/*
+ * Measurement regions.
+ *
+ * A region is a stretch of kernel code whose cost we want in cycles.
+ * Bracket it with
+ *
+ *	uint64_t start = REGION_BEGIN(RG_xxx);
+ *	...
+ *	REGION_END(RG_xxx, start);
+ *
+ * and each pass is added to the region's count, minimum, maximum, and
+ * total, read from mainbus_cycles(). The start time lives with the
+ * caller, so regions can nest and run on several CPUs at once.
+ *
+ * mainbus_cycles() counts separately on each CPU, so a region that
+ * sleeps and wakes up on another CPU can't be timed; the start value
+ * carries the CPU it was taken on, and such passes are dropped.
+ *
+ * A region can also be given a trace161 flag (see <lamebus/ltrace.h>),
+ * which is turned on at begin and off at end so that the simulator's
+ * own tracing and counters cover exactly that code.
+ *
+ * Nothing is measured until regions are switched on; when they are
+ * off, REGION_BEGIN/REGION_END cost a load and a branch each.
+ * Controlled from the "rg" menu command.
+ */
+
+#ifndef _REGION_H_
+#define _REGION_H_
+
+/* Regions. Add the name in region.c too. */
+#define RG_THREAD_SWITCH	0	/* thread_switch, until next runs */
+#define RG_FORK			1	/* sys_fork */
+#define RG_EXECV		2	/* sys_execv, successful ones only */
+#define RG_VM_FAULT		3	/* vm_fault from the trap handler */
+#define RG_SOFTIRQ		4	/* one softirq function */
+#define RG_COUNT		5
+
+/* The start value's top bits hold the CPU number. */
+#define RG_CPUSHIFT		56
+#define RG_CYCLEMASK		(((uint64_t)1 << RG_CPUSHIFT) - 1)
+
+struct regionstat {
+	unsigned rs_count;
+	uint64_t rs_min;		/* cycles */
+	uint64_t rs_max;
+	uint64_t rs_total;
+};
+
+extern volatile bool region_enabled;
+
+/* A start time of 0 means "not measuring"; REGION_END ignores it. */
+#define REGION_BEGIN(rg) (region_enabled ? region_begin(rg) : 0)
+
+#define REGION_END(rg, start)						\
+	do {								\
+		if ((start) != 0) {					\
+			region_end(rg, start);				\
+		}							\
+	} while (0)
+
+uint64_t region_begin(unsigned rg);
+void region_end(unsigned rg, uint64_t start);
+
+/* Menu support. */
+int region_lookup(const char *name);	/* RG_* or -1 */
+int region_enable(void);		/* allocates tables as needed */
+void region_disable(void);
+void region_setltrace(unsigned rg, char flag);	/* 0 for none */
+void region_reset(void);
+void region_report(void);
+
+#endif /* _REGION_H_ */
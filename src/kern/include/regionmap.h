@@ -0,0 +1,87 @@
+/*
+ * Region maps: the set of valid ranges of an address space.
+ */
+
+#ifndef _REGIONMAP_H_
+#define _REGIONMAP_H_
+
+/*
+ * A region map holds non-overlapping regions [rg_start, rg_end) in a
+ * red-black tree ordered by address. Since regions never overlap, the
+ * interval search a fault needs is an ordinary descent of the tree,
+ * O(log n) in the number of regions.
+ *
+ * Adding a region that abuts another with the same flags extends that
+ * one instead, so a process that maps page after page in order still
+ * has one region.
+ *
+ * A struct regioncache remembers the last region found, so that
+ * faults that keep hitting the same region (the common case) skip the
+ * tree walk. Each thread has one. Every change to a map gives it a new
+ * generation number, unique over all maps, and a cache is only used
+ * if its generation matches, so caches never need to be found and
+ * invalidated.
+ *
+ * The map does no locking of its own; the address space does that.
+ *
+ * Operations:
+ *   regionmap_init - set up an empty map in space externally allocated.
+ *   regionmap_cleanup - remove and free all regions.
+ *   regionmap_num - number of regions.
+ *   regionmap_add - add [START, END) with FLAGS. Fails with EINVAL if
+ *                  it overlaps an existing region, or ENOMEM.
+ *   regionmap_remove - remove [START, END), which need not match any
+ *                  region's bounds; regions are trimmed or split. Fails
+ *                  only with ENOMEM, from splitting a region in two.
+ *   regionmap_lookup - find the region containing ADDR, or NULL. RC
+ *                  may be NULL to skip the cache.
+ *   regionmap_copy - copy all of SRC's regions into DST, which should
+ *                  be empty. May fail with ENOMEM.
+ *   regionmap_first, regionmap_next - visit the regions in address
+ *                  order. Don't change the map while doing so.
+ *   regioncache_init - set up an empty cache.
+ */
+
+#define VMR_READ	0x4	/* same values as the ELF PF_* flags */
+#define VMR_WRITE	0x2
+#define VMR_EXEC	0x1
+
+struct region {
+	vaddr_t rg_start;
+	vaddr_t rg_end;			/* first address past the region */
+	unsigned rg_flags;		/* VMR_* */
+
+	/* tree linkage */
+	struct region *rg_left;
+	struct region *rg_right;
+	struct region *rg_parent;
+	bool rg_red;
+};
+
+struct regionmap {
+	struct region *rm_root;
+	unsigned rm_num;
+	unsigned rm_gen;		/* changes whenever the map does */
+};
+
+struct regioncache {
+	unsigned rc_gen;		/* of the map rc_region is in */
+	struct region *rc_region;
+};
+
+void regionmap_init(struct regionmap *rm);
+void regionmap_cleanup(struct regionmap *rm);
+unsigned regionmap_num(const struct regionmap *rm);
+int regionmap_add(struct regionmap *rm, vaddr_t start, vaddr_t end,
+		  unsigned flags);
+int regionmap_remove(struct regionmap *rm, vaddr_t start, vaddr_t end);
+struct region *regionmap_lookup(struct regionmap *rm, vaddr_t addr,
+				struct regioncache *rc);
+int regionmap_copy(const struct regionmap *src, struct regionmap *dst);
+struct region *regionmap_first(const struct regionmap *rm);
+struct region *regionmap_next(const struct region *rg);
+
+void regioncache_init(struct regioncache *rc);
+
+
+#endif /* _REGIONMAP_H_ */
@@ -0,0 +1,78 @@
+/*
+ * Ring buffers for handing items from interrupt handlers to threads.
+ */
+
+#ifndef _RING_H_
+#define _RING_H_
+
+#include <spinlock.h>
+
+/*
+ * struct spscring is a fixed-size FIFO of fixed-size items with one
+ * producer and one consumer, which need no lock between them: the
+ * producer only writes sr_head and the consumer only writes sr_tail,
+ * and memory barriers order each one's index update against its access
+ * to the items. So an interrupt handler can put while a thread gets,
+ * on another CPU or the same one, without either of them spinning.
+ *
+ * The indexes count items put and taken since the beginning and are
+ * reduced mod the size (a power of 2) only to pick a slot, so every
+ * slot gets used, and they sit on separate cache lines so producer and
+ * consumer don't take turns stealing each other's line.
+ *
+ * struct mpscring is the same with any number of producers, which
+ * serialize among themselves with a spinlock. The consumer still takes
+ * no lock.
+ *
+ * Neither blocks or counts waiters; pair the ring with a semaphore,
+ * as the console does, to sleep until there's something to get.
+ *
+ * Operations:
+ *   spscring_init - set up a ring of NITEMS (a power of 2) items of
+ *                   ITEMSIZE bytes in BUF, which the caller supplies.
+ *   spscring_put - copy ITEM in; false if the ring is full.
+ *   spscring_get - copy the oldest item out to ITEM; false if the ring
+ *                   is empty.
+ *   spscring_count - items in the ring; only a snapshot unless called
+ *                   by the producer (a lower bound) or the consumer
+ *                   (an upper bound).
+ *   mpscring_* - the same, plus mpscring_cleanup.
+ */
+
+#define RING_PAD	64	/* bytes; at least a cache line */
+
+struct spscring {
+	/* producer's */
+	volatile unsigned sr_head;	/* items ever put */
+	char sr_pad1[RING_PAD - sizeof(unsigned)];
+
+	/* consumer's */
+	volatile unsigned sr_tail;	/* items ever taken */
+	char sr_pad2[RING_PAD - sizeof(unsigned)];
+
+	/* shared, read-only */
+	unsigned sr_mask;		/* number of items - 1 */
+	size_t sr_itemsize;
+	char *sr_buf;
+};
+
+struct mpscring {
+	struct spscring mr_ring;
+	struct spinlock mr_putlock;
+};
+
+void spscring_init(struct spscring *r, void *buf, unsigned nitems,
+		   size_t itemsize);
+bool spscring_put(struct spscring *r, const void *item);
+bool spscring_get(struct spscring *r, void *item);
+unsigned spscring_count(const struct spscring *r);
+
+void mpscring_init(struct mpscring *r, void *buf, unsigned nitems,
+		   size_t itemsize);
+void mpscring_cleanup(struct mpscring *r);
+bool mpscring_put(struct mpscring *r, const void *item);
+bool mpscring_get(struct mpscring *r, void *item);
+unsigned mpscring_count(const struct mpscring *r);
+
+
+#endif /* _RING_H_ */
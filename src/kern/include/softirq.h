@@ -0,0 +1,66 @@
+/*
+ * Softirqs: work an interrupt handler defers until interrupts are on.
+ *
+ * A device interrupt handler should only talk to the hardware: read
+ * the status, acknowledge it, and note the result. Anything more, such
+ * as waking up the thread waiting for the I/O, it hands off by raising
+ * a softirq. That queues the softirq on the current CPU, and it runs
+ * on that CPU as soon as the interrupt returns to code that had
+ * interrupts on, with interrupts back on; or, if the CPU was idle,
+ * from the idle loop. So a long wakeup no longer holds off the timer
+ * and the other devices.
+ *
+ * A softirq function runs on whatever thread was interrupted and must
+ * not sleep; V, wchan_wake*, and spinlocks are fine, P and locks are
+ * not. Raising a softirq that is already queued does nothing; raising
+ * one that is running makes it run again afterwards, so one softirq
+ * never runs on two CPUs at once and never misses a raise.
+ *
+ * Operations:
+ *   softirq_init - set up SI to call FUNC(DATA).
+ *   softirq_cleanup - tear it down; it must not be queued or running.
+ *   softirq_raise - queue SI on this CPU. Callable from interrupt
+ *                   handlers and from threads; in the latter case,
+ *                   with interrupts on, it runs before this returns.
+ *
+ * softirq_dispatch and softirq_run are for the trap code and the idle
+ * loop respectively.
+ */
+
+#ifndef _SOFTIRQ_H_
+#define _SOFTIRQ_H_
+
+#include <spinlock.h>
+
+/* States; the lock protects si_state and si_next. */
+#define SI_IDLE		0
+#define SI_QUEUED	1
+#define SI_RUNNING	2
+#define SI_AGAIN	3	/* raised while running */
+
+struct softirq {
+	const char *si_name;
+	void (*si_func)(void *);
+	void *si_data;
+	struct spinlock si_lock;
+	unsigned si_state;
+	struct softirq *si_next;	/* on a cpu's queue */
+};
+
+void softirq_init(struct softirq *si, const char *name,
+		  void (*func)(void *), void *data);
+void softirq_cleanup(struct softirq *si);
+void softirq_raise(struct softirq *si);
+
+/* Run this CPU's queue, with interrupts as the caller had them. */
+void softirq_run(void);
+
+/*
+ * From the trap code, returning from an interrupt to code that had
+ * interrupts on (so held no spinlocks): turn interrupts on, run this
+ * CPU's queue, and turn them off again.
+ */
+void softirq_dispatch(void);
+
+
+#endif /* _SOFTIRQ_H_ */
@@ -50,6 +50,12 @@ void syscall(struct trapframe *tf);
  */
 void enter_forked_process(void *data1, unsigned long unused);
 
+/*
+ * Start a thread made by __threadfork. DATA1 is a heap copy of its
+ * initial trapframe; DATA2 is its as_define_thread_stack slot.
+ */
+void enter_new_thread(void *data1, unsigned long data2);
+
 /* Enter user mode. Does not return. */
 void enter_new_process(int argc, userptr_t argv, vaddr_t stackptr,
 		       vaddr_t entrypoint);
@@ -61,13 +67,32 @@ void enter_new_process(int argc, userptr_t argv, vaddr_t stackptr,
 
 int sys_reboot(int code);
 int sys___time(userptr_t user_seconds, userptr_t user_nanoseconds);
+int sys_nanosleep(userptr_t req, userptr_t rem);
 
 /* ASST1 setup */
 int sys_fork(struct trapframe *tf, pid_t *retval);
 int sys_read(int fd, userptr_t buf, size_t size, int *retval);
 int sys_write(int fd, userptr_t buf, size_t size, int *retval);
+int sys_execv(userptr_t prog, userptr_t argv);
+int sys_sbrk(intptr_t amount, int32_t *retval);
+int sys___vmstat(int who, userptr_t statp);
+int sys___threadlist(userptr_t buf, unsigned max, int32_t *retval);
 int sys_getpid(void);
 int sys_waitpid(pid_t targetpid, int *status, int flags);
+int sys_open(userptr_t path, int flags, mode_t mode, int *retval);
+int sys_close(int fd);
+int sys_lseek(int fd, off_t pos, int whence, off_t *retval);
+int sys_fsync(int fd);
+int sys_fstat(int fd, userptr_t statbuf);
+int sys_stat(userptr_t path, userptr_t statbuf);
+int sys_remove(userptr_t path);
+int sys___threadfork(struct trapframe *tf, userptr_t entry, userptr_t arg,
+		     pid_t *retval);
+
+/* Shared submission/completion rings (ioring.c) */
+int sys_ioring_setup(unsigned entries, int flags, userptr_t ringp);
+int sys_ioring_enter(unsigned to_submit, unsigned min_complete, int flags,
+		     int *retval);
 /*
  * ASST1 - Prototypes for new bootstrap/shutdown functions needed by syscalls
  */
@@ -72,6 +72,15 @@ int malloctest(int, char **);
 int mallocstress(int, char **);
 int nettest(int, char **);
 
+/* microbenchmarks */
+int benchtest(int, char **);
+int kmreplay(int, char **);
+int lattest(int, char **);
+int hashtest(int, char **);
+int regiontest(int, char **);
+int ringtest(int, char **);
+int hrtimertest(int, char **);
+
 /* Routine for running a user-level program. */
 int runprogram(char *progname, char **args, unsigned long nargs);
 
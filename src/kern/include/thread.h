@@ -38,10 +38,13 @@
 
 #include <spinlock.h>
 #include <threadlist.h>
+#include <regionmap.h>
 
 struct addrspace;
 struct cpu;
 struct vnode;
+struct filetable;
+struct ioring;
 
 /* get machine-dependent defs */
 #include <machine/thread.h>
@@ -84,6 +87,16 @@ struct thread {
 	struct switchframe *t_context;	/* Saved register context (on stack) */
 	struct cpu *t_cpu;		/* CPU thread runs on */
 
+	/* Registry of all threads, under allthreads_lock in thread.c */
+	struct thread *t_allnext;
+	struct thread *t_allprev;
+	unsigned t_id;			/* serial number, for listings */
+
+	/* Accounting, updated in thread_switch */
+	uint64_t t_runcycles;		/* time on a cpu so far */
+	uint64_t t_runstart;		/* mainbus_cycles() when last run */
+	unsigned t_nswitches;		/* times switched out */
+
 	/*
 	 * Interrupt state fields.
 	 *
@@ -94,10 +107,17 @@ struct thread {
 	 *
 	 * See notes in spinlock.c regarding t_curspl and t_iplhigh_count.
 	 *
+	 * t_in_softirq is true while softirq_dispatch is running the
+	 * queue on the way out of an interrupt, so a nested interrupt
+	 * doesn't start another pass on top of it. It belongs to the
+	 * thread because the pass can be preempted and moved to another
+	 * cpu partway through.
+	 *
 	 * Exercise for the student: why is this material per-thread
 	 * rather than per-cpu or global?
 	 */
 	bool t_in_interrupt;		/* Are we in an interrupt? */
+	bool t_in_softirq;		/* In softirq_dispatch? */
 	int t_curspl;			/* Current spl*() state */
 	int t_iplhigh_count;		/* # of times IPL has been raised */
 
@@ -107,12 +127,17 @@ struct thread {
 
 	/* Process-level */
 	pid_t t_pid;			/* this thread's pid */
+	pid_t t_procpid;		/* its process's pid, for getpid */
 
 	/* VM */
 	struct addrspace *t_addrspace;	/* virtual address space */
+	int t_ustack;			/* as_define_thread_stack slot, or -1 */
+	struct regioncache t_regioncache; /* last region as_findregion hit */
 
 	/* VFS */
 	struct vnode *t_cwd;		/* current working directory */
+	struct filetable *t_filetable;	/* open file descriptors */
+	struct ioring *t_ioring;	/* submission/completion ring */
 
 	/* add more here as needed */
 	 bool sig_flag;
@@ -142,6 +167,16 @@ int thread_fork(const char *name,
                 void *data1, unsigned long data2, 
                 pid_t *ret);
 
+/*
+ * Like thread_fork, but the new thread runs in the caller's address
+ * space and file table instead of copies of them. Both are reference
+ * counted and outlive whichever thread exits last.
+ */
+int thread_fork_shared(const char *name,
+                       void (*func)(void *, unsigned long),
+                       void *data1, unsigned long data2,
+                       pid_t *ret);
+
 /*
  * Cause the current thread to exit.
  * Interrupts need not be disabled.
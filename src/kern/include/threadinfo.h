@@ -0,0 +1,28 @@
+/*
+ * Thread listing: the kernel side of __threadlist, and the ps and top
+ * menu commands.
+ *
+ * threadinfo_get fills in up to MAX entries, one per thread that
+ * exists, and returns how many threads there are, which may be more.
+ * It takes only the thread registry's own lock, not the run queues, so
+ * listing doesn't hold up scheduling; but that means the entries are
+ * a snapshot that may be slightly stale, and wait-channel names can be
+ * garbled if the channel goes away while they're copied.
+ *
+ * threadinfo_ps prints every thread. threadinfo_top prints, ITERATIONS
+ * times every SECS seconds, the threads that used the most cpu time in
+ * that interval.
+ */
+
+#ifndef _THREADINFO_H_
+#define _THREADINFO_H_
+
+#include <kern/threadinfo.h>
+
+unsigned threadinfo_get(struct threadinfo *ti, unsigned max);
+
+void threadinfo_ps(void);
+int threadinfo_top(unsigned iterations, unsigned secs);
+
+
+#endif /* _THREADINFO_H_ */
@@ -0,0 +1,65 @@
+/*
+ * Static tracepoints.
+ *
+ * TRACE(TP_xxx, a0, a1, a2, a3) appends a fixed-size binary record
+ * (cycle timestamp, CPU, pid, and four word arguments) to the current
+ * CPU's trace ring, if that tracepoint is enabled. Nothing is
+ * formatted until the ring is dumped, and a disabled tracepoint costs
+ * one load and one branch, so unlike DEBUG() these can be left in hot
+ * paths.
+ *
+ * Controlled from the "trace" menu command.
+ */
+
+#ifndef _TRACE_H_
+#define _TRACE_H_
+
+/* Tracepoints. Add the name and decode format in trace.c too. */
+#define TP_THREAD_SWITCH	0	/* newstate, next pid */
+#define TP_WCHAN_SLEEP		1	/* wchan */
+#define TP_VM_FAULT		2	/* faulttype, address */
+#define TP_SYSCALL		3	/* callno, a0, a1, a2 */
+#define TP_SYSRET		4	/* callno, err, retval */
+#define TP_LHD_IO		5	/* unit, sector, count, iswrite */
+#define TP_EMU_WAITDONE		6	/* unit, result */
+#define TP_COUNT		7
+
+#define TRACE_NARGS	4
+#define TRACE_RINGSIZE	512	/* records per CPU; a power of 2 */
+
+struct tracerec {
+	uint64_t tr_cycles;		/* mainbus_cycles() */
+	uint16_t tr_tp;			/* TP_* */
+	uint16_t tr_cpu;		/* cpu number */
+	pid_t tr_pid;			/* current thread */
+	uint32_t tr_args[TRACE_NARGS];
+};
+
+struct tracering {
+	unsigned tr_head;		/* total records written */
+	struct tracerec tr_recs[TRACE_RINGSIZE];
+};
+
+/* Bit (1 << TP_xxx) set if enabled. */
+extern volatile uint32_t trace_enabled;
+
+#define TRACE(tp, a0, a1, a2, a3)					\
+	do {								\
+		if (trace_enabled & (1U << (tp))) {			\
+			trace_record(tp, (uint32_t)(a0), (uint32_t)(a1), \
+				     (uint32_t)(a2), (uint32_t)(a3));	\
+		}							\
+	} while (0)
+
+void trace_record(unsigned tp, uint32_t a0, uint32_t a1, uint32_t a2,
+		  uint32_t a3);
+
+/* Menu support. */
+int trace_lookup(const char *name);	/* TP_* or -1 */
+int trace_enable(uint32_t mask);	/* allocates rings as needed */
+void trace_disable(uint32_t mask);
+void trace_clear(void);
+void trace_list(void);
+void trace_dump(bool raw);
+
+#endif /* _TRACE_H_ */
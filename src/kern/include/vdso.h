@@ -0,0 +1,25 @@
+/*
+ * Kernel side of the read-only time/pid pages. The user-visible
+ * layout is in <kern/vdso.h>.
+ */
+
+#ifndef _VDSO_H_
+#define _VDSO_H_
+
+#include <kern/vdso.h>
+
+struct addrspace;
+
+/* Allocate the global time page. Call once, after vm_bootstrap. */
+void vdso_bootstrap(void);
+
+/* Refresh the time page. Called from hardclock on one CPU only. */
+void vdso_hardclock(void);
+
+/* Map the time page and a fresh pid page into AS. */
+int vdso_map(struct addrspace *as, pid_t pid);
+
+/* Undo vdso_map (harmless if it was never done). */
+void vdso_unmap(struct addrspace *as);
+
+#endif /* _VDSO_H_ */
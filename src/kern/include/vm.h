@@ -55,6 +55,14 @@ int vm_fault(int faulttype, vaddr_t faultaddress);
 vaddr_t alloc_kpages(int npages);
 void free_kpages(vaddr_t addr);
 
+/*
+ * Copy out the fault and TLB counters of AS, or if AS is NULL the
+ * totals for the whole system.
+ */
+struct addrspace;
+struct vmstat;
+void vm_getstat(struct addrspace *as, struct vmstat *vs);
+
 /* TLB shootdown handling called from interprocessor_interrupt */
 void vm_tlbshootdown_all(void);
 void vm_tlbshootdown(const struct tlbshootdown *);
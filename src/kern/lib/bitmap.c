@@ -42,40 +42,98 @@
  * because if one uses any data type more than a single byte wide,
  * bitmap data saved on disk becomes endian-dependent, which is a
  * severe nuisance.
+ *
+ * Searching is done 32 bits at a time anyway, by putting scan words
+ * together from four bytes by hand, which gives the same answer on
+ * either byte order. The byte array is padded out to a whole number
+ * of scan words with bits marked in use.
+ *
+ * A second, in-memory-only level has one bit per scan word, set when
+ * that word is full, so a search skips 1024 bits per summary word.
  */
 #define BITS_PER_WORD   (CHAR_BIT)
 #define WORD_TYPE       unsigned char
 #define WORD_ALLBITS    (0xff)
 
+#define BITS_PER_SCAN   32
+#define BYTES_PER_SCAN  (BITS_PER_SCAN / BITS_PER_WORD)
+#define SCAN_ALLBITS    (0xffffffffU)
+
 struct bitmap {
         unsigned nbits;
+        unsigned nscan;         /* scan words, rounded up */
+        unsigned nsummary;      /* summary words, rounded up */
+        unsigned hint;          /* scan word to try first (next fit) */
         WORD_TYPE *v;
+        uint32_t *full;         /* bit per scan word: set if word is full */
 };
 
+/*
+ * Scan word WIX, with bit N of the word being bit WIX*32+N.
+ */
+static
+inline
+uint32_t
+bitmap_getscan(const struct bitmap *b, unsigned wix)
+{
+        const WORD_TYPE *p = &b->v[wix * BYTES_PER_SCAN];
+
+        return (uint32_t)p[0] | ((uint32_t)p[1] << 8) |
+                ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+/*
+ * Update the summary bit for scan word WIX.
+ */
+static
+inline
+void
+bitmap_summarize(struct bitmap *b, unsigned wix)
+{
+        uint32_t mask = (uint32_t)1 << (wix % BITS_PER_SCAN);
+
+        if (bitmap_getscan(b, wix) == SCAN_ALLBITS) {
+                b->full[wix / BITS_PER_SCAN] |= mask;
+        }
+        else {
+                b->full[wix / BITS_PER_SCAN] &= ~mask;
+        }
+}
 
 struct bitmap *
 bitmap_create(unsigned nbits)
 {
         struct bitmap *b; 
-        unsigned words;
+        unsigned words, nbytes, j;
 
         words = DIVROUNDUP(nbits, BITS_PER_WORD);
         b = kmalloc(sizeof(struct bitmap));
         if (b == NULL) {
                 return NULL;
         }
-        b->v = kmalloc(words*sizeof(WORD_TYPE));
+        b->nscan = DIVROUNDUP(nbits, BITS_PER_SCAN);
+        b->nsummary = DIVROUNDUP(b->nscan, BITS_PER_SCAN);
+        b->hint = 0;
+
+        nbytes = b->nscan * BYTES_PER_SCAN;
+        b->v = kmalloc(nbytes);
         if (b->v == NULL) {
                 kfree(b);
                 return NULL;
         }
+        b->full = kmalloc(b->nsummary * sizeof(uint32_t));
+        if (b->full == NULL) {
+                kfree(b->v);
+                kfree(b);
+                return NULL;
+        }
 
         bzero(b->v, words*sizeof(WORD_TYPE));
         b->nbits = nbits;
 
         /* Mark any leftover bits at the end in use */
         if (words > nbits / BITS_PER_WORD) {
-                unsigned j, ix = words-1;
+                unsigned ix = words-1;
                 unsigned overbits = nbits - ix*BITS_PER_WORD;
 
                 KASSERT(nbits / BITS_PER_WORD == words-1);
@@ -85,7 +143,12 @@ bitmap_create(unsigned nbits)
                         b->v[ix] |= ((WORD_TYPE)1 << j);
                 }
         }
+        /* ...and the padding out to a scan word */
+        for (j=words; j<nbytes; j++) {
+                b->v[j] = WORD_ALLBITS;
+        }
 
+        bitmap_rescan(b);
         return b;
 }
 
@@ -95,29 +158,119 @@ bitmap_getdata(struct bitmap *b)
         return b->v;
 }
 
+void
+bitmap_rescan(struct bitmap *b)
+{
+        unsigned wix;
+
+        bzero(b->full, b->nsummary * sizeof(uint32_t));
+        for (wix=0; wix<b->nscan; wix++) {
+                bitmap_summarize(b, wix);
+        }
+        /* Summary bits past the last scan word count as full */
+        for (wix=b->nscan; wix<b->nsummary*BITS_PER_SCAN; wix++) {
+                b->full[wix / BITS_PER_SCAN] |=
+                        (uint32_t)1 << (wix % BITS_PER_SCAN);
+        }
+}
+
 int
 bitmap_alloc(struct bitmap *b, unsigned *index)
 {
-        unsigned ix;
-        unsigned maxix = DIVROUNDUP(b->nbits, BITS_PER_WORD);
-        unsigned offset;
+        unsigned wix, six, i, offset;
+        WORD_TYPE mask;
+
+        if (b->nscan == 0) {
+                return ENOSPC;
+        }
+
+        /* Next fit: try where the last allocation was first */
+        wix = b->hint;
+        if (bitmap_getscan(b, wix) == SCAN_ALLBITS) {
+                six = wix / BITS_PER_SCAN;
+                for (i=0; i<b->nsummary; i++) {
+                        if (b->full[six] != SCAN_ALLBITS) {
+                                break;
+                        }
+                        six = (six + 1) % b->nsummary;
+                }
+                if (i == b->nsummary) {
+                        return ENOSPC;
+                }
+                wix = six * BITS_PER_SCAN + ctz32(~b->full[six]);
+        }
+
+        offset = ctz32(~bitmap_getscan(b, wix));
+        *index = wix * BITS_PER_SCAN + offset;
+        KASSERT(*index < b->nbits);
+
+        mask = ((WORD_TYPE)1) << (*index % BITS_PER_WORD);
+        b->v[*index / BITS_PER_WORD] |= mask;
+        bitmap_summarize(b, wix);
+        b->hint = wix;
+        return 0;
+}
+
+/*
+ * Find the first run of N clear bits, skipping full scan words (and
+ * whole summary words of them) without looking at their bits.
+ */
+int
+bitmap_alloc_range(struct bitmap *b, unsigned n, unsigned *index)
+{
+        unsigned wix, bit, start = 0, run = 0, i;
+        uint32_t w;
 
-        for (ix=0; ix<maxix; ix++) {
-                if (b->v[ix]!=WORD_ALLBITS) {
-                        for (offset = 0; offset < BITS_PER_WORD; offset++) {
-                                WORD_TYPE mask = ((WORD_TYPE)1) << offset;
+        KASSERT(n > 0);
 
-                                if ((b->v[ix] & mask)==0) {
-                                        b->v[ix] |= mask;
-                                        *index = (ix*BITS_PER_WORD)+offset;
-                                        KASSERT(*index < b->nbits);
-                                        return 0;
+        for (wix=0; wix<b->nscan && run<n; wix++) {
+                if (wix % BITS_PER_SCAN == 0 &&
+                    b->full[wix / BITS_PER_SCAN] == SCAN_ALLBITS) {
+                        run = 0;
+                        wix += BITS_PER_SCAN - 1;
+                        continue;
+                }
+                w = bitmap_getscan(b, wix);
+                if (w == SCAN_ALLBITS) {
+                        run = 0;
+                        continue;
+                }
+                if (w == 0) {
+                        if (run == 0) {
+                                start = wix * BITS_PER_SCAN;
+                        }
+                        run += BITS_PER_SCAN;
+                        continue;
+                }
+                for (bit=0; bit<BITS_PER_SCAN && run<n; bit++) {
+                        if (w & ((uint32_t)1 << bit)) {
+                                run = 0;
+                        }
+                        else {
+                                if (run == 0) {
+                                        start = wix * BITS_PER_SCAN + bit;
                                 }
+                                run++;
                         }
-                        KASSERT(0);
                 }
         }
-        return ENOSPC;
+        if (run < n) {
+                return ENOSPC;
+        }
+
+        /* Padding bits are marked, so the run can't go off the end */
+        KASSERT(start + n <= b->nbits);
+        for (i=start; i<start+n; i++) {
+                b->v[i / BITS_PER_WORD] |=
+                        ((WORD_TYPE)1) << (i % BITS_PER_WORD);
+        }
+        for (wix = start / BITS_PER_SCAN;
+             wix <= (start + n - 1) / BITS_PER_SCAN;
+             wix++) {
+                bitmap_summarize(b, wix);
+        }
+        *index = start;
+        return 0;
 }
 
 static
@@ -142,6 +295,7 @@ bitmap_mark(struct bitmap *b, unsigned index)
 
         KASSERT((b->v[ix] & mask)==0);
         b->v[ix] |= mask;
+        bitmap_summarize(b, index / BITS_PER_SCAN);
 }
 
 void
@@ -155,6 +309,8 @@ bitmap_unmark(struct bitmap *b, unsigned index)
 
         KASSERT((b->v[ix] & mask)!=0);
         b->v[ix] &= ~mask;
+        b->full[index / (BITS_PER_SCAN * BITS_PER_SCAN)] &=
+                ~((uint32_t)1 << ((index / BITS_PER_SCAN) % BITS_PER_SCAN));
 }
 
 
@@ -171,6 +327,7 @@ bitmap_isset(struct bitmap *b, unsigned index)
 void
 bitmap_destroy(struct bitmap *b)
 {
+        kfree(b->full);
         kfree(b->v);
         kfree(b);
 }
@@ -0,0 +1,409 @@
+/*
+ * Intrusive hash table. See hashtable.h for the interface.
+ *
+ * Bucket b belongs to stripe b & (nstripes-1), which is also the
+ * stripe of every hash that lands in it, in any size of the table;
+ * there are always at least as many buckets as stripes.
+ *
+ * While the table is growing, ht_old holds the previous bucket array.
+ * Stripe s owns old buckets s, s + nstripes, s + 2*nstripes, ...; the
+ * first hs_moved of those have been emptied into ht_buckets and the
+ * rest have not been touched. Each stripe moves its own old buckets
+ * with only its own lock held. Stripes finish at different times and
+ * all of them read ht_old and ht_oldn, so those stay put, and the old
+ * array stays allocated, until the next grow or hashtable_cleanup,
+ * which hold every stripe lock.
+ */
+
+#include <types.h>
+#include <kern/errno.h>
+#include <lib.h>
+#include <spinlock.h>
+#include <hashtable.h>
+
+void
+hashlink_init(struct hashlink *hl, void *self)
+{
+	hl->hl_next = NULL;
+	hl->hl_self = self;
+	hl->hl_hash = 0;
+}
+
+////////////////////////////////////////////////////////////
+// locking
+
+static
+void
+stripe_lock(struct hashtable *ht, unsigned s)
+{
+	if (ht->ht_locked) {
+		spinlock_acquire(&ht->ht_stripes[s].hs_lock);
+	}
+}
+
+static
+void
+stripe_unlock(struct hashtable *ht, unsigned s)
+{
+	if (ht->ht_locked) {
+		spinlock_release(&ht->ht_stripes[s].hs_lock);
+	}
+}
+
+////////////////////////////////////////////////////////////
+// resizing
+
+/*
+ * Number of old buckets each stripe owns.
+ */
+static
+unsigned
+old_perstripe(struct hashtable *ht)
+{
+	return ht->ht_oldn / ht->ht_nstripes;
+}
+
+/*
+ * Empty old bucket J into the new array.
+ */
+static
+void
+move_bucket(struct hashtable *ht, unsigned j)
+{
+	struct hashlink *hl, *next;
+	unsigned b;
+
+	for (hl = ht->ht_old[j]; hl != NULL; hl = next) {
+		next = hl->hl_next;
+		b = hl->hl_hash & (ht->ht_nbuckets - 1);
+		hl->hl_next = ht->ht_buckets[b];
+		ht->ht_buckets[b] = hl;
+	}
+	ht->ht_old[j] = NULL;
+}
+
+/*
+ * Move up to MAX of stripe S's old buckets; the stripe must be locked.
+ */
+static
+void
+move_some(struct hashtable *ht, unsigned s, unsigned max)
+{
+	struct hashstripe *hs = &ht->ht_stripes[s];
+	unsigned per;
+
+	if (ht->ht_old == NULL) {
+		return;
+	}
+	per = old_perstripe(ht);
+	while (max > 0 && hs->hs_moved < per) {
+		move_bucket(ht, s + hs->hs_moved * ht->ht_nstripes);
+		hs->hs_moved++;
+		max--;
+	}
+}
+
+/*
+ * Double the table, which had N buckets when the caller decided to.
+ * Called with no locks held. Only installs the new array; the entries
+ * move over later, a few buckets at a time. If we can't get memory,
+ * the table just stays at the size it is.
+ */
+static
+void
+grow(struct hashtable *ht, unsigned n)
+{
+	struct hashlink **buckets, **stale;
+	unsigned i;
+
+	buckets = kmalloc(2 * n * sizeof(*buckets));
+	if (buckets == NULL) {
+		return;
+	}
+	for (i=0; i<2*n; i++) {
+		buckets[i] = NULL;
+	}
+
+	for (i=0; i<ht->ht_nstripes; i++) {
+		stripe_lock(ht, i);
+	}
+
+	if (ht->ht_nbuckets != n) {
+		/* someone beat us to it */
+		stale = buckets;
+		goto out;
+	}
+
+	/* Finish the last move, if it's still going, and drop its array. */
+	for (i=0; i<ht->ht_nstripes; i++) {
+		move_some(ht, i, (unsigned)-1);
+	}
+	stale = ht->ht_old;
+
+	ht->ht_old = ht->ht_buckets;
+	ht->ht_oldn = n;
+	ht->ht_buckets = buckets;
+	ht->ht_nbuckets = 2 * n;
+	for (i=0; i<ht->ht_nstripes; i++) {
+		ht->ht_stripes[i].hs_moved = 0;
+	}
+
+ out:
+	for (i=ht->ht_nstripes; i-- > 0; ) {
+		stripe_unlock(ht, i);
+	}
+	if (stale != NULL) {
+		kfree(stale);
+	}
+}
+
+////////////////////////////////////////////////////////////
+// finding things
+
+/*
+ * Return the head pointer of the bucket HASH is in right now: the old
+ * one if its stripe hasn't moved it yet, else the new one. The stripe
+ * must be locked.
+ */
+static
+struct hashlink **
+bucketof(struct hashtable *ht, uint32_t hash)
+{
+	unsigned s, j;
+
+	if (ht->ht_old != NULL) {
+		s = hash & (ht->ht_nstripes - 1);
+		j = hash & (ht->ht_oldn - 1);
+		if (j / ht->ht_nstripes >= ht->ht_stripes[s].hs_moved) {
+			return &ht->ht_old[j];
+		}
+	}
+	return &ht->ht_buckets[hash & (ht->ht_nbuckets - 1)];
+}
+
+////////////////////////////////////////////////////////////
+// operations
+
+int
+hashtable_init(struct hashtable *ht, unsigned nlocks)
+{
+	unsigned i;
+
+	ht->ht_locked = nlocks > 0;
+	ht->ht_nstripes = nlocks > 0 ? nlocks : 1;
+	KASSERT((ht->ht_nstripes & (ht->ht_nstripes - 1)) == 0);
+	ht->ht_nbuckets = HASH_MINBUCKETS;
+	while (ht->ht_nbuckets < ht->ht_nstripes) {
+		ht->ht_nbuckets *= 2;
+	}
+	ht->ht_old = NULL;
+	ht->ht_oldn = 0;
+
+	ht->ht_stripes = kmalloc(ht->ht_nstripes * sizeof(*ht->ht_stripes));
+	if (ht->ht_stripes == NULL) {
+		return ENOMEM;
+	}
+	ht->ht_buckets = kmalloc(ht->ht_nbuckets * sizeof(*ht->ht_buckets));
+	if (ht->ht_buckets == NULL) {
+		kfree(ht->ht_stripes);
+		return ENOMEM;
+	}
+	for (i=0; i<ht->ht_nbuckets; i++) {
+		ht->ht_buckets[i] = NULL;
+	}
+	for (i=0; i<ht->ht_nstripes; i++) {
+		spinlock_init(&ht->ht_stripes[i].hs_lock);
+		ht->ht_stripes[i].hs_count = 0;
+		ht->ht_stripes[i].hs_moved = 0;
+	}
+	return 0;
+}
+
+void
+hashtable_cleanup(struct hashtable *ht)
+{
+	unsigned i;
+
+	KASSERT(hashtable_num(ht) == 0);
+	for (i=0; i<ht->ht_nstripes; i++) {
+		spinlock_cleanup(&ht->ht_stripes[i].hs_lock);
+	}
+	kfree(ht->ht_stripes);
+	kfree(ht->ht_buckets);
+	if (ht->ht_old != NULL) {
+		kfree(ht->ht_old);
+	}
+	ht->ht_stripes = NULL;
+	ht->ht_buckets = NULL;
+	ht->ht_old = NULL;
+}
+
+/*
+ * With locks, this is only a snapshot.
+ */
+unsigned
+hashtable_num(const struct hashtable *ht)
+{
+	unsigned i, num = 0;
+
+	for (i=0; i<ht->ht_nstripes; i++) {
+		num += ht->ht_stripes[i].hs_count;
+	}
+	return num;
+}
+
+void
+hashtable_insert(struct hashtable *ht, struct hashlink *hl, uint32_t hash)
+{
+	struct hashlink **head;
+	unsigned s, n;
+	bool full;
+
+	KASSERT(hl->hl_self != NULL);
+	s = hash & (ht->ht_nstripes - 1);
+	stripe_lock(ht, s);
+	move_some(ht, s, HASH_MIGRATE);
+
+	hl->hl_hash = hash;
+	head = bucketof(ht, hash);
+	hl->hl_next = *head;
+	*head = hl;
+
+	n = ht->ht_nbuckets;
+	full = ++ht->ht_stripes[s].hs_count >
+		HASH_LOAD * (n / ht->ht_nstripes);
+	stripe_unlock(ht, s);
+	if (full) {
+		grow(ht, n);
+	}
+}
+
+void
+hashtable_remove(struct hashtable *ht, struct hashlink *hl)
+{
+	struct hashlink **pp;
+	unsigned s;
+
+	s = hl->hl_hash & (ht->ht_nstripes - 1);
+	stripe_lock(ht, s);
+	move_some(ht, s, HASH_MIGRATE);
+
+	for (pp = bucketof(ht, hl->hl_hash); *pp != hl; pp = &(*pp)->hl_next) {
+		KASSERT(*pp != NULL);
+	}
+	*pp = hl->hl_next;
+	hl->hl_next = NULL;
+	KASSERT(ht->ht_stripes[s].hs_count > 0);
+	ht->ht_stripes[s].hs_count--;
+	stripe_unlock(ht, s);
+}
+
+void *
+hashtable_lookup(struct hashtable *ht, uint32_t hash,
+		 bool (*match)(const void *entry, const void *key),
+		 const void *key)
+{
+	struct hashlink *hl;
+	void *ret = NULL;
+	unsigned s;
+
+	s = hash & (ht->ht_nstripes - 1);
+	stripe_lock(ht, s);
+	move_some(ht, s, HASH_MIGRATE);
+
+	for (hl = *bucketof(ht, hash); hl != NULL; hl = hl->hl_next) {
+		if (hl->hl_hash == hash && match(hl->hl_self, key)) {
+			ret = hl->hl_self;
+			break;
+		}
+	}
+	stripe_unlock(ht, s);
+	return ret;
+}
+
+////////////////////////////////////////////////////////////
+// iteration
+
+/*
+ * Is old bucket J still in use, i.e., not yet moved?
+ */
+static
+bool
+old_live(struct hashtable *ht, unsigned j)
+{
+	unsigned s = j & (ht->ht_nstripes - 1);
+
+	return j / ht->ht_nstripes >= ht->ht_stripes[s].hs_moved;
+}
+
+void
+hashtable_iter_start(struct hashtable *ht, struct hashiter *hi)
+{
+	hi->hi_ht = ht;
+	hi->hi_old = false;
+	hi->hi_bucket = 0;
+	hi->hi_link = ht->ht_buckets[0];
+}
+
+void *
+hashtable_iter_next(struct hashiter *hi)
+{
+	struct hashtable *ht = hi->hi_ht;
+	struct hashlink *hl;
+
+	while (hi->hi_link == NULL) {
+		hi->hi_bucket++;
+		if (!hi->hi_old && hi->hi_bucket == ht->ht_nbuckets) {
+			if (ht->ht_old == NULL) {
+				return NULL;
+			}
+			hi->hi_old = true;
+			hi->hi_bucket = 0;
+		}
+		else if (hi->hi_old && hi->hi_bucket >= ht->ht_oldn) {
+			return NULL;
+		}
+		if (!hi->hi_old) {
+			hi->hi_link = ht->ht_buckets[hi->hi_bucket];
+		}
+		else if (old_live(ht, hi->hi_bucket)) {
+			hi->hi_link = ht->ht_old[hi->hi_bucket];
+		}
+	}
+	hl = hi->hi_link;
+	hi->hi_link = hl->hl_next;
+	return hl->hl_self;
+}
+
+////////////////////////////////////////////////////////////
+// hash functions
+
+/*
+ * FNV-1a.
+ */
+uint32_t
+hash_string(const char *s)
+{
+	uint32_t h = 2166136261U;
+
+	while (*s != '\0') {
+		h ^= (unsigned char)*s++;
+		h *= 16777619U;
+	}
+	return h;
+}
+
+/*
+ * Mix all the bits of X into the low ones, which pick the bucket.
+ * (The finalizer from MurmurHash3.)
+ */
+uint32_t
+hash_uint32(uint32_t x)
+{
+	x ^= x >> 16;
+	x *= 0x85ebca6bU;
+	x ^= x >> 13;
+	x *= 0xc2b2ae35U;
+	x ^= x >> 16;
+	return x;
+}
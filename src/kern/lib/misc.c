@@ -60,3 +60,20 @@ strerror(int errcode)
 	panic("Invalid error code %d\n", errcode);
 	return NULL;
 }
+
+/*
+ * Trailing zeros by de Bruijn multiply: X & -X isolates the lowest set
+ * bit, and multiplying by the de Bruijn constant puts a different
+ * 5-bit pattern in the top bits for each of the 32 possible bits.
+ */
+static const unsigned char ctz32_debruijn[32] = {
+	0, 1, 28, 2, 29, 14, 24, 3, 30, 22, 20, 15, 25, 17, 4, 8,
+	31, 27, 13, 23, 21, 19, 16, 7, 26, 12, 18, 6, 11, 5, 10, 9,
+};
+
+unsigned
+ctz32(uint32_t x)
+{
+	KASSERT(x != 0);
+	return ctz32_debruijn[((x & -x) * 0x077CB531U) >> 27];
+}
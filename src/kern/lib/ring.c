@@ -0,0 +1,109 @@
+/*
+ * Ring buffers. See ring.h for the interface.
+ */
+
+/* Make sure out-of-line copies of the memory barriers get built. */
+#define MEMBAR_INLINE
+
+#include <types.h>
+#include <lib.h>
+#include <spinlock.h>
+#include <membar.h>
+#include <ring.h>
+
+////////////////////////////////////////////////////////////
+// single producer
+
+void
+spscring_init(struct spscring *r, void *buf, unsigned nitems,
+	      size_t itemsize)
+{
+	KASSERT(nitems > 0 && (nitems & (nitems - 1)) == 0);
+	KASSERT(itemsize > 0);
+
+	r->sr_head = 0;
+	r->sr_tail = 0;
+	r->sr_mask = nitems - 1;
+	r->sr_itemsize = itemsize;
+	r->sr_buf = buf;
+}
+
+bool
+spscring_put(struct spscring *r, const void *item)
+{
+	unsigned head = r->sr_head;
+
+	if (head - r->sr_tail > r->sr_mask) {
+		return false;
+	}
+	memcpy(r->sr_buf + (head & r->sr_mask) * r->sr_itemsize, item,
+	       r->sr_itemsize);
+	/* the item has to be there before the consumer can see it is */
+	membar_store_store();
+	r->sr_head = head + 1;
+	return true;
+}
+
+bool
+spscring_get(struct spscring *r, void *item)
+{
+	unsigned tail = r->sr_tail;
+
+	if (r->sr_head == tail) {
+		return false;
+	}
+	/* don't read the item before seeing the head that covers it */
+	membar_load_load();
+	memcpy(item, r->sr_buf + (tail & r->sr_mask) * r->sr_itemsize,
+	       r->sr_itemsize);
+	/* and finish reading it before the producer can reuse the slot */
+	membar_load_store();
+	r->sr_tail = tail + 1;
+	return true;
+}
+
+unsigned
+spscring_count(const struct spscring *r)
+{
+	return r->sr_head - r->sr_tail;
+}
+
+////////////////////////////////////////////////////////////
+// multiple producers
+
+void
+mpscring_init(struct mpscring *r, void *buf, unsigned nitems,
+	      size_t itemsize)
+{
+	spscring_init(&r->mr_ring, buf, nitems, itemsize);
+	spinlock_init(&r->mr_putlock);
+}
+
+void
+mpscring_cleanup(struct mpscring *r)
+{
+	spinlock_cleanup(&r->mr_putlock);
+}
+
+bool
+mpscring_put(struct mpscring *r, const void *item)
+{
+	bool ret;
+
+	spinlock_acquire(&r->mr_putlock);
+	ret = spscring_put(&r->mr_ring, item);
+	spinlock_release(&r->mr_putlock);
+	return ret;
+}
+
+bool
+mpscring_get(struct mpscring *r, void *item)
+{
+	return spscring_get(&r->mr_ring, item);
+}
+
+unsigned
+mpscring_count(const struct mpscring *r)
+{
+	return spscring_count(&r->mr_ring);
+}
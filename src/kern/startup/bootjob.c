@@ -0,0 +1,109 @@
+/*
+ * Deferred attach work. See <bootjob.h>.
+ */
+
+#include <types.h>
+#include <lib.h>
+#include <spl.h>
+#include <thread.h>
+#include <synch.h>
+#include <bootprof.h>
+#include <bootjob.h>
+
+struct bootjob {
+	const char *bj_name;
+	int bj_unit;
+	int (*bj_func)(void *);
+	void *bj_data;
+};
+
+/* Only the boot thread adds jobs, before the other cpus start. */
+static struct bootjob bootjobs[BOOTJOB_MAX];
+static unsigned nbootjobs;
+static bool bootjobs_done;
+static struct semaphore *bootjob_sem;
+
+static
+void
+bootjob_run(struct bootjob *bj)
+{
+	uint64_t start;
+	int result;
+
+	start = bootprof_now();
+	result = bj->bj_func(bj->bj_data);
+	bootprof_device(bj->bj_name, bj->bj_unit, start, true);
+	if (result) {
+		kprintf("%s%d: %s\n", bj->bj_name, bj->bj_unit,
+			strerror(result));
+	}
+}
+
+static
+void
+bootjob_thread(void *vbj, unsigned long junk)
+{
+	(void)junk;
+
+	bootjob_run(vbj);
+	V(bootjob_sem);
+}
+
+void
+bootjob_add(const char *name, int unit, int (*func)(void *), void *data)
+{
+	struct bootjob bj;
+
+	bj.bj_name = name;
+	bj.bj_unit = unit;
+	bj.bj_func = func;
+	bj.bj_data = data;
+
+	if (bootjobs_done || nbootjobs == BOOTJOB_MAX) {
+		bootjob_run(&bj);
+		return;
+	}
+	bootjobs[nbootjobs++] = bj;
+}
+
+void
+bootjob_runall(void)
+{
+	unsigned i, nforked;
+	int result, spl;
+
+	KASSERT(!bootjobs_done);
+	bootjobs_done = true;
+
+	bootjob_sem = sem_create("bootjob", 0);
+	if (bootjob_sem == NULL) {
+		panic("bootjob_runall: out of memory\n");
+	}
+
+	nforked = 0;
+	for (i=0; i<nbootjobs; i++) {
+		result = thread_fork("bootjob", bootjob_thread, &bootjobs[i], 0,
+				     NULL);
+		if (result) {
+			/* do it ourselves */
+			bootjob_run(&bootjobs[i]);
+			continue;
+		}
+		nforked++;
+	}
+
+	/*
+	 * They're all on our run queue; hand them to the idle cpus.
+	 * thread_consider_migration expects to be called from
+	 * hardclock, with interrupts off.
+	 */
+	spl = splhigh();
+	thread_consider_migration();
+	splx(spl);
+
+	for (i=0; i<nforked; i++) {
+		P(bootjob_sem);
+	}
+	sem_destroy(bootjob_sem);
+	bootjob_sem = NULL;
+}
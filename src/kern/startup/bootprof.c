@@ -0,0 +1,135 @@
+/*
+ * Boot-time profile. See <bootprof.h>.
+ *
+ * The tables are static, since the first phases come before kmalloc
+ * is much use, and only grow; the boot thread writes the phases, and
+ * the device entries are claimed under a spinlock since deferred jobs
+ * finish on several cpus at once.
+ */
+
+#include <types.h>
+#include <lib.h>
+#include <spl.h>
+#include <spinlock.h>
+#include <cpu.h>
+#include <current.h>
+#include <mainbus.h>
+#include <bootprof.h>
+
+struct bootphase {
+	const char *bp_name;
+	uint64_t bp_start;
+	uint64_t bp_cycles;
+};
+
+struct bootdevice {
+	const char *bd_name;
+	int bd_unit;
+	unsigned bd_cpu;
+	bool bd_deferred;
+	bool bd_migrated;		/* started on another cpu */
+	uint64_t bd_cycles;
+};
+
+static struct bootphase bootphases[BOOTPROF_MAXPHASES];
+static unsigned nbootphases;
+static struct bootdevice bootdevices[BOOTPROF_MAXDEVICES];
+static unsigned nbootdevices;
+static struct spinlock bootdevices_lock = SPINLOCK_INITIALIZER;
+
+/* bootprof_now's top bits hold the cpu number, as region_start's do. */
+#define BP_CPUSHIFT		56
+#define BP_CYCLEMASK		(((uint64_t)1 << BP_CPUSHIFT) - 1)
+
+uint64_t
+bootprof_now(void)
+{
+	uint64_t start;
+	int spl;
+
+	/* read the clock and the cpu it belongs to together */
+	spl = splhigh();
+	start = (mainbus_cycles() & BP_CYCLEMASK) |
+		((uint64_t)curcpu->c_number << BP_CPUSHIFT);
+	splx(spl);
+	return start;
+}
+
+void
+bootprof_phase(const char *name)
+{
+	uint64_t now;
+
+	now = mainbus_cycles();
+	if (nbootphases > 0) {
+		bootphases[nbootphases - 1].bp_cycles =
+			now - bootphases[nbootphases - 1].bp_start;
+	}
+	if (name == NULL || nbootphases == BOOTPROF_MAXPHASES) {
+		return;
+	}
+	bootphases[nbootphases].bp_name = name;
+	bootphases[nbootphases].bp_start = now;
+	bootphases[nbootphases].bp_cycles = 0;
+	nbootphases++;
+}
+
+void
+bootprof_device(const char *name, int unit, uint64_t start, bool deferred)
+{
+	struct bootdevice *bd;
+	uint64_t now;
+
+	spinlock_acquire(&bootdevices_lock);
+	/* the spinlock keeps us on this cpu until we're done */
+	now = mainbus_cycles() & BP_CYCLEMASK;
+	if (nbootdevices < BOOTPROF_MAXDEVICES) {
+		bd = &bootdevices[nbootdevices++];
+		bd->bd_name = name;
+		bd->bd_unit = unit;
+		bd->bd_cpu = curcpu->c_number;
+		bd->bd_deferred = deferred;
+		/* another cpu's cycle count means nothing here */
+		bd->bd_migrated = (start >> BP_CPUSHIFT != bd->bd_cpu ||
+				   now < (start & BP_CYCLEMASK));
+		bd->bd_cycles = bd->bd_migrated ? 0 :
+			now - (start & BP_CYCLEMASK);
+	}
+	spinlock_release(&bootdevices_lock);
+}
+
+void
+bootprof_report(void)
+{
+	char name[32];
+	uint64_t total;
+	uint32_t mhz;
+	unsigned i;
+
+	mhz = mainbus_cyclefreq() / 1000000;
+
+	total = 0;
+	kprintf("Boot profile (us):\n");
+	for (i=0; i<nbootphases; i++) {
+		kprintf("    %-32s %10u\n", bootphases[i].bp_name,
+			(unsigned)(bootphases[i].bp_cycles / mhz));
+		total += bootphases[i].bp_cycles;
+	}
+	kprintf("    %-32s %10u\n", "total",
+		(unsigned)(total / mhz));
+
+	kprintf("Device attach (us):\n");
+	for (i=0; i<nbootdevices; i++) {
+		snprintf(name, sizeof(name), "%s%d", bootdevices[i].bd_name,
+			 bootdevices[i].bd_unit);
+		if (bootdevices[i].bd_migrated) {
+			kprintf("    %-12s cpu%-3u %10s%s\n", name,
+				bootdevices[i].bd_cpu, "?",
+				" (migrated)");
+			continue;
+		}
+		kprintf("    %-12s cpu%-3u %10u%s\n", name, bootdevices[i].bd_cpu,
+			(unsigned)(bootdevices[i].bd_cycles / mhz),
+			bootdevices[i].bd_deferred ? " (deferred)" : "");
+	}
+}
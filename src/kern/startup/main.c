@@ -49,6 +49,10 @@
 #include <test.h>
 #include <version.h>
 #include <pid.h> /* to bootstrap process ID system - New for ASST1 */
+#include <vdso.h>
+#include <execcache.h>
+#include <bootprof.h>
+#include <bootjob.h>
 #include "autoconf.h"  // for pseudoconfig
 
 
@@ -72,6 +76,11 @@ static const char harvard_copyright[] =
     "   President and Fellows of Harvard College.  All rights reserved.\n";
 
 
+/*
+ * Run one step of boot, timing it as a phase of its own.
+ */
+#define BOOTSTEP(x) do { bootprof_phase(#x); x; } while (0)
+
 /*
  * Initial boot sequence.
  */
@@ -105,35 +114,45 @@ boot(void)
 		GROUP_VERSION, buildconfig, buildversion);
 	kprintf("\n");
 
-	/* Early initialization. */
+	/* Early initialization. (Nothing can be timed until curcpu exists.) */
 	ram_bootstrap();
 	thread_bootstrap();
-	hardclock_bootstrap();
-	vfs_bootstrap();
+	BOOTSTEP(hardclock_bootstrap());
+	BOOTSTEP(vfs_bootstrap());
 
 	/* Probe and initialize devices. Interrupts should come on. */
 	kprintf("Device probe...\n");
 	KASSERT(curthread->t_curspl > 0);
-	mainbus_bootstrap();
+	BOOTSTEP(mainbus_bootstrap());
 	KASSERT(curthread->t_curspl == 0);
 	/* Now do pseudo-devices. */
-	pseudoconfig();
+	BOOTSTEP(pseudoconfig());
 	kprintf("\n");
 
 	/* Late phase of initialization. */
-	vm_bootstrap();
-	kprintf_bootstrap();
+	BOOTSTEP(vm_bootstrap());
+	BOOTSTEP(vdso_bootstrap());
+	BOOTSTEP(execcache_bootstrap());
+	BOOTSTEP(kprintf_bootstrap());
 	
 	/* New for ASST1 - Initialize process ID managment. This should
 	 * come before additional cpus are brought online.
 	 */
-	pid_bootstrap(); 
-	dumb_consoleIO_bootstrap(); /* And initialize for user console IO */
+	BOOTSTEP(pid_bootstrap()); 
+	/* And initialize for user console IO */
+	BOOTSTEP(dumb_consoleIO_bootstrap());
 
-	thread_start_cpus();
+	BOOTSTEP(thread_start_cpus());
+
+	/* Finish attaching devices, on all the cpus, before mounting. */
+	BOOTSTEP(bootjob_runall());
 
 	/* Default bootfs - but ignore failure, in case emu0 doesn't exist */
-	vfs_setbootfs("emu0");
+	BOOTSTEP(vfs_setbootfs("emu0"));
+
+	bootprof_phase(NULL);
+	kprintf("\n");
+	bootprof_report();
 
 
 	/*
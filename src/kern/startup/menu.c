@@ -29,6 +29,7 @@
 
 #include <types.h>
 #include <kern/errno.h>
+#include <kern/fcntl.h>
 #include <kern/reboot.h>
 #include <kern/unistd.h>
 #include <kern/sysexits.h>
@@ -38,8 +39,16 @@
 #include <clock.h>
 #include <thread.h>
 #include <vfs.h>
+#include <vnode.h>
+#include <pid.h>
 #include <syscall.h>
 #include <test.h>
+#include <execcache.h>
+#include <prof.h>
+#include <trace.h>
+#include <region.h>
+#include <mainbus.h>
+#include <threadinfo.h>
 
 /*
  * In-kernel menu and command dispatcher.
@@ -48,6 +57,15 @@
 #define _PATH_SHELL "/bin/sh"
 
 #define MAXMENUARGS  16
+#define MAXSCRIPT    4096	/* bytes in a "script" file */
+
+/*
+ * Set while running a script: programs are waited for, and failed
+ * commands don't stop it.
+ */
+static bool menu_script;
+
+static int cmd_dispatch(char *cmd);
 
 // XXX this should not be in this file
 void
@@ -75,33 +93,40 @@ static
 void
 free_args(int nargs, char **args)
 {
-	int j;
-	for (j=0; j < nargs; j++) {
-		kfree(args[j]);
-	}
+	/* The strings live in the same block as the array */
+	(void)nargs;
 	kfree(args);
 }
 
+/*
+ * Copy the argument array and all its strings into a single block:
+ * the nargs pointers first, then the strings they point to.
+ */
 static
 char **
 copy_args(int nargs, char **args)
 {
 	char **the_copy;
+	char *strings;
+	size_t total, len;
 	int i;
-	
-	the_copy = (char **)kmalloc(nargs * sizeof(char *));
+
+	total = nargs * sizeof(char *);
+	for (i=0; i < nargs; i++) {
+		total += strlen(args[i]) + 1;
+	}
+
+	the_copy = (char **)kmalloc(total);
 	if (!the_copy) {
 		kprintf("Could not allocate memory for copy of args");
 		return NULL;
 	}
+	strings = (char *)&the_copy[nargs];
 	for (i=0; i < nargs; i++) {
-		the_copy[i] = kstrdup(args[i]);	
-		if (!the_copy[i]) {
-			kprintf("Could not allocate memory for copy of argument %d\n",i);
-			/* unwind existing allocations */
-			free_args(i, the_copy);
-			return NULL;
-		}
+		len = strlen(args[i]) + 1;
+		memcpy(strings, args[i], len);
+		the_copy[i] = strings;
+		strings += len;
 	}
 
 	return the_copy;
@@ -145,6 +170,7 @@ cmd_progthread(void *ptr, unsigned long nargs)
 	if (result) {
 		kprintf("Running program %s failed: %s\n", progname,
 			strerror(result));
+		free_args(nargs, args);
 		return;
 	}
 
@@ -155,9 +181,8 @@ cmd_progthread(void *ptr, unsigned long nargs)
  * Common code for cmd_prog and cmd_shell.
  *
  * Note that this does not wait for the subprogram to finish, but
- * returns immediately to the menu. This is usually not what you want,
- * so you should have it call your system-calls-assignment waitpid
- * code after forking.
+ * returns immediately to the menu, except in a script (see cmd_script)
+ * where it waits and prints the exit status.
  *
  * Also note that because the subprogram's thread uses the "args"
  * array and strings, until you do this a race condition exists
@@ -170,8 +195,9 @@ static
 int
 common_prog(int nargs, char **args)
 {
-	int result;
+	int result, status;
 	char **args_copy;
+	pid_t pid;
 #if OPT_SYNCHPROBS
 	kprintf("Warning: this probably won't work with a "
 		"synchronization-problems kernel.\n");
@@ -190,7 +216,7 @@ common_prog(int nargs, char **args)
 	result = thread_fork(args_copy[0] /* thread name */,
 			cmd_progthread /* thread function */,
 			args_copy /* thread arg */, nargs /* thread arg */,
-			NULL);
+			menu_script ? &pid : NULL);
 	if (result) {
 		kprintf("thread_fork failed: %s\n", strerror(result));
 		/* demke: need to free copy of args if fork fails */
@@ -198,6 +224,14 @@ common_prog(int nargs, char **args)
 		return result;
 	}
 
+	if (menu_script) {
+		result = pid_join(pid, &status, 0);
+		if (result < 0) {
+			return -result;
+		}
+		kprintf("Program %s exited with status %d\n", args[0], status);
+	}
+
 	return 0;
 }
 
@@ -389,6 +423,79 @@ cmd_quit(int nargs, char **args)
 	return 0;
 }
 
+/*
+ * Command for running the commands in a file, one per line, without
+ * stopping for input. Lines starting with # are skipped. Each command
+ * is echoed and timed as if given on the kernel command line, but
+ * programs run to completion before the next line, and a failure is
+ * reported without stopping the script. End it with "q" to power off
+ * when done; tools that boot the kernel to run benchmarks use this as
+ *
+ *	sys161 kernel "script emu0:bench.script"
+ */
+static
+int
+cmd_script(int nargs, char **args)
+{
+	struct vnode *vn;
+	struct iovec iov;
+	struct uio ku;
+	char *buf, *line, *context;
+	int result;
+
+	if (nargs != 2) {
+		kprintf("Usage: script file\n");
+		return EINVAL;
+	}
+	if (menu_script) {
+		kprintf("script: scripts don't nest\n");
+		return EINVAL;
+	}
+
+	buf = kmalloc(MAXSCRIPT);
+	if (buf == NULL) {
+		return ENOMEM;
+	}
+
+	/* vfs_open destroys the string it's passed */
+	result = vfs_open(args[1], O_RDONLY, 0, &vn);
+	if (result) {
+		kfree(buf);
+		return result;
+	}
+	uio_kinit(&iov, &ku, buf, MAXSCRIPT, 0, UIO_READ);
+	result = VOP_READ(vn, &ku);
+	vfs_close(vn);
+	if (result) {
+		kfree(buf);
+		return result;
+	}
+	if (ku.uio_resid == 0) {
+		kprintf("script: file is over %d bytes\n", MAXSCRIPT - 1);
+		kfree(buf);
+		return EFBIG;
+	}
+	buf[MAXSCRIPT - ku.uio_resid] = '\0';
+
+	menu_script = true;
+	for (line = strtok_r(buf, "\n", &context);
+	     line != NULL;
+	     line = strtok_r(NULL, "\n", &context)) {
+		if (line[0] == '#') {
+			continue;
+		}
+		kprintf("OS/161 kernel: %s\n", line);
+		result = cmd_dispatch(line);
+		if (result) {
+			kprintf("Menu command failed: %s\n", strerror(result));
+		}
+	}
+	menu_script = false;
+
+	kfree(buf);
+	return 0;
+}
+
 /*
  * Command for mounting a filesystem.
  */
@@ -493,6 +600,232 @@ cmd_kheapstats(int nargs, char **args)
 	return 0;
 }
 
+/*
+ * Command for showing (or with "flush", emptying) the exec image cache.
+ */
+static
+int
+cmd_execcache(int nargs, char **args)
+{
+	if (nargs == 2 && !strcmp(args[1], "flush")) {
+		execcache_flush();
+		return 0;
+	}
+	if (nargs != 1) {
+		kprintf("Usage: ec [flush]\n");
+		return EINVAL;
+	}
+
+	execcache_printstats();
+	return 0;
+}
+
+/*
+ * Command for the sampling profiler.
+ */
+static
+int
+cmd_prof(int nargs, char **args)
+{
+	if (nargs == 2 && !strcmp(args[1], "start")) {
+		return prof_start();
+	}
+	if (nargs == 2 && !strcmp(args[1], "stop")) {
+		prof_stop();
+		return 0;
+	}
+	if (nargs == 2 && !strcmp(args[1], "dump")) {
+		return prof_dump(-1);
+	}
+	if (nargs == 3 && !strcmp(args[1], "dump")) {
+		return prof_dump(atoi(args[2]));
+	}
+
+	kprintf("Usage: prof start | stop | dump [pid]\n");
+	return EINVAL;
+}
+
+/*
+ * Command for tracepoints: list them, turn them on or off, or dump
+ * the records (decoded, or raw with "dump raw").
+ */
+static
+int
+cmd_trace(int nargs, char **args)
+{
+	uint32_t mask = 0;
+	int i, tp;
+
+	if (nargs == 1) {
+		trace_list();
+		return 0;
+	}
+	if (!strcmp(args[1], "dump")) {
+		trace_dump(nargs == 3 && !strcmp(args[2], "raw"));
+		return 0;
+	}
+	if (nargs == 2 && !strcmp(args[1], "clear")) {
+		trace_clear();
+		return 0;
+	}
+	if (nargs >= 3 &&
+	    (!strcmp(args[1], "on") || !strcmp(args[1], "off"))) {
+		for (i=2; i<nargs; i++) {
+			if (!strcmp(args[i], "all")) {
+				mask = ~(uint32_t)0;
+				continue;
+			}
+			tp = trace_lookup(args[i]);
+			if (tp < 0) {
+				kprintf("trace: no tracepoint %s\n", args[i]);
+				return EINVAL;
+			}
+			mask |= 1U << tp;
+		}
+		if (args[1][1] == 'n') {
+			return trace_enable(mask);
+		}
+		trace_disable(mask);
+		return 0;
+	}
+
+	kprintf("Usage: trace [on|off all|NAME...] | dump [raw] | clear\n");
+	return EINVAL;
+}
+
+/*
+ * Command for measurement regions: print the table, turn measuring
+ * on or off, zero the table, or set the trace161 flag a region turns
+ * on while it runs ("rg ltrace fork k", "rg ltrace fork off").
+ */
+static
+int
+cmd_region(int nargs, char **args)
+{
+	int rg;
+
+	if (nargs == 1) {
+		region_report();
+		return 0;
+	}
+	if (nargs == 2 && !strcmp(args[1], "on")) {
+		return region_enable();
+	}
+	if (nargs == 2 && !strcmp(args[1], "off")) {
+		region_disable();
+		return 0;
+	}
+	if (nargs == 2 && !strcmp(args[1], "reset")) {
+		region_reset();
+		return 0;
+	}
+	if (nargs == 4 && !strcmp(args[1], "ltrace")) {
+		rg = region_lookup(args[2]);
+		if (rg < 0) {
+			kprintf("rg: no region %s\n", args[2]);
+			return EINVAL;
+		}
+		if (!strcmp(args[3], "off")) {
+			region_setltrace(rg, 0);
+			return 0;
+		}
+		if (strlen(args[3]) == 1) {
+			region_setltrace(rg, args[3][0]);
+			return 0;
+		}
+	}
+
+	kprintf("Usage: rg [on | off | reset | ltrace NAME FLAG|off]\n");
+	return EINVAL;
+}
+
+/*
+ * Command for interrupt statistics.
+ */
+static
+int
+cmd_intr(int nargs, char **args)
+{
+	uint32_t cpus;
+	int i, cpu, result;
+
+	if (nargs == 1) {
+		mainbus_intrstats();
+		return 0;
+	}
+	if (nargs == 2 && !strcmp(args[1], "reset")) {
+		mainbus_intrreset();
+		return 0;
+	}
+	if (nargs > 2 && !strcmp(args[1], "route")) {
+		cpus = 0;
+		for (i=2; i<nargs; i++) {
+			cpu = atoi(args[i]);
+			if (cpu < 0 || cpu >= 32) {
+				kprintf("intr: no cpu %s\n", args[i]);
+				return EINVAL;
+			}
+			cpus |= (uint32_t)1 << cpu;
+		}
+		result = mainbus_intrroute(cpus);
+		if (result) {
+			kprintf("intr: route: %s\n", strerror(result));
+		}
+		return result;
+	}
+
+	kprintf("Usage: intr [reset | route CPU...]\n");
+	return EINVAL;
+}
+
+/*
+ * Command for listing threads.
+ */
+static
+int
+cmd_ps(int nargs, char **args)
+{
+	(void)args;
+
+	if (nargs != 1) {
+		kprintf("Usage: ps\n");
+		return EINVAL;
+	}
+	threadinfo_ps();
+	return 0;
+}
+
+/*
+ * Command for showing the busiest threads, every so often.
+ */
+static
+int
+cmd_top(int nargs, char **args)
+{
+	int count = 1, secs = 1;
+	int result;
+
+	if (nargs > 3) {
+		kprintf("Usage: top [count [secs]]\n");
+		return EINVAL;
+	}
+	if (nargs > 1) {
+		count = atoi(args[1]);
+	}
+	if (nargs > 2) {
+		secs = atoi(args[2]);
+	}
+	if (count < 1 || secs < 1) {
+		kprintf("top: count and secs must be positive\n");
+		return EINVAL;
+	}
+	result = threadinfo_top(count, secs);
+	if (result) {
+		kprintf("top: %s\n", strerror(result));
+	}
+	return result;
+}
+
 ////////////////////////////////////////
 //
 // Menus.
@@ -534,6 +867,7 @@ static const char *opsmenu[] = {
 	"[pwd]     Print current directory   ",
 	"[sync]    Sync filesystems          ",
 	"[panic]   Intentional panic         ",
+	"[script]  Run commands from a file  ",
 	"[q]       Quit and shut down        ",
 	NULL
 };
@@ -568,6 +902,13 @@ static const char *testmenu[] = {
 	"[fs3] FS write stress       (4)     ",
 	"[fs4] FS write stress 2     (4)     ",
 	"[fs5] FS long stress        (4)     ",
+	"[bench] Kernel microbenchmarks      ",
+	"[kmr] Replay malloc trace           ",
+	"[lat] Wakeup latency                ",
+	"[ht] Hash table vs. array lookup    ",
+	"[rmap] Region map lookup            ",
+	"[ring] Ring buffer handoff          ",
+	"[hrt] High-resolution timers        ",
 	NULL
 };
 
@@ -634,12 +975,20 @@ static struct {
 	{ "pwd",	cmd_pwd },
 	{ "sync",	cmd_sync },
 	{ "panic",	cmd_panic },
+	{ "script",	cmd_script },
 	{ "q",		cmd_quit },
 	{ "exit",	cmd_quit },
 	{ "halt",	cmd_quit },
 
 	/* stats */
 	{ "kh",         cmd_kheapstats },
+	{ "ec",		cmd_execcache },
+	{ "prof",	cmd_prof },
+	{ "trace",	cmd_trace },
+	{ "rg",		cmd_region },
+	{ "intr",	cmd_intr },
+	{ "ps",		cmd_ps },
+	{ "top",	cmd_top },
 
 	/* base system tests */
 	{ "at",		arraytest },
@@ -669,6 +1018,15 @@ static struct {
 	{ "fs4",	writestress2 },
 	{ "fs5",	longstress },
 
+	/* microbenchmarks */
+	{ "bench",	benchtest },
+	{ "kmr",	kmreplay },
+	{ "lat",	lattest },
+	{ "ht",		hashtest },
+	{ "rmap",	regiontest },
+	{ "ring",	ringtest },
+	{ "hrt",	hrtimertest },
+
 	{ NULL, NULL }
 };
 
@@ -0,0 +1,248 @@
+/*
+ * Exec argument packing. See <argblock.h>.
+ */
+
+#include <types.h>
+#include <kern/errno.h>
+#include <limits.h>
+#include <lib.h>
+#include <vm.h>
+#include <copyinout.h>
+#include <argblock.h>
+
+/* Pad string lengths so the next string starts on a word boundary */
+#define ARGBLOCK_ALIGN	sizeof(vaddr_t)
+
+/* First buffer size; a power of 2, as ARG_MAX is */
+#define ARGBLOCK_MINSIZE 512
+
+static
+int
+argblock_init(struct argblock *ab, size_t size)
+{
+	ab->ab_buf = kmalloc(size);
+	if (ab->ab_buf == NULL) {
+		return ENOMEM;
+	}
+	ab->ab_size = size;
+	ab->ab_len = 0;
+	ab->ab_argc = 0;
+	return 0;
+}
+
+/*
+ * Make the buffer at least NEED bytes, doubling it.
+ */
+static
+int
+argblock_grow(struct argblock *ab, size_t need)
+{
+	char *buf;
+	size_t size;
+
+	if (need <= ab->ab_size) {
+		return 0;
+	}
+	if (need > ARG_MAX) {
+		return E2BIG;
+	}
+	for (size = ab->ab_size; size < need; size *= 2) {
+		/* nothing */
+	}
+	if (size > ARG_MAX) {
+		size = ARG_MAX;
+	}
+
+	buf = kmalloc(size);
+	if (buf == NULL) {
+		return ENOMEM;
+	}
+	memcpy(buf, ab->ab_buf, ab->ab_size);
+	kfree(ab->ab_buf);
+	ab->ab_buf = buf;
+	ab->ab_size = size;
+	return 0;
+}
+
+void
+argblock_cleanup(struct argblock *ab)
+{
+	if (ab->ab_buf != NULL) {
+		kfree(ab->ab_buf);
+		ab->ab_buf = NULL;
+	}
+}
+
+/*
+ * Pad the block out to the next word boundary.
+ */
+static
+void
+argblock_pad(struct argblock *ab)
+{
+	while (ab->ab_len % ARGBLOCK_ALIGN != 0) {
+		ab->ab_buf[ab->ab_len++] = '\0';
+	}
+}
+
+/*
+ * Copy in the user's argv array straight into the pointer slots at
+ * the front of the block. Rather than fetch one pointer at a time,
+ * take everything up to the end of the current user page per copyin;
+ * stopping at page ends means we never touch a page past the one
+ * holding the terminating NULL.
+ */
+static
+int
+argblock_copyinptrs(struct argblock *ab, userptr_t uargv)
+{
+	vaddr_t *slots;
+	vaddr_t uaddr = (vaddr_t)uargv;
+	size_t maxslots = ARG_MAX / sizeof(vaddr_t);
+	size_t n, i;
+	int result;
+
+	for (;;) {
+		n = (PAGE_SIZE - uaddr % PAGE_SIZE) / sizeof(vaddr_t);
+		if (n == 0) {
+			/* misaligned pointer straddling a page */
+			n = 1;
+		}
+		if (ab->ab_argc + n > maxslots) {
+			n = maxslots - ab->ab_argc;
+			if (n == 0) {
+				return E2BIG;
+			}
+		}
+
+		result = argblock_grow(ab, (ab->ab_argc + n) * sizeof(vaddr_t));
+		if (result) {
+			return result;
+		}
+		slots = (vaddr_t *)ab->ab_buf;
+
+		result = copyin((const_userptr_t)uaddr, &slots[ab->ab_argc],
+				n * sizeof(vaddr_t));
+		if (result) {
+			return result;
+		}
+
+		for (i=0; i<n; i++) {
+			if (slots[ab->ab_argc + i] == 0) {
+				ab->ab_argc += i;
+				return 0;
+			}
+		}
+		ab->ab_argc += n;
+		uaddr += n * sizeof(vaddr_t);
+	}
+}
+
+int
+argblock_copyin(struct argblock *ab, userptr_t uargv)
+{
+	vaddr_t *slots;
+	size_t got;
+	int i, result;
+
+	result = argblock_init(ab, ARGBLOCK_MINSIZE);
+	if (result) {
+		return result;
+	}
+
+	result = argblock_copyinptrs(ab, uargv);
+	if (result == 0) {
+		/* room for the NULL slot too */
+		result = argblock_grow(ab, (ab->ab_argc + 1) * sizeof(vaddr_t));
+	}
+	if (result) {
+		argblock_cleanup(ab);
+		return result;
+	}
+
+	/* Strings go right after the pointers, in their final places */
+	ab->ab_len = (ab->ab_argc + 1) * sizeof(vaddr_t);
+	for (i=0; i<ab->ab_argc; i++) {
+		slots = (vaddr_t *)ab->ab_buf;
+		result = copyinstr((const_userptr_t)slots[i],
+				   ab->ab_buf + ab->ab_len,
+				   ab->ab_size - ab->ab_len, &got);
+		if (result == ENAMETOOLONG && ab->ab_size < ARG_MAX) {
+			/* doesn't fit yet; copy it again into a bigger one */
+			result = argblock_grow(ab, ab->ab_size + 1);
+			if (result == 0) {
+				i--;
+				continue;
+			}
+		}
+		if (result) {
+			argblock_cleanup(ab);
+			return result == ENAMETOOLONG ? E2BIG : result;
+		}
+		slots[i] = ab->ab_len;
+		ab->ab_len += got;
+		argblock_pad(ab);
+	}
+	return 0;
+}
+
+int
+argblock_kinit(struct argblock *ab, char **args, int nargs)
+{
+	vaddr_t *slots;
+	size_t len, total;
+	int i, result;
+
+	/* Size it exactly, to the same limit as argblock_copyin */
+	total = (nargs + 1) * sizeof(vaddr_t);
+	for (i=0; i<nargs; i++) {
+		len = strlen(args[i]) + 1;
+		total += (len + ARGBLOCK_ALIGN - 1) & ~(ARGBLOCK_ALIGN - 1);
+	}
+	if (total > ARG_MAX) {
+		return E2BIG;
+	}
+
+	result = argblock_init(ab, total);
+	if (result) {
+		return result;
+	}
+	slots = (vaddr_t *)ab->ab_buf;
+
+	ab->ab_argc = nargs;
+	ab->ab_len = (nargs + 1) * sizeof(vaddr_t);
+	for (i=0; i<nargs; i++) {
+		len = strlen(args[i]) + 1;
+		memcpy(ab->ab_buf + ab->ab_len, args[i], len);
+		slots[i] = ab->ab_len;
+		ab->ab_len += len;
+		argblock_pad(ab);
+	}
+	slots[nargs] = 0;
+	return 0;
+}
+
+int
+argblock_copyout(struct argblock *ab, vaddr_t *stackptr, userptr_t *uargv)
+{
+	vaddr_t *slots = (vaddr_t *)ab->ab_buf;
+	vaddr_t base;
+	int i, result;
+
+	/* Keep the stack doubleword-aligned for the MIPS ABI */
+	base = (*stackptr - ab->ab_len) & ~(vaddr_t)7;
+
+	/* Turn the offsets into user addresses */
+	for (i=0; i<ab->ab_argc; i++) {
+		slots[i] += base;
+	}
+
+	result = copyout(ab->ab_buf, (userptr_t)base, ab->ab_len);
+	if (result) {
+		return result;
+	}
+
+	*stackptr = base;
+	*uargv = (userptr_t)base;
+	return 0;
+}
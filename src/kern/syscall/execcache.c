@@ -0,0 +1,322 @@
+/*
+ * Exec image cache. See <execcache.h>.
+ *
+ * A small fixed table of images under one sleep lock, with LRU
+ * replacement. Images are reference counted so that one can be
+ * evicted or invalidated while some thread is still loading from it.
+ */
+
+#include <types.h>
+#include <kern/errno.h>
+#include <lib.h>
+#include <synch.h>
+#include <vnode.h>
+#include <execcache.h>
+
+static struct lock *execcache_lock;
+static struct execimage *execcache[EXECCACHE_SIZE];
+static size_t execcache_bytes;		/* sum of cached ei_bytes */
+static unsigned execcache_clock;	/* LRU timestamps */
+
+/* Statistics, also under execcache_lock */
+static unsigned execcache_hits, execcache_misses;
+static unsigned execcache_invalidations, execcache_evictions;
+static unsigned long execcache_hitusecs, execcache_missusecs;
+
+void
+execcache_bootstrap(void)
+{
+	execcache_lock = lock_create("execcache");
+	if (execcache_lock == NULL) {
+		panic("execcache: lock_create failed\n");
+	}
+}
+
+////////////////////////////////////////////////////////////
+// images
+
+struct execimage *
+execimage_create(struct vnode *v, const struct stat *st, vaddr_t entry)
+{
+	struct execimage *ei;
+
+	ei = kmalloc(sizeof(struct execimage));
+	if (ei == NULL) {
+		return NULL;
+	}
+	bzero(ei, sizeof(*ei));
+
+	VOP_INCREF(v);
+	ei->ei_vnode = v;
+	ei->ei_mtime = st->st_mtime;
+	ei->ei_mtimensec = st->st_mtimensec;
+	ei->ei_size = st->st_size;
+	ei->ei_entry = entry;
+	ei->ei_refcount = 1;
+	return ei;
+}
+
+int
+execimage_addseg(struct execimage *ei, vaddr_t vaddr, size_t memsize,
+		 size_t filesize, uint32_t flags, struct execseg **ret)
+{
+	struct execseg *es;
+
+	if (ei->ei_nsegs == EXECCACHE_MAXSEGS ||
+	    ei->ei_bytes + filesize > EXECCACHE_MAXBYTES) {
+		return EFBIG;
+	}
+
+	es = &ei->ei_segs[ei->ei_nsegs];
+	es->es_data = NULL;
+	if (filesize > 0) {
+		es->es_data = kmalloc(filesize);
+		if (es->es_data == NULL) {
+			return ENOMEM;
+		}
+	}
+	es->es_vaddr = vaddr;
+	es->es_memsize = memsize;
+	es->es_filesize = filesize;
+	es->es_flags = flags;
+
+	ei->ei_nsegs++;
+	ei->ei_bytes += filesize;
+	*ret = es;
+	return 0;
+}
+
+static
+void
+execimage_destroy(struct execimage *ei)
+{
+	unsigned i;
+
+	KASSERT(ei->ei_refcount == 0);
+
+	for (i=0; i<ei->ei_nsegs; i++) {
+		if (ei->ei_segs[i].es_data != NULL) {
+			kfree(ei->ei_segs[i].es_data);
+		}
+	}
+	VOP_DECREF(ei->ei_vnode);
+	kfree(ei);
+}
+
+////////////////////////////////////////////////////////////
+// the table
+
+/*
+ * Take the image out of slot IX and drop the cache's reference.
+ * Call with execcache_lock held.
+ */
+static
+void
+execcache_remove(unsigned ix)
+{
+	struct execimage *ei = execcache[ix];
+
+	KASSERT(ei != NULL);
+	execcache[ix] = NULL;
+	execcache_bytes -= ei->ei_bytes;
+
+	KASSERT(ei->ei_refcount > 0);
+	ei->ei_refcount--;
+	if (ei->ei_refcount == 0) {
+		execimage_destroy(ei);
+	}
+}
+
+/*
+ * Return the slot holding V's image, or -1.
+ */
+static
+int
+execcache_find(struct vnode *v)
+{
+	unsigned i;
+
+	for (i=0; i<EXECCACHE_SIZE; i++) {
+		if (execcache[i] != NULL && execcache[i]->ei_vnode == v) {
+			return i;
+		}
+	}
+	return -1;
+}
+
+void
+execcache_insert(struct execimage *ei)
+{
+	unsigned i, victim;
+	int ix;
+
+	if (ei->ei_bytes > EXECCACHE_MAXBYTES) {
+		execcache_release(ei);
+		return;
+	}
+
+	lock_acquire(execcache_lock);
+
+	/* Someone else may have loaded the same file meanwhile */
+	ix = execcache_find(ei->ei_vnode);
+	if (ix >= 0) {
+		execcache_remove(ix);
+	}
+
+	for (;;) {
+		ix = -1;
+		victim = 0;
+		for (i=0; i<EXECCACHE_SIZE; i++) {
+			if (execcache[i] == NULL) {
+				ix = i;
+			}
+			else if (execcache[victim] == NULL ||
+				 execcache[i]->ei_lastuse <
+				 execcache[victim]->ei_lastuse) {
+				victim = i;
+			}
+		}
+		if (ix >= 0 &&
+		    execcache_bytes + ei->ei_bytes <= EXECCACHE_MAXBYTES) {
+			break;
+		}
+		KASSERT(execcache[victim] != NULL);
+		execcache_remove(victim);
+		execcache_evictions++;
+	}
+
+	ei->ei_lastuse = ++execcache_clock;
+	execcache[ix] = ei;
+	execcache_bytes += ei->ei_bytes;
+
+	lock_release(execcache_lock);
+}
+
+struct execimage *
+execcache_lookup(struct vnode *v, const struct stat *st)
+{
+	struct execimage *ei;
+	int ix;
+
+	KASSERT(execcache_lock != NULL);
+
+	lock_acquire(execcache_lock);
+	ix = execcache_find(v);
+	if (ix < 0) {
+		lock_release(execcache_lock);
+		return NULL;
+	}
+
+	ei = execcache[ix];
+	if (ei->ei_mtime != st->st_mtime ||
+	    ei->ei_mtimensec != st->st_mtimensec ||
+	    ei->ei_size != st->st_size) {
+		/* The file changed under us */
+		execcache_remove(ix);
+		execcache_invalidations++;
+		lock_release(execcache_lock);
+		return NULL;
+	}
+
+	ei->ei_refcount++;
+	ei->ei_lastuse = ++execcache_clock;
+	lock_release(execcache_lock);
+	return ei;
+}
+
+void
+execcache_release(struct execimage *ei)
+{
+	bool last;
+
+	lock_acquire(execcache_lock);
+	KASSERT(ei->ei_refcount > 0);
+	ei->ei_refcount--;
+	last = (ei->ei_refcount == 0);
+	lock_release(execcache_lock);
+
+	if (last) {
+		execimage_destroy(ei);
+	}
+}
+
+void
+execcache_invalidate(struct vnode *v)
+{
+	int ix;
+
+	if (execcache_lock == NULL) {
+		return;
+	}
+
+	lock_acquire(execcache_lock);
+	ix = execcache_find(v);
+	if (ix >= 0) {
+		execcache_remove(ix);
+		execcache_invalidations++;
+	}
+	lock_release(execcache_lock);
+}
+
+void
+execcache_flush(void)
+{
+	unsigned i;
+
+	lock_acquire(execcache_lock);
+	for (i=0; i<EXECCACHE_SIZE; i++) {
+		if (execcache[i] != NULL) {
+			execcache_remove(i);
+		}
+	}
+	lock_release(execcache_lock);
+}
+
+////////////////////////////////////////////////////////////
+// statistics
+
+void
+execcache_account(bool hit, time_t secs, uint32_t nsecs)
+{
+	unsigned long us = (unsigned long)secs * 1000000 + nsecs / 1000;
+
+	lock_acquire(execcache_lock);
+	if (hit) {
+		execcache_hits++;
+		execcache_hitusecs += us;
+	}
+	else {
+		execcache_misses++;
+		execcache_missusecs += us;
+	}
+	lock_release(execcache_lock);
+}
+
+void
+execcache_printstats(void)
+{
+	unsigned i, n = 0, total, hitavg, missavg;
+
+	lock_acquire(execcache_lock);
+	for (i=0; i<EXECCACHE_SIZE; i++) {
+		if (execcache[i] != NULL) {
+			n++;
+		}
+	}
+	total = execcache_hits + execcache_misses;
+	hitavg = execcache_hits ? execcache_hitusecs / execcache_hits : 0;
+	missavg = execcache_misses ?
+		execcache_missusecs / execcache_misses : 0;
+
+	kprintf("Exec cache: %u/%u images, %lu/%u bytes\n", n,
+		EXECCACHE_SIZE, (unsigned long)execcache_bytes,
+		EXECCACHE_MAXBYTES);
+	kprintf("    %u hits, %u misses (%u%% hit rate), "
+		"%u invalidated, %u evicted\n",
+		execcache_hits, execcache_misses,
+		total ? execcache_hits * 100 / total : 0,
+		execcache_invalidations, execcache_evictions);
+	kprintf("    average load_elf: %u us on a hit, %u us on a miss\n",
+		hitavg, missavg);
+	lock_release(execcache_lock);
+}
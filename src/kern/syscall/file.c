@@ -0,0 +1,274 @@
+/*
+ * File descriptor table management.
+ *
+ * Each process (thread with an address space) owns a filetable,
+ * shared by its threads. Descriptors point at openfile structures,
+ * which are shared by fork and reference counted.
+ */
+
+#include <types.h>
+#include <kern/errno.h>
+#include <kern/fcntl.h>
+#include <kern/unistd.h>
+#include <lib.h>
+#include <synch.h>
+#include <thread.h>
+#include <current.h>
+#include <vfs.h>
+#include <vnode.h>
+#include <file.h>
+#include <execcache.h>
+
+/*
+ * Make an openfile for an already-open vnode. Consumes the vnode
+ * reference on success.
+ */
+static
+struct openfile *
+openfile_create(struct vnode *vn, int flags)
+{
+	struct openfile *of;
+
+	of = kmalloc(sizeof(struct openfile));
+	if (of == NULL) {
+		return NULL;
+	}
+	of->of_lock = lock_create("openfile");
+	if (of->of_lock == NULL) {
+		kfree(of);
+		return NULL;
+	}
+	of->of_vnode = vn;
+	of->of_offset = 0;
+	of->of_flags = flags;
+	of->of_refcount = 1;
+	return of;
+}
+
+static
+void
+openfile_incref(struct openfile *of)
+{
+	lock_acquire(of->of_lock);
+	of->of_refcount++;
+	lock_release(of->of_lock);
+}
+
+/*
+ * Drop a reference; the last one closes the vnode.
+ */
+void
+openfile_decref(struct openfile *of)
+{
+	bool last;
+
+	lock_acquire(of->of_lock);
+	KASSERT(of->of_refcount > 0);
+	of->of_refcount--;
+	last = (of->of_refcount == 0);
+	lock_release(of->of_lock);
+
+	if (last) {
+		vfs_close(of->of_vnode);
+		lock_destroy(of->of_lock);
+		kfree(of);
+	}
+}
+
+////////////////////////////////////////////////////////////
+
+struct filetable *
+filetable_create(void)
+{
+	struct filetable *ft;
+	int i;
+
+	ft = kmalloc(sizeof(struct filetable));
+	if (ft == NULL) {
+		return NULL;
+	}
+	ft->ft_lock = lock_create("filetable");
+	if (ft->ft_lock == NULL) {
+		kfree(ft);
+		return NULL;
+	}
+	ft->ft_refcount = 1;
+	for (i=0; i<OPEN_MAX; i++) {
+		ft->ft_files[i] = NULL;
+	}
+	return ft;
+}
+
+/*
+ * Copy a file table for fork. The open files are shared, not
+ * duplicated, so the child sees the same seek positions.
+ */
+int
+filetable_copy(struct filetable *src, struct filetable **ret)
+{
+	struct filetable *ft;
+	int i;
+
+	ft = filetable_create();
+	if (ft == NULL) {
+		return ENOMEM;
+	}
+
+	lock_acquire(src->ft_lock);
+	for (i=0; i<OPEN_MAX; i++) {
+		if (src->ft_files[i] != NULL) {
+			openfile_incref(src->ft_files[i]);
+			ft->ft_files[i] = src->ft_files[i];
+		}
+	}
+	lock_release(src->ft_lock);
+
+	*ret = ft;
+	return 0;
+}
+
+static
+void
+filetable_destroy(struct filetable *ft)
+{
+	int i;
+
+	KASSERT(ft->ft_refcount == 0);
+	for (i=0; i<OPEN_MAX; i++) {
+		if (ft->ft_files[i] != NULL) {
+			openfile_decref(ft->ft_files[i]);
+			ft->ft_files[i] = NULL;
+		}
+	}
+	lock_destroy(ft->ft_lock);
+	kfree(ft);
+}
+
+void
+filetable_incref(struct filetable *ft)
+{
+	lock_acquire(ft->ft_lock);
+	KASSERT(ft->ft_refcount > 0);
+	ft->ft_refcount++;
+	lock_release(ft->ft_lock);
+}
+
+void
+filetable_decref(struct filetable *ft)
+{
+	bool last;
+
+	lock_acquire(ft->ft_lock);
+	KASSERT(ft->ft_refcount > 0);
+	ft->ft_refcount--;
+	last = (ft->ft_refcount == 0);
+	lock_release(ft->ft_lock);
+
+	if (last) {
+		filetable_destroy(ft);
+	}
+}
+
+int
+filetable_get(struct filetable *ft, int fd, struct openfile **ret)
+{
+	struct openfile *of;
+
+	if (ft == NULL || fd < 0 || fd >= OPEN_MAX) {
+		return EBADF;
+	}
+
+	lock_acquire(ft->ft_lock);
+	of = ft->ft_files[fd];
+	if (of == NULL) {
+		lock_release(ft->ft_lock);
+		return EBADF;
+	}
+	openfile_incref(of);
+	lock_release(ft->ft_lock);
+
+	*ret = of;
+	return 0;
+}
+
+////////////////////////////////////////////////////////////
+
+/*
+ * Open a file into the lowest free descriptor above 2. Descriptors
+ * 0-2 are never handed out: read and write fall back to the console
+ * for them while they're empty, so filling one would quietly take
+ * over stdin, stdout or stderr.
+ */
+int
+file_open(char *path, int flags, mode_t mode, int *retfd)
+{
+	struct filetable *ft;
+	struct openfile *of;
+	struct vnode *vn;
+	int fd, result;
+
+	ft = curthread->t_filetable;
+	if (ft == NULL) {
+		return EBADF;
+	}
+
+	result = vfs_open(path, flags, mode, &vn);
+	if (result) {
+		return result;
+	}
+	/*
+	 * Don't launch a stale copy of a program that's about to be
+	 * rewritten. This covers O_TRUNC, which vfs_open has already
+	 * done; file_rw invalidates again on each write, since an image
+	 * can be cached while the file is open.
+	 */
+	if ((flags & O_ACCMODE) != O_RDONLY) {
+		execcache_invalidate(vn);
+	}
+
+	of = openfile_create(vn, flags);
+	if (of == NULL) {
+		vfs_close(vn);
+		return ENOMEM;
+	}
+
+	lock_acquire(ft->ft_lock);
+	for (fd = STDERR_FILENO+1; fd < OPEN_MAX; fd++) {
+		if (ft->ft_files[fd] == NULL) {
+			break;
+		}
+	}
+	if (fd == OPEN_MAX) {
+		lock_release(ft->ft_lock);
+		openfile_decref(of);
+		return EMFILE;
+	}
+	ft->ft_files[fd] = of;
+	lock_release(ft->ft_lock);
+
+	*retfd = fd;
+	return 0;
+}
+
+int
+file_close(int fd)
+{
+	struct filetable *ft;
+	struct openfile *of;
+
+	ft = curthread->t_filetable;
+	if (ft == NULL || fd < 0 || fd >= OPEN_MAX) {
+		return EBADF;
+	}
+
+	lock_acquire(ft->ft_lock);
+	of = ft->ft_files[fd];
+	ft->ft_files[fd] = NULL;
+	lock_release(ft->ft_lock);
+
+	if (of == NULL) {
+		return EBADF;
+	}
+	openfile_decref(of);
+	return 0;
+}
@@ -1,19 +1,27 @@
 /*
  * File-related system call implementations.
  * New for ASST1
- * Only crippled version of read/write for console I/O.
+ * read/write go through the per-process file table (file.c), with a
+ * console fallback for descriptors 0-2.
  */
 
 #include <types.h>
 #include <kern/errno.h>
 #include <kern/unistd.h>
 #include <lib.h>
+#include <synch.h>
 #include <uio.h>
 #include <thread.h>
 #include <current.h>
 #include <vfs.h>
 #include <vnode.h>
 #include <kern/fcntl.h>
+#include <kern/stat.h>
+#include <kern/seek.h>
+#include <limits.h>
+#include <copyinout.h>
+#include <file.h>
+#include <execcache.h>
 #include <syscall.h>
 
 /* dumb_consoleIO_bootstrap
@@ -68,48 +76,110 @@ mk_useruio(struct iovec *iov, struct uio *u,
 }
 
 /*
- * sys_read
- * calls VOP_READ.
+ * file_rw
+ * Common code for read and write. Descriptors in the current
+ * thread's file table go to their vnode at the file's offset;
+ * stdin/stdout/stderr that were never opened fall back to the
+ * console, as in the original ASST1 version.
  */
+static
 int
-sys_read(int fd, userptr_t buf, size_t size, int *retval)
+file_rw(int fd, userptr_t buf, size_t size, enum uio_rw rw, int *retval)
 {
 	struct uio user_uio;
 	struct iovec user_iov;
+	struct openfile *of = NULL;
+	struct vnode *vn;
+	struct stat st;
 	int result;
-	int offset = 0;
+	off_t offset = 0;
 
-	/* Make sure we were able to init the cons_vnode */
-	if (cons_vnode == NULL) {
-	  return ENODEV;
+	result = filetable_get(curthread->t_filetable, fd, &of);
+	if (result) {
+		if (fd < STDIN_FILENO || fd > STDERR_FILENO) {
+			return result;
+		}
+		/* Make sure we were able to init the cons_vnode */
+		if (cons_vnode == NULL) {
+			return ENODEV;
+		}
+		of = NULL;
+		vn = cons_vnode;
 	}
+	else {
+		int accmode = of->of_flags & O_ACCMODE;
 
-	/* better be a valid file descriptor */
-	/* Right now, only stdin (0), stdout (1) and stderr (2)
-	 * are supported, and they can't be redirected to a file
-	 */
-	if (fd < 0 || fd > 2) {
-	  return EBADF;
+		if ((rw == UIO_READ && accmode == O_WRONLY) ||
+		    (rw == UIO_WRITE && accmode == O_RDONLY)) {
+			openfile_decref(of);
+			return EBADF;
+		}
+		vn = of->of_vnode;
+
+		/* Hold the offset for the duration of the I/O */
+		lock_acquire(of->of_lock);
+		offset = of->of_offset;
+		if (rw == UIO_WRITE && (of->of_flags & O_APPEND)) {
+			result = VOP_STAT(vn, &st);
+			if (result) {
+				lock_release(of->of_lock);
+				openfile_decref(of);
+				return result;
+			}
+			offset = st.st_size;
+		}
 	}
 
 	/* set up a uio with the buffer, its size, and the current offset */
-	mk_useruio(&user_iov, &user_uio, buf, size, offset, UIO_READ);
+	mk_useruio(&user_iov, &user_uio, buf, size, offset, rw);
 
-	/* does the read */
-	result = VOP_READ(cons_vnode, &user_uio);
+	/* does the I/O */
+	if (rw == UIO_READ) {
+		result = VOP_READ(vn, &user_uio);
+	}
+	else {
+		result = VOP_WRITE(vn, &user_uio);
+		if (of != NULL) {
+			/*
+			 * Drop any cached exec image of this file, even
+			 * if the write failed partway. emufs has no
+			 * mtime, so execcache_lookup's stamp check alone
+			 * can't see a write that leaves the size alone.
+			 */
+			execcache_invalidate(vn);
+		}
+	}
+
+	if (of != NULL) {
+		if (!result) {
+			of->of_offset = user_uio.uio_offset;
+		}
+		lock_release(of->of_lock);
+		openfile_decref(of);
+	}
 	if (result) {
 		return result;
 	}
 
 	/*
-	 * The amount read is the size of the buffer originally, minus
-	 * how much is left in it.
+	 * The amount transferred is the size of the buffer originally,
+	 * minus how much is left in it.
 	 */
 	*retval = size - user_uio.uio_resid;
 
 	return 0;
 }
 
+/*
+ * sys_read
+ * calls VOP_READ.
+ */
+int
+sys_read(int fd, userptr_t buf, size_t size, int *retval)
+{
+	return file_rw(fd, buf, size, UIO_READ, retval);
+}
+
 /*
  * sys_write
  * calls VOP_WRITE.
@@ -117,38 +187,202 @@ sys_read(int fd, userptr_t buf, size_t size, int *retval)
 int
 sys_write(int fd, userptr_t buf, size_t size, int *retval)
 {
-	struct uio user_uio;
-	struct iovec user_iov;
+	return file_rw(fd, buf, size, UIO_WRITE, retval);
+}
+
+/*
+ * sys_open
+ * copies in the path and opens it into the file table.
+ */
+int
+sys_open(userptr_t upath, int flags, mode_t mode, int *retval)
+{
+	char *path;
 	int result;
-	int offset = 0;
 
-	/* Make sure we were able to init the cons_vnode */
-	if (cons_vnode == NULL) {
-	  return ENODEV;
+	path = kmalloc(PATH_MAX);
+	if (path == NULL) {
+		return ENOMEM;
 	}
 
-	/* Right now, only stdin (0), stdout (1) and stderr (2)
-	 * are supported, and they can't be redirected to a file
-	 */
-	if (fd < 0 || fd > 2) {
-	  return EBADF;
+	result = copyinstr(upath, path, PATH_MAX, NULL);
+	if (result) {
+		kfree(path);
+		return result;
 	}
 
-	/* set up a uio with the buffer, its size, and the current offset */
-	mk_useruio(&user_iov, &user_uio, buf, size, offset, UIO_WRITE);
+	result = file_open(path, flags, mode, retval);
+	kfree(path);
+	return result;
+}
+
+/*
+ * sys_close
+ */
+int
+sys_close(int fd)
+{
+	return file_close(fd);
+}
+
+/*
+ * sys_lseek
+ * moves the file's offset and returns the new one.
+ */
+int
+sys_lseek(int fd, off_t pos, int whence, off_t *retval)
+{
+	struct openfile *of;
+	struct stat st;
+	off_t newpos;
+	int result;
 
-	/* does the write */
-	result = VOP_WRITE(cons_vnode, &user_uio);
+	result = filetable_get(curthread->t_filetable, fd, &of);
 	if (result) {
 		return result;
 	}
 
-	/*
-	 * the amount written is the size of the buffer originally,
-	 * minus how much is left in it.
-	 */
-	*retval = size - user_uio.uio_resid;
+	lock_acquire(of->of_lock);
+	switch (whence) {
+	    case SEEK_SET:
+		newpos = pos;
+		break;
+	    case SEEK_CUR:
+		newpos = of->of_offset + pos;
+		break;
+	    case SEEK_END:
+		result = VOP_STAT(of->of_vnode, &st);
+		newpos = st.st_size + pos;
+		break;
+	    default:
+		result = EINVAL;
+		break;
+	}
+	if (!result && newpos < 0) {
+		result = EINVAL;
+	}
+	if (!result) {
+		/* Fails for the console and other unseekable objects */
+		result = VOP_TRYSEEK(of->of_vnode, newpos);
+	}
+	if (!result) {
+		of->of_offset = newpos;
+		*retval = newpos;
+	}
+	lock_release(of->of_lock);
+	openfile_decref(of);
+	return result;
+}
 
-	return 0;
+/*
+ * sys_fsync
+ * flushes the file's data to its device.
+ */
+int
+sys_fsync(int fd)
+{
+	struct openfile *of;
+	int result;
+
+	result = filetable_get(curthread->t_filetable, fd, &of);
+	if (result) {
+		return result;
+	}
+	result = VOP_FSYNC(of->of_vnode);
+	openfile_decref(of);
+	return result;
+}
+
+/*
+ * sys_fstat
+ */
+int
+sys_fstat(int fd, userptr_t statbuf)
+{
+	struct openfile *of;
+	struct stat st;
+	int result;
+
+	result = filetable_get(curthread->t_filetable, fd, &of);
+	if (result) {
+		return result;
+	}
+	result = VOP_STAT(of->of_vnode, &st);
+	openfile_decref(of);
+	if (result) {
+		return result;
+	}
+	return copyout(&st, statbuf, sizeof(st));
+}
+
+/*
+ * sys_stat
+ * like fstat, but looks the file up by name.
+ */
+int
+sys_stat(userptr_t upath, userptr_t statbuf)
+{
+	struct vnode *vn;
+	struct stat st;
+	char *path;
+	int result;
+
+	path = kmalloc(PATH_MAX);
+	if (path == NULL) {
+		return ENOMEM;
+	}
+	result = copyinstr(upath, path, PATH_MAX, NULL);
+	if (result == 0) {
+		result = vfs_lookup(path, &vn);
+	}
+	kfree(path);
+	if (result) {
+		return result;
+	}
+
+	result = VOP_STAT(vn, &st);
+	VOP_DECREF(vn);
+	if (result) {
+		return result;
+	}
+	return copyout(&st, statbuf, sizeof(st));
 }
 
+/*
+ * sys_remove
+ * unlinks a file, first dropping any cached exec image of it so that
+ * the cache does not keep the file alive.
+ */
+int
+sys_remove(userptr_t upath)
+{
+	struct vnode *vn;
+	char *path;
+	int result;
+
+	path = kmalloc(PATH_MAX);
+	if (path == NULL) {
+		return ENOMEM;
+	}
+	result = copyinstr(upath, path, PATH_MAX, NULL);
+	if (result) {
+		kfree(path);
+		return result;
+	}
+
+	/* vfs_lookup and vfs_remove may both modify the path */
+	result = vfs_lookup(path, &vn);
+	if (result) {
+		kfree(path);
+		return result;
+	}
+	execcache_invalidate(vn);
+	VOP_DECREF(vn);
+
+	result = copyinstr(upath, path, PATH_MAX, NULL);
+	if (result == 0) {
+		result = vfs_remove(path);
+	}
+	kfree(path);
+	return result;
+}
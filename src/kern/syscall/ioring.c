@@ -0,0 +1,392 @@
+/*
+ * Shared submission/completion rings (ioring).
+ *
+ * A process maps one ring with ioring_setup and then queues reads,
+ * writes, opens and closes in it. One ioring_enter call consumes a
+ * whole batch, so a batch of N operations costs one trap instead of
+ * N. With IORING_SETUP_SQPOLL a kernel thread sharing the process's
+ * address space polls the SQ, and in the steady state no traps are
+ * needed at all.
+ *
+ * The ring memory comes from alloc_kpages and is mapped into the
+ * process with as_map_shared, so the kernel reaches it through KSEG0
+ * without copyin/copyout. Buffers and pathnames named by SQEs are
+ * still user pointers and go through the ordinary syscall code.
+ */
+
+#include <types.h>
+#include <kern/errno.h>
+#include <limits.h>
+#include <lib.h>
+#include <synch.h>
+#include <thread.h>
+#include <current.h>
+#include <addrspace.h>
+#include <vm.h>
+#include <copyinout.h>
+#include <syscall.h>
+#include <membar.h>
+#include <ioring.h>
+
+/*
+ * Allocate a ring with the given (power of two) sizes.
+ */
+static
+struct ioring *
+ioring_create(unsigned sqentries, unsigned cqentries, bool sqpoll)
+{
+	struct ioring *ring;
+	size_t size, sqoff, cqoff;
+
+	sqoff = sizeof(struct ioring_hdr);
+	cqoff = sqoff + sqentries * sizeof(struct ioring_sqe);
+	size = cqoff + cqentries * sizeof(struct ioring_cqe);
+
+	ring = kmalloc(sizeof(struct ioring));
+	if (ring == NULL) {
+		return NULL;
+	}
+
+	ring->ir_npages = (size + PAGE_SIZE - 1) / PAGE_SIZE;
+	ring->ir_kvaddr = alloc_kpages(ring->ir_npages);
+	if (ring->ir_kvaddr == 0) {
+		kfree(ring);
+		return NULL;
+	}
+	bzero((void *)ring->ir_kvaddr, ring->ir_npages * PAGE_SIZE);
+
+	ring->ir_hdr = (struct ioring_hdr *)ring->ir_kvaddr;
+	ring->ir_sqes = (struct ioring_sqe *)(ring->ir_kvaddr + sqoff);
+	ring->ir_cqes = (struct ioring_cqe *)(ring->ir_kvaddr + cqoff);
+	ring->ir_hdr->ir_sqentries = sqentries;
+	ring->ir_hdr->ir_cqentries = cqentries;
+	ring->ir_hdr->ir_sqoff = sqoff;
+	ring->ir_hdr->ir_cqoff = cqoff;
+
+	ring->ir_sqmask = sqentries - 1;
+	ring->ir_cqmask = cqentries - 1;
+	ring->ir_sqhead = 0;
+	ring->ir_cqtail = 0;
+
+	ring->ir_sqpoll = sqpoll;
+	ring->ir_stopping = false;
+	ring->ir_nenter = 0;
+	ring->ir_nsubmitted = 0;
+
+	ring->ir_lock = lock_create("ioring");
+	ring->ir_cqcv = cv_create("ioring cq");
+	ring->ir_sqwake = sem_create("ioring sqwake", 0);
+	ring->ir_sqdone = sem_create("ioring sqdone", 0);
+	if (ring->ir_lock == NULL || ring->ir_cqcv == NULL ||
+	    ring->ir_sqwake == NULL || ring->ir_sqdone == NULL) {
+		if (ring->ir_lock) lock_destroy(ring->ir_lock);
+		if (ring->ir_cqcv) cv_destroy(ring->ir_cqcv);
+		if (ring->ir_sqwake) sem_destroy(ring->ir_sqwake);
+		if (ring->ir_sqdone) sem_destroy(ring->ir_sqdone);
+		free_kpages(ring->ir_kvaddr);
+		kfree(ring);
+		return NULL;
+	}
+
+	return ring;
+}
+
+static
+void
+ioring_free(struct ioring *ring)
+{
+	sem_destroy(ring->ir_sqdone);
+	sem_destroy(ring->ir_sqwake);
+	cv_destroy(ring->ir_cqcv);
+	lock_destroy(ring->ir_lock);
+	free_kpages(ring->ir_kvaddr);
+	kfree(ring);
+}
+
+/*
+ * Perform one operation. Returns the CQE result: the syscall's
+ * return value, or a negative error code.
+ */
+static
+int32_t
+ioring_do(const struct ioring_sqe *sqe)
+{
+	int result, ret = 0;
+
+	switch (sqe->sqe_op) {
+	    case IORING_OP_NOP:
+		result = 0;
+		break;
+	    case IORING_OP_READ:
+		result = sys_read(sqe->sqe_fd, (userptr_t)sqe->sqe_addr,
+				  sqe->sqe_len, &ret);
+		break;
+	    case IORING_OP_WRITE:
+		result = sys_write(sqe->sqe_fd, (userptr_t)sqe->sqe_addr,
+				   sqe->sqe_len, &ret);
+		break;
+	    case IORING_OP_OPEN:
+		result = sys_open((userptr_t)sqe->sqe_addr, sqe->sqe_flags,
+				  0, &ret);
+		break;
+	    case IORING_OP_CLOSE:
+		result = sys_close(sqe->sqe_fd);
+		break;
+	    default:
+		result = EINVAL;
+		break;
+	}
+
+	return result ? -result : ret;
+}
+
+/*
+ * Consume up to MAX entries from the SQ, posting a CQE for each.
+ * Stops early if the CQ fills up. Returns the number consumed.
+ */
+static
+unsigned
+ioring_submit(struct ioring *ring, unsigned max)
+{
+	struct ioring_hdr *hdr = ring->ir_hdr;
+	struct ioring_sqe sqe;
+	struct ioring_cqe *cqe;
+	unsigned tail, n;
+
+	KASSERT(lock_do_i_hold(ring->ir_lock));
+
+	tail = hdr->sq_tail;
+	if (tail - ring->ir_sqhead > ring->ir_sqmask + 1) {
+		/* Garbage from userlevel; take only what can be there */
+		tail = ring->ir_sqhead + ring->ir_sqmask + 1;
+	}
+
+	for (n = 0; n < max && ring->ir_sqhead != tail; n++) {
+		/* Leave the SQE queued if there is nowhere to report it */
+		if (ring->ir_cqtail - hdr->cq_head > ring->ir_cqmask) {
+			break;
+		}
+
+		/* Copy the SQE before looking at it; userlevel can change it */
+		membar_load_load();
+		sqe = ring->ir_sqes[ring->ir_sqhead & ring->ir_sqmask];
+		/* and finish copying before userlevel can reuse the slot */
+		membar_load_store();
+		ring->ir_sqhead++;
+		hdr->sq_head = ring->ir_sqhead;
+
+		cqe = &ring->ir_cqes[ring->ir_cqtail & ring->ir_cqmask];
+		cqe->cqe_userdata = sqe.sqe_userdata;
+		cqe->cqe_res = ioring_do(&sqe);
+		membar_store_store();
+		ring->ir_cqtail++;
+		hdr->cq_tail = ring->ir_cqtail;
+	}
+
+	ring->ir_nsubmitted += n;
+	return n;
+}
+
+/*
+ * SQPOLL thread. Runs in the owner's address space and file table
+ * (see thread_fork_shared) and consumes the SQ until told to stop.
+ * After IORING_SQPOLL_IDLE empty polls it sets IORING_SQ_NEED_WAKEUP
+ * and sleeps until ioring_enter(IORING_ENTER_SQ_WAKEUP).
+ */
+static
+void
+ioring_sqpoll_thread(void *data1, unsigned long data2)
+{
+	struct ioring *ring = data1;
+	struct ioring_hdr *hdr = ring->ir_hdr;
+	unsigned idle, n;
+
+	(void)data2;
+
+	idle = 0;
+	while (!ring->ir_stopping) {
+		lock_acquire(ring->ir_lock);
+		n = ioring_submit(ring, ring->ir_sqmask + 1);
+		if (n > 0) {
+			cv_broadcast(ring->ir_cqcv, ring->ir_lock);
+		}
+		lock_release(ring->ir_lock);
+
+		if (n > 0) {
+			idle = 0;
+			continue;
+		}
+		if (++idle < IORING_SQPOLL_IDLE) {
+			thread_yield();
+			continue;
+		}
+
+		/*
+		 * Advertise that we are going to sleep, then look once
+		 * more so a submission that raced with us is not lost.
+		 */
+		hdr->sq_flags |= IORING_SQ_NEED_WAKEUP;
+		/* the flag must be out before we look at sq_tail */
+		membar_any_any();
+		if (hdr->sq_tail == ring->ir_sqhead && !ring->ir_stopping) {
+			P(ring->ir_sqwake);
+		}
+		hdr->sq_flags &= ~IORING_SQ_NEED_WAKEUP;
+		idle = 0;
+	}
+
+	V(ring->ir_sqdone);
+}
+
+/*
+ * Tear down the current thread's ring. Called from thread_exit while
+ * the address space and file table are still intact.
+ */
+void
+ioring_destroy(struct ioring *ring)
+{
+	if (ring->ir_sqpoll) {
+		ring->ir_stopping = true;
+		V(ring->ir_sqwake);
+		P(ring->ir_sqdone);
+	}
+
+	if (curthread->t_addrspace != NULL) {
+		as_unmap_shared(curthread->t_addrspace, IORING_VADDR);
+	}
+	ioring_free(ring);
+}
+
+////////////////////////////////////////////////////////////
+
+/*
+ * sys_ioring_setup
+ * Create and map a ring with at least ENTRIES SQ slots; hands back
+ * its user address in *RINGP.
+ */
+int
+sys_ioring_setup(unsigned entries, int flags, userptr_t ringp)
+{
+	struct ioring *ring;
+	unsigned sqentries;
+	vaddr_t uvaddr;
+	int result;
+
+	if (curthread->t_addrspace == NULL) {
+		return EINVAL;
+	}
+	if (curthread->t_ioring != NULL) {
+		return EBUSY;
+	}
+	if (entries == 0 || entries > IORING_MAX_ENTRIES) {
+		return EINVAL;
+	}
+	if (flags & ~IORING_SETUP_SQPOLL) {
+		return EINVAL;
+	}
+
+	for (sqentries = 1; sqentries < entries; sqentries <<= 1) {
+		/* round up to a power of 2 */
+	}
+
+	ring = ioring_create(sqentries, sqentries * 2,
+			     (flags & IORING_SETUP_SQPOLL) != 0);
+	if (ring == NULL) {
+		return ENOMEM;
+	}
+
+	uvaddr = IORING_VADDR;
+	result = as_map_shared(curthread->t_addrspace, uvaddr,
+			       KVADDR_TO_PADDR(ring->ir_kvaddr),
+			       ring->ir_npages, 1);
+	if (result) {
+		ioring_free(ring);
+		return result;
+	}
+
+	result = copyout(&uvaddr, ringp, sizeof(uvaddr));
+	if (result) {
+		as_unmap_shared(curthread->t_addrspace, uvaddr);
+		ioring_free(ring);
+		return result;
+	}
+
+	if (ring->ir_sqpoll) {
+		result = thread_fork_shared("ioring sqpoll",
+					    ioring_sqpoll_thread, ring, 0,
+					    NULL);
+		if (result) {
+			as_unmap_shared(curthread->t_addrspace, uvaddr);
+			ioring_free(ring);
+			return result;
+		}
+	}
+
+	curthread->t_ioring = ring;
+	return 0;
+}
+
+/*
+ * sys_ioring_enter
+ * Submit up to TO_SUBMIT queued SQEs. Without SQPOLL they are
+ * executed right here; with it, the poller does the work and this
+ * call only wakes it and/or waits. IORING_ENTER_GETEVENTS waits
+ * until at least MIN_COMPLETE CQEs are available, or until no SQEs
+ * are left outstanding to produce more. Returns the number of SQEs
+ * consumed by this call.
+ */
+int
+sys_ioring_enter(unsigned to_submit, unsigned min_complete, int flags,
+		 int *retval)
+{
+	struct ioring *ring;
+	struct ioring_hdr *hdr;
+	unsigned n = 0;
+
+	ring = curthread->t_ioring;
+	if (ring == NULL) {
+		return EBADF;
+	}
+	if (flags & ~(IORING_ENTER_GETEVENTS | IORING_ENTER_SQ_WAKEUP)) {
+		return EINVAL;
+	}
+	hdr = ring->ir_hdr;
+	if (min_complete > ring->ir_cqmask + 1) {
+		min_complete = ring->ir_cqmask + 1;
+	}
+
+	lock_acquire(ring->ir_lock);
+	ring->ir_nenter++;
+
+	if (!ring->ir_sqpoll) {
+		n = ioring_submit(ring, to_submit);
+	}
+	else if (hdr->sq_flags & IORING_SQ_NEED_WAKEUP) {
+		/* Waiting for events implies the poller must run */
+		if (flags & (IORING_ENTER_SQ_WAKEUP|IORING_ENTER_GETEVENTS)) {
+			V(ring->ir_sqwake);
+		}
+	}
+
+	if (flags & IORING_ENTER_GETEVENTS) {
+		while (ring->ir_cqtail - hdr->cq_head < min_complete) {
+			if (!ring->ir_sqpoll) {
+				/* Everything completes inline; no more coming */
+				break;
+			}
+			if (hdr->sq_tail == ring->ir_sqhead) {
+				/*
+				 * Nothing outstanding for the poller, so
+				 * no more CQEs are coming either.
+				 */
+				break;
+			}
+			cv_wait(ring->ir_cqcv, ring->ir_lock);
+		}
+	}
+
+	lock_release(ring->ir_lock);
+
+	*retval = n;
+	return 0;
+}
@@ -48,17 +48,25 @@
  * To support dynamically linked executables with shared libraries
  * you'd need to change this to load the "ELF interpreter" (dynamic
  * linker). And you'd have to write a dynamic linker...
+ *
+ * Programs that fit are also kept in the exec image cache (see
+ * <execcache.h>); launching one again builds the address space from
+ * the cached segments instead of reading and parsing the file.
  */
 
 #include <types.h>
 #include <kern/errno.h>
 #include <lib.h>
 #include <uio.h>
+#include <copyinout.h>
 #include <thread.h>
 #include <current.h>
 #include <addrspace.h>
 #include <vnode.h>
 #include <elf.h>
+#include <clock.h>
+#include <kern/stat.h>
+#include <execcache.h>
 
 /*
  * Load a segment at virtual address VADDR. The segment in memory
@@ -145,12 +153,110 @@ load_segment(struct vnode *v, off_t offset, vaddr_t vaddr,
 }
 
 /*
- * Load an ELF executable user program into the current address space.
- *
- * Returns the entry point (initial PC) for the program in ENTRYPOINT.
+ * Like load_segment, but read the file contents into a kernel copy
+ * for the exec image cache on the way. If the image can't take
+ * another segment, drop it and load the segment the usual way.
  */
+static
 int
-load_elf(struct vnode *v, vaddr_t *entrypoint)
+load_segment_cached(struct vnode *v, struct execimage **eip,
+		    Elf_Phdr *ph)
+{
+	struct execseg *es;
+	struct iovec iov;
+	struct uio ku;
+	size_t filesize;
+	int result;
+
+	filesize = ph->p_filesz;
+	if (filesize > ph->p_memsz) {
+		kprintf("ELF: warning: segment filesize > segment memsize\n");
+		filesize = ph->p_memsz;
+	}
+
+	result = execimage_addseg(*eip, ph->p_vaddr, ph->p_memsz, filesize,
+				  ph->p_flags, &es);
+	if (result) {
+		execcache_release(*eip);
+		*eip = NULL;
+		return load_segment(v, ph->p_offset, ph->p_vaddr,
+				    ph->p_memsz, ph->p_filesz,
+				    ph->p_flags & PF_X);
+	}
+
+	uio_kinit(&iov, &ku, es->es_data, filesize, ph->p_offset, UIO_READ);
+	result = VOP_READ(v, &ku);
+	if (result) {
+		return result;
+	}
+	if (ku.uio_resid != 0) {
+		/* short read; problem with executable? */
+		kprintf("ELF: short read on segment - file truncated?\n");
+		return ENOEXEC;
+	}
+
+	/* copyout checks that the segment is in user space */
+	return copyout(es->es_data, (userptr_t)es->es_vaddr, filesize);
+}
+
+/*
+ * Set up the current address space from a cached image.
+ */
+static
+int
+load_image(struct execimage *ei, vaddr_t *entrypoint)
+{
+	struct execseg *es;
+	unsigned i;
+	int result;
+
+	for (i=0; i<ei->ei_nsegs; i++) {
+		es = &ei->ei_segs[i];
+		result = as_define_region(curthread->t_addrspace,
+					  es->es_vaddr, es->es_memsize,
+					  es->es_flags & PF_R,
+					  es->es_flags & PF_W,
+					  es->es_flags & PF_X);
+		if (result) {
+			return result;
+		}
+	}
+
+	result = as_prepare_load(curthread->t_addrspace);
+	if (result) {
+		return result;
+	}
+
+	for (i=0; i<ei->ei_nsegs; i++) {
+		es = &ei->ei_segs[i];
+		DEBUG(DB_EXEC, "ELF: Copying %lu cached bytes to 0x%lx\n",
+		      (unsigned long) es->es_filesize,
+		      (unsigned long) es->es_vaddr);
+		result = copyout(es->es_data, (userptr_t)es->es_vaddr,
+				 es->es_filesize);
+		if (result) {
+			return result;
+		}
+	}
+
+	result = as_complete_load(curthread->t_addrspace);
+	if (result) {
+		return result;
+	}
+
+	*entrypoint = ei->ei_entry;
+	return 0;
+}
+
+/*
+ * Load an ELF executable user program into the current address space,
+ * reading it from the file. If *EIP is not NULL, the segments are also
+ * saved into it for the exec image cache; on return *EIP is NULL if
+ * that was abandoned.
+ */
+static
+int
+load_elf_file(struct vnode *v, struct execimage **eip, vaddr_t *entrypoint)
 {
 	Elf_Ehdr eh;   /* Executable header */
 	Elf_Phdr ph;   /* "Program header" = segment header */
@@ -284,9 +390,14 @@ load_elf(struct vnode *v, vaddr_t *entrypoint)
 			return ENOEXEC;
 		}
 
-		result = load_segment(v, ph.p_offset, ph.p_vaddr, 
-				      ph.p_memsz, ph.p_filesz,
-				      ph.p_flags & PF_X);
+		if (*eip != NULL) {
+			result = load_segment_cached(v, eip, &ph);
+		}
+		else {
+			result = load_segment(v, ph.p_offset, ph.p_vaddr, 
+					      ph.p_memsz, ph.p_filesz,
+					      ph.p_flags & PF_X);
+		}
 		if (result) {
 			return result;
 		}
@@ -301,3 +412,57 @@ load_elf(struct vnode *v, vaddr_t *entrypoint)
 
 	return 0;
 }
+
+/*
+ * Load an ELF executable user program into the current address space.
+ *
+ * Returns the entry point (initial PC) for the program in ENTRYPOINT.
+ */
+int
+load_elf(struct vnode *v, vaddr_t *entrypoint)
+{
+	struct execimage *ei;
+	struct stat st;
+	time_t before_secs, after_secs;
+	uint32_t before_nsecs, after_nsecs;
+	bool hit;
+	int result;
+
+	gettime(&before_secs, &before_nsecs);
+
+	result = VOP_STAT(v, &st);
+	if (result) {
+		return result;
+	}
+
+	ei = execcache_lookup(v, &st);
+	hit = (ei != NULL);
+	if (hit) {
+		result = load_image(ei, entrypoint);
+		execcache_release(ei);
+	}
+	else {
+		/* Not cached; cache it if we can get the memory */
+		ei = execimage_create(v, &st, 0);
+		result = load_elf_file(v, &ei, entrypoint);
+		if (ei != NULL) {
+			if (result == 0) {
+				ei->ei_entry = *entrypoint;
+				execcache_insert(ei);
+			}
+			else {
+				execcache_release(ei);
+			}
+		}
+	}
+	if (result) {
+		return result;
+	}
+
+	gettime(&after_secs, &after_nsecs);
+	getinterval(before_secs, before_nsecs, after_secs, after_nsecs,
+		    &after_secs, &after_nsecs);
+	execcache_account(hit, after_secs, after_nsecs);
+
+	return 0;
+}
@@ -5,11 +5,22 @@
 
 #include <types.h>
 #include <kern/errno.h>
+#include <kern/fcntl.h>
+#include <limits.h>
 #include <lib.h>
+#include <copyinout.h>
+#include <vfs.h>
 #include <thread.h>
 #include <current.h>
 #include <pid.h>
 #include <machine/trapframe.h>
+#include <addrspace.h>
+#include <vm.h>
+#include <vdso.h>
+#include <ioring.h>
+#include <argblock.h>
+#include <region.h>
+#include <threadinfo.h>
 #include <syscall.h>
 
 /*
@@ -23,8 +34,11 @@ int
 sys_fork(struct trapframe *tf, pid_t *retval)
 {
 	struct trapframe *ntf; /* new trapframe, copy of tf */
+	uint64_t start;
 	int result;
 
+	start = REGION_BEGIN(RG_FORK);
+
 	/*
 	 * Copy the trapframe to the heap, because we might return to
 	 * userlevel and make another syscall (changing the trapframe)
@@ -39,6 +53,7 @@ sys_fork(struct trapframe *tf, pid_t *retval)
 
 	result = thread_fork(curthread->t_name, enter_forked_process, 
 			     ntf, 0, retval);
+	REGION_END(RG_FORK, start);
 	if (result) {
 		kfree(ntf);
 		return result;
@@ -47,14 +62,260 @@ sys_fork(struct trapframe *tf, pid_t *retval)
 	return 0;
 }
 
+/*
+ * sys___threadfork
+ *
+ * Start a new thread in the current address space. It shares the
+ * address space and file table, gets its own user stack and thread
+ * (process) id, and begins executing at ENTRY with ARG as its first
+ * argument. The new id is returned, and can be waited for; getpid()
+ * in the new thread still returns the process's id.
+ */
+int
+sys___threadfork(struct trapframe *tf, userptr_t entry, userptr_t arg,
+		 pid_t *retval)
+{
+	struct trapframe *ntf;
+	vaddr_t stackptr;
+	int slot, result;
+
+	if (curthread->t_addrspace == NULL) {
+		return EINVAL;
+	}
+
+	ntf = kmalloc(sizeof(struct trapframe));
+	if (ntf == NULL) {
+		return ENOMEM;
+	}
+
+	result = as_define_thread_stack(curthread->t_addrspace, &stackptr,
+					&slot);
+	if (result) {
+		kfree(ntf);
+		return result;
+	}
+
+	/* Same registers (notably gp and status) but a new PC and stack */
+	*ntf = *tf;
+	ntf->tf_epc = (vaddr_t)entry;
+	ntf->tf_a0 = (vaddr_t)arg;
+	ntf->tf_sp = stackptr;
+	ntf->tf_ra = 0;
+
+	result = thread_fork_shared(curthread->t_name, enter_new_thread,
+				    ntf, slot, retval);
+	if (result) {
+		as_release_thread_stack(curthread->t_addrspace, slot);
+		kfree(ntf);
+		return result;
+	}
+
+	return 0;
+}
+
+/*
+ * sys_execv
+ *
+ * Replace the current program with PROG, passing it ARGV. The
+ * arguments are packed into one kernel block (see <argblock.h>) and
+ * the old address space is kept until the new one is fully loaded,
+ * so that on failure we can return to the caller.
+ */
+int
+sys_execv(userptr_t prog, userptr_t uargv)
+{
+	struct argblock ab;
+	struct addrspace *oldas, *newas;
+	struct vnode *v;
+	vaddr_t entrypoint, stackptr;
+	userptr_t argv;
+	uint64_t start;
+	char *path;
+	int argc, result;
+
+	start = REGION_BEGIN(RG_EXECV);
+
+	path = kmalloc(PATH_MAX);
+	if (path == NULL) {
+		return ENOMEM;
+	}
+	result = copyinstr(prog, path, PATH_MAX, NULL);
+	if (result) {
+		kfree(path);
+		return result;
+	}
+
+	result = argblock_copyin(&ab, uargv);
+	if (result) {
+		kfree(path);
+		return result;
+	}
+
+	result = vfs_open(path, O_RDONLY, 0, &v);
+	kfree(path);
+	if (result) {
+		argblock_cleanup(&ab);
+		return result;
+	}
+
+	newas = as_create();
+	if (newas == NULL) {
+		vfs_close(v);
+		argblock_cleanup(&ab);
+		return ENOMEM;
+	}
+	result = as_reserve_stack(newas, ab.ab_len);
+	if (result == 0) {
+		/* the new program is a process of its own */
+		result = vdso_map(newas, curthread->t_pid);
+	}
+	if (result) {
+		as_destroy(newas);
+		vfs_close(v);
+		argblock_cleanup(&ab);
+		return result;
+	}
+
+	/* load_elf and the argv copyout work on the current address space */
+	oldas = curthread->t_addrspace;
+	curthread->t_addrspace = newas;
+	as_activate(newas);
+
+	result = load_elf(v, &entrypoint);
+	vfs_close(v);
+	if (result == 0) {
+		result = as_define_stack(newas, &stackptr);
+	}
+	if (result == 0) {
+		result = argblock_copyout(&ab, &stackptr, &argv);
+	}
+	argc = ab.ab_argc;
+	argblock_cleanup(&ab);
+
+	/* Drop whichever address space we are not keeping */
+	curthread->t_addrspace = oldas;
+	if (result) {
+		as_activate(oldas);
+		vdso_unmap(newas);
+		as_destroy(newas);
+		return result;
+	}
+
+	/* Past the point of no return: tear down the old program */
+	if (curthread->t_ioring != NULL) {
+		ioring_destroy(curthread->t_ioring);
+		curthread->t_ioring = NULL;
+	}
+	if (curthread->t_ustack >= 0) {
+		as_release_thread_stack(oldas, curthread->t_ustack);
+		curthread->t_ustack = -1;
+	}
+	curthread->t_addrspace = newas;
+	curthread->t_procpid = curthread->t_pid;
+	if (oldas != NULL && as_decref(oldas) == 0) {
+		vdso_unmap(oldas);
+		as_destroy(oldas);
+	}
+
+	REGION_END(RG_EXECV, start);
+	enter_new_process(argc, argv, stackptr, entrypoint);
+
+	/* enter_new_process does not return. */
+	panic("enter_new_process returned\n");
+	return EINVAL;
+}
+
+/*
+ * sys_sbrk
+ * Moves the heap break; returns the old one.
+ */
+int
+sys_sbrk(intptr_t amount, int32_t *retval)
+{
+	vaddr_t oldbreak;
+	int result;
+
+	if (curthread->t_addrspace == NULL) {
+		return EINVAL;
+	}
+	result = as_sbrk(curthread->t_addrspace, amount, &oldbreak);
+	if (result) {
+		return result;
+	}
+	*retval = (int32_t)oldbreak;
+	return 0;
+}
+
+/*
+ * sys___vmstat
+ * Copies out the VM event counters for this process (VMSTAT_SELF) or
+ * the whole system (VMSTAT_SYSTEM).
+ */
+int
+sys___vmstat(int who, userptr_t statp)
+{
+	struct vmstat vs;
+
+	switch (who) {
+	    case VMSTAT_SELF:
+		if (curthread->t_addrspace == NULL) {
+			return EINVAL;
+		}
+		vm_getstat(curthread->t_addrspace, &vs);
+		break;
+	    case VMSTAT_SYSTEM:
+		vm_getstat(NULL, &vs);
+		break;
+	    default:
+		return EINVAL;
+	}
+	return copyout(&vs, statp, sizeof(vs));
+}
+
+/*
+ * sys___threadlist
+ * Copies out up to MAX entries describing the threads in the system,
+ * and returns how many there are. MAX of 0 just counts them.
+ */
+int
+sys___threadlist(userptr_t buf, unsigned max, int32_t *retval)
+{
+	struct threadinfo *ti;
+	unsigned total;
+	int result;
+
+	if (max > THREADLIST_MAX) {
+		max = THREADLIST_MAX;
+	}
+	if (max == 0) {
+		*retval = threadinfo_get(NULL, 0);
+		return 0;
+	}
+
+	ti = kmalloc(max * sizeof(*ti));
+	if (ti == NULL) {
+		return ENOMEM;
+	}
+	total = threadinfo_get(ti, max);
+	result = copyout(ti, buf, (total < max ? total : max) * sizeof(*ti));
+	kfree(ti);
+	if (result) {
+		return result;
+	}
+	*retval = total;
+	return 0;
+}
+
 /*
  * sys_getpid
- * Placeholder to remind you to implement this.
+ * Returns the process id, the same value libc's getpid() reads from
+ * the pid page (see vm/vdso.c). For a thread started with __threadfork
+ * that is its process's id, not the thread id __threadfork returned.
  */
 
  int sys_getpid(void){
 
- 	return curthread->t_pid;
+ 	return curthread->t_procpid;
  }
 
 /*
@@ -65,7 +326,7 @@ sys_fork(struct trapframe *tf, pid_t *retval)
 int sys_waitpid(pid_t targetpid, int *status, int flags){
 
 	// waitpid can only be called if the parent is calling on its children
-	target_parent(targetpid, sys_getpid());
+	target_parent(targetpid, curthread->t_pid);
 
 	return pid_join(targetpid, status, flags);
 }
@@ -0,0 +1,628 @@
+/*
+ * Kernel microbenchmarks.
+ *
+ * Unlike the other tests these check nothing; they time the basic
+ * primitives so that changes to them can be compared. Each one runs
+ * a short untimed warmup first, and prints one line in the form
+ *
+ *	bench NAME PARAM=P ops=N total_us=T ns_per_op=X
+ *
+ * which stays the same from run to run apart from the numbers.
+ *
+ * dumbvm never frees pages, and every thread_fork leaks a kernel stack
+ * and every kmalloc of a page or more leaks the page, so there the
+ * fork count is capped and the page-sized kmalloc classes are left out.
+ *
+ * Usage: bench [all | NAME [iterations [threads]]]
+ */
+
+#include <types.h>
+#include <kern/errno.h>
+#include <lib.h>
+#include <clock.h>
+#include <thread.h>
+#include <synch.h>
+#include <wchan.h>
+#include <pid.h>
+#include <test.h>
+#include "opt-dumbvm.h"
+
+#define BENCH_MAXTHREADS	32
+#define BENCH_MAXITERS		1000000	/* keeps the 32-bit math exact */
+#define BENCH_WARMUP(n)		((n) / 10 + 1)
+
+#if OPT_DUMBVM
+#define BENCH_MAXFORKS		32	/* leaks ~150k */
+#define BENCH_FORKS		32
+#else
+#define BENCH_MAXFORKS		BENCH_MAXITERS
+#define BENCH_FORKS		1000
+#endif
+
+/* Time accumulated by the benchmark being run. */
+static time_t bench_secs;
+static uint32_t bench_nsecs;
+
+/* Shared by the benchmark threads. */
+static struct semaphore *bench_gate;	/* released to start them */
+static struct semaphore *bench_done;	/* V'd by each as it finishes */
+static struct semaphore *bench_ping, *bench_pong;
+static struct lock *bench_lock;
+static struct wchan *bench_wchan;
+static volatile bool bench_asleep;
+static volatile time_t bench_wakesecs;
+static volatile uint32_t bench_wakensecs;
+
+static
+int
+bench_init(void)
+{
+	if (bench_gate != NULL) {
+		return 0;
+	}
+
+	bench_done = sem_create("bench_done", 0);
+	bench_ping = sem_create("bench_ping", 0);
+	bench_pong = sem_create("bench_pong", 0);
+	bench_lock = lock_create("bench_lock");
+	bench_wchan = wchan_create("bench_wchan");
+	if (bench_done != NULL && bench_ping != NULL && bench_pong != NULL &&
+	    bench_lock != NULL && bench_wchan != NULL) {
+		/* last, as it says the rest are there */
+		bench_gate = sem_create("bench_gate", 0);
+		if (bench_gate != NULL) {
+			return 0;
+		}
+	}
+
+	if (bench_done != NULL) {
+		sem_destroy(bench_done);
+	}
+	if (bench_ping != NULL) {
+		sem_destroy(bench_ping);
+	}
+	if (bench_pong != NULL) {
+		sem_destroy(bench_pong);
+	}
+	if (bench_lock != NULL) {
+		lock_destroy(bench_lock);
+	}
+	if (bench_wchan != NULL) {
+		wchan_destroy(bench_wchan);
+	}
+	bench_done = bench_ping = bench_pong = NULL;
+	bench_lock = NULL;
+	bench_wchan = NULL;
+	return ENOMEM;
+}
+
+////////////////////////////////////////////////////////////
+// timing
+
+/*
+ * Add the time from (SECS1, NSECS1) to (SECS2, NSECS2) to the total.
+ */
+static
+void
+bench_addtime(time_t secs1, uint32_t nsecs1, time_t secs2, uint32_t nsecs2)
+{
+	time_t secs;
+	uint32_t nsecs;
+
+	getinterval(secs1, nsecs1, secs2, nsecs2, &secs, &nsecs);
+	bench_secs += secs;
+	bench_nsecs += nsecs;
+	if (bench_nsecs >= 1000000000) {
+		bench_nsecs -= 1000000000;
+		bench_secs++;
+	}
+}
+
+/*
+ * Print the result line.
+ */
+static
+void
+bench_report(const char *name, const char *param, unsigned pval,
+	     unsigned ops)
+{
+	uint64_t ns;
+
+	ns = (uint64_t)bench_secs * 1000000000 + bench_nsecs;
+	kprintf("bench %s %s=%u ops=%u total_us=%lu ns_per_op=%lu\n",
+		name, param, pval, ops, (unsigned long)(ns / 1000),
+		(unsigned long)(ns / ops));
+}
+
+/*
+ * Start NTHREADS copies of FUNC, each doing ITERS loops. They wait on
+ * bench_gate so that forking isn't timed. If one can't be forked, let
+ * the ones that were go and wait for them; FUNC must be able to run
+ * without the others.
+ */
+static
+int
+bench_fork(const char *name, void (*func)(void *, unsigned long),
+	   unsigned nthreads, unsigned iters)
+{
+	unsigned i, j;
+	int result;
+
+	for (i=0; i<nthreads; i++) {
+		result = thread_fork(name, func, NULL, iters, NULL);
+		if (result) {
+			for (j=0; j<i; j++) {
+				V(bench_gate);
+			}
+			for (j=0; j<i; j++) {
+				P(bench_done);
+			}
+			return result;
+		}
+	}
+	return 0;
+}
+
+/*
+ * Release the threads, wait for them all, and time the whole thing.
+ */
+static
+void
+bench_run(unsigned nthreads)
+{
+	time_t secs1, secs2;
+	uint32_t nsecs1, nsecs2;
+	unsigned i;
+
+	gettime(&secs1, &nsecs1);
+	for (i=0; i<nthreads; i++) {
+		V(bench_gate);
+	}
+	for (i=0; i<nthreads; i++) {
+		P(bench_done);
+	}
+	gettime(&secs2, &nsecs2);
+	bench_addtime(secs1, nsecs1, secs2, nsecs2);
+}
+
+////////////////////////////////////////////////////////////
+// benchmarks
+//
+// Each takes an iteration count and a thread count (which some
+// ignore), sets *OPS to the number of operations it timed, and
+// returns an error code.
+
+/*
+ * Context switch: two threads yielding to each other. On a machine
+ * with more than one CPU they may land on different CPUs, and then
+ * this measures thread_yield finding nothing else to run.
+ */
+static
+void
+ctxsw_thread(void *junk, unsigned long iters)
+{
+	unsigned long i;
+
+	(void)junk;
+	P(bench_gate);
+	for (i=0; i<iters; i++) {
+		thread_yield();
+	}
+	V(bench_done);
+}
+
+static
+int
+bench_ctxsw(unsigned iters, unsigned nthreads, unsigned *ops)
+{
+	int result;
+
+	(void)nthreads;
+	result = bench_fork("bench_ctxsw", ctxsw_thread, 2, iters);
+	if (result) {
+		return result;
+	}
+	bench_run(2);
+	*ops = iters * 2;
+	return 0;
+}
+
+/*
+ * Semaphore ping-pong: a round trip is one V and one P on each side.
+ */
+static
+void
+pingpong_thread(void *junk, unsigned long iters)
+{
+	unsigned long i;
+
+	(void)junk;
+	P(bench_gate);
+	for (i=0; i<iters; i++) {
+		P(bench_ping);
+		V(bench_pong);
+	}
+	V(bench_done);
+}
+
+static
+int
+bench_sempp(unsigned iters, unsigned nthreads, unsigned *ops)
+{
+	time_t secs1, secs2;
+	uint32_t nsecs1, nsecs2;
+	unsigned i;
+	int result;
+
+	(void)nthreads;
+	result = bench_fork("bench_sempp", pingpong_thread, 1, iters);
+	if (result) {
+		return result;
+	}
+	V(bench_gate);
+
+	gettime(&secs1, &nsecs1);
+	for (i=0; i<iters; i++) {
+		V(bench_ping);
+		P(bench_pong);
+	}
+	gettime(&secs2, &nsecs2);
+
+	P(bench_done);
+	bench_addtime(secs1, nsecs1, secs2, nsecs2);
+	*ops = iters;
+	return 0;
+}
+
+/*
+ * Lock acquire/release by one thread, never waiting.
+ */
+static
+int
+bench_lock1(unsigned iters, unsigned nthreads, unsigned *ops)
+{
+	time_t secs1, secs2;
+	uint32_t nsecs1, nsecs2;
+	unsigned i;
+
+	(void)nthreads;
+	gettime(&secs1, &nsecs1);
+	for (i=0; i<iters; i++) {
+		lock_acquire(bench_lock);
+		lock_release(bench_lock);
+	}
+	gettime(&secs2, &nsecs2);
+	bench_addtime(secs1, nsecs1, secs2, nsecs2);
+	*ops = iters;
+	return 0;
+}
+
+/*
+ * Lock acquire/release by NTHREADS threads at once, ITERS in total.
+ */
+static
+void
+lock_thread(void *junk, unsigned long iters)
+{
+	unsigned long i;
+
+	(void)junk;
+	P(bench_gate);
+	for (i=0; i<iters; i++) {
+		lock_acquire(bench_lock);
+		lock_release(bench_lock);
+	}
+	V(bench_done);
+}
+
+static
+int
+bench_lockn(unsigned iters, unsigned nthreads, unsigned *ops)
+{
+	unsigned each;
+	int result;
+
+	each = iters < nthreads ? 1 : iters / nthreads;
+	result = bench_fork("bench_lockn", lock_thread, nthreads, each);
+	if (result) {
+		return result;
+	}
+	bench_run(nthreads);
+	*ops = each * nthreads;
+	return 0;
+}
+
+/*
+ * thread_fork of a thread that exits at once, then pid_join on it.
+ */
+static
+void
+null_thread(void *junk, unsigned long num)
+{
+	(void)junk;
+	(void)num;
+}
+
+static
+int
+bench_fork1(unsigned iters, unsigned nthreads, unsigned *ops)
+{
+	time_t secs1, secs2;
+	uint32_t nsecs1, nsecs2;
+	unsigned i;
+	pid_t pid;
+	int status, result;
+
+	(void)nthreads;
+	if (iters > BENCH_MAXFORKS) {
+		iters = BENCH_MAXFORKS;
+	}
+	gettime(&secs1, &nsecs1);
+	for (i=0; i<iters; i++) {
+		result = thread_fork("bench_fork", null_thread, NULL, 0, &pid);
+		if (result) {
+			return result;
+		}
+		result = pid_join(pid, &status, 0);
+		if (result < 0) {
+			return -result;
+		}
+	}
+	gettime(&secs2, &nsecs2);
+	bench_addtime(secs1, nsecs1, secs2, nsecs2);
+	*ops = iters;
+	return 0;
+}
+
+/*
+ * Wakeup latency: from just before wchan_wakeone to the sleeper
+ * running again. The waker only wakes once the sleeper is on the
+ * channel, and the sleeper does the timing.
+ */
+static
+void
+wchan_thread(void *junk, unsigned long iters)
+{
+	time_t secs;
+	uint32_t nsecs;
+	unsigned long i;
+
+	(void)junk;
+	for (i=0; i<iters; i++) {
+		wchan_lock(bench_wchan);
+		bench_asleep = true;
+		wchan_sleep(bench_wchan);
+		gettime(&secs, &nsecs);
+		bench_addtime(bench_wakesecs, bench_wakensecs, secs, nsecs);
+	}
+	V(bench_done);
+}
+
+static
+int
+bench_wakeup(unsigned iters, unsigned nthreads, unsigned *ops)
+{
+	time_t secs;
+	uint32_t nsecs;
+	unsigned i;
+	int result;
+
+	(void)nthreads;
+	bench_asleep = false;
+	result = bench_fork("bench_wakeup", wchan_thread, 1, iters);
+	if (result) {
+		return result;
+	}
+
+	for (i=0; i<iters; i++) {
+		for (;;) {
+			wchan_lock(bench_wchan);
+			if (bench_asleep) {
+				break;
+			}
+			wchan_unlock(bench_wchan);
+			thread_yield();
+		}
+		bench_asleep = false;
+		gettime(&secs, &nsecs);
+		bench_wakesecs = secs;
+		bench_wakensecs = nsecs;
+		wchan_unlock(bench_wchan);
+		wchan_wakeone(bench_wchan);
+	}
+	P(bench_done);
+	*ops = iters;
+	return 0;
+}
+
+static const struct {
+	const char *name;
+	int (*func)(unsigned iters, unsigned nthreads, unsigned *ops);
+	unsigned iters;		/* default */
+	unsigned nthreads;	/* fixed, or 0 to take the argument */
+} benchmarks[] = {
+	{ "ctxsw",  bench_ctxsw,  10000,  2 },
+	{ "sempp",  bench_sempp,  10000,  2 },
+	{ "lock1",  bench_lock1,  100000, 1 },
+	{ "lockn",  bench_lockn,  100000, 0 },
+	{ "fork",   bench_fork1,  BENCH_FORKS, 1 },
+	{ "wakeup", bench_wakeup, 10000,  2 },
+	{ NULL, NULL, 0, 0 }
+};
+
+////////////////////////////////////////////////////////////
+// kmalloc, one line per size class
+
+#define KMALLOC_BATCH	32	/* blocks held at once */
+
+static const unsigned kmalloc_sizes[] = {
+	16, 32, 64, 128, 256, 512, 1024,
+#if !OPT_DUMBVM
+	2048, 4096,
+#endif
+	0
+};
+
+/*
+ * Allocate and free ITERS blocks of SIZE, with KMALLOC_BATCH of them
+ * held at once so we aren't just taking the same block back over and
+ * over. Each step frees the oldest and allocates a replacement, so
+ * the pages the batch sits on never empty out; with dumbvm an empty
+ * page is a leaked page.
+ */
+static
+int
+bench_kmalloc1(unsigned iters, unsigned size, unsigned *ops)
+{
+	void *ptrs[KMALLOC_BATCH];
+	time_t secs1, secs2;
+	uint32_t nsecs1, nsecs2;
+	unsigned i, j;
+	int result = 0;
+
+	for (j=0; j<KMALLOC_BATCH; j++) {
+		ptrs[j] = kmalloc(size);
+		if (ptrs[j] == NULL) {
+			result = ENOMEM;
+			goto out;
+		}
+	}
+
+	gettime(&secs1, &nsecs1);
+	for (i=0; i<iters; i++) {
+		j = i % KMALLOC_BATCH;
+		kfree(ptrs[j]);
+		ptrs[j] = kmalloc(size);
+		if (ptrs[j] == NULL) {
+			result = ENOMEM;
+			goto out;
+		}
+	}
+	gettime(&secs2, &nsecs2);
+	bench_addtime(secs1, nsecs1, secs2, nsecs2);
+	*ops = iters;
+	j = KMALLOC_BATCH;
+
+ out:
+	while (j-- > 0) {
+		kfree(ptrs[j]);
+	}
+	return result;
+}
+
+static
+int
+bench_kmalloc(unsigned iters)
+{
+	unsigned i, ops;
+	int result;
+
+	for (i=0; kmalloc_sizes[i] != 0; i++) {
+		result = bench_kmalloc1(BENCH_WARMUP(iters), kmalloc_sizes[i],
+					&ops);
+		if (result) {
+			return result;
+		}
+		bench_secs = 0;
+		bench_nsecs = 0;
+		result = bench_kmalloc1(iters, kmalloc_sizes[i], &ops);
+		if (result) {
+			return result;
+		}
+		bench_report("kmalloc", "size", kmalloc_sizes[i], ops);
+	}
+	return 0;
+}
+
+////////////////////////////////////////////////////////////
+// driver
+
+static
+int
+bench_one(unsigned ix, unsigned iters, unsigned nthreads)
+{
+	unsigned ops;
+	int result;
+
+	if (iters == 0) {
+		iters = benchmarks[ix].iters;
+	}
+	if (benchmarks[ix].nthreads != 0) {
+		nthreads = benchmarks[ix].nthreads;
+	}
+
+	result = benchmarks[ix].func(BENCH_WARMUP(iters), nthreads, &ops);
+	if (result) {
+		return result;
+	}
+	bench_secs = 0;
+	bench_nsecs = 0;
+	result = benchmarks[ix].func(iters, nthreads, &ops);
+	if (result) {
+		return result;
+	}
+	bench_report(benchmarks[ix].name, "threads", nthreads, ops);
+	return 0;
+}
+
+int
+benchtest(int nargs, char **args)
+{
+	unsigned i, iters = 0, nthreads = 4;
+	bool all;
+	int result;
+
+	if (nargs < 2 || nargs > 4) {
+		kprintf("Usage: bench all | NAME [iterations [threads]]\n");
+		kprintf("Benchmarks: kmalloc");
+		for (i=0; benchmarks[i].name != NULL; i++) {
+			kprintf(" %s", benchmarks[i].name);
+		}
+		kprintf("\n");
+		return EINVAL;
+	}
+	if (nargs >= 3) {
+		iters = atoi(args[2]);
+		if (iters == 0 || iters > BENCH_MAXITERS) {
+			kprintf("bench: iterations must be 1-%u\n",
+				BENCH_MAXITERS);
+			return EINVAL;
+		}
+	}
+	if (nargs == 4) {
+		nthreads = atoi(args[3]);
+		if (nthreads == 0 || nthreads > BENCH_MAXTHREADS) {
+			kprintf("bench: threads must be 1-%u\n",
+				BENCH_MAXTHREADS);
+			return EINVAL;
+		}
+	}
+
+	result = bench_init();
+	if (result) {
+		goto done;
+	}
+	all = !strcmp(args[1], "all");
+
+	for (i=0; benchmarks[i].name != NULL; i++) {
+		if (all || !strcmp(args[1], benchmarks[i].name)) {
+			result = bench_one(i, iters, nthreads);
+			if (result || !all) {
+				goto done;
+			}
+		}
+	}
+	if (all || !strcmp(args[1], "kmalloc")) {
+		result = bench_kmalloc(iters ? iters : 10000);
+		goto done;
+	}
+
+	kprintf("bench: no benchmark %s\n", args[1]);
+	return EINVAL;
+
+ done:
+	if (result) {
+		kprintf("bench: %s\n", strerror(result));
+	}
+	return result;
+}
@@ -29,11 +29,149 @@
 
 #include <types.h>
 #include <lib.h>
+#include <clock.h>
 #include <bitmap.h>
 #include <test.h>
 
 #define TESTSIZE 533
+#define BENCHSIZE 65536		/* bits */
+#define BENCHOPS 20000
+#define BENCHRANGE 8		/* bits per bitmap_alloc_range */
 
+/*
+ * Allocate runs of random length until the map is full, checking each
+ * is clear and is the lowest one there is, then free every other run
+ * and do it again.
+ */
+static
+void
+bitmaptest_range(void)
+{
+	struct bitmap *b;
+	char data[TESTSIZE];
+	unsigned x, n, i, j, lowest;
+	bool ok;
+
+	b = bitmap_create(TESTSIZE);
+	KASSERT(b != NULL);
+	bzero(data, sizeof(data));
+
+	while (1) {
+		n = random() % 20 + 1;
+		for (lowest = 0; lowest + n <= TESTSIZE; lowest++) {
+			ok = true;
+			for (j=lowest; j<lowest+n; j++) {
+				if (data[j]) {
+					ok = false;
+					break;
+				}
+			}
+			if (ok) {
+				break;
+			}
+		}
+		if (bitmap_alloc_range(b, n, &x) != 0) {
+			KASSERT(lowest + n > TESTSIZE);
+			if (n == 1) {
+				break;
+			}
+			continue;
+		}
+		KASSERT(x == lowest);
+		for (i=x; i<x+n; i++) {
+			KASSERT(bitmap_isset(b, i));
+			data[i] = 1;
+		}
+		if (random() % 2) {
+			for (i=x; i<x+n; i++) {
+				bitmap_unmark(b, i);
+				data[i] = 0;
+			}
+		}
+	}
+
+	for (i=0; i<TESTSIZE; i++) {
+		KASSERT(bitmap_isset(b, i));
+	}
+	bitmap_destroy(b);
+}
+
+/*
+ * Time single and range allocations in a bitmap that is nearly full,
+ * freeing a random set bit after each one so it stays that way.
+ */
+static
+void
+bitmaptest_bench(void)
+{
+	struct bitmap *b;
+	time_t secs1, secs2, secs;
+	uint32_t nsecs1, nsecs2, nsecs;
+	unsigned long us;
+	unsigned x, y, i, j, n;
+
+	b = bitmap_create(BENCHSIZE);
+	KASSERT(b != NULL);
+
+	for (n=1; n<=BENCHRANGE; n*=BENCHRANGE) {
+		for (i=0; i<BENCHSIZE; i++) {
+			if (!bitmap_isset(b, i)) {
+				bitmap_mark(b, i);
+			}
+		}
+		/* leave about one bit in a hundred free */
+		for (i=0; i<BENCHSIZE/100; i++) {
+			y = random() % (BENCHSIZE - n);
+			for (j=y; j<y+n; j++) {
+				if (bitmap_isset(b, j)) {
+					bitmap_unmark(b, j);
+				}
+			}
+		}
+
+		gettime(&secs1, &nsecs1);
+		for (i=0; i<BENCHOPS; i++) {
+			if (bitmap_alloc_range(b, n, &x) != 0) {
+				continue;
+			}
+			y = random() % (BENCHSIZE - n);
+			for (j=y; j<y+n; j++) {
+				if (bitmap_isset(b, j)) {
+					bitmap_unmark(b, j);
+				}
+			}
+		}
+		gettime(&secs2, &nsecs2);
+		getinterval(secs1, nsecs1, secs2, nsecs2, &secs, &nsecs);
+		us = (unsigned long)secs * 1000000 + nsecs / 1000;
+		kprintf("bench bitmap_alloc_range n=%u nbits=%u ops=%u "
+			"total_us=%lu ns_per_op=%lu\n", n, BENCHSIZE,
+			BENCHOPS, us, us * 1000 / BENCHOPS);
+	}
+
+	gettime(&secs1, &nsecs1);
+	for (i=0; i<BENCHOPS; i++) {
+		if (bitmap_alloc(b, &x) != 0) {
+			continue;
+		}
+		y = random() % BENCHSIZE;
+		if (bitmap_isset(b, y)) {
+			bitmap_unmark(b, y);
+		}
+	}
+	gettime(&secs2, &nsecs2);
+	getinterval(secs1, nsecs1, secs2, nsecs2, &secs, &nsecs);
+	us = (unsigned long)secs * 1000000 + nsecs / 1000;
+	kprintf("bench bitmap_alloc nbits=%u ops=%u total_us=%lu "
+		"ns_per_op=%lu\n", BENCHSIZE, BENCHOPS, us,
+		us * 1000 / BENCHOPS);
+
+	bitmap_destroy(b);
+}
+
+/*
+ * Usage: bt [bench]
+ */
 int
 bitmaptest(int nargs, char **args)
 {
@@ -42,8 +180,10 @@ bitmaptest(int nargs, char **args)
 	uint32_t x;
 	int i;
 
-	(void)nargs;
-	(void)args;
+	if (nargs == 2 && !strcmp(args[1], "bench")) {
+		bitmaptest_bench();
+		return 0;
+	}
 
 	kprintf("Starting bitmap test...\n");
 
@@ -100,6 +240,9 @@ bitmaptest(int nargs, char **args)
 		KASSERT(bitmap_isset(b, i));
 		KASSERT(data[i]==0);
 	}
+	bitmap_destroy(b);
+
+	bitmaptest_range();
 
 	kprintf("Bitmap test complete\n");
 	return 0;
@@ -0,0 +1,307 @@
+/*
+ * Hash table test and benchmark.
+ *
+ * Checks the table, unlocked and with locks (and from several threads
+ * at once in the locked case), then times looking up N keys, picked
+ * at random, three ways: by scanning a struct array the way most of
+ * the kernel finds things now, and in an unlocked and a locked hash
+ * table. Prints
+ *
+ *	bench lookup_array n=N ops=K total_us=T ns_per_op=X
+ *
+ * and then for each kind of table (WHICH is unlocked or locked) a line
+ * for inserting the N keys into it, empty, with the slowest single
+ * insert, which should stay small as the table grows, and a line for
+ * the lookups:
+ *
+ *	bench hash_insert_WHICH n=N ops=N total_us=T ns_per_op=X max_ns=Y
+ *	bench lookup_hash_WHICH n=N ops=K total_us=T ns_per_op=X
+ *
+ * Usage: ht [n]
+ */
+
+#define HTINLINE
+
+#include <types.h>
+#include <kern/errno.h>
+#include <lib.h>
+#include <array.h>
+#include <clock.h>
+#include <thread.h>
+#include <synch.h>
+#include <hashtable.h>
+#include <test.h>
+
+#define HT_DEFAULTN	1000
+#define HT_MAXN		20000
+#define HT_OPS		5000
+#define HT_LOCKS	8
+#define HT_THREADS	4
+
+struct htent {
+	uint32_t he_key;
+	struct hashlink he_link;
+};
+
+static
+bool
+htent_match(const struct htent *he, const void *key)
+{
+	return he->he_key == *(const uint32_t *)key;
+}
+
+DECLHASH(htent);
+DEFHASH(htent, he_link, htent_match, HTINLINE);
+
+static struct htent *ht_ents;
+static struct htenthash ht_table;
+static struct semaphore *ht_done;
+
+static
+struct htent *
+ht_find(uint32_t key)
+{
+	return htenthash_lookup(&ht_table, hash_uint32(key), &key);
+}
+
+static
+unsigned long
+ht_us(time_t secs1, uint32_t nsecs1)
+{
+	time_t secs2, secs;
+	uint32_t nsecs2, nsecs;
+
+	gettime(&secs2, &nsecs2);
+	getinterval(secs1, nsecs1, secs2, nsecs2, &secs, &nsecs);
+	return (unsigned long)secs * 1000000 + nsecs / 1000;
+}
+
+////////////////////////////////////////////////////////////
+// correctness
+
+/*
+ * Fill the table with keys 0..n-1 (entry i has key i), check it, and
+ * empty it again.
+ */
+static
+void
+ht_check(unsigned n, unsigned nlocks)
+{
+	struct hashiter hi;
+	struct htent *he;
+	unsigned i, count;
+	uint32_t key;
+	int result;
+
+	result = htenthash_init(&ht_table, nlocks);
+	KASSERT(result == 0);
+
+	for (i=0; i<n; i++) {
+		htenthash_insert(&ht_table, &ht_ents[i], hash_uint32(i));
+		/* look things up mid-resize too */
+		key = random() % (i + 1);
+		KASSERT(ht_find(key) == &ht_ents[key]);
+	}
+	KASSERT(htenthash_num(&ht_table) == n);
+	key = n;
+	KASSERT(ht_find(key) == NULL);
+
+	count = 0;
+	htenthash_iter_start(&ht_table, &hi);
+	while ((he = htenthash_iter_next(&hi)) != NULL) {
+		KASSERT(he == &ht_ents[he->he_key]);
+		count++;
+	}
+	KASSERT(count == n);
+
+	for (i=0; i<n; i+=2) {
+		htenthash_remove(&ht_table, &ht_ents[i]);
+	}
+	for (i=0; i<n; i++) {
+		KASSERT(ht_find(i) == (i % 2 ? &ht_ents[i] : NULL));
+	}
+	for (i=1; i<n; i+=2) {
+		htenthash_remove(&ht_table, &ht_ents[i]);
+	}
+	KASSERT(htenthash_num(&ht_table) == 0);
+	htenthash_cleanup(&ht_table);
+}
+
+/*
+ * Thread NUM of HT_THREADS repeatedly inserts, finds, and removes
+ * its share of the keys.
+ */
+static
+void
+ht_worker(void *junk, unsigned long num)
+{
+	unsigned i, pass, n = (unsigned long)junk;
+
+	for (pass=0; pass<4; pass++) {
+		for (i=num; i<n; i+=HT_THREADS) {
+			htenthash_insert(&ht_table, &ht_ents[i],
+					 hash_uint32(i));
+		}
+		for (i=num; i<n; i+=HT_THREADS) {
+			KASSERT(ht_find(i) == &ht_ents[i]);
+		}
+		for (i=num; i<n; i+=HT_THREADS) {
+			htenthash_remove(&ht_table, &ht_ents[i]);
+			KASSERT(ht_find(i) == NULL);
+		}
+	}
+	V(ht_done);
+}
+
+static
+void
+ht_threads(unsigned n)
+{
+	unsigned long i;
+	int result;
+
+	result = htenthash_init(&ht_table, HT_LOCKS);
+	KASSERT(result == 0);
+	for (i=0; i<HT_THREADS; i++) {
+		result = thread_fork("ht_worker", ht_worker,
+				     (void *)(unsigned long)n, i, NULL);
+		if (result) {
+			panic("hashtest: thread_fork failed: %s\n",
+			      strerror(result));
+		}
+	}
+	for (i=0; i<HT_THREADS; i++) {
+		P(ht_done);
+	}
+	KASSERT(htenthash_num(&ht_table) == 0);
+	htenthash_cleanup(&ht_table);
+}
+
+////////////////////////////////////////////////////////////
+// benchmarks
+
+static
+void
+ht_bench_array(unsigned n)
+{
+	struct array *a;
+	struct htent *he;
+	time_t secs;
+	uint32_t nsecs, key;
+	unsigned long us;
+	unsigned i, j;
+	int result;
+
+	a = array_create();
+	KASSERT(a != NULL);
+	for (i=0; i<n; i++) {
+		result = array_add(a, &ht_ents[i], NULL);
+		KASSERT(result == 0);
+	}
+
+	gettime(&secs, &nsecs);
+	for (i=0; i<HT_OPS; i++) {
+		key = random() % n;
+		for (j=0; j<array_num(a); j++) {
+			he = array_get(a, j);
+			if (he->he_key == key) {
+				break;
+			}
+		}
+		KASSERT(j < array_num(a));
+	}
+	us = ht_us(secs, nsecs);
+	kprintf("bench lookup_array n=%u ops=%u total_us=%lu ns_per_op=%lu\n",
+		n, HT_OPS, us, us * 1000 / HT_OPS);
+
+	array_setsize(a, 0);
+	array_destroy(a);
+}
+
+static
+void
+ht_bench_hash(unsigned n, unsigned nlocks)
+{
+	const char *name = nlocks ? "locked" : "unlocked";
+	time_t secs, secs1;
+	uint32_t nsecs, nsecs1;
+	unsigned long us, one, max = 0;
+	unsigned i;
+	int result;
+
+	result = htenthash_init(&ht_table, nlocks);
+	KASSERT(result == 0);
+
+	gettime(&secs, &nsecs);
+	for (i=0; i<n; i++) {
+		gettime(&secs1, &nsecs1);
+		htenthash_insert(&ht_table, &ht_ents[i], hash_uint32(i));
+		one = ht_us(secs1, nsecs1);
+		if (one > max) {
+			max = one;
+		}
+	}
+	us = ht_us(secs, nsecs);
+	kprintf("bench hash_insert_%s n=%u ops=%u total_us=%lu ns_per_op=%lu "
+		"max_ns=%lu\n", name, n, n, us, us * 1000 / n, max * 1000);
+
+	gettime(&secs, &nsecs);
+	for (i=0; i<HT_OPS; i++) {
+		KASSERT(ht_find(random() % n) != NULL);
+	}
+	us = ht_us(secs, nsecs);
+	kprintf("bench lookup_hash_%s n=%u ops=%u total_us=%lu "
+		"ns_per_op=%lu\n", name, n, HT_OPS, us, us * 1000 / HT_OPS);
+
+	for (i=0; i<n; i++) {
+		htenthash_remove(&ht_table, &ht_ents[i]);
+	}
+	htenthash_cleanup(&ht_table);
+}
+
+int
+hashtest(int nargs, char **args)
+{
+	unsigned i, n = HT_DEFAULTN;
+
+	if (nargs > 2) {
+		kprintf("Usage: ht [n]\n");
+		return EINVAL;
+	}
+	if (nargs == 2) {
+		n = atoi(args[1]);
+	}
+	if (n < 1 || n > HT_MAXN) {
+		kprintf("ht: n must be 1-%u\n", HT_MAXN);
+		return EINVAL;
+	}
+
+	if (ht_done == NULL) {
+		ht_done = sem_create("ht_done", 0);
+		if (ht_done == NULL) {
+			panic("hashtest: out of memory\n");
+		}
+	}
+	ht_ents = kmalloc(n * sizeof(*ht_ents));
+	if (ht_ents == NULL) {
+		return ENOMEM;
+	}
+	for (i=0; i<n; i++) {
+		ht_ents[i].he_key = i;
+		hashlink_init(&ht_ents[i].he_link, &ht_ents[i]);
+	}
+
+	kprintf("Starting hash table test...\n");
+	ht_check(n, 0);
+	ht_check(n, HT_LOCKS);
+	ht_threads(n);
+	kprintf("Hash table test done.\n");
+
+	ht_bench_array(n);
+	ht_bench_hash(n, 0);
+	ht_bench_hash(n, HT_LOCKS);
+
+	kfree(ht_ents);
+	ht_ents = NULL;
+	return 0;
+}
@@ -0,0 +1,159 @@
+/*
+ * High-resolution timer test.
+ *
+ * Sleeps HT_COUNT times for USEC microseconds with clock_nsleep and
+ * reports how late it woke, on average and at worst:
+ *
+ *	bench hrtimer_sleep usec=U count=N mean_late_us=X max_late_us=Y
+ *
+ * Then starts HT_COUNT timers with deadlines in scrambled order,
+ * checks that they go off in deadline order, and that cancelling one
+ * keeps it from going off. The timers are started at splhigh, but
+ * another CPU may take the timer interrupt, and with a small USEC
+ * some deadlines can pass before the last timer is queued; those
+ * early ones only have to go off, in any order, before the rest.
+ *
+ * Usage: hrt [usec]
+ */
+
+#include <types.h>
+#include <kern/errno.h>
+#include <lib.h>
+#include <clock.h>
+#include <spl.h>
+#include <synch.h>
+#include <hrtimer.h>
+#include <test.h>
+
+#define HT_DEFAULTUSEC	500
+#define HT_MAXUSEC	1000000
+#define HT_COUNT	16
+
+static struct hrtimer ht_timers[HT_COUNT];
+static unsigned ht_order[HT_COUNT];	/* timer numbers as they went off */
+static unsigned ht_fired;
+static struct semaphore *ht_sem;
+
+static
+void
+ht_expire(void *data)
+{
+	/* Only this softirq writes these, and it doesn't run twice at once. */
+	ht_order[ht_fired++] = (uintptr_t)data;
+	V(ht_sem);
+}
+
+static
+void
+ht_sleeps(unsigned usec)
+{
+	uint64_t start, late, total, max;
+	unsigned i;
+
+	total = max = 0;
+	for (i=0; i<HT_COUNT; i++) {
+		start = hrtimer_now();
+		clock_nsleep(0, usec * 1000);
+		late = hrtimer_now() - start - usec * 1000;
+		total += late;
+		if (late > max) {
+			max = late;
+		}
+	}
+	kprintf("bench hrtimer_sleep usec=%u count=%u mean_late_us=%u "
+		"max_late_us=%u\n", usec, HT_COUNT,
+		(unsigned)(total / (HT_COUNT * 1000)),
+		(unsigned)(max / 1000));
+}
+
+static
+void
+ht_ordering(unsigned usec)
+{
+	bool seen[HT_COUNT];
+	uint64_t now, started;
+	unsigned i, j, early, last, cancelled;
+	int spl;
+
+	ht_fired = 0;
+	spl = splhigh();
+	now = hrtimer_now();
+	for (i=0; i<HT_COUNT; i++) {
+		/* 7 is prime to HT_COUNT, so this visits every slot */
+		j = (i * 7) % HT_COUNT;
+		hrtimer_init(&ht_timers[j], ht_expire, (void *)(uintptr_t)j);
+		hrtimer_start(&ht_timers[j],
+			      now + (uint64_t)(j + 1) * usec * 1000);
+	}
+	started = hrtimer_now();
+	splx(spl);
+
+	/* Timers 0..early-1 were due before they were all queued. */
+	early = (started - now) / (usec * 1000);
+	if (early > HT_COUNT) {
+		early = HT_COUNT;
+	}
+
+	cancelled = HT_COUNT / 2;
+	if (!hrtimer_cancel(&ht_timers[cancelled])) {
+		/* already went off (tiny usec); nothing was cancelled */
+		cancelled = HT_COUNT;
+	}
+
+	for (i=0; i<HT_COUNT; i++) {
+		if (i != cancelled) {
+			P(ht_sem);
+		}
+	}
+	KASSERT(!hrtimer_cancel(&ht_timers[0]));
+
+	for (j=0; j<HT_COUNT; j++) {
+		seen[j] = false;
+	}
+	last = 0;
+	for (i=0; i<ht_fired; i++) {
+		j = ht_order[i];
+		KASSERT(j < HT_COUNT && j != cancelled && !seen[j]);
+		seen[j] = true;
+		if (j < early) {
+			/* no on-time timer went before it */
+			KASSERT(last < early);
+		}
+		else {
+			KASSERT(j >= last);
+			last = j;
+		}
+	}
+	KASSERT(ht_fired == (cancelled < HT_COUNT ? HT_COUNT - 1 : HT_COUNT));
+}
+
+int
+hrtimertest(int nargs, char **args)
+{
+	unsigned usec = HT_DEFAULTUSEC;
+
+	if (nargs > 2) {
+		kprintf("Usage: hrt [usec]\n");
+		return EINVAL;
+	}
+	if (nargs == 2) {
+		usec = atoi(args[1]);
+	}
+	if (usec < 1 || usec > HT_MAXUSEC) {
+		kprintf("hrt: usec must be 1-%u\n", HT_MAXUSEC);
+		return EINVAL;
+	}
+
+	if (ht_sem == NULL) {
+		ht_sem = sem_create("ht_sem", 0);
+		if (ht_sem == NULL) {
+			panic("hrtimertest: out of memory\n");
+		}
+	}
+
+	kprintf("Starting hrtimer test...\n");
+	ht_sleeps(usec);
+	ht_ordering(usec);
+	kprintf("hrtimer test done.\n");
+	return 0;
+}
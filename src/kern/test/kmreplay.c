@@ -0,0 +1,222 @@
+/*
+ * Replay an allocation trace against kmalloc.
+ *
+ * The trace is in the format of <kern/mtrace.h>, as written by libc's
+ * malloc with MALLOCTRACE on or by "mallocreplay -g", so the same
+ * workload can be run through both allocators. The file is streamed
+ * in chunks; each chunk's addresses are resolved to table slots first
+ * so that only the kmalloc and kfree calls are timed.
+ *
+ * Usage: kmr tracefile
+ */
+
+#include <types.h>
+#include <kern/errno.h>
+#include <kern/fcntl.h>
+#include <kern/mtrace.h>
+#include <lib.h>
+#include <clock.h>
+#include <uio.h>
+#include <vfs.h>
+#include <vnode.h>
+#include <test.h>
+
+#define KMR_CHUNK	256		/* records read at a time */
+#define KMR_SLOTS	2048		/* most blocks live at once; power of 2 */
+
+#define KMR_EMPTY	0		/* slot never used */
+#define KMR_DEAD	1		/* slot freed; key is stale */
+#define KMR_LIVE	2
+#define KMR_FREEING	3		/* freed in this chunk, not yet replayed */
+
+#define KMR_SKIP	0		/* op for a free we can't match */
+
+struct kmr_slot {
+	uint32_t ks_addr;
+	int ks_state;
+	void *ks_ptr;
+	size_t ks_size;
+};
+
+static struct kmr_slot *kmr_slots;
+
+/*
+ * Find the live slot for ADDR, or if INSERT, claim a free one for it.
+ * Returns -1 if there is none.
+ */
+static
+int
+kmr_lookup(uint32_t addr, bool insert)
+{
+	unsigned h, i;
+	int dead = -1;
+
+	h = (addr * 2654435761U) & (KMR_SLOTS - 1);
+	for (i=0; i<KMR_SLOTS; i++, h = (h + 1) & (KMR_SLOTS - 1)) {
+		switch (kmr_slots[h].ks_state) {
+		    case KMR_EMPTY:
+			if (!insert) {
+				return -1;
+			}
+			if (dead < 0) {
+				dead = h;
+			}
+			goto claim;
+		    case KMR_DEAD:
+			if (dead < 0) {
+				dead = h;
+			}
+			break;
+		    case KMR_FREEING:
+			/* still holds a block the timed pass will free */
+			break;
+		    case KMR_LIVE:
+			if (kmr_slots[h].ks_addr == addr) {
+				/* malloc of a live address: trace is torn */
+				return insert ? -1 : (int)h;
+			}
+			break;
+		}
+	}
+	if (!insert || dead < 0) {
+		return -1;
+	}
+ claim:
+	kmr_slots[dead].ks_addr = addr;
+	kmr_slots[dead].ks_state = KMR_LIVE;
+	kmr_slots[dead].ks_ptr = NULL;
+	return dead;
+}
+
+int
+kmreplay(int nargs, char **args)
+{
+	struct mtrace_rec *recs;
+	struct vnode *vn;
+	struct iovec iov;
+	struct uio ku;
+	time_t secs1, secs2, secs, tsecs = 0;
+	uint32_t nsecs1, nsecs2, nsecs, tnsecs = 0;
+	unsigned long us, live = 0, peak = 0;
+	unsigned ops = 0, skipped = 0, failed = 0, n, i;
+	off_t pos = 0;
+	int result, slot;
+
+	if (nargs != 2) {
+		kprintf("Usage: kmr tracefile\n");
+		return EINVAL;
+	}
+
+	recs = kmalloc(KMR_CHUNK * sizeof(*recs));
+	kmr_slots = kmalloc(KMR_SLOTS * sizeof(*kmr_slots));
+	if (recs == NULL || kmr_slots == NULL) {
+		kfree(recs);
+		kfree(kmr_slots);
+		return ENOMEM;
+	}
+	bzero(kmr_slots, KMR_SLOTS * sizeof(*kmr_slots));
+
+	/* vfs_open destroys the string it's passed */
+	result = vfs_open(args[1], O_RDONLY, 0, &vn);
+	if (result) {
+		kprintf("kmr: %s: %s\n", args[1], strerror(result));
+		goto out;
+	}
+
+	while (1) {
+		uio_kinit(&iov, &ku, recs, KMR_CHUNK * sizeof(*recs), pos,
+			  UIO_READ);
+		result = VOP_READ(vn, &ku);
+		if (result) {
+			kprintf("kmr: read: %s\n", strerror(result));
+			break;
+		}
+		n = (ku.uio_offset - pos) / sizeof(*recs);
+		pos = ku.uio_offset;
+		if (n == 0) {
+			break;
+		}
+
+		/* Resolve addresses to slots, untimed */
+		for (i=0; i<n; i++) {
+			slot = kmr_lookup(recs[i].mt_addr,
+					  recs[i].mt_op == MTRACE_MALLOC);
+			if (slot < 0 || (recs[i].mt_op != MTRACE_MALLOC &&
+					 recs[i].mt_op != MTRACE_FREE)) {
+				recs[i].mt_op = KMR_SKIP;
+				skipped++;
+				continue;
+			}
+			if (recs[i].mt_op == MTRACE_FREE) {
+				kmr_slots[slot].ks_state = KMR_FREEING;
+			}
+			recs[i].mt_addr = slot;
+		}
+
+		gettime(&secs1, &nsecs1);
+		for (i=0; i<n; i++) {
+			slot = recs[i].mt_addr;
+			switch (recs[i].mt_op) {
+			    case MTRACE_MALLOC:
+				kmr_slots[slot].ks_ptr =
+					kmalloc(recs[i].mt_size);
+				if (kmr_slots[slot].ks_ptr == NULL) {
+					failed++;
+					break;
+				}
+				kmr_slots[slot].ks_size = recs[i].mt_size;
+				live += recs[i].mt_size;
+				if (live > peak) {
+					peak = live;
+				}
+				break;
+			    case MTRACE_FREE:
+				if (kmr_slots[slot].ks_ptr != NULL) {
+					kfree(kmr_slots[slot].ks_ptr);
+					kmr_slots[slot].ks_ptr = NULL;
+					live -= kmr_slots[slot].ks_size;
+				}
+				break;
+			    default:
+				continue;
+			}
+			ops++;
+		}
+		gettime(&secs2, &nsecs2);
+
+		/* Only now can this chunk's freed slots be reused */
+		for (i=0; i<n; i++) {
+			if (recs[i].mt_op == MTRACE_FREE) {
+				kmr_slots[recs[i].mt_addr].ks_state = KMR_DEAD;
+			}
+		}
+
+		getinterval(secs1, nsecs1, secs2, nsecs2, &secs, &nsecs);
+		tsecs += secs;
+		tnsecs += nsecs;
+		if (tnsecs >= 1000000000) {
+			tnsecs -= 1000000000;
+			tsecs++;
+		}
+	}
+	vfs_close(vn);
+
+	/* microseconds fit in 32 bits for over an hour */
+	us = (unsigned long)tsecs * 1000000 + tnsecs / 1000;
+	kprintf("kmr ops=%u total_us=%lu ops_per_sec=%lu peak_live=%lu "
+		"failed=%u skipped=%u\n", ops, us,
+		(unsigned long)((uint64_t)ops * 1000000 / (us + 1)), peak,
+		failed, skipped);
+
+ out:
+	for (i=0; i<KMR_SLOTS; i++) {
+		if (kmr_slots[i].ks_state == KMR_LIVE &&
+		    kmr_slots[i].ks_ptr != NULL) {
+			kfree(kmr_slots[i].ks_ptr);
+		}
+	}
+	kfree(kmr_slots);
+	kmr_slots = NULL;
+	kfree(recs);
+	return result;
+}
@@ -0,0 +1,213 @@
+/*
+ * Wakeup latency, the kernel side of cyclictest.
+ *
+ * A thread sleeps on a wait channel; the menu thread notes the time
+ * and wakes it, and the sleeper notes how long it took to run again.
+ * HOGS kernel threads spin meanwhile, so the sleeper has to wait its
+ * turn for a CPU. Prints
+ *
+ *	lat wchan hogs=H loops=L min_ns=A avg_ns=B p99_ns=C max_ns=D
+ *
+ * then a histogram in power-of-two buckets, one "lat hist <Xus=N"
+ * line per nonempty bucket.
+ *
+ * Usage: lat [loops [hogs]]
+ */
+
+#include <types.h>
+#include <kern/errno.h>
+#include <lib.h>
+#include <clock.h>
+#include <thread.h>
+#include <synch.h>
+#include <wchan.h>
+#include <test.h>
+
+#define LAT_MAXLOOPS	10000
+#define LAT_MAXHOGS	16
+#define LAT_NBUCKETS	20	/* up to 2^19 us, then everything else */
+
+static struct wchan *lat_wchan;
+static struct semaphore *lat_done;
+static volatile bool lat_asleep;
+static volatile bool lat_stop;
+static volatile time_t lat_wakesecs;
+static volatile uint32_t lat_wakensecs;
+static uint32_t *lat_samples;		/* nanoseconds */
+
+static
+void
+lat_sleeper(void *junk, unsigned long loops)
+{
+	time_t secs;
+	uint32_t nsecs;
+	unsigned long i;
+
+	(void)junk;
+	for (i=0; i<loops; i++) {
+		wchan_lock(lat_wchan);
+		lat_asleep = true;
+		wchan_sleep(lat_wchan);
+		gettime(&secs, &nsecs);
+		getinterval(lat_wakesecs, lat_wakensecs, secs, nsecs,
+			    &secs, &nsecs);
+		/* anything over 4 seconds is off the scale anyway */
+		lat_samples[i] = secs > 3 ? 0xffffffff :
+			secs * 1000000000 + nsecs;
+	}
+	V(lat_done);
+}
+
+static
+void
+lat_hog(void *junk1, unsigned long junk2)
+{
+	(void)junk1;
+	(void)junk2;
+
+	while (!lat_stop) {
+		/* spin; hardclock will preempt us */
+	}
+	V(lat_done);
+}
+
+/*
+ * Shell sort; there can be a lot of samples.
+ */
+static
+void
+lat_sort(uint32_t *v, unsigned n)
+{
+	unsigned gap, i, j;
+	uint32_t t;
+
+	for (gap = n / 2; gap > 0; gap /= 2) {
+		for (i=gap; i<n; i++) {
+			t = v[i];
+			for (j=i; j>=gap && v[j-gap] > t; j-=gap) {
+				v[j] = v[j-gap];
+			}
+			v[j] = t;
+		}
+	}
+}
+
+static
+void
+lat_report(unsigned loops, unsigned nhogs)
+{
+	unsigned counts[LAT_NBUCKETS];
+	uint64_t sum = 0;
+	uint32_t us;
+	unsigned i, b;
+
+	lat_sort(lat_samples, loops);
+	for (i=0; i<loops; i++) {
+		sum += lat_samples[i];
+	}
+	kprintf("lat wchan hogs=%u loops=%u min_ns=%u avg_ns=%u p99_ns=%u "
+		"max_ns=%u\n", nhogs, loops, lat_samples[0],
+		(unsigned)(sum / loops),
+		lat_samples[(loops * 99) / 100], lat_samples[loops - 1]);
+
+	bzero(counts, sizeof(counts));
+	for (i=0; i<loops; i++) {
+		us = lat_samples[i] / 1000;
+		for (b=0; b<LAT_NBUCKETS-1 && us >= (1U << b); b++) {
+			/* nothing */
+		}
+		counts[b]++;
+	}
+	for (b=0; b<LAT_NBUCKETS; b++) {
+		if (counts[b] == 0) {
+			continue;
+		}
+		if (b < LAT_NBUCKETS-1) {
+			kprintf("lat hist <%uus=%u\n", 1U << b, counts[b]);
+		}
+		else {
+			kprintf("lat hist >=%uus=%u\n", 1U << (LAT_NBUCKETS-2),
+				counts[b]);
+		}
+	}
+}
+
+int
+lattest(int nargs, char **args)
+{
+	time_t secs;
+	uint32_t nsecs;
+	unsigned i, loops = 1000, nhogs = 0;
+	int result;
+
+	if (nargs > 3) {
+		kprintf("Usage: lat [loops [hogs]]\n");
+		return EINVAL;
+	}
+	if (nargs > 1) {
+		loops = atoi(args[1]);
+	}
+	if (nargs > 2) {
+		nhogs = atoi(args[2]);
+	}
+	if (loops < 1 || loops > LAT_MAXLOOPS || nhogs > LAT_MAXHOGS) {
+		kprintf("lat: loops must be 1-%u and hogs 0-%u\n",
+			LAT_MAXLOOPS, LAT_MAXHOGS);
+		return EINVAL;
+	}
+
+	if (lat_wchan == NULL) {
+		lat_wchan = wchan_create("lat_wchan");
+		lat_done = sem_create("lat_done", 0);
+		if (lat_wchan == NULL || lat_done == NULL) {
+			panic("lattest: out of memory\n");
+		}
+	}
+	lat_samples = kmalloc(loops * sizeof(*lat_samples));
+	if (lat_samples == NULL) {
+		return ENOMEM;
+	}
+
+	lat_stop = false;
+	for (i=0; i<nhogs; i++) {
+		result = thread_fork("lat_hog", lat_hog, NULL, 0, NULL);
+		if (result) {
+			panic("lattest: thread_fork failed: %s\n",
+			      strerror(result));
+		}
+	}
+
+	lat_asleep = false;
+	result = thread_fork("lat_sleeper", lat_sleeper, NULL, loops, NULL);
+	if (result) {
+		panic("lattest: thread_fork failed: %s\n", strerror(result));
+	}
+
+	for (i=0; i<loops; i++) {
+		for (;;) {
+			wchan_lock(lat_wchan);
+			if (lat_asleep) {
+				break;
+			}
+			wchan_unlock(lat_wchan);
+			thread_yield();
+		}
+		lat_asleep = false;
+		gettime(&secs, &nsecs);
+		lat_wakesecs = secs;
+		lat_wakensecs = nsecs;
+		wchan_unlock(lat_wchan);
+		wchan_wakeone(lat_wchan);
+	}
+	P(lat_done);
+
+	lat_stop = true;
+	for (i=0; i<nhogs; i++) {
+		P(lat_done);
+	}
+
+	lat_report(loops, nhogs);
+	kfree(lat_samples);
+	lat_samples = NULL;
+	return 0;
+}
@@ -0,0 +1,209 @@
+/*
+ * Region map test and benchmark.
+ *
+ * Builds a map the way a process that mmaps N small files would: N
+ * regions of RM_PAGES pages each, with a page of gap after each so
+ * they stay separate. Checks it, then times finding the region for
+ * fault addresses three ways:
+ *
+ *	list	scanning the regions in order, as for a fixed set of
+ *		regions in the address space
+ *	tree	regionmap_lookup at random addresses, no cache
+ *	cached	regionmap_lookup with a regioncache, walking every page
+ *		of the regions in order, as a process touching its
+ *		mappings would
+ *
+ * one line each:
+ *
+ *	bench rmap_WAY n=N ops=K total_us=T ns_per_op=X
+ *
+ * Finally it fills the gaps, which must merge everything into one
+ * region, and punches them out again.
+ *
+ * Usage: rmap [n]
+ */
+
+#include <types.h>
+#include <kern/errno.h>
+#include <lib.h>
+#include <clock.h>
+#include <vm.h>
+#include <regionmap.h>
+#include <test.h>
+
+#define RM_DEFAULTN	4096
+#define RM_MAXN		16384
+#define RM_PAGES	4
+#define RM_OPS		20000
+#define RM_BASE		0x10000000
+
+/* Where region I starts, and ends */
+#define RM_START(i)	(RM_BASE + (i) * (RM_PAGES + 1) * PAGE_SIZE)
+#define RM_END(i)	(RM_START(i) + RM_PAGES * PAGE_SIZE)
+
+static
+unsigned long
+rm_us(time_t secs1, uint32_t nsecs1)
+{
+	time_t secs2, secs;
+	uint32_t nsecs2, nsecs;
+
+	gettime(&secs2, &nsecs2);
+	getinterval(secs1, nsecs1, secs2, nsecs2, &secs, &nsecs);
+	return (unsigned long)secs * 1000000 + nsecs / 1000;
+}
+
+static
+void
+rm_report(const char *way, unsigned n, unsigned long us)
+{
+	kprintf("bench rmap_%s n=%u ops=%u total_us=%lu ns_per_op=%lu\n",
+		way, n, RM_OPS, us, us * 1000 / RM_OPS);
+}
+
+/*
+ * A random address in some region.
+ */
+static
+vaddr_t
+rm_randaddr(unsigned n)
+{
+	return RM_START(random() % n) + random() % (RM_PAGES * PAGE_SIZE);
+}
+
+static
+void
+rm_check(struct regionmap *rm, unsigned n)
+{
+	struct regioncache rc;
+	struct region *rg;
+	unsigned i;
+
+	KASSERT(regionmap_num(rm) == n);
+	regioncache_init(&rc);
+	for (i=0, rg = regionmap_first(rm); i<n; i++, rg = regionmap_next(rg)) {
+		KASSERT(rg->rg_start == RM_START(i));
+		KASSERT(rg->rg_end == RM_END(i));
+		KASSERT(regionmap_lookup(rm, RM_START(i), &rc) == rg);
+		KASSERT(regionmap_lookup(rm, RM_END(i) - 1, &rc) == rg);
+		KASSERT(regionmap_lookup(rm, RM_END(i), &rc) == NULL);
+	}
+	KASSERT(rg == NULL);
+	KASSERT(regionmap_lookup(rm, RM_BASE - 1, NULL) == NULL);
+}
+
+static
+void
+rm_bench(struct regionmap *rm, unsigned n)
+{
+	struct regioncache rc;
+	struct region **list, *rg;
+	time_t secs;
+	uint32_t nsecs;
+	vaddr_t addr;
+	unsigned i, j;
+
+	list = kmalloc(n * sizeof(*list));
+	if (list == NULL) {
+		kprintf("rmap: out of memory for the list\n");
+		return;
+	}
+	for (i=0, rg = regionmap_first(rm); i<n; i++, rg = regionmap_next(rg)) {
+		list[i] = rg;
+	}
+
+	gettime(&secs, &nsecs);
+	for (i=0; i<RM_OPS; i++) {
+		addr = rm_randaddr(n);
+		for (j=0; j<n; j++) {
+			if (addr >= list[j]->rg_start && addr < list[j]->rg_end) {
+				break;
+			}
+		}
+		KASSERT(j < n);
+	}
+	rm_report("list", n, rm_us(secs, nsecs));
+	kfree(list);
+
+	gettime(&secs, &nsecs);
+	for (i=0; i<RM_OPS; i++) {
+		rg = regionmap_lookup(rm, rm_randaddr(n), NULL);
+		KASSERT(rg != NULL);
+	}
+	rm_report("tree", n, rm_us(secs, nsecs));
+
+	regioncache_init(&rc);
+	gettime(&secs, &nsecs);
+	for (i=0; i<RM_OPS; i++) {
+		j = i / RM_PAGES % n;
+		addr = RM_START(j) + (i % RM_PAGES) * PAGE_SIZE;
+		rg = regionmap_lookup(rm, addr, &rc);
+		KASSERT(rg != NULL);
+	}
+	rm_report("cached", n, rm_us(secs, nsecs));
+}
+
+int
+regiontest(int nargs, char **args)
+{
+	struct regionmap rm;
+	unsigned i, n = RM_DEFAULTN;
+	int result;
+
+	if (nargs > 2) {
+		kprintf("Usage: rmap [n]\n");
+		return EINVAL;
+	}
+	if (nargs == 2) {
+		n = atoi(args[1]);
+	}
+	if (n < 1 || n > RM_MAXN) {
+		kprintf("rmap: n must be 1-%u\n", RM_MAXN);
+		return EINVAL;
+	}
+
+	kprintf("Starting region map test...\n");
+	regionmap_init(&rm);
+
+	/* Backwards, which would leave an unbalanced tree a list. */
+	for (i=n; i-- > 0; ) {
+		result = regionmap_add(&rm, RM_START(i), RM_END(i), VMR_READ);
+		if (result) {
+			goto fail;
+		}
+	}
+	rm_check(&rm, n);
+
+	/* overlaps are refused */
+	result = regionmap_add(&rm, RM_END(0) - PAGE_SIZE,
+			       RM_END(0) + PAGE_SIZE, VMR_READ);
+	KASSERT(result == EINVAL);
+	KASSERT(regionmap_num(&rm) == n);
+
+	rm_bench(&rm, n);
+
+	/* filling the gaps merges everything */
+	for (i=0; i+1<n; i++) {
+		result = regionmap_add(&rm, RM_END(i), RM_START(i+1),
+				       VMR_READ);
+		KASSERT(result == 0);
+	}
+	KASSERT(regionmap_num(&rm) == 1);
+	/* and punching them out again splits it */
+	for (i=0; i+1<n; i++) {
+		result = regionmap_remove(&rm, RM_END(i), RM_START(i+1));
+		if (result) {
+			goto fail;
+		}
+	}
+	rm_check(&rm, n);
+
+	regionmap_cleanup(&rm);
+	kprintf("Region map test done.\n");
+	return 0;
+
+ fail:
+	regionmap_cleanup(&rm);
+	kprintf("rmap: %s\n", strerror(result));
+	return result;
+}
@@ -0,0 +1,191 @@
+/*
+ * Ring buffer test and benchmark.
+ *
+ * Producer threads push ITEMS sequence-numbered words through a ring
+ * to the menu thread, which checks that each producer's words come
+ * out in order and none are lost. Done three ways:
+ *
+ *	locked	one producer, with both sides taking a spinlock, the
+ *		way drivers have done it
+ *	spsc	one producer, spscring
+ *	mpsc	RT_PRODUCERS producers, mpscring
+ *
+ * printing one line each:
+ *
+ *	bench ring_WAY producers=P items=N total_us=T ns_per_item=X
+ *
+ * Both sides yield when the ring is full or empty, so on one CPU the
+ * time is mostly context switches; it means more with several.
+ *
+ * Usage: ring [items]
+ */
+
+#include <types.h>
+#include <kern/errno.h>
+#include <lib.h>
+#include <clock.h>
+#include <spinlock.h>
+#include <thread.h>
+#include <synch.h>
+#include <ring.h>
+#include <test.h>
+
+#define RT_DEFAULTITEMS	100000
+#define RT_MAXITEMS	1000000
+#define RT_SLOTS	64
+#define RT_PRODUCERS	4
+
+#define RT_LOCKED	0
+#define RT_SPSC		1
+#define RT_MPSC		2
+
+static const char *const rt_names[] = { "locked", "spsc", "mpsc" };
+
+static int rt_way;
+static unsigned rt_items;		/* per producer */
+static struct spscring rt_spsc;
+static struct mpscring rt_mpsc;
+static struct spinlock rt_lock;
+static uint32_t rt_buf[RT_SLOTS];
+static struct semaphore *rt_done;
+
+static
+bool
+rt_put(uint32_t item)
+{
+	bool ret;
+
+	switch (rt_way) {
+	    case RT_LOCKED:
+		spinlock_acquire(&rt_lock);
+		ret = spscring_put(&rt_spsc, &item);
+		spinlock_release(&rt_lock);
+		return ret;
+	    case RT_SPSC:
+		return spscring_put(&rt_spsc, &item);
+	    default:
+		return mpscring_put(&rt_mpsc, &item);
+	}
+}
+
+static
+bool
+rt_get(uint32_t *item)
+{
+	bool ret;
+
+	switch (rt_way) {
+	    case RT_LOCKED:
+		spinlock_acquire(&rt_lock);
+		ret = spscring_get(&rt_spsc, item);
+		spinlock_release(&rt_lock);
+		return ret;
+	    case RT_SPSC:
+		return spscring_get(&rt_spsc, item);
+	    default:
+		return mpscring_get(&rt_mpsc, item);
+	}
+}
+
+/*
+ * Producer ID puts (ID << 24) | sequence number.
+ */
+static
+void
+rt_producer(void *junk, unsigned long id)
+{
+	unsigned i;
+
+	(void)junk;
+	for (i=0; i<rt_items; i++) {
+		while (!rt_put((id << 24) | i)) {
+			thread_yield();
+		}
+	}
+	V(rt_done);
+}
+
+static
+void
+rt_run(int way, unsigned nproducers)
+{
+	unsigned next[RT_PRODUCERS];
+	time_t secs1, secs2, secs;
+	uint32_t nsecs1, nsecs2, nsecs, item;
+	unsigned long us, id, total;
+	unsigned i;
+	int result;
+
+	rt_way = way;
+	spscring_init(&rt_spsc, rt_buf, RT_SLOTS, sizeof(rt_buf[0]));
+	mpscring_init(&rt_mpsc, rt_buf, RT_SLOTS, sizeof(rt_buf[0]));
+	for (i=0; i<nproducers; i++) {
+		next[i] = 0;
+	}
+	total = (unsigned long)rt_items * nproducers;
+
+	gettime(&secs1, &nsecs1);
+	for (id=0; id<nproducers; id++) {
+		result = thread_fork("rt_producer", rt_producer, NULL, id,
+				     NULL);
+		if (result) {
+			panic("ringtest: thread_fork failed: %s\n",
+			      strerror(result));
+		}
+	}
+	for (i=0; i<total; i++) {
+		while (!rt_get(&item)) {
+			thread_yield();
+		}
+		id = item >> 24;
+		KASSERT(id < nproducers);
+		KASSERT((item & 0xffffff) == next[id]);
+		next[id]++;
+	}
+	for (i=0; i<nproducers; i++) {
+		P(rt_done);
+	}
+	gettime(&secs2, &nsecs2);
+
+	KASSERT(!rt_get(&item));
+	mpscring_cleanup(&rt_mpsc);
+
+	getinterval(secs1, nsecs1, secs2, nsecs2, &secs, &nsecs);
+	us = (unsigned long)secs * 1000000 + nsecs / 1000;
+	kprintf("bench ring_%s producers=%u items=%lu total_us=%lu "
+		"ns_per_item=%lu\n", rt_names[way], nproducers, total, us,
+		/* us * 1000 / total, in 32 bits */
+		us / total * 1000 + us % total * 1000 / total);
+}
+
+int
+ringtest(int nargs, char **args)
+{
+	unsigned items = RT_DEFAULTITEMS;
+
+	if (nargs > 2) {
+		kprintf("Usage: ring [items]\n");
+		return EINVAL;
+	}
+	if (nargs == 2) {
+		items = atoi(args[1]);
+	}
+	if (items < 1 || items > RT_MAXITEMS) {
+		kprintf("ring: items must be 1-%u\n", RT_MAXITEMS);
+		return EINVAL;
+	}
+
+	if (rt_done == NULL) {
+		rt_done = sem_create("rt_done", 0);
+		if (rt_done == NULL) {
+			panic("ringtest: out of memory\n");
+		}
+		spinlock_init(&rt_lock);
+	}
+
+	rt_items = items;
+	rt_run(RT_LOCKED, 1);
+	rt_run(RT_SPSC, 1);
+	rt_run(RT_MPSC, RT_PRODUCERS);
+	return 0;
+}
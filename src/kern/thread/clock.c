@@ -34,6 +34,9 @@
 #include <clock.h>
 #include <thread.h>
 #include <current.h>
+#include <vdso.h>
+#include <prof.h>
+#include <hrtimer.h>
 
 /*
  * Time handling.
@@ -58,6 +61,12 @@
  */
 static struct wchan *lbolt;
 
+/*
+ * Everything in clock_nsleep sleeps here; each one's timer wakes them
+ * all to check whose it was.
+ */
+static struct wchan *nsleepchan;
+
 /*
  * Setup.
  */
@@ -68,6 +77,11 @@ hardclock_bootstrap(void)
 	if (lbolt == NULL) {
 		panic("Couldn't create lbolt\n");
 	}
+	nsleepchan = wchan_create("nsleep");
+	if (nsleepchan == NULL) {
+		panic("Couldn't create nsleepchan\n");
+	}
+	hrtimer_bootstrap();
 }
 
 /*
@@ -93,6 +107,12 @@ hardclock(void)
 	 */
 
 	curcpu->c_hardclocks++;
+	prof_hardclock();
+	if (curcpu->c_number == 0) {
+		/* one writer for the user-visible time page */
+		vdso_hardclock();
+		hrtimer_hardclock();
+	}
 	if ((curcpu->c_hardclocks % SCHEDULE_HARDCLOCKS) == 0) {
 		schedule();
 	}
@@ -114,3 +134,40 @@ clocksleep(int num_secs)
 		num_secs--;
 	}
 }
+
+/*
+ * Timer function for clock_nsleep. Once DONE is set the sleeper may
+ * return, so don't touch it after that.
+ */
+static
+void
+clock_nsleep_expire(void *vdone)
+{
+	bool *done = vdone;
+
+	*done = true;
+	wchan_wakeall(nsleepchan);
+}
+
+/*
+ * Suspend execution until SECS + NSECS from now.
+ */
+void
+clock_nsleep(time_t secs, uint32_t nsecs)
+{
+	struct hrtimer ht;
+	bool done = false;
+
+	hrtimer_init(&ht, clock_nsleep_expire, &done);
+	hrtimer_start(&ht, hrtimer_now() + (uint64_t)secs * HRT_NSEC + nsecs);
+
+	while (1) {
+		/* the timer sets DONE before taking the channel's lock */
+		wchan_lock(nsleepchan);
+		if (done) {
+			wchan_unlock(nsleepchan);
+			break;
+		}
+		wchan_sleep(nsleepchan);
+	}
+}
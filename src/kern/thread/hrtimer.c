@@ -0,0 +1,240 @@
+/*
+ * High-resolution timers. See <hrtimer.h>.
+ *
+ * The queue is a sorted list under one spinlock; there are only ever
+ * a handful of timers (one per sleeping thread, plus timerclock's), so
+ * it isn't worth a tree. The device's countdown is set whenever the
+ * head of the queue changes and after each run of expired timers.
+ * It is never set further out than HRT_MAXARM, so a lost interrupt or
+ * a clock step only delays things that long.
+ */
+
+#include <types.h>
+#include <lib.h>
+#include <spinlock.h>
+#include <clock.h>
+#include <softirq.h>
+#include <hrtimer.h>
+
+#define HRT_MAXARM	1000000		/* usec */
+
+static struct spinlock hrt_lock = SPINLOCK_INITIALIZER;
+static struct hrtimer *hrt_queue;	/* soonest first */
+static struct softirq hrt_softirq;
+
+/* The timer device, once there is one */
+static void *hrt_dev;
+static void (*hrt_arm)(void *dev, uint32_t usecs);
+static void (*hrt_gettime)(void *dev, time_t *secs, uint32_t *nsecs);
+
+/* Drives timerclock() once the device is attached */
+static struct hrtimer hrt_timerclock;
+
+uint64_t
+hrtimer_now(void)
+{
+	time_t secs;
+	uint32_t nsecs;
+
+	if (hrt_gettime != NULL) {
+		hrt_gettime(hrt_dev, &secs, &nsecs);
+	}
+	else {
+		gettime(&secs, &nsecs);
+	}
+	return (uint64_t)secs * HRT_NSEC + nsecs;
+}
+
+/*
+ * Set the device's countdown for the head of the queue. Call with
+ * the lock held.
+ */
+static
+void
+hrtimer_program(uint64_t now)
+{
+	uint64_t usecs;
+
+	KASSERT(spinlock_do_i_hold(&hrt_lock));
+
+	if (hrt_arm == NULL || hrt_queue == NULL) {
+		return;
+	}
+	if (hrt_queue->ht_when <= now) {
+		usecs = 1;
+	}
+	else {
+		/* round up, so we're never early */
+		usecs = (hrt_queue->ht_when - now + 999) / 1000;
+		if (usecs > HRT_MAXARM) {
+			usecs = HRT_MAXARM;
+		}
+	}
+	hrt_arm(hrt_dev, (uint32_t)usecs);
+}
+
+void
+hrtimer_init(struct hrtimer *ht, void (*func)(void *), void *data)
+{
+	ht->ht_when = 0;
+	ht->ht_func = func;
+	ht->ht_data = data;
+	ht->ht_next = NULL;
+	ht->ht_queued = false;
+}
+
+/*
+ * Take HT off the queue. Call with the lock held.
+ */
+static
+void
+hrtimer_dequeue(struct hrtimer *ht)
+{
+	struct hrtimer **pp;
+
+	for (pp = &hrt_queue; *pp != ht; pp = &(*pp)->ht_next) {
+		KASSERT(*pp != NULL);
+	}
+	*pp = ht->ht_next;
+	ht->ht_next = NULL;
+	ht->ht_queued = false;
+}
+
+void
+hrtimer_start(struct hrtimer *ht, uint64_t when)
+{
+	struct hrtimer **pp;
+	uint64_t now;
+
+	/* Read the clock first; it's several bus reads. */
+	now = hrtimer_now();
+
+	spinlock_acquire(&hrt_lock);
+	if (ht->ht_queued) {
+		hrtimer_dequeue(ht);
+	}
+	ht->ht_when = when;
+	/* after any others with the same deadline */
+	for (pp = &hrt_queue; *pp != NULL; pp = &(*pp)->ht_next) {
+		if ((*pp)->ht_when > when) {
+			break;
+		}
+	}
+	ht->ht_next = *pp;
+	*pp = ht;
+	ht->ht_queued = true;
+	if (hrt_queue == ht) {
+		hrtimer_program(now);
+	}
+	spinlock_release(&hrt_lock);
+}
+
+bool
+hrtimer_cancel(struct hrtimer *ht)
+{
+	bool wasqueued;
+
+	spinlock_acquire(&hrt_lock);
+	wasqueued = ht->ht_queued;
+	if (wasqueued) {
+		/* The countdown may now go off early; that's harmless. */
+		hrtimer_dequeue(ht);
+	}
+	spinlock_release(&hrt_lock);
+	return wasqueued;
+}
+
+/*
+ * Softirq: run whatever has expired, then set the countdown for what
+ * hasn't. Functions run without the lock, so they can start timers,
+ * their own included.
+ */
+static
+void
+hrtimer_expire(void *junk)
+{
+	struct hrtimer *ht;
+	void (*func)(void *);
+	void *data;
+	uint64_t now;
+
+	(void)junk;
+
+	now = hrtimer_now();
+	spinlock_acquire(&hrt_lock);
+	while (hrt_queue != NULL && hrt_queue->ht_when <= now) {
+		ht = hrt_queue;
+		func = ht->ht_func;
+		data = ht->ht_data;
+		hrtimer_dequeue(ht);
+		/* HT may be gone as soon as FUNC runs */
+		spinlock_release(&hrt_lock);
+		func(data);
+		spinlock_acquire(&hrt_lock);
+	}
+	spinlock_release(&hrt_lock);
+
+	now = hrtimer_now();
+	spinlock_acquire(&hrt_lock);
+	hrtimer_program(now);
+	spinlock_release(&hrt_lock);
+}
+
+void
+hrtimer_interrupt(void)
+{
+	softirq_raise(&hrt_softirq);
+}
+
+void
+hrtimer_hardclock(void)
+{
+	/* Peeking at the head unlocked is fine; we'll look again. */
+	if (hrt_arm == NULL && hrt_queue != NULL) {
+		softirq_raise(&hrt_softirq);
+	}
+}
+
+/*
+ * timerclock() used to be the device's once-a-second countdown; now
+ * it's a timer like any other.
+ */
+static
+void
+hrtimer_timerclock(void *junk)
+{
+	(void)junk;
+
+	timerclock();
+	hrtimer_start(&hrt_timerclock, hrt_timerclock.ht_when + HRT_NSEC);
+}
+
+void
+hrtimer_attach(void *dev, void (*arm)(void *dev, uint32_t usecs),
+	       void (*gettime)(void *dev, time_t *secs, uint32_t *nsecs))
+{
+	uint64_t now;
+
+	KASSERT(hrt_arm == NULL);
+
+	spinlock_acquire(&hrt_lock);
+	hrt_dev = dev;
+	hrt_arm = arm;
+	hrt_gettime = gettime;
+	spinlock_release(&hrt_lock);
+
+	now = hrtimer_now();
+	hrtimer_start(&hrt_timerclock, now + HRT_NSEC);
+
+	/* In case anything was waiting for us. */
+	spinlock_acquire(&hrt_lock);
+	hrtimer_program(now);
+	spinlock_release(&hrt_lock);
+}
+
+void
+hrtimer_bootstrap(void)
+{
+	softirq_init(&hrt_softirq, "hrtimer", hrtimer_expire, NULL);
+	hrtimer_init(&hrt_timerclock, hrtimer_timerclock, NULL);
+}
@@ -0,0 +1,314 @@
+/*
+ * Statistical sampling profiler. See <prof.h>.
+ *
+ * Each CPU writes only its own buffer, from hardclock with
+ * interrupts off, so taking a sample needs no locking. Buffers are
+ * allocated by prof_start and kept for the next run; prof_dump only
+ * runs once sampling is stopped.
+ */
+
+#include <types.h>
+#include <kern/errno.h>
+#include <lib.h>
+#include <cpu.h>
+#include <thread.h>
+#include <current.h>
+#include <ksyms.h>
+#include <prof.h>
+
+#define PROF_TOPN	20	/* lines printed per report */
+
+static volatile bool prof_running;
+
+void
+prof_hardclock(void)
+{
+	struct profbuf *pb;
+	struct profsample *ps;
+
+	if (!prof_running) {
+		return;
+	}
+	pb = curcpu->c_profbuf;
+	if (pb == NULL) {
+		return;
+	}
+	if (pb->pb_count == PROF_NSAMPLES) {
+		pb->pb_dropped++;
+		return;
+	}
+
+	ps = &pb->pb_samples[pb->pb_count++];
+	ps->ps_pc = curcpu->c_intrpc;
+	ps->ps_user = curcpu->c_intruser;
+	ps->ps_pid = curthread->t_pid;
+}
+
+int
+prof_start(void)
+{
+	struct cpu *c;
+	unsigned i;
+
+	if (prof_running) {
+		return EBUSY;
+	}
+
+	for (i=0; i<cpu_numcpus(); i++) {
+		c = cpu_getcpu(i);
+		if (c->c_profbuf == NULL) {
+			c->c_profbuf = kmalloc(sizeof(struct profbuf));
+			if (c->c_profbuf == NULL) {
+				return ENOMEM;
+			}
+		}
+		c->c_profbuf->pb_count = 0;
+		c->c_profbuf->pb_dropped = 0;
+	}
+
+	prof_running = true;
+	return 0;
+}
+
+void
+prof_stop(void)
+{
+	prof_running = false;
+}
+
+////////////////////////////////////////////////////////////
+// reporting
+
+/*
+ * Return the index of the function containing kernel address PC,
+ * or -1 if it is outside the table.
+ */
+static
+int
+ksym_find(vaddr_t pc)
+{
+	unsigned lo, hi, mid;
+
+	if (ksyms_count == 0 || pc < ksyms[0].ks_addr) {
+		return -1;
+	}
+
+	/* Find the last symbol at or below PC */
+	lo = 0;
+	hi = ksyms_count;
+	while (hi - lo > 1) {
+		mid = lo + (hi - lo) / 2;
+		if (ksyms[mid].ks_addr <= pc) {
+			lo = mid;
+		}
+		else {
+			hi = mid;
+		}
+	}
+	return lo;
+}
+
+/*
+ * Print the PROF_TOPN largest entries of COUNTS (destroying it),
+ * labelling entry I with NAME(I, ARG).
+ */
+static
+void
+prof_printtop(unsigned *counts, unsigned n, unsigned total,
+	      void (*name)(unsigned i, void *arg), void *arg)
+{
+	unsigned line, i, best;
+
+	for (line = 0; line < PROF_TOPN; line++) {
+		best = 0;
+		for (i=1; i<n; i++) {
+			if (counts[i] > counts[best]) {
+				best = i;
+			}
+		}
+		if (n == 0 || counts[best] == 0) {
+			break;
+		}
+		kprintf("    %6u %3u%%  ", counts[best],
+			counts[best] * 100 / total);
+		name(best, arg);
+		kprintf("\n");
+		counts[best] = 0;
+	}
+}
+
+static
+void
+prof_ksymname(unsigned i, void *arg)
+{
+	(void)arg;
+	if (i == ksyms_count) {
+		kprintf("(unknown)");
+	}
+	else {
+		kprintf("%s", ksyms[i].ks_name);
+	}
+}
+
+static
+void
+prof_pcname(unsigned i, void *arg)
+{
+	vaddr_t *pcs = arg;
+
+	kprintf("0x%08lx", (unsigned long)pcs[i]);
+}
+
+/*
+ * Visit every sample of the last run.
+ */
+#define FOREACH_SAMPLE(c, ci, ps, si)					\
+	for (ci = 0; ci < cpu_numcpus(); ci++)				\
+		if ((c = cpu_getcpu(ci))->c_profbuf != NULL)		\
+			for (si = 0;					\
+			     si < c->c_profbuf->pb_count &&		\
+			     (ps = &c->c_profbuf->pb_samples[si]);	\
+			     si++)
+
+/*
+ * Kernel functions, plus a per-process count of user samples.
+ */
+static
+int
+prof_dumpall(void)
+{
+	struct cpu *c;
+	struct profsample *ps;
+	unsigned ci, si, i, total = 0, kernel = 0, dropped = 0;
+	unsigned *counts;
+	pid_t pids[PROF_TOPN];
+	unsigned pidcounts[PROF_TOPN];
+	unsigned npids = 0, otherpids = 0;
+	int ix;
+
+	/* One slot per function, plus one for PCs we can't place */
+	counts = kmalloc((ksyms_count + 1) * sizeof(unsigned));
+	if (counts == NULL) {
+		return ENOMEM;
+	}
+	bzero(counts, (ksyms_count + 1) * sizeof(unsigned));
+
+	FOREACH_SAMPLE(c, ci, ps, si) {
+		total++;
+		if (!ps->ps_user) {
+			kernel++;
+			ix = ksym_find(ps->ps_pc);
+			counts[ix < 0 ? ksyms_count : (unsigned)ix]++;
+			continue;
+		}
+		for (i=0; i<npids; i++) {
+			if (pids[i] == ps->ps_pid) {
+				break;
+			}
+		}
+		if (i == npids) {
+			if (npids == PROF_TOPN) {
+				otherpids++;
+				continue;
+			}
+			pids[npids] = ps->ps_pid;
+			pidcounts[npids++] = 0;
+		}
+		pidcounts[i]++;
+	}
+	for (ci = 0; ci < cpu_numcpus(); ci++) {
+		c = cpu_getcpu(ci);
+		if (c->c_profbuf != NULL) {
+			dropped += c->c_profbuf->pb_dropped;
+		}
+	}
+
+	kprintf("%u samples (%u kernel, %u user), %u dropped\n",
+		total, kernel, total - kernel, dropped);
+	if (kernel > 0) {
+		kprintf("Kernel functions:\n");
+		prof_printtop(counts, ksyms_count + 1, kernel,
+			      prof_ksymname, NULL);
+	}
+	if (kernel < total) {
+		kprintf("User samples by process (prof dump PID for PCs):\n");
+		for (i=0; i<npids; i++) {
+			kprintf("    pid %5d: %6u\n", pids[i], pidcounts[i]);
+		}
+		if (otherpids > 0) {
+			kprintf("    others:    %6u\n", otherpids);
+		}
+	}
+
+	kfree(counts);
+	return 0;
+}
+
+/*
+ * The most frequent user PCs of one process.
+ */
+static
+int
+prof_dumppid(pid_t pid)
+{
+	struct cpu *c;
+	struct profsample *ps;
+	unsigned ci, si, i, n = 0, total = 0, max = 0;
+	vaddr_t *pcs;
+	unsigned *counts;
+
+	FOREACH_SAMPLE(c, ci, ps, si) {
+		max++;
+	}
+	if (max == 0) {
+		kprintf("No samples\n");
+		return 0;
+	}
+
+	pcs = kmalloc(max * sizeof(vaddr_t));
+	counts = kmalloc(max * sizeof(unsigned));
+	if (pcs == NULL || counts == NULL) {
+		kfree(pcs);
+		kfree(counts);
+		return ENOMEM;
+	}
+
+	FOREACH_SAMPLE(c, ci, ps, si) {
+		if (!ps->ps_user || ps->ps_pid != pid) {
+			continue;
+		}
+		total++;
+		for (i=0; i<n; i++) {
+			if (pcs[i] == ps->ps_pc) {
+				break;
+			}
+		}
+		if (i == n) {
+			pcs[n] = ps->ps_pc;
+			counts[n++] = 0;
+		}
+		counts[i]++;
+	}
+
+	kprintf("pid %d: %u user samples at %u distinct PCs\n", pid, total, n);
+	if (total > 0) {
+		prof_printtop(counts, n, total, prof_pcname, pcs);
+	}
+
+	kfree(pcs);
+	kfree(counts);
+	return 0;
+}
+
+int
+prof_dump(pid_t pid)
+{
+	if (prof_running) {
+		kprintf("prof: stop the profiler first\n");
+		return EBUSY;
+	}
+	if (pid >= 0) {
+		return prof_dumppid(pid);
+	}
+	return prof_dumpall();
+}
@@ -0,0 +1,221 @@
+/*
+ * Measurement regions. See <region.h>.
+ *
+ * Each CPU keeps its own table and updates it with interrupts off,
+ * as with the trace rings, so ending a region takes no locks. The
+ * report adds the tables up. Tables are allocated the first time
+ * regions are switched on and kept after that.
+ */
+
+#include <types.h>
+#include <kern/errno.h>
+#include <lib.h>
+#include <spl.h>
+#include <cpu.h>
+#include <current.h>
+#include <mainbus.h>
+#include <lamebus/ltrace.h>
+#include <region.h>
+
+volatile bool region_enabled;
+
+static const char *const regionnames[RG_COUNT] = {
+	[RG_THREAD_SWITCH] = "thread_switch",
+	[RG_FORK] =          "fork",
+	[RG_EXECV] =         "execv",
+	[RG_VM_FAULT] =      "vm_fault",
+	[RG_SOFTIRQ] =       "softirq",
+};
+
+/* trace161 flag per region, or 0 */
+static char regionflags[RG_COUNT];
+
+uint64_t
+region_begin(unsigned rg)
+{
+	uint64_t start;
+	int spl;
+
+	KASSERT(rg < RG_COUNT);
+
+	if (regionflags[rg] != 0) {
+		ltrace_on(regionflags[rg]);
+	}
+	/* read the clock and the cpu it belongs to together */
+	spl = splhigh();
+	start = (mainbus_cycles() & RG_CYCLEMASK) |
+		((uint64_t)curcpu->c_number << RG_CPUSHIFT);
+	splx(spl);
+	return start;
+}
+
+void
+region_end(unsigned rg, uint64_t start)
+{
+	struct regionstat *rs;
+	uint64_t now, cycles;
+	int spl;
+
+	spl = splhigh();
+	now = mainbus_cycles() & RG_CYCLEMASK;
+	if (curcpu->c_regions != NULL &&
+	    start >> RG_CPUSHIFT == curcpu->c_number &&
+	    now >= (start & RG_CYCLEMASK)) {
+		cycles = now - (start & RG_CYCLEMASK);
+		rs = &curcpu->c_regions[rg];
+		if (rs->rs_count == 0 || cycles < rs->rs_min) {
+			rs->rs_min = cycles;
+		}
+		if (cycles > rs->rs_max) {
+			rs->rs_max = cycles;
+		}
+		rs->rs_total += cycles;
+		rs->rs_count++;
+	}
+	splx(spl);
+
+	if (regionflags[rg] != 0) {
+		ltrace_off(regionflags[rg]);
+	}
+}
+
+////////////////////////////////////////////////////////////
+// control
+
+int
+region_lookup(const char *name)
+{
+	int i;
+
+	for (i=0; i<RG_COUNT; i++) {
+		if (!strcmp(name, regionnames[i])) {
+			return i;
+		}
+	}
+	return -1;
+}
+
+int
+region_enable(void)
+{
+	struct cpu *c;
+	unsigned i;
+
+	for (i=0; i<cpu_numcpus(); i++) {
+		c = cpu_getcpu(i);
+		if (c->c_regions == NULL) {
+			c->c_regions = kmalloc(RG_COUNT *
+					       sizeof(struct regionstat));
+			if (c->c_regions == NULL) {
+				return ENOMEM;
+			}
+			bzero(c->c_regions,
+			      RG_COUNT * sizeof(struct regionstat));
+		}
+	}
+	region_enabled = true;
+	return 0;
+}
+
+void
+region_disable(void)
+{
+	region_enabled = false;
+}
+
+void
+region_setltrace(unsigned rg, char flag)
+{
+	KASSERT(rg < RG_COUNT);
+	regionflags[rg] = flag;
+}
+
+void
+region_reset(void)
+{
+	struct cpu *c;
+	unsigned i;
+	int spl;
+
+	for (i=0; i<cpu_numcpus(); i++) {
+		c = cpu_getcpu(i);
+		if (c->c_regions != NULL) {
+			spl = splhigh();
+			bzero(c->c_regions,
+			      RG_COUNT * sizeof(struct regionstat));
+			splx(spl);
+		}
+	}
+}
+
+////////////////////////////////////////////////////////////
+// reporting
+
+/*
+ * Print a cycle count, which is almost always under 2^32.
+ */
+static
+void
+region_printcycles(uint64_t cycles)
+{
+	if (cycles > 0xffffffff) {
+		kprintf(" %12s", ">4G");
+	}
+	else {
+		kprintf(" %12u", (uint32_t)cycles);
+	}
+}
+
+void
+region_report(void)
+{
+	struct regionstat sum, *rs;
+	struct cpu *c;
+	unsigned i, rg;
+	uint64_t mean;
+	uint32_t mhz;
+
+	mhz = mainbus_cyclefreq() / 1000000;
+	kprintf("Regions %s; cycles at %u MHz\n",
+		region_enabled ? "on" : "off", mhz);
+	kprintf("%-16s %8s %12s %12s %12s %12s  %s\n", "region", "count",
+		"min", "max", "mean", "mean(us)", "ltrace");
+
+	for (rg=0; rg<RG_COUNT; rg++) {
+		bzero(&sum, sizeof(sum));
+		for (i=0; i<cpu_numcpus(); i++) {
+			c = cpu_getcpu(i);
+			if (c->c_regions == NULL) {
+				continue;
+			}
+			rs = &c->c_regions[rg];
+			if (rs->rs_count == 0) {
+				continue;
+			}
+			if (sum.rs_count == 0 || rs->rs_min < sum.rs_min) {
+				sum.rs_min = rs->rs_min;
+			}
+			if (rs->rs_max > sum.rs_max) {
+				sum.rs_max = rs->rs_max;
+			}
+			sum.rs_total += rs->rs_total;
+			sum.rs_count += rs->rs_count;
+		}
+
+		kprintf("%-16s %8u", regionnames[rg], sum.rs_count);
+		if (sum.rs_count == 0) {
+			kprintf(" %12s %12s %12s %12s", "-", "-", "-", "-");
+		}
+		else {
+			region_printcycles(sum.rs_min);
+			region_printcycles(sum.rs_max);
+			mean = sum.rs_total / sum.rs_count;
+			region_printcycles(mean);
+			region_printcycles(mean / mhz);
+		}
+		if (regionflags[rg] != 0) {
+			kprintf("  %c", regionflags[rg]);
+		}
+		kprintf("\n");
+	}
+}
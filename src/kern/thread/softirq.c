@@ -0,0 +1,146 @@
+/*
+ * Softirqs. See <softirq.h>.
+ *
+ * Each CPU has a FIFO of raised softirqs, c_softirqs to
+ * c_softirqtail, that only that CPU touches, with interrupts off.
+ * Whichever CPU a softirq is queued on runs it; so it mostly runs on
+ * the CPU that took the interrupt, with that CPU's caches warm.
+ */
+
+#include <types.h>
+#include <lib.h>
+#include <spl.h>
+#include <cpu.h>
+#include <thread.h>
+#include <current.h>
+#include <region.h>
+#include <softirq.h>
+
+void
+softirq_init(struct softirq *si, const char *name,
+	     void (*func)(void *), void *data)
+{
+	si->si_name = name;
+	si->si_func = func;
+	si->si_data = data;
+	spinlock_init(&si->si_lock);
+	si->si_state = SI_IDLE;
+	si->si_next = NULL;
+}
+
+void
+softirq_cleanup(struct softirq *si)
+{
+	KASSERT(si->si_state == SI_IDLE);
+	spinlock_cleanup(&si->si_lock);
+}
+
+/*
+ * Put SI on the end of this cpu's queue. Interrupts must be off.
+ */
+static
+void
+softirq_enqueue(struct softirq *si)
+{
+	struct cpu *c = curcpu->c_self;
+
+	si->si_next = NULL;
+	if (c->c_softirqtail == NULL) {
+		c->c_softirqs = si;
+	}
+	else {
+		c->c_softirqtail->si_next = si;
+	}
+	c->c_softirqtail = si;
+}
+
+void
+softirq_raise(struct softirq *si)
+{
+	spinlock_acquire(&si->si_lock);
+	switch (si->si_state) {
+	    case SI_IDLE:
+		si->si_state = SI_QUEUED;
+		softirq_enqueue(si);
+		break;
+	    case SI_RUNNING:
+		si->si_state = SI_AGAIN;
+		break;
+	    default:
+		break;
+	}
+	spinlock_release(&si->si_lock);
+
+	if (!curthread->t_in_interrupt && curthread->t_curspl == 0) {
+		softirq_run();
+	}
+}
+
+void
+softirq_run(void)
+{
+	struct softirq *si;
+	struct cpu *c;
+	uint64_t start;
+	int spl;
+
+	spl = splhigh();
+	while (1) {
+		/*
+		 * Look up curcpu every time; being preempted while
+		 * running a function can move us to another cpu.
+		 */
+		c = curcpu->c_self;
+		si = c->c_softirqs;
+		if (si == NULL) {
+			break;
+		}
+		c->c_softirqs = si->si_next;
+		if (c->c_softirqs == NULL) {
+			c->c_softirqtail = NULL;
+		}
+
+		spinlock_acquire(&si->si_lock);
+		KASSERT(si->si_state == SI_QUEUED);
+		si->si_state = SI_RUNNING;
+		spinlock_release(&si->si_lock);
+
+		splx(spl);
+		start = REGION_BEGIN(RG_SOFTIRQ);
+		si->si_func(si->si_data);
+		REGION_END(RG_SOFTIRQ, start);
+		splhigh();
+
+		spinlock_acquire(&si->si_lock);
+		if (si->si_state == SI_AGAIN) {
+			si->si_state = SI_QUEUED;
+			softirq_enqueue(si);
+		}
+		else {
+			si->si_state = SI_IDLE;
+		}
+		spinlock_release(&si->si_lock);
+	}
+	splx(spl);
+}
+
+void
+softirq_dispatch(void)
+{
+	KASSERT(curthread->t_curspl == 0);
+
+	/*
+	 * A nested interrupt comes back here; leave the queue to the
+	 * outer one instead of piling up stack. This is per-thread:
+	 * other threads on this cpu, including after we get moved
+	 * off it, can still run the queue.
+	 */
+	if (curcpu->c_softirqs == NULL || curthread->t_in_softirq) {
+		return;
+	}
+	curthread->t_in_softirq = true;
+	cpu_irqon();
+	softirq_run();
+	cpu_irqoff();
+	curthread->t_in_softirq = false;
+}
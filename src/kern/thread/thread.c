@@ -50,6 +50,13 @@
 #include <kern/sysexits.h>
 #include <kern/wait.h> /* New include of macros to make exit codes for ASST1 */
 #include <pid.h> /* New include of pid functions for ASST 1 */
+#include <file.h>
+#include <ioring.h>
+#include <vdso.h>
+#include <trace.h>
+#include <region.h>
+#include <softirq.h>
+#include <threadinfo.h>
 #include "opt-synchprobs.h"
 
 
@@ -71,6 +78,16 @@ static struct cpuarray allcpus;
 /* Used to wait for secondary CPUs to come online. */
 static struct semaphore *cpu_startup_sem;
 
+/*
+ * Every thread, from thread_create to thread_destroy, for listings.
+ * This lock is taken by nothing else, so listing threads doesn't stall
+ * the scheduler.
+ */
+static struct spinlock allthreads_lock = SPINLOCK_INITIALIZER;
+static struct thread *allthreads;
+static unsigned nallthreads;
+static unsigned nextthreadid;
+
 ////////////////////////////////////////////////////////////
 
 /*
@@ -141,23 +158,44 @@ thread_create(const char *name)
 	thread->t_stack = NULL;
 	thread->t_context = NULL;
 	thread->t_cpu = NULL;
+	thread->t_runcycles = 0;
+	thread->t_runstart = 0;
+	thread->t_nswitches = 0;
 
 	/* Interrupt state fields */
 	thread->t_in_interrupt = false;
+	thread->t_in_softirq = false;
 	thread->t_curspl = IPL_HIGH;
 	thread->t_iplhigh_count = 1; /* corresponding to t_curspl */
 
 	/* Process ID  - New for ASST 2 */
 	thread->t_pid = INVALID_PID;
+	thread->t_procpid = INVALID_PID;
 
 	/* VM fields */
 	thread->t_addrspace = NULL;
+	thread->t_ustack = -1;
+	regioncache_init(&thread->t_regioncache);
 
 	/* VFS fields */
 	thread->t_cwd = NULL;
+	thread->t_filetable = NULL;
+	thread->t_ioring = NULL;
 
 	/* If you add to struct thread, be sure to initialize here */
 
+	/* Now everything's set, let listings see it. */
+	spinlock_acquire(&allthreads_lock);
+	thread->t_id = nextthreadid++;
+	thread->t_allprev = NULL;
+	thread->t_allnext = allthreads;
+	if (allthreads != NULL) {
+		allthreads->t_allprev = thread;
+	}
+	allthreads = thread;
+	nallthreads++;
+	spinlock_release(&allthreads_lock);
+
 	return thread;
 }
 
@@ -187,6 +225,15 @@ cpu_create(unsigned hardware_number)
 	c->c_curthread = NULL;
 	threadlist_init(&c->c_zombies);
 	c->c_hardclocks = 0;
+	c->c_intrpc = 0;
+	c->c_intruser = false;
+	c->c_profbuf = NULL;
+	c->c_tracering = NULL;
+	c->c_regions = NULL;
+	c->c_switchstart = 0;
+	bzero(&c->c_vmstat, sizeof(c->c_vmstat));
+	c->c_softirqs = NULL;
+	c->c_softirqtail = NULL;
 
 	c->c_isidle = false;
 	threadlist_init(&c->c_runqueue);
@@ -218,6 +265,7 @@ cpu_create(unsigned hardware_number)
 
 		/* Also, set the initial process ID - New for ASST1. */
 		c->c_curthread->t_pid = BOOTUP_PID;
+		c->c_curthread->t_procpid = BOOTUP_PID;
 	}
 	else {
 		c->c_curthread->t_stack = kmalloc(STACK_SIZE);
@@ -231,6 +279,7 @@ cpu_create(unsigned hardware_number)
 		if (result) {
 			panic("cpu_create: pid_alloc failed\n");
 		}
+		c->c_curthread->t_procpid = c->c_curthread->t_pid;
 
 	}
 	c->c_curthread->t_cpu = c;
@@ -240,6 +289,19 @@ cpu_create(unsigned hardware_number)
 	return c;
 }
 
+unsigned
+cpu_numcpus(void)
+{
+	return cpuarray_num(&allcpus);
+}
+
+struct cpu *
+cpu_getcpu(unsigned n)
+{
+	KASSERT(n < cpuarray_num(&allcpus));
+	return cpuarray_get(&allcpus, n);
+}
+
 /*
  * Destroy a thread.
  *
@@ -260,8 +322,24 @@ thread_destroy(struct thread *thread)
 	 * either here or in thread_exit(). (And not both...)
 	 */
 
+	/* Registry */
+	spinlock_acquire(&allthreads_lock);
+	if (thread->t_allprev != NULL) {
+		thread->t_allprev->t_allnext = thread->t_allnext;
+	}
+	else {
+		allthreads = thread->t_allnext;
+	}
+	if (thread->t_allnext != NULL) {
+		thread->t_allnext->t_allprev = thread->t_allprev;
+	}
+	nallthreads--;
+	spinlock_release(&allthreads_lock);
+
 	/* VFS fields, cleaned up in thread_exit */
 	KASSERT(thread->t_cwd == NULL);
+	KASSERT(thread->t_filetable == NULL);
+	KASSERT(thread->t_ioring == NULL);
 
 	/* VM fields, cleaned up in thread_exit */
 	KASSERT(thread->t_addrspace == NULL);
@@ -495,11 +573,12 @@ thread_make_runnable(struct thread *target, bool already_have_lock)
  * we are giving the new thread a copy of its parent's address space, if
  * it has one, contrary to the comment above.
  */
+static
 int
-thread_fork(const char *name,
-	    void (*entrypoint)(void *data1, unsigned long data2),
-	    void *data1, unsigned long data2,
-	    pid_t *ret)
+thread_fork_common(const char *name,
+		   void (*entrypoint)(void *data1, unsigned long data2),
+		   void *data1, unsigned long data2,
+		   pid_t *ret, bool share)
 {
 	struct thread *newthread;
 	int result;
@@ -523,15 +602,54 @@ thread_fork(const char *name,
 		thread_destroy(newthread);
 		return result;
 	}
+	/* A thread sharing our address space is part of our process */
+	newthread->t_procpid = share ? curthread->t_procpid : newthread->t_pid;
 
 	/* Copy address space if there is one - new for ASST1, sys_fork */
-	if (curthread->t_addrspace != NULL) {
+	if (share) {
+		if (curthread->t_addrspace != NULL) {
+			as_incref(curthread->t_addrspace);
+			newthread->t_addrspace = curthread->t_addrspace;
+		}
+		if (curthread->t_filetable != NULL) {
+			filetable_incref(curthread->t_filetable);
+			newthread->t_filetable = curthread->t_filetable;
+		}
+	}
+	else if (curthread->t_addrspace != NULL) {
 		result = as_copy(curthread->t_addrspace, &newthread->t_addrspace);
 		if (result) {
  			pid_unalloc(newthread->t_pid); 
 			thread_destroy(newthread);
  			return -ENOMEM;
 		}
+		/* as_copy copied our user stack slot, if we have one */
+		newthread->t_ustack = curthread->t_ustack;
+		/* Shared pages aren't copied; the child needs its own pid page */
+		result = vdso_map(newthread->t_addrspace, newthread->t_pid);
+		if (result) {
+			as_destroy(newthread->t_addrspace);
+			newthread->t_addrspace = NULL;
+			pid_unalloc(newthread->t_pid);
+			thread_destroy(newthread);
+			return result;
+		}
+	}
+
+	/* Likewise the file table */
+	if (!share && curthread->t_filetable != NULL) {
+		result = filetable_copy(curthread->t_filetable,
+					&newthread->t_filetable);
+		if (result) {
+			if (newthread->t_addrspace != NULL) {
+				vdso_unmap(newthread->t_addrspace);
+				as_destroy(newthread->t_addrspace);
+				newthread->t_addrspace = NULL;
+			}
+			pid_unalloc(newthread->t_pid);
+			thread_destroy(newthread);
+			return result;
+		}
 	}
 	
 	/*
@@ -584,6 +702,29 @@ thread_fork(const char *name,
 	return 0;
 }
 
+int
+thread_fork(const char *name,
+	    void (*entrypoint)(void *data1, unsigned long data2),
+	    void *data1, unsigned long data2,
+	    pid_t *ret)
+{
+	return thread_fork_common(name, entrypoint, data1, data2, ret, false);
+}
+
+/*
+ * Fork a thread that shares the caller's address space and file
+ * table. Used for kernel helper threads that act on behalf of a user
+ * process (e.g. the ioring SQPOLL thread).
+ */
+int
+thread_fork_shared(const char *name,
+		   void (*entrypoint)(void *data1, unsigned long data2),
+		   void *data1, unsigned long data2,
+		   pid_t *ret)
+{
+	return thread_fork_common(name, entrypoint, data1, data2, ret, true);
+}
+
 /*
  * High level, machine-independent context switch code.
  *
@@ -630,6 +771,10 @@ thread_switch(threadstate_t newstate, struct wchan *wc)
 		return;
 	}
 
+	/* Charge the time so far to cur, before any idling. */
+	cur->t_runcycles += mainbus_cycles() - cur->t_runstart;
+	cur->t_nswitches++;
+
 	/* Put the thread in the right place. */
 	switch (newstate) {
 	    case S_RUN:
@@ -686,10 +831,16 @@ thread_switch(threadstate_t newstate, struct wchan *wc)
 		if (next == NULL) {
 			spinlock_release(&curcpu->c_runqueue_lock);
 			cpu_idle();
+			/* Finish what the interrupt that woke us raised */
+			softirq_run();
 			spinlock_acquire(&curcpu->c_runqueue_lock);
 		}
 	} while (next == NULL);
 	curcpu->c_isidle = false;
+	next->t_runstart = mainbus_cycles();
+
+	TRACE(TP_THREAD_SWITCH, newstate, next->t_pid, 0, 0);
+	curcpu->c_switchstart = REGION_BEGIN(RG_THREAD_SWITCH);
 
 	/*
 	 * Note that curcpu->c_curthread may be the same variable as
@@ -763,6 +914,10 @@ thread_switch(threadstate_t newstate, struct wchan *wc)
 		as_activate(cur->t_addrspace);
 	}
 
+	/* The switch that started in the previous thread ends here. */
+	REGION_END(RG_THREAD_SWITCH, curcpu->c_switchstart);
+	curcpu->c_switchstart = 0;
+
 	/* Clean up dead threads. */
 	exorcise();
 
@@ -798,6 +953,10 @@ thread_startup(void (*entrypoint)(void *data1, unsigned long data2),
 		as_activate(cur->t_addrspace);
 	}
 
+	/* The switch that started in the previous thread ends here. */
+	REGION_END(RG_THREAD_SWITCH, curcpu->c_switchstart);
+	curcpu->c_switchstart = 0;
+
 	/* Clean up dead threads. */
 	exorcise();
 
@@ -846,7 +1005,17 @@ thread_exit(int exitcode)
 
 	pid_exit(exitcode, dodetach);
 
+	/* Shut down any ioring first; its SQPOLL thread uses our state */
+	if (cur->t_ioring) {
+		ioring_destroy(cur->t_ioring);
+		cur->t_ioring = NULL;
+	}
+
 	/* VFS fields */
+	if (cur->t_filetable) {
+		filetable_decref(cur->t_filetable);
+		cur->t_filetable = NULL;
+	}
 	if (cur->t_cwd) {
 		VOP_DECREF(cur->t_cwd);
 		cur->t_cwd = NULL;
@@ -864,7 +1033,15 @@ thread_exit(int exitcode)
 		struct addrspace *as = cur->t_addrspace;
 		cur->t_addrspace = NULL;
 		as_activate(NULL);
-		as_destroy(as);
+		if (cur->t_ustack >= 0) {
+			as_release_thread_stack(as, cur->t_ustack);
+			cur->t_ustack = -1;
+		}
+		/* Other threads may still be using it */
+		if (as_decref(as) == 0) {
+			vdso_unmap(as);
+			as_destroy(as);
+		}
 	}
 
 	/* Check the stack guard band. */
@@ -1027,6 +1204,97 @@ thread_consider_migration(void)
 
 ////////////////////////////////////////////////////////////
 
+/*
+ * Thread listing. See threadinfo.h.
+ */
+
+/*
+ * Copy a name, truncating it and always terminating it. NAME may be
+ * NULL. The wchan name of a thread on another cpu may change under us,
+ * so read each byte only once.
+ */
+static
+void
+threadinfo_copyname(char *buf, const char *name)
+{
+	unsigned i;
+	char ch;
+
+	i = 0;
+	if (name != NULL) {
+		for (; i<THREADINFO_NAMELEN - 1; i++) {
+			ch = ((volatile const char *)name)[i];
+			if (ch == 0) {
+				break;
+			}
+			buf[i] = ch;
+		}
+	}
+	buf[i] = 0;
+}
+
+unsigned
+threadinfo_get(struct threadinfo *ti, unsigned max)
+{
+	struct thread *t;
+	uint64_t now;
+	uint32_t khz;
+	unsigned i, total;
+
+	spinlock_acquire(&allthreads_lock);
+	now = mainbus_cycles();
+	total = nallthreads;
+	for (i=0, t = allthreads; i<max && t != NULL; i++, t = t->t_allnext) {
+		ti[i].ti_id = t->t_id;
+		ti[i].ti_pid = t->t_pid;
+		switch (t->t_state) {
+		    case S_RUN:
+			ti[i].ti_state = TI_RUN;
+			break;
+		    case S_READY:
+			ti[i].ti_state = TI_READY;
+			break;
+		    case S_SLEEP:
+			ti[i].ti_state = TI_SLEEP;
+			break;
+		    default:
+			ti[i].ti_state = TI_ZOMBIE;
+			break;
+		}
+		ti[i].ti_cpu = t->t_cpu != NULL ? (int)t->t_cpu->c_number : -1;
+		ti[i].ti_switches = t->t_nswitches;
+		ti[i].ti_pad = 0;
+		/* cycles for now; converted below, outside the lock */
+		ti[i].ti_runms = t->t_runcycles;
+		/*
+		 * Count the run it's in the middle of, but only on this
+		 * CPU: t_runstart on another CPU is from that CPU's
+		 * cycle counter, which isn't comparable with NOW.
+		 * (Holding the spinlock keeps us from migrating.)
+		 */
+		if (t->t_state == S_RUN && t->t_cpu == curcpu->c_self &&
+		    t->t_runstart != 0 && now > t->t_runstart) {
+			ti[i].ti_runms += now - t->t_runstart;
+		}
+		threadinfo_copyname(ti[i].ti_name, t->t_name);
+		threadinfo_copyname(ti[i].ti_wchan,
+				    t->t_state == S_SLEEP ?
+				    t->t_wchan_name : NULL);
+	}
+	spinlock_release(&allthreads_lock);
+
+	khz = mainbus_cyclefreq() / 1000;
+	if (khz == 0) {
+		khz = 1;
+	}
+	while (i-- > 0) {
+		ti[i].ti_runms /= khz;
+	}
+	return total;
+}
+
+////////////////////////////////////////////////////////////
+
 /*
  * Wait channel functions
  */
@@ -1093,6 +1361,7 @@ wchan_sleep(struct wchan *wc)
 	/* may not sleep in an interrupt handler */
 	KASSERT(!curthread->t_in_interrupt);
 
+	TRACE(TP_WCHAN_SLEEP, wc, 0, 0, 0);
 	thread_switch(S_SLEEP, wc);
 }
 
@@ -1208,6 +1477,20 @@ ipi_broadcast(int code)
 	}
 }
 
+void
+ipi_tlbshootdown_broadcast(const struct tlbshootdown *mapping)
+{
+	unsigned i;
+	struct cpu *c;
+
+	for (i=0; i < cpuarray_num(&allcpus); i++) {
+		c = cpuarray_get(&allcpus, i);
+		if (c != curcpu->c_self) {
+			ipi_tlbshootdown(c, mapping);
+		}
+	}
+}
+
 void
 ipi_tlbshootdown(struct cpu *target, const struct tlbshootdown *mapping)
 {
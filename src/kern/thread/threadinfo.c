@@ -0,0 +1,180 @@
+/*
+ * The ps and top menu commands. See threadinfo.h.
+ */
+
+#include <types.h>
+#include <kern/errno.h>
+#include <lib.h>
+#include <clock.h>
+#include <threadinfo.h>
+
+#define TOP_LINES	20
+
+static const char *const ti_statenames[] = { "run", "ready", "sleep", "zombie" };
+
+/*
+ * Take a snapshot of every thread into a fresh array. Threads can be
+ * created between counting and copying, so allow some slack and retry
+ * if it wasn't enough.
+ */
+static
+struct threadinfo *
+ti_snapshot(unsigned *ret)
+{
+	struct threadinfo *ti;
+	unsigned max, total;
+
+	max = threadinfo_get(NULL, 0);
+	while (1) {
+		max += 8;
+		ti = kmalloc(max * sizeof(*ti));
+		if (ti == NULL) {
+			return NULL;
+		}
+		total = threadinfo_get(ti, max);
+		if (total <= max) {
+			*ret = total;
+			return ti;
+		}
+		kfree(ti);
+		max = total;
+	}
+}
+
+static
+void
+ti_header(void)
+{
+	kprintf("    ID   PID STATE  CPU   SWITCHES     TIME_MS "
+		"WCHAN            NAME\n");
+}
+
+static
+void
+ti_print(const struct threadinfo *ti)
+{
+	char cpu[8];
+
+	if (ti->ti_cpu < 0) {
+		strcpy(cpu, "-");
+	}
+	else {
+		snprintf(cpu, sizeof(cpu), "%d", (int)ti->ti_cpu);
+	}
+	kprintf("%6u %5d %-6s %3s %10u %11lu %-16s %s\n",
+		ti->ti_id, (int)ti->ti_pid, ti_statenames[ti->ti_state], cpu,
+		ti->ti_switches, (unsigned long)ti->ti_runms,
+		ti->ti_wchan, ti->ti_name);
+}
+
+void
+threadinfo_ps(void)
+{
+	struct threadinfo *ti;
+	unsigned i, n;
+
+	ti = ti_snapshot(&n);
+	if (ti == NULL) {
+		kprintf("ps: out of memory\n");
+		return;
+	}
+	ti_header();
+	for (i=0; i<n; i++) {
+		ti_print(&ti[i]);
+	}
+	kprintf("%u threads\n", n);
+	kfree(ti);
+}
+
+/*
+ * Run time since the earlier snapshot, for each thread in the later
+ * one; threads that are new count from zero.
+ */
+static
+void
+ti_deltas(const struct threadinfo *old, unsigned nold,
+	  const struct threadinfo *new, unsigned nnew, uint64_t *delta)
+{
+	unsigned i, j;
+
+	for (i=0; i<nnew; i++) {
+		delta[i] = new[i].ti_runms;
+		for (j=0; j<nold; j++) {
+			if (old[j].ti_id == new[i].ti_id) {
+				/*
+				 * A thread running on another CPU is
+				 * counted only up to its last switch,
+				 * so NEW can trail OLD; call that 0.
+				 */
+				delta[i] = new[i].ti_runms > old[j].ti_runms ?
+					new[i].ti_runms - old[j].ti_runms : 0;
+				break;
+			}
+		}
+	}
+}
+
+int
+threadinfo_top(unsigned iterations, unsigned secs)
+{
+	struct threadinfo *old, *new;
+	uint64_t *delta;
+	unsigned *order;
+	unsigned nold, nnew, i, j, k, tmp;
+	uint32_t permille;
+
+	old = ti_snapshot(&nold);
+	if (old == NULL) {
+		return ENOMEM;
+	}
+
+	while (iterations-- > 0) {
+		clock_nsleep(secs, 0);
+
+		new = ti_snapshot(&nnew);
+		if (new == NULL) {
+			kfree(old);
+			return ENOMEM;
+		}
+		delta = kmalloc(nnew * sizeof(*delta));
+		order = kmalloc(nnew * sizeof(*order));
+		if (delta == NULL || order == NULL) {
+			kfree(delta);
+			kfree(order);
+			kfree(new);
+			kfree(old);
+			return ENOMEM;
+		}
+		ti_deltas(old, nold, new, nnew, delta);
+
+		/* Sort by run time in the interval, most first. */
+		for (i=0; i<nnew; i++) {
+			order[i] = i;
+			for (j=i; j>0 && delta[order[j]] > delta[order[j-1]]; j--) {
+				tmp = order[j];
+				order[j] = order[j-1];
+				order[j-1] = tmp;
+			}
+		}
+
+		kprintf("\n%u threads, last %u seconds\n", nnew, secs);
+		kprintf("  %%CPU ");
+		ti_header();
+		for (i=0; i<nnew && i<TOP_LINES; i++) {
+			k = order[i];
+			/* of one cpu, in tenths of a percent */
+			permille = delta[k] / secs;
+			kprintf("%4u.%u ", permille / 10, permille % 10);
+			ti_print(&new[k]);
+		}
+
+		kfree(delta);
+		kfree(order);
+		kfree(old);
+		old = new;
+		nold = nnew;
+	}
+
+	kfree(old);
+	return 0;
+}
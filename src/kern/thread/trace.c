@@ -0,0 +1,221 @@
+/*
+ * Static tracepoints. See <trace.h>.
+ *
+ * Each CPU appends only to its own ring, with interrupts off, so
+ * recording takes no locks. Rings are allocated the first time any
+ * tracepoint is enabled and kept after that.
+ */
+
+#include <types.h>
+#include <kern/errno.h>
+#include <lib.h>
+#include <spl.h>
+#include <cpu.h>
+#include <thread.h>
+#include <current.h>
+#include <mainbus.h>
+#include <trace.h>
+
+volatile uint32_t trace_enabled;
+
+static const struct {
+	const char *name;
+	const char *fmt;	/* for the four arguments */
+} tracepoints[TP_COUNT] = {
+	[TP_THREAD_SWITCH] = { "thread_switch", "state %u -> pid %d" },
+	[TP_WCHAN_SLEEP] =   { "wchan_sleep",   "wchan 0x%x" },
+	[TP_VM_FAULT] =      { "vm_fault",      "type %u addr 0x%x" },
+	[TP_SYSCALL] =       { "syscall",       "%u (0x%x, 0x%x, 0x%x)" },
+	[TP_SYSRET] =        { "sysret",        "%u err %u ret 0x%x" },
+	[TP_LHD_IO] =        { "lhd_io",        "lhd%u sector %u x%u write %u" },
+	[TP_EMU_WAITDONE] =  { "emu_waitdone",  "emu%u result %u" },
+};
+
+void
+trace_record(unsigned tp, uint32_t a0, uint32_t a1, uint32_t a2, uint32_t a3)
+{
+	struct tracering *ring;
+	struct tracerec *rec;
+	int spl;
+
+	spl = splhigh();
+	ring = curcpu->c_tracering;
+	if (ring != NULL) {
+		rec = &ring->tr_recs[ring->tr_head++ % TRACE_RINGSIZE];
+		rec->tr_cycles = mainbus_cycles();
+		rec->tr_tp = tp;
+		rec->tr_cpu = curcpu->c_number;
+		rec->tr_pid = curthread->t_pid;
+		rec->tr_args[0] = a0;
+		rec->tr_args[1] = a1;
+		rec->tr_args[2] = a2;
+		rec->tr_args[3] = a3;
+	}
+	splx(spl);
+}
+
+////////////////////////////////////////////////////////////
+// control
+
+int
+trace_lookup(const char *name)
+{
+	int i;
+
+	for (i=0; i<TP_COUNT; i++) {
+		if (!strcmp(name, tracepoints[i].name)) {
+			return i;
+		}
+	}
+	return -1;
+}
+
+int
+trace_enable(uint32_t mask)
+{
+	struct cpu *c;
+	unsigned i;
+
+	for (i=0; i<cpu_numcpus(); i++) {
+		c = cpu_getcpu(i);
+		if (c->c_tracering == NULL) {
+			c->c_tracering = kmalloc(sizeof(struct tracering));
+			if (c->c_tracering == NULL) {
+				return ENOMEM;
+			}
+			c->c_tracering->tr_head = 0;
+		}
+	}
+	trace_enabled |= mask;
+	return 0;
+}
+
+void
+trace_disable(uint32_t mask)
+{
+	trace_enabled &= ~mask;
+}
+
+void
+trace_clear(void)
+{
+	struct cpu *c;
+	unsigned i;
+	int spl;
+
+	for (i=0; i<cpu_numcpus(); i++) {
+		c = cpu_getcpu(i);
+		if (c->c_tracering != NULL) {
+			spl = splhigh();
+			c->c_tracering->tr_head = 0;
+			splx(spl);
+		}
+	}
+}
+
+void
+trace_list(void)
+{
+	struct cpu *c;
+	unsigned i, n = 0;
+
+	for (i=0; i<cpu_numcpus(); i++) {
+		c = cpu_getcpu(i);
+		if (c->c_tracering != NULL) {
+			n += c->c_tracering->tr_head;
+		}
+	}
+
+	for (i=0; i<TP_COUNT; i++) {
+		kprintf("    %-16s %s\n", tracepoints[i].name,
+			(trace_enabled & (1U << i)) ? "on" : "off");
+	}
+	kprintf("%u records written, %u kept per CPU\n", n, TRACE_RINGSIZE);
+}
+
+////////////////////////////////////////////////////////////
+// dumping
+
+static
+void
+trace_print(const struct tracerec *rec, uint64_t base, bool raw)
+{
+	uint64_t delta;
+	uint32_t usecs;
+
+	if (raw) {
+		kprintf("%08x%08x %u %u %d %08x %08x %08x %08x\n",
+			(uint32_t)(rec->tr_cycles >> 32),
+			(uint32_t)rec->tr_cycles,
+			rec->tr_tp, rec->tr_cpu, rec->tr_pid,
+			rec->tr_args[0], rec->tr_args[1],
+			rec->tr_args[2], rec->tr_args[3]);
+		return;
+	}
+
+	delta = (rec->tr_cycles - base) / (mainbus_cyclefreq() / 1000000);
+	usecs = delta > 0xffffffff ? 0xffffffff : (uint32_t)delta;
+
+	kprintf("%10u us cpu%u pid %d %-14s ", usecs, rec->tr_cpu,
+		rec->tr_pid,
+		rec->tr_tp < TP_COUNT ? tracepoints[rec->tr_tp].name : "?");
+	if (rec->tr_tp < TP_COUNT) {
+		kprintf(tracepoints[rec->tr_tp].fmt, rec->tr_args[0],
+			rec->tr_args[1], rec->tr_args[2], rec->tr_args[3]);
+	}
+	kprintf("\n");
+}
+
+/*
+ * Print each CPU's ring, oldest record first, with times relative to
+ * the oldest record on any CPU. Tracing is paused meanwhile so that
+ * the printing doesn't trace itself.
+ */
+void
+trace_dump(bool raw)
+{
+	struct tracering *ring;
+	struct cpu *c;
+	uint32_t saved;
+	uint64_t base = 0;
+	unsigned i, j, first;
+	bool havebase = false;
+
+	saved = trace_enabled;
+	trace_enabled = 0;
+
+	for (i=0; i<cpu_numcpus(); i++) {
+		ring = cpu_getcpu(i)->c_tracering;
+		if (ring == NULL || ring->tr_head == 0) {
+			continue;
+		}
+		first = ring->tr_head > TRACE_RINGSIZE ?
+			ring->tr_head - TRACE_RINGSIZE : 0;
+		if (!havebase ||
+		    ring->tr_recs[first % TRACE_RINGSIZE].tr_cycles < base) {
+			base = ring->tr_recs[first % TRACE_RINGSIZE].tr_cycles;
+			havebase = true;
+		}
+	}
+
+	for (i=0; i<cpu_numcpus(); i++) {
+		c = cpu_getcpu(i);
+		ring = c->c_tracering;
+		if (ring == NULL || ring->tr_head == 0) {
+			continue;
+		}
+		first = ring->tr_head > TRACE_RINGSIZE ?
+			ring->tr_head - TRACE_RINGSIZE : 0;
+		kprintf("cpu%u: %u records", i, ring->tr_head - first);
+		if (first > 0) {
+			kprintf(" (%u older lost)", first);
+		}
+		kprintf("\n");
+		for (j=first; j<ring->tr_head; j++) {
+			trace_print(&ring->tr_recs[j % TRACE_RINGSIZE], base,
+				    raw);
+		}
+	}
+
+	trace_enabled = saved;
+}
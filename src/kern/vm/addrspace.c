@@ -30,6 +30,8 @@
 #include <types.h>
 #include <kern/errno.h>
 #include <lib.h>
+#include <current.h>
+#include <thread.h>
 #include <addrspace.h>
 #include <vm.h>
 
@@ -39,6 +41,9 @@
  * used. The cheesy hack versions in dumbvm.c are used instead.
  */
 
+/* Pages of user stack: as much as dumbvm gives a full ARG_MAX exec */
+#define STACKPAGES 20
+
 struct addrspace *
 as_create(void)
 {
@@ -53,6 +58,11 @@ as_create(void)
 	 * Initialize as needed.
 	 */
 
+	regionmap_init(&as->as_regions);
+	bzero(&as->as_vmstat, sizeof(as->as_vmstat));
+	spinlock_init(&as->as_reflock);
+	as->as_refcount = 1;
+
 	return as;
 }
 
@@ -60,18 +70,23 @@ int
 as_copy(struct addrspace *old, struct addrspace **ret)
 {
 	struct addrspace *newas;
+	int result;
 
 	newas = as_create();
 	if (newas==NULL) {
 		return ENOMEM;
 	}
 
+	result = regionmap_copy(&old->as_regions, &newas->as_regions);
+	if (result) {
+		as_destroy(newas);
+		return result;
+	}
+
 	/*
-	 * Write this.
+	 * Write the rest of this.
 	 */
 
-	(void)old;
-	
 	*ret = newas;
 	return 0;
 }
@@ -83,9 +98,33 @@ as_destroy(struct addrspace *as)
 	 * Clean up as needed.
 	 */
 	
+	KASSERT(as->as_refcount <= 1);
+	regionmap_cleanup(&as->as_regions);
+	spinlock_cleanup(&as->as_reflock);
 	kfree(as);
 }
 
+void
+as_incref(struct addrspace *as)
+{
+	spinlock_acquire(&as->as_reflock);
+	KASSERT(as->as_refcount > 0);
+	as->as_refcount++;
+	spinlock_release(&as->as_reflock);
+}
+
+unsigned
+as_decref(struct addrspace *as)
+{
+	unsigned ret;
+
+	spinlock_acquire(&as->as_reflock);
+	KASSERT(as->as_refcount > 0);
+	ret = --as->as_refcount;
+	spinlock_release(&as->as_reflock);
+	return ret;
+}
+
 void
 as_activate(struct addrspace *as)
 {
@@ -102,25 +141,44 @@ as_activate(struct addrspace *as)
  * VADDR+MEMSIZE.
  *
  * The READABLE, WRITEABLE, and EXECUTABLE flags are set if read,
- * write, or execute permission should be set on the segment. At the
- * moment, these are ignored. When you write the VM system, you may
- * want to implement them.
+ * write, or execute permission should be set on the segment. They
+ * are recorded in the region; enforcing them is up to the fault
+ * handler.
+ *
+ * The segment is widened to whole pages. Segments that then abut or
+ * overlap (ELF files may put two in one page) are joined, with the
+ * permissions of both.
  */
 int
 as_define_region(struct addrspace *as, vaddr_t vaddr, size_t sz,
 		 int readable, int writeable, int executable)
 {
-	/*
-	 * Write this.
-	 */
+	struct region *rg;
+	vaddr_t end;
+	unsigned flags;
 
-	(void)as;
-	(void)vaddr;
-	(void)sz;
-	(void)readable;
-	(void)writeable;
-	(void)executable;
-	return EUNIMP;
+	end = ROUNDUP(vaddr + sz, PAGE_SIZE);
+	vaddr &= PAGE_FRAME;
+	if (end <= vaddr || end > USERSPACETOP) {
+		return EFAULT;
+	}
+
+	flags = (readable ? VMR_READ : 0) | (writeable ? VMR_WRITE : 0) |
+		(executable ? VMR_EXEC : 0);
+
+	/* Fold in any page we share with a neighbor. */
+	rg = regionmap_lookup(&as->as_regions, vaddr, NULL);
+	if (rg != NULL) {
+		flags |= rg->rg_flags;
+	}
+	rg = regionmap_lookup(&as->as_regions, end - 1, NULL);
+	if (rg != NULL) {
+		flags |= rg->rg_flags;
+	}
+	if (regionmap_remove(&as->as_regions, vaddr, end)) {
+		return ENOMEM;
+	}
+	return regionmap_add(&as->as_regions, vaddr, end, flags);
 }
 
 int
@@ -145,18 +203,94 @@ as_complete_load(struct addrspace *as)
 	return 0;
 }
 
+/*
+ * The stack region is always big enough for a full ARG_MAX, and its
+ * pages are only used as they are touched.
+ */
+int
+as_reserve_stack(struct addrspace *as, size_t bytes)
+{
+	(void)as;
+	return bytes + PAGE_SIZE > STACKPAGES * PAGE_SIZE ? E2BIG : 0;
+}
+
 int
 as_define_stack(struct addrspace *as, vaddr_t *stackptr)
+{
+	int result;
+
+	result = regionmap_add(&as->as_regions,
+			       USERSTACK - STACKPAGES * PAGE_SIZE, USERSTACK,
+			       VMR_READ | VMR_WRITE);
+	if (result) {
+		return result;
+	}
+
+	/* Initial user-level stack pointer */
+	*stackptr = USERSTACK;
+	
+	return 0;
+}
+
+int
+as_map_shared(struct addrspace *as, vaddr_t vaddr, paddr_t paddr,
+	      size_t npages, int writeable)
 {
 	/*
 	 * Write this.
 	 */
 
 	(void)as;
+	(void)vaddr;
+	(void)paddr;
+	(void)npages;
+	(void)writeable;
+	return EUNIMP;
+}
 
-	/* Initial user-level stack pointer */
-	*stackptr = USERSTACK;
-	
+paddr_t
+as_unmap_shared(struct addrspace *as, vaddr_t vaddr)
+{
+	/*
+	 * Write this.
+	 */
+
+	(void)as;
+	(void)vaddr;
 	return 0;
 }
 
+int
+as_define_thread_stack(struct addrspace *as, vaddr_t *stackptr, int *slot)
+{
+	/*
+	 * Write this.
+	 */
+
+	(void)as;
+	(void)stackptr;
+	(void)slot;
+	return EUNIMP;
+}
+
+void
+as_release_thread_stack(struct addrspace *as, int slot)
+{
+	/*
+	 * Write this.
+	 */
+
+	(void)as;
+	(void)slot;
+}
+
+/*
+ * Find the region VADDR is in, trying first the one this thread found
+ * last time.
+ */
+struct region *
+as_findregion(struct addrspace *as, vaddr_t vaddr)
+{
+	return regionmap_lookup(&as->as_regions, vaddr,
+				&curthread->t_regioncache);
+}
@@ -0,0 +1,542 @@
+/*
+ * Region maps. See regionmap.h for the interface.
+ *
+ * The tree is a red-black tree with parent pointers and NULL leaves,
+ * after CLR(S); the deletion code carries the parent of the possibly
+ * NULL replacement node along separately.
+ */
+
+#include <types.h>
+#include <kern/errno.h>
+#include <lib.h>
+#include <spinlock.h>
+#include <regionmap.h>
+
+/*
+ * Source of generation numbers. 0 is never handed out, so an empty
+ * cache matches nothing.
+ */
+static struct spinlock regionmap_genlock = SPINLOCK_INITIALIZER;
+static unsigned regionmap_nextgen = 1;
+
+static
+unsigned
+newgen(void)
+{
+	unsigned gen;
+
+	spinlock_acquire(&regionmap_genlock);
+	gen = regionmap_nextgen++;
+	if (regionmap_nextgen == 0) {
+		regionmap_nextgen = 1;
+	}
+	spinlock_release(&regionmap_genlock);
+	return gen;
+}
+
+////////////////////////////////////////////////////////////
+// tree primitives
+
+static
+void
+rotate_left(struct regionmap *rm, struct region *x)
+{
+	struct region *y = x->rg_right;
+
+	x->rg_right = y->rg_left;
+	if (y->rg_left != NULL) {
+		y->rg_left->rg_parent = x;
+	}
+	y->rg_parent = x->rg_parent;
+	if (x->rg_parent == NULL) {
+		rm->rm_root = y;
+	}
+	else if (x == x->rg_parent->rg_left) {
+		x->rg_parent->rg_left = y;
+	}
+	else {
+		x->rg_parent->rg_right = y;
+	}
+	y->rg_left = x;
+	x->rg_parent = y;
+}
+
+static
+void
+rotate_right(struct regionmap *rm, struct region *x)
+{
+	struct region *y = x->rg_left;
+
+	x->rg_left = y->rg_right;
+	if (y->rg_right != NULL) {
+		y->rg_right->rg_parent = x;
+	}
+	y->rg_parent = x->rg_parent;
+	if (x->rg_parent == NULL) {
+		rm->rm_root = y;
+	}
+	else if (x == x->rg_parent->rg_right) {
+		x->rg_parent->rg_right = y;
+	}
+	else {
+		x->rg_parent->rg_left = y;
+	}
+	y->rg_right = x;
+	x->rg_parent = y;
+}
+
+static
+bool
+isred(const struct region *rg)
+{
+	return rg != NULL && rg->rg_red;
+}
+
+/*
+ * Link RG, which must not overlap anything, into the tree.
+ */
+static
+void
+tree_insert(struct regionmap *rm, struct region *rg)
+{
+	struct region **pp, *parent = NULL, *g, *u;
+
+	pp = &rm->rm_root;
+	while (*pp != NULL) {
+		parent = *pp;
+		pp = rg->rg_start < parent->rg_start ?
+			&parent->rg_left : &parent->rg_right;
+	}
+	rg->rg_left = rg->rg_right = NULL;
+	rg->rg_parent = parent;
+	rg->rg_red = true;
+	*pp = rg;
+
+	while (isred(rg->rg_parent)) {
+		parent = rg->rg_parent;
+		g = parent->rg_parent;
+		if (parent == g->rg_left) {
+			u = g->rg_right;
+			if (isred(u)) {
+				parent->rg_red = u->rg_red = false;
+				g->rg_red = true;
+				rg = g;
+				continue;
+			}
+			if (rg == parent->rg_right) {
+				rotate_left(rm, parent);
+				rg = parent;
+				parent = rg->rg_parent;
+			}
+			parent->rg_red = false;
+			g->rg_red = true;
+			rotate_right(rm, g);
+		}
+		else {
+			u = g->rg_left;
+			if (isred(u)) {
+				parent->rg_red = u->rg_red = false;
+				g->rg_red = true;
+				rg = g;
+				continue;
+			}
+			if (rg == parent->rg_left) {
+				rotate_right(rm, parent);
+				rg = parent;
+				parent = rg->rg_parent;
+			}
+			parent->rg_red = false;
+			g->rg_red = true;
+			rotate_left(rm, g);
+		}
+	}
+	rm->rm_root->rg_red = false;
+}
+
+/*
+ * Put V (possibly NULL) where U is in the tree.
+ */
+static
+void
+transplant(struct regionmap *rm, struct region *u, struct region *v)
+{
+	if (u->rg_parent == NULL) {
+		rm->rm_root = v;
+	}
+	else if (u == u->rg_parent->rg_left) {
+		u->rg_parent->rg_left = v;
+	}
+	else {
+		u->rg_parent->rg_right = v;
+	}
+	if (v != NULL) {
+		v->rg_parent = u->rg_parent;
+	}
+}
+
+static
+void
+tree_delete_fixup(struct regionmap *rm, struct region *x, struct region *xp)
+{
+	struct region *w;
+
+	while (x != rm->rm_root && !isred(x)) {
+		if (x == xp->rg_left) {
+			w = xp->rg_right;
+			if (w->rg_red) {
+				w->rg_red = false;
+				xp->rg_red = true;
+				rotate_left(rm, xp);
+				w = xp->rg_right;
+			}
+			if (!isred(w->rg_left) && !isred(w->rg_right)) {
+				w->rg_red = true;
+				x = xp;
+				xp = x->rg_parent;
+				continue;
+			}
+			if (!isred(w->rg_right)) {
+				w->rg_left->rg_red = false;
+				w->rg_red = true;
+				rotate_right(rm, w);
+				w = xp->rg_right;
+			}
+			w->rg_red = xp->rg_red;
+			xp->rg_red = false;
+			w->rg_right->rg_red = false;
+			rotate_left(rm, xp);
+		}
+		else {
+			w = xp->rg_left;
+			if (w->rg_red) {
+				w->rg_red = false;
+				xp->rg_red = true;
+				rotate_right(rm, xp);
+				w = xp->rg_left;
+			}
+			if (!isred(w->rg_left) && !isred(w->rg_right)) {
+				w->rg_red = true;
+				x = xp;
+				xp = x->rg_parent;
+				continue;
+			}
+			if (!isred(w->rg_left)) {
+				w->rg_right->rg_red = false;
+				w->rg_red = true;
+				rotate_left(rm, w);
+				w = xp->rg_left;
+			}
+			w->rg_red = xp->rg_red;
+			xp->rg_red = false;
+			w->rg_left->rg_red = false;
+			rotate_right(rm, xp);
+		}
+		x = rm->rm_root;
+	}
+	if (x != NULL) {
+		x->rg_red = false;
+	}
+}
+
+/*
+ * Unlink Z from the tree. Doesn't free it.
+ */
+static
+void
+tree_delete(struct regionmap *rm, struct region *z)
+{
+	struct region *y, *x, *xp;
+	bool wasred;
+
+	wasred = z->rg_red;
+	if (z->rg_left == NULL) {
+		x = z->rg_right;
+		xp = z->rg_parent;
+		transplant(rm, z, x);
+	}
+	else if (z->rg_right == NULL) {
+		x = z->rg_left;
+		xp = z->rg_parent;
+		transplant(rm, z, x);
+	}
+	else {
+		for (y = z->rg_right; y->rg_left != NULL; y = y->rg_left) {
+			/* nothing */
+		}
+		wasred = y->rg_red;
+		x = y->rg_right;
+		if (y->rg_parent == z) {
+			xp = y;
+		}
+		else {
+			xp = y->rg_parent;
+			transplant(rm, y, x);
+			y->rg_right = z->rg_right;
+			y->rg_right->rg_parent = y;
+		}
+		transplant(rm, z, y);
+		y->rg_left = z->rg_left;
+		y->rg_left->rg_parent = y;
+		y->rg_red = z->rg_red;
+	}
+	if (!wasred) {
+		tree_delete_fixup(rm, x, xp);
+	}
+}
+
+/*
+ * The last region starting at or below ADDR, or NULL.
+ */
+static
+struct region *
+tree_floor(const struct regionmap *rm, vaddr_t addr)
+{
+	struct region *rg = rm->rm_root, *best = NULL;
+
+	while (rg != NULL) {
+		if (addr < rg->rg_start) {
+			rg = rg->rg_left;
+		}
+		else {
+			best = rg;
+			rg = rg->rg_right;
+		}
+	}
+	return best;
+}
+
+////////////////////////////////////////////////////////////
+// iteration
+
+struct region *
+regionmap_first(const struct regionmap *rm)
+{
+	struct region *rg = rm->rm_root;
+
+	if (rg == NULL) {
+		return NULL;
+	}
+	while (rg->rg_left != NULL) {
+		rg = rg->rg_left;
+	}
+	return rg;
+}
+
+struct region *
+regionmap_next(const struct region *rg)
+{
+	struct region *r;
+
+	if (rg->rg_right != NULL) {
+		for (r = rg->rg_right; r->rg_left != NULL; r = r->rg_left) {
+			/* nothing */
+		}
+		return r;
+	}
+	while (rg->rg_parent != NULL && rg == rg->rg_parent->rg_right) {
+		rg = rg->rg_parent;
+	}
+	return rg->rg_parent;
+}
+
+////////////////////////////////////////////////////////////
+// operations
+
+void
+regioncache_init(struct regioncache *rc)
+{
+	rc->rc_gen = 0;
+	rc->rc_region = NULL;
+}
+
+void
+regionmap_init(struct regionmap *rm)
+{
+	rm->rm_root = NULL;
+	rm->rm_num = 0;
+	rm->rm_gen = newgen();
+}
+
+void
+regionmap_cleanup(struct regionmap *rm)
+{
+	struct region *rg;
+
+	/* Always remove a leaf, so there's nothing to rebalance. */
+	rg = rm->rm_root;
+	while (rg != NULL) {
+		if (rg->rg_left != NULL) {
+			rg = rg->rg_left;
+		}
+		else if (rg->rg_right != NULL) {
+			rg = rg->rg_right;
+		}
+		else {
+			transplant(rm, rg, NULL);
+			kfree(rg);
+			rg = rm->rm_root;
+		}
+	}
+	rm->rm_num = 0;
+	rm->rm_gen = newgen();
+}
+
+unsigned
+regionmap_num(const struct regionmap *rm)
+{
+	return rm->rm_num;
+}
+
+int
+regionmap_add(struct regionmap *rm, vaddr_t start, vaddr_t end,
+	      unsigned flags)
+{
+	struct region *prev, *next, *rg;
+
+	KASSERT(start < end);
+
+	prev = tree_floor(rm, start);
+	next = prev != NULL ? regionmap_next(prev) : regionmap_first(rm);
+	if (prev != NULL && prev->rg_end > start) {
+		return EINVAL;
+	}
+	if (next != NULL && next->rg_start < end) {
+		return EINVAL;
+	}
+
+	if (prev != NULL && prev->rg_end == start && prev->rg_flags == flags) {
+		prev->rg_end = end;
+		if (next != NULL && next->rg_start == end &&
+		    next->rg_flags == flags) {
+			/* fills the hole between two regions */
+			prev->rg_end = next->rg_end;
+			tree_delete(rm, next);
+			kfree(next);
+			rm->rm_num--;
+		}
+	}
+	else if (next != NULL && next->rg_start == end &&
+		 next->rg_flags == flags) {
+		/* still in order, since nothing is in between */
+		next->rg_start = start;
+	}
+	else {
+		rg = kmalloc(sizeof(*rg));
+		if (rg == NULL) {
+			return ENOMEM;
+		}
+		rg->rg_start = start;
+		rg->rg_end = end;
+		rg->rg_flags = flags;
+		tree_insert(rm, rg);
+		rm->rm_num++;
+	}
+	rm->rm_gen = newgen();
+	return 0;
+}
+
+int
+regionmap_remove(struct regionmap *rm, vaddr_t start, vaddr_t end)
+{
+	struct region *rg, *next, *tail;
+
+	KASSERT(start < end);
+
+	rg = tree_floor(rm, start);
+	if (rg == NULL) {
+		rg = regionmap_first(rm);
+	}
+	else if (rg->rg_end <= start) {
+		rg = regionmap_next(rg);
+	}
+	if (rg == NULL || rg->rg_start >= end) {
+		return 0;
+	}
+
+	if (rg->rg_start < start && rg->rg_end > end) {
+		/* punching a hole in the middle */
+		tail = kmalloc(sizeof(*tail));
+		if (tail == NULL) {
+			return ENOMEM;
+		}
+		tail->rg_start = end;
+		tail->rg_end = rg->rg_end;
+		tail->rg_flags = rg->rg_flags;
+		rg->rg_end = start;
+		tree_insert(rm, tail);
+		rm->rm_num++;
+		rm->rm_gen = newgen();
+		return 0;
+	}
+
+	for (; rg != NULL && rg->rg_start < end; rg = next) {
+		next = regionmap_next(rg);
+		if (rg->rg_start < start) {
+			rg->rg_end = start;
+		}
+		else if (rg->rg_end > end) {
+			rg->rg_start = end;
+		}
+		else {
+			tree_delete(rm, rg);
+			kfree(rg);
+			rm->rm_num--;
+		}
+	}
+	rm->rm_gen = newgen();
+	return 0;
+}
+
+struct region *
+regionmap_lookup(struct regionmap *rm, vaddr_t addr, struct regioncache *rc)
+{
+	struct region *rg;
+
+	if (rc != NULL && rc->rc_gen == rm->rm_gen) {
+		rg = rc->rc_region;
+		if (addr >= rg->rg_start && addr < rg->rg_end) {
+			return rg;
+		}
+	}
+
+	rg = rm->rm_root;
+	while (rg != NULL) {
+		if (addr < rg->rg_start) {
+			rg = rg->rg_left;
+		}
+		else if (addr >= rg->rg_end) {
+			rg = rg->rg_right;
+		}
+		else {
+			if (rc != NULL) {
+				rc->rc_gen = rm->rm_gen;
+				rc->rc_region = rg;
+			}
+			return rg;
+		}
+	}
+	return NULL;
+}
+
+int
+regionmap_copy(const struct regionmap *src, struct regionmap *dst)
+{
+	struct region *rg, *copy;
+
+	KASSERT(dst->rm_root == NULL);
+
+	for (rg = regionmap_first(src); rg != NULL; rg = regionmap_next(rg)) {
+		copy = kmalloc(sizeof(*copy));
+		if (copy == NULL) {
+			regionmap_cleanup(dst);
+			return ENOMEM;
+		}
+		copy->rg_start = rg->rg_start;
+		copy->rg_end = rg->rg_end;
+		copy->rg_flags = rg->rg_flags;
+		tree_insert(dst, copy);
+		dst->rm_num++;
+	}
+	dst->rm_gen = newgen();
+	return 0;
+}
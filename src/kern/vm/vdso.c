@@ -0,0 +1,107 @@
+/*
+ * Read-only kernel pages mapped into every user address space, so
+ * that libc's time() and getpid() can answer without a trap.
+ *
+ * There is one global time page, refreshed from hardclock() under a
+ * sequence counter, and one small page per address space holding the
+ * pid. Both are mapped read-only with as_map_shared.
+ */
+
+#include <types.h>
+#include <kern/errno.h>
+#include <lib.h>
+#include <clock.h>
+#include <addrspace.h>
+#include <vm.h>
+#include <membar.h>
+#include <vdso.h>
+
+/* The time page, via its kernel address; NULL until bootstrapped */
+static struct vdso_time *vdso_time;
+
+void
+vdso_bootstrap(void)
+{
+	vaddr_t page;
+
+	page = alloc_kpages(1);
+	if (page == 0) {
+		panic("vdso: Out of memory for the time page\n");
+	}
+	bzero((void *)page, PAGE_SIZE);
+	vdso_time = (struct vdso_time *)page;
+	vdso_hardclock();
+}
+
+/*
+ * Only one CPU calls this, so the writer side needs no lock; readers
+ * use vt_seq to detect a torn read.
+ */
+void
+vdso_hardclock(void)
+{
+	time_t secs;
+	uint32_t nsecs;
+
+	if (vdso_time == NULL) {
+		return;
+	}
+
+	gettime(&secs, &nsecs);
+
+	/*
+	 * Readers on other CPUs must see the odd count before the new
+	 * time, and the new time before the even count.
+	 */
+	vdso_time->vt_seq++;
+	membar_store_store();
+	vdso_time->vt_secs = secs;
+	vdso_time->vt_nsecs = nsecs;
+	membar_store_store();
+	vdso_time->vt_seq++;
+}
+
+int
+vdso_map(struct addrspace *as, pid_t pid)
+{
+	struct vdso_proc *vp;
+	vaddr_t page;
+	int result;
+
+	KASSERT(vdso_time != NULL);
+
+	page = alloc_kpages(1);
+	if (page == 0) {
+		return ENOMEM;
+	}
+	bzero((void *)page, PAGE_SIZE);
+	vp = (struct vdso_proc *)page;
+	vp->vp_pid = pid;
+
+	result = as_map_shared(as, VDSO_VADDR,
+			       KVADDR_TO_PADDR((vaddr_t)vdso_time), 1, 0);
+	if (result) {
+		free_kpages(page);
+		return result;
+	}
+	result = as_map_shared(as, VDSO_PROC_VADDR, KVADDR_TO_PADDR(page),
+			       1, 0);
+	if (result) {
+		as_unmap_shared(as, VDSO_VADDR);
+		free_kpages(page);
+		return result;
+	}
+	return 0;
+}
+
+void
+vdso_unmap(struct addrspace *as)
+{
+	paddr_t pa;
+
+	as_unmap_shared(as, VDSO_VADDR);
+	pa = as_unmap_shared(as, VDSO_PROC_VADDR);
+	if (pa != 0) {
+		free_kpages(PADDR_TO_KVADDR(pa));
+	}
+}
@@ -95,12 +95,23 @@ all: includelinks .WAIT $(KERNEL)
 # The version number is kept in the file called "version" in the build
 # directory.
 #
+# ksyms.c/.o is the table of kernel function names used by the
+# sampling profiler. It is made from the kernel's own symbols, so the
+# kernel is linked twice: once with an empty table, then again with
+# the real one. The table is all read-only data, which the ldscript
+# places after .text, so code addresses are the same in both links.
+#
 # By immemorial tradition, "size" is run on the kernel after it's linked.
 #
 $(KERNEL):
 	$(KTOP)/conf/newvers.sh $(CONFNAME)
 	$(CC) $(KCFLAGS) -c vers.c
-	$(LD) $(KLDFLAGS) $(OBJS) vers.o -o $(KERNEL)
+	$(KTOP)/conf/mkksyms.sh < /dev/null > ksyms.c
+	$(CC) $(KCFLAGS) -c ksyms.c
+	$(LD) $(KLDFLAGS) $(OBJS) vers.o ksyms.o -o $(KERNEL)
+	$(NM) -n $(KERNEL) | $(KTOP)/conf/mkksyms.sh > ksyms.c
+	$(CC) $(KCFLAGS) -c ksyms.c
+	$(LD) $(KLDFLAGS) $(OBJS) vers.o ksyms.o -o $(KERNEL)
 	$(SIZE) $(KERNEL)
 
 #
@@ -146,7 +157,7 @@ includelinks:
 # blow away the whole compile directory.)
 #
 clean:
-	rm -f *.o *.a tags TAGS $(KERNEL)
+	rm -f *.o *.a tags TAGS $(KERNEL) ksyms.c
 	rm -r includelinks
 
 distclean cleandir: clean
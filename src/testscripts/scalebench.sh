@@ -0,0 +1,173 @@
+#!/bin/sh
+#
+# scalebench.sh - run the benchmark suite under a range of CPU counts
+# and RAM sizes, and tabulate how each workload scales.
+#
+# Usage: scalebench.sh [-r root] [-k kernel] [-c "cpus..."]
+#                      [-m "ramsizes..."] [-t timeout] [-o csvfile]
+#
+# For each RAM size and CPU count this writes a sys161.conf with that
+# mainboard line into the root directory (default $HOME/os161/root,
+# where "make install" puts things), boots the kernel once with
+#
+#	sys161 -c scalebench.conf kernel "script emu0:scalebench.script"
+#
+# and takes each program's time from the kernel's "Operation took"
+# lines. The suite is psort, parallelvm, farm and fsbench; the kernel's
+# script command waits for each one to exit.
+#
+# The CSV (default scalebench.csv in the current directory) has one
+# row per run of a program:
+#
+#	ramsize,cpus,test,seconds,status
+#
+# and the table printed at the end gives, for each RAM size and test,
+# the speedup at each CPU count over the first one. A run that dies or
+# times out leaves its tests out; they show as "-" in the table.
+#
+# sys161 must be on the path. Each boot is killed after TIMEOUT
+# seconds (default 600) if timeout(1) is available.
+
+ROOT="$HOME/os161/root"
+KERNEL=kernel
+CPUS="1 2 4 8"
+RAMS="4M"
+TIMEOUT=600
+CSV=scalebench.csv
+
+usage() {
+    echo "Usage: $0 [-r root] [-k kernel] [-c \"cpus...\"]" 1>&2
+    echo "       [-m \"ramsizes...\"] [-t timeout] [-o csvfile]" 1>&2
+    exit 1
+}
+
+while [ $# -gt 0 ]; do
+    [ $# -ge 2 ] || usage
+    case "$1" in
+	-r) ROOT="$2";;
+	-k) KERNEL="$2";;
+	-c) CPUS="$2";;
+	-m) RAMS="$2";;
+	-t) TIMEOUT="$2";;
+	-o) CSV="$2";;
+	*) usage;;
+    esac
+    shift 2
+done
+
+if [ ! -f "$ROOT/$KERNEL" ] || [ ! -f "$ROOT/sys161.conf" ]; then
+    echo "$0: need $KERNEL and sys161.conf in $ROOT" 1>&2
+    exit 1
+fi
+
+case "$CSV" in
+    /*) ;;
+    *) CSV="`pwd`/$CSV";;
+esac
+
+# Turn 4M, 512K or a plain byte count into bytes.
+bytes() {
+    case "$1" in
+	*[Mm]) echo $((${1%?} * 1048576));;
+	*[Kk]) echo $((${1%?} * 1024));;
+	*) echo "$1";;
+    esac
+}
+
+if command -v timeout >/dev/null 2>&1; then
+    TIMEOUTCMD="timeout $TIMEOUT"
+else
+    TIMEOUTCMD=
+fi
+
+cd "$ROOT" || exit 1
+
+# farm cats this.
+[ -f catfile ] || echo "scalebench catfile" > catfile
+
+cat > scalebench.script <<EOF
+# Written by scalebench.sh; run with "script emu0:scalebench.script"
+p /testbin/psort
+p /testbin/parallelvm
+p /testbin/farm
+p /testbin/fsbench -s 64 -n 16 emu0:
+q
+EOF
+
+echo "ramsize,cpus,test,seconds,status" > "$CSV"
+
+for ram in $RAMS; do
+    for cpus in $CPUS; do
+	echo "scalebench: ramsize=$ram cpus=$cpus" 1>&2
+
+	sed 's/^\([0-9]*[ 	]*mainboard\).*/\1 ramsize='`bytes $ram`' cpus='$cpus'/' \
+	    sys161.conf > scalebench.conf
+
+	$TIMEOUTCMD sys161 -c scalebench.conf "$KERNEL" \
+	    "script emu0:scalebench.script" > scalebench.log 2>&1
+
+	# The script's own echo of each command comes first, then the
+	# program's status, then the time the menu took to run it.
+	awk -v ram="$ram" -v cpus="$cpus" '
+	    /^OS\/161 kernel: p / {
+		n = split($4, parts, "/");
+		test = parts[n];
+		status = "";
+		next;
+	    }
+	    /^Program .* exited with status/ {
+		status = $NF;
+		next;
+	    }
+	    /^Operation took/ && test != "" {
+		printf "%s,%s,%s,%s,%s\n", ram, cpus, test, $3, status;
+		test = "";
+	    }
+	' scalebench.log >> "$CSV"
+    done
+done
+
+rm -f scalebench.conf scalebench.script
+
+# Speedup table: one block per RAM size, one row per test.
+awk -F, -v cpulist="$CPUS" '
+    NR == 1 { next; }
+    {
+	key = $1 SUBSEP $3;
+	secs[key, $2] = $4;
+	if (!(key in seen)) {
+	    seen[key] = 1;
+	    order[++nkeys] = key;
+	}
+    }
+    END {
+	ncpus = split(cpulist, cpus, " ");
+	lastram = "";
+	for (i = 1; i <= nkeys; i++) {
+	    split(order[i], k, SUBSEP);
+	    if (k[1] != lastram) {
+		printf "\nspeedup, ramsize=%s\n%-12s", k[1], "test";
+		for (j = 1; j <= ncpus; j++) {
+		    printf " %7s", cpus[j] "cpu";
+		}
+		printf "\n";
+		lastram = k[1];
+	    }
+	    printf "%-12s", k[2];
+	    base = secs[order[i], cpus[1]];
+	    for (j = 1; j <= ncpus; j++) {
+		t = secs[order[i], cpus[j]];
+		if (base == "" || t == "" || t + 0 == 0) {
+		    printf " %7s", "-";
+		}
+		else {
+		    printf " %7.2f", base / t;
+		}
+	    }
+	    printf "\n";
+	}
+    }
+' "$CSV"
+
+echo "" 1>&2
+echo "scalebench: results in $CSV, last boot log in $ROOT/scalebench.log" 1>&2
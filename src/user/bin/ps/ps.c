@@ -0,0 +1,67 @@
+/*
+ * ps - list threads.
+ * Usage: ps
+ *
+ * Uses __threadlist, once to count the threads and again to fetch
+ * them. Threads created in between may be left out.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <err.h>
+#include <kern/threadinfo.h>
+
+#define SLACK	8
+
+static const char *const statenames[] = { "run", "ready", "sleep", "zombie" };
+
+int
+main(int argc, char *argv[])
+{
+	struct threadinfo *ti;
+	char cpu[8];
+	int max, total, i;
+
+	if (argc != 1) {
+		errx(1, "Usage: %s", argv[0]);
+	}
+
+	total = __threadlist(NULL, 0);
+	if (total < 0) {
+		err(1, "__threadlist");
+	}
+	max = total + SLACK;
+	if (max > THREADLIST_MAX) {
+		max = THREADLIST_MAX;
+	}
+	ti = malloc(max * sizeof(*ti));
+	if (ti == NULL) {
+		errx(1, "Out of memory");
+	}
+	total = __threadlist(ti, max);
+	if (total < 0) {
+		err(1, "__threadlist");
+	}
+	if (total > max) {
+		total = max;
+	}
+
+	printf("    ID   PID STATE  CPU   SWITCHES     TIME_MS "
+	       "WCHAN            NAME\n");
+	for (i=0; i<total; i++) {
+		if (ti[i].ti_cpu < 0) {
+			snprintf(cpu, sizeof(cpu), "-");
+		}
+		else {
+			snprintf(cpu, sizeof(cpu), "%d", (int)ti[i].ti_cpu);
+		}
+		printf("%6u %5d %-6s %3s %10u %11lu %-16s %s\n",
+		       ti[i].ti_id, (int)ti[i].ti_pid,
+		       statenames[ti[i].ti_state], cpu, ti[i].ti_switches,
+		       (unsigned long)ti[i].ti_runms,
+		       ti[i].ti_wchan, ti[i].ti_name);
+	}
+	free(ti);
+	return 0;
+}
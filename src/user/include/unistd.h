@@ -154,15 +154,30 @@ int readlink(const char *path, char *buf, size_t buflen);
 int dup2(int filehandle, int newhandle);
 int pipe(int filehandles[2]);
 time_t __time(time_t *seconds, unsigned long *nanoseconds);
+struct timespec;	/* kern/time.h */
+int nanosleep(const struct timespec *req, struct timespec *rem);
 int __getcwd(char *buf, size_t buflen);
 /* stat - see sys/stat.h */
 /* lstat - see sys/stat.h */
 
+/* Local additions. */
+int ioring_setup(unsigned entries, int flags, void **ringp); /* kern/ioring.h */
+int ioring_enter(unsigned to_submit, unsigned min_complete, int flags);
+int __sys_getpid(void);	/* trapping getpid; getpid() reads kern/vdso.h */
+int __threadfork(void (*entry)(void *), void *arg);
+struct vmstat;
+int __vmstat(int who, struct vmstat *vs);		/* kern/vmstat.h */
+struct threadinfo;
+int __threadlist(struct threadinfo *ti, unsigned max);	/* kern/threadinfo.h */
+
 /*
  * These are not themselves system calls, but wrapper routines in libc.
  */
 
 char *getcwd(char *buf, size_t buflen);		/* calls __getcwd */
 time_t time(time_t *seconds);			/* calls __time */
+int threadfork(void (*func)(void));		/* calls __threadfork */
+int threadjoin(int tid, int *status);		/* calls waitpid */
+void threadexit(int code);			/* calls _exit */
 
 #endif /* _UNISTD_H_ */
@@ -43,6 +43,19 @@
 
 #undef MALLOCDEBUG
 
+/*
+ * Define MALLOCTRACE to append a record of every malloc and free to
+ * MALLOCTRACE_FILE, in the format of <kern/mtrace.h>, for replaying
+ * with the mallocreplay testbin or the kernel's kmr test.
+ */
+#undef MALLOCTRACE
+#define MALLOCTRACE_FILE "malloc.trace"
+
+#ifdef MALLOCTRACE
+#include <fcntl.h>
+#include <kern/mtrace.h>
+#endif
+
 #if defined(__mips__) || defined(__i386__)
 #define MALLOC32
 #elif defined(__alpha__) || defined(__x86_64__)
@@ -254,6 +267,40 @@ __malloc_dump(void)
 
 ////////////////////////////////////////////////////////////
 
+#ifdef MALLOCTRACE
+
+/*
+ * Append a trace record. The file is opened on first use and kept
+ * open; forked children share it, and O_APPEND keeps their records
+ * whole.
+ */
+static
+void
+__malloc_trace(unsigned op, void *ptr, size_t size)
+{
+	static int tracefd = -1;
+	struct mtrace_rec rec;
+
+	if (tracefd < 0) {
+		tracefd = open(MALLOCTRACE_FILE, O_WRONLY|O_CREAT|O_APPEND,
+			       0664);
+		if (tracefd < 0) {
+			return;
+		}
+	}
+	rec.mt_op = op;
+	rec.mt_addr = (uintptr_t)ptr;
+	rec.mt_size = size;
+	write(tracefd, &rec, sizeof(rec));
+}
+
+#define MTRACE(op, ptr, size) __malloc_trace(op, ptr, size)
+#else
+#define MTRACE(op, ptr, size) ((void)(size))
+#endif /* MALLOCTRACE */
+
+////////////////////////////////////////////////////////////
+
 /*
  * Get more memory (at the top of the heap) using sbrk, and 
  * return a pointer to it.
@@ -334,7 +381,7 @@ malloc(size_t size)
 {
 	struct mheader *mh;
 	uintptr_t i;
-	size_t rightprevblock;
+	size_t rightprevblock, reqsize;
 
 	if (__heapbase==0) {
 		__malloc_init();
@@ -352,6 +399,7 @@ malloc(size_t size)
 #endif
 
 	/* Round size up to an integral number of blocks. */
+	reqsize = size;
 	size = ((size + MBLOCKSIZE - 1) & ~(size_t)(MBLOCKSIZE-1));
 
 	/*
@@ -398,6 +446,7 @@ malloc(size_t size)
 		warnx("malloc: allocating at %p", M_DATA(mh));
 		__malloc_dump();
 #endif
+		MTRACE(MTRACE_MALLOC, M_DATA(mh), reqsize);
 		return M_DATA(mh);
 	}
 	if (i!=__heaptop) {
@@ -424,6 +473,7 @@ malloc(size_t size)
 	warnx("malloc: allocating at %p", M_DATA(mh));
 	__malloc_dump();
 #endif
+	MTRACE(MTRACE_MALLOC, M_DATA(mh), reqsize);
 	return M_DATA(mh);
 }
 
@@ -487,6 +537,7 @@ free(void *x)
 		/* safest practice */
 		return;
 	}
+	MTRACE(MTRACE_FREE, x, 0);
 
 	/* Consistency check. */
 	if (__heapbase==0 || __heaptop==0 || __heapbase > __heaptop) {
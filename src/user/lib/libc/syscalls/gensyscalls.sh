@@ -19,8 +19,17 @@ awk '
 	# print the name of the call and the number.
 	print $2, $3;
     }
-' | awk '{
+' | awk '
+    # Calls that libc implements in C (reading the vdso page instead
+    # of trapping) keep their trap stub under the name __sys_<call>.
+    BEGIN { wrapped["getpid"] = 1; }
+{
 	# output something simple that will work in syscalls.S.
-	printf "SYSCALL(%s, %s)\n", $1, $2;
+	if ($1 in wrapped) {
+		printf "SYSCALL_AS(__sys_%s, %s)\n", $1, $1;
+	}
+	else {
+		printf "SYSCALL(%s, %s)\n", $1, $2;
+	}
 }'
     
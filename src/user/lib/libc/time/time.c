@@ -28,15 +28,47 @@
  */
 
 #include <unistd.h>
+#include <kern/vdso.h>
 
 /*
  * POSIX C function: retrieve time in seconds since the epoch.
- * Uses the OS/161 system call __time, which does the same thing
- * but also returns nanoseconds.
+ * Reads the kernel's read-only time page, which is refreshed every
+ * clock tick; the OS/161 system call __time does the same thing with
+ * a trap but also returns nanoseconds, and is the fallback if the
+ * page has never been filled in.
  */
 
+/*
+ * Read barrier for the vt_seq protocol; userland has no <membar.h>,
+ * so this is MIPS SYNC, as the kernel's membar_load_load is.
+ */
+static
+inline
+void
+vdso_load_barrier(void)
+{
+	__asm volatile(".set push; .set mips32; sync; .set pop" ::: "memory");
+}
+
 time_t
 time(time_t *t)
 {
-	return __time(t, NULL);
+	const struct vdso_time *vt = (const struct vdso_time *)VDSO_VADDR;
+	unsigned seq;
+	time_t secs;
+
+	do {
+		seq = vt->vt_seq;
+		vdso_load_barrier();
+		secs = vt->vt_secs;
+		vdso_load_barrier();
+	} while ((seq & 1) || seq != vt->vt_seq);
+
+	if (secs == 0) {
+		return __time(t, NULL);
+	}
+	if (t != NULL) {
+		*t = secs;
+	}
+	return secs;
 }
@@ -0,0 +1,41 @@
+/*
+ * Threads within a process, on top of __threadfork. Each thread has
+ * its own user stack and thread id (from the same space as pids) and
+ * shares everything else. A thread exits when it returns from the
+ * function it started in, and can be waited for with threadjoin.
+ * getpid() returns the process's id in every thread, not the thread
+ * id, both from the pid page and from the trapping __sys_getpid.
+ */
+
+#include <unistd.h>
+
+/*
+ * Every thread starts here, with the function to run as its argument.
+ */
+static
+void
+threadstart(void *arg)
+{
+	void (*func)(void) = (void (*)(void))arg;
+
+	func();
+	threadexit(0);
+}
+
+int
+threadfork(void (*func)(void))
+{
+	return __threadfork(threadstart, (void *)func);
+}
+
+int
+threadjoin(int tid, int *status)
+{
+	return waitpid(tid, status, 0);
+}
+
+void
+threadexit(int code)
+{
+	_exit(code);
+}
@@ -32,6 +32,9 @@
  *
  * Checks that argv passing works and is not restricted to an
  * unreasonably small size.
+ *
+ * The chain of execs runs in a child, and the parent reports how
+ * long it took, so this also serves as an exec/argv benchmark.
  */
 
 #include <stdarg.h>
@@ -40,9 +43,11 @@
 #include <unistd.h>
 #include <limits.h>
 #include <assert.h>
+#include <sys/wait.h>
 #include <err.h>
 
 #define _PATH_MYSELF "/testbin/bigexec"
+#define NEXECS 10	/* execs in one run of the test */
 
 ////////////////////////////////////////////////////////////
 // words
@@ -205,6 +210,50 @@ checkmany(int argc, char *argv[], int num, const char *word)
 	return 1;
 }
 
+////////////////////////////////////////////////////////////
+// timing
+
+/*
+ * Fork; the child returns to run the test, and the parent waits for
+ * the whole chain of execs to finish and reports the time.
+ */
+static
+void
+timechain(void)
+{
+	time_t startsecs, endsecs;
+	unsigned long startnsecs, endnsecs, usecs;
+	pid_t pid;
+	int status;
+
+	__time(&startsecs, &startnsecs);
+	pid = fork();
+	if (pid < 0) {
+		err(1, "fork");
+	}
+	if (pid == 0) {
+		return;
+	}
+	if (waitpid(pid, &status, 0) < 0) {
+		err(1, "waitpid");
+	}
+	__time(&endsecs, &endnsecs);
+
+	if (endnsecs < startnsecs) {
+		endnsecs += 1000000000;
+		endsecs--;
+	}
+	usecs = (unsigned long)(endsecs - startsecs) * 1000000
+		+ (endnsecs - startnsecs) / 1000;
+	warnx("%d execs in %lu us, %lu us per exec", NEXECS, usecs,
+	      usecs / NEXECS);
+
+	if (!WIFEXITED(status)) {
+		errx(1, "test did not exit normally");
+	}
+	exit(WEXITSTATUS(status));
+}
+
 ////////////////////////////////////////////////////////////
 // test driver
 
@@ -262,6 +311,7 @@ main(int argc, char *argv[])
 	if (argv == NULL || argc == 0 || argc == 1) {
 		/* no args -- start the test */
 		warnx("Starting.");
+		timechain();
 
 		/*
 		 * 1. Should always fit no matter what.
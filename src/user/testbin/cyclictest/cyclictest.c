@@ -0,0 +1,311 @@
+/*
+ * cyclictest - wakeup latency of periodic sleepers, optionally under load.
+ *
+ * Usage: cyclictest [-t threads] [-i interval_us] [-l loops]
+ *                   [-h hogs] [-m matmults]
+ *
+ * THREADS user threads each sleep with nanosleep until their next
+ * period, LOOPS times, and record how late they woke up. Meanwhile
+ * HOGS processes run /testbin/hog over and over, and MATMULTS run
+ * /testbin/matmult, until the measurement is done.
+ *
+ * Prints one line per thread and one for all of them together:
+ *
+ *	cyclictest T:N interval_us=I loops=L min_us=A avg_us=B p99_us=C
+ *	  max_us=D
+ *
+ * followed by a histogram of the combined latencies in power-of-two
+ * buckets, one "cyclictest hist <Xus=N" line per nonempty bucket.
+ *
+ * Each sleeper is woken by a one-shot hrtimer set for its deadline,
+ * rounded up to the microsecond, so on an idle system the latency is
+ * just the timer interrupt, the softirq and a context switch. Under
+ * load the woken thread may also wait its turn on the run queue. On
+ * a machine with no timer device the kernel falls back to checking
+ * sleepers on hardclock, and latencies are up to one tick (10ms at
+ * HZ=100).
+ */
+
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <err.h>
+#include <kern/time.h>
+
+#define MAXTHREADS	8
+#define MAXLOOPS	1000
+#define MAXLOAD		8
+#define NBUCKETS	20	/* up to 2^19 us, then everything else */
+
+static int nthreads = 1;
+static unsigned long interval = 20000;	/* us */
+static int nloops = 200;
+static int nhogs = 0;
+static int nmatmults = 0;
+
+/* latency of each wakeup, in microseconds, per thread */
+static unsigned long samples[MAXTHREADS][MAXLOOPS];
+/* all of them, for the combined line */
+static unsigned long allsamples[MAXTHREADS * MAXLOOPS];
+
+static time_t basesecs;
+
+/*
+ * Microseconds since basesecs; fine in 32 bits for over an hour.
+ */
+static
+unsigned long
+now_us(void)
+{
+	time_t secs;
+	unsigned long nsecs;
+
+	__time(&secs, &nsecs);
+	return (unsigned long)(secs - basesecs) * 1000000 + nsecs / 1000;
+}
+
+////////////////////////////////////////////////////////////
+// background load
+
+/*
+ * Run PROG again and again until DEADLINE (in now_us time).
+ */
+static
+void
+loadloop(const char *prog, unsigned long deadline)
+{
+	char *args[2];
+	pid_t pid;
+	int status;
+
+	args[0] = (char *)prog;
+	args[1] = NULL;
+	while (now_us() < deadline) {
+		pid = fork();
+		if (pid < 0) {
+			err(1, "fork");
+		}
+		if (pid == 0) {
+			execv(prog, args);
+			err(1, "%s", prog);
+		}
+		if (waitpid(pid, &status, 0) < 0) {
+			err(1, "waitpid");
+		}
+	}
+}
+
+static
+pid_t
+startload(const char *prog, unsigned long deadline)
+{
+	pid_t pid;
+
+	pid = fork();
+	if (pid < 0) {
+		err(1, "fork");
+	}
+	if (pid == 0) {
+		loadloop(prog, deadline);
+		_exit(0);
+	}
+	return pid;
+}
+
+////////////////////////////////////////////////////////////
+// measurement
+
+static
+void
+measure(void *arg)
+{
+	int id = (intptr_t)arg;
+	unsigned long next, now, delta;
+	struct timespec ts;
+	int i;
+
+	next = now_us();
+	for (i=0; i<nloops; i++) {
+		next += interval;
+		now = now_us();
+		if (next > now) {
+			delta = next - now;
+			ts.tv_sec = delta / 1000000;
+			ts.tv_nsec = (delta % 1000000) * 1000;
+			if (nanosleep(&ts, NULL) < 0) {
+				err(1, "nanosleep");
+			}
+			now = now_us();
+		}
+		samples[id][i] = now > next ? now - next : 0;
+	}
+	_exit(0);
+}
+
+////////////////////////////////////////////////////////////
+// reporting
+
+static
+void
+sortsamples(unsigned long *v, int n)
+{
+	unsigned long t;
+	int i, j;
+
+	for (i=1; i<n; i++) {
+		t = v[i];
+		for (j=i; j>0 && v[j-1] > t; j--) {
+			v[j] = v[j-1];
+		}
+		v[j] = t;
+	}
+}
+
+/*
+ * Print the summary line for the N samples in V, which get sorted.
+ */
+static
+void
+report(const char *label, unsigned long *v, int n)
+{
+	unsigned long q = 0, r = 0;
+	int i;
+
+	sortsamples(v, n);
+	/* the mean, without overflowing the sum */
+	for (i=0; i<n; i++) {
+		q += v[i] / n;
+		r += v[i] % n;
+	}
+	printf("cyclictest %s interval_us=%lu loops=%d min_us=%lu "
+	       "avg_us=%lu p99_us=%lu max_us=%lu\n", label, interval, n,
+	       v[0], q + r / n, v[(n * 99) / 100], v[n - 1]);
+}
+
+static
+void
+histogram(const unsigned long *v, int n)
+{
+	int counts[NBUCKETS];
+	int i, b;
+
+	for (b=0; b<NBUCKETS; b++) {
+		counts[b] = 0;
+	}
+	for (i=0; i<n; i++) {
+		for (b=0; b<NBUCKETS-1 && v[i] >= (1UL << b); b++) {
+			/* nothing */
+		}
+		counts[b]++;
+	}
+	for (b=0; b<NBUCKETS; b++) {
+		if (counts[b] == 0) {
+			continue;
+		}
+		if (b < NBUCKETS-1) {
+			printf("cyclictest hist <%luus=%d\n", 1UL << b,
+			       counts[b]);
+		}
+		else {
+			printf("cyclictest hist >=%luus=%d\n",
+			       1UL << (NBUCKETS-2), counts[b]);
+		}
+	}
+}
+
+static
+void
+usage(void)
+{
+	errx(1, "Usage: cyclictest [-t threads] [-i interval_us] [-l loops] "
+	     "[-h hogs] [-m matmults]");
+}
+
+int
+main(int argc, char *argv[])
+{
+	pid_t tids[MAXTHREADS], loadpids[2 * MAXLOAD];
+	unsigned long nsecs, deadline;
+	char label[16];
+	int i, nload = 0, status, total = 0;
+
+	for (i=1; i<argc; i++) {
+		if (argv[i][0] != '-' || i+1 == argc) {
+			usage();
+		}
+		if (!strcmp(argv[i], "-t")) {
+			nthreads = atoi(argv[++i]);
+		}
+		else if (!strcmp(argv[i], "-i")) {
+			interval = atoi(argv[++i]);
+		}
+		else if (!strcmp(argv[i], "-l")) {
+			nloops = atoi(argv[++i]);
+		}
+		else if (!strcmp(argv[i], "-h")) {
+			nhogs = atoi(argv[++i]);
+		}
+		else if (!strcmp(argv[i], "-m")) {
+			nmatmults = atoi(argv[++i]);
+		}
+		else {
+			usage();
+		}
+	}
+	if (nthreads < 1 || nthreads > MAXTHREADS) {
+		errx(1, "threads must be 1-%d", MAXTHREADS);
+	}
+	if (nloops < 1 || nloops > MAXLOOPS) {
+		errx(1, "loops must be 1-%d", MAXLOOPS);
+	}
+	if (nhogs < 0 || nhogs > MAXLOAD || nmatmults < 0 ||
+	    nmatmults > MAXLOAD) {
+		errx(1, "hogs and matmults must be 0-%d", MAXLOAD);
+	}
+	if (interval < 1) {
+		errx(1, "interval must be positive");
+	}
+
+	__time(&basesecs, &nsecs);
+
+	/* Keep the load going a little past the end of the measurement */
+	deadline = now_us() + (nloops + 10) * interval;
+	for (i=0; i<nhogs; i++) {
+		loadpids[nload++] = startload("/testbin/hog", deadline);
+	}
+	for (i=0; i<nmatmults; i++) {
+		loadpids[nload++] = startload("/testbin/matmult", deadline);
+	}
+
+	for (i=0; i<nthreads; i++) {
+		tids[i] = __threadfork(measure, (void *)(intptr_t)i);
+		if (tids[i] < 0) {
+			err(1, "threadfork");
+		}
+	}
+	for (i=0; i<nthreads; i++) {
+		if (threadjoin(tids[i], &status) < 0) {
+			err(1, "threadjoin");
+		}
+	}
+	for (i=0; i<nload; i++) {
+		if (waitpid(loadpids[i], &status, 0) < 0) {
+			err(1, "waitpid");
+		}
+	}
+
+	for (i=0; i<nthreads; i++) {
+		memcpy(&allsamples[total], samples[i],
+		       nloops * sizeof(samples[i][0]));
+		total += nloops;
+		snprintf(label, sizeof(label), "T:%d", i);
+		report(label, samples[i], nloops);
+	}
+	report("all", allsamples, total);
+	histogram(allsamples, total);
+	return 0;
+}
@@ -0,0 +1,418 @@
+/*
+ * fsbench - file system data and metadata throughput.
+ *
+ * Usage: fsbench [-b blocksize] [-s filekb] [-n files] [-p procs] [dir...]
+ *
+ * For each directory named (default emu0:, the emulator passthrough;
+ * name e.g. lhd1: for an SFS volume on a disk) this runs
+ *
+ *	seqwrite, seqread	FILEKB of one file, BLOCKSIZE per call
+ *	randwrite, randread	as many BLOCKSIZE calls at random blocks
+ *	fsync			one-block write plus fsync, repeated
+ *	create, stat, unlink	FILES empty files in the directory
+ *	pseqwrite, pseqread,	the same as above, in PROCS processes at
+ *	pcreate			once, each with its own files
+ *
+ * and prints one line per test:
+ *
+ *	fsbench DIR TEST bs=B ops=N total_us=T us_per_op=U kb_per_sec=K
+ *
+ * kb_per_sec is 0 for the metadata tests. For fsync, us_per_op is the
+ * mean and the line also has max_us.
+ */
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <err.h>
+
+#define MAXBLOCK	65536
+#define MAXPROCS	8
+#define NFSYNC		32
+
+static int blocksize = 4096;
+static int filekb = 256;
+static int nfiles = 64;
+static int nprocs = 4;
+
+static char buf[MAXBLOCK];
+
+////////////////////////////////////////////////////////////
+// timing
+
+static time_t startsecs;
+static unsigned long startnsecs;
+
+static
+void
+timer_start(void)
+{
+	__time(&startsecs, &startnsecs);
+}
+
+/*
+ * Microseconds since timer_start.
+ */
+static
+unsigned long
+timer_us(void)
+{
+	time_t endsecs;
+	unsigned long endnsecs;
+
+	__time(&endsecs, &endnsecs);
+	if (endnsecs < startnsecs) {
+		endnsecs += 1000000000;
+		endsecs--;
+	}
+	return (unsigned long)(endsecs - startsecs) * 1000000
+		+ (endnsecs - startnsecs) / 1000;
+}
+
+/*
+ * Print a result line; BYTES is the total data moved, or 0.
+ */
+static
+void
+report(const char *dir, const char *test, int ops, unsigned long us,
+       unsigned long bytes)
+{
+	if (us == 0) {
+		us = 1;
+	}
+	printf("fsbench %s %s bs=%d ops=%d total_us=%lu us_per_op=%lu "
+	       "kb_per_sec=%lu", dir, test, blocksize, ops, us,
+	       ops ? us / ops : 0,
+	       /* KB * 1e6 / us, ordered to stay in 32 bits */
+	       bytes / 1024 * 1000 / (us / 1000 + 1));
+}
+
+////////////////////////////////////////////////////////////
+// files
+
+static
+void
+mkname(char *name, size_t len, const char *dir, const char *what, int n)
+{
+	size_t dl = strlen(dir);
+
+	if (dl > 0 && dir[dl-1] != ':' && dir[dl-1] != '/') {
+		snprintf(name, len, "%s/fsb-%s-%d", dir, what, n);
+	}
+	else {
+		snprintf(name, len, "%sfsb-%s-%d", dir, what, n);
+	}
+}
+
+static
+int
+openfile(const char *name, int flags)
+{
+	int fd;
+
+	fd = open(name, flags, 0664);
+	if (fd < 0) {
+		err(1, "%s", name);
+	}
+	return fd;
+}
+
+static
+void
+doio(int fd, const char *name, int dowrite)
+{
+	int r;
+
+	r = dowrite ? write(fd, buf, blocksize) : read(fd, buf, blocksize);
+	if (r < 0) {
+		err(1, "%s: %s", name, dowrite ? "write" : "read");
+	}
+	if (r != blocksize) {
+		errx(1, "%s: short %s", name, dowrite ? "write" : "read");
+	}
+}
+
+/*
+ * Sequential pass over the file, start to end. Returns microseconds.
+ */
+static
+unsigned long
+seqpass(const char *name, int dowrite)
+{
+	unsigned long us;
+	int fd, i, nblocks = filekb * 1024 / blocksize;
+
+	fd = openfile(name, dowrite ? O_WRONLY|O_CREAT|O_TRUNC : O_RDONLY);
+	timer_start();
+	for (i=0; i<nblocks; i++) {
+		doio(fd, name, dowrite);
+	}
+	us = timer_us();
+	close(fd);
+	return us;
+}
+
+/*
+ * The same number of blocks, each at a random block of the file.
+ */
+static
+unsigned long
+randpass(const char *name, int dowrite)
+{
+	unsigned long us;
+	int fd, i, nblocks = filekb * 1024 / blocksize;
+
+	fd = openfile(name, dowrite ? O_WRONLY : O_RDONLY);
+	timer_start();
+	for (i=0; i<nblocks; i++) {
+		if (lseek(fd, (off_t)(random() % nblocks) * blocksize,
+			  SEEK_SET) < 0) {
+			err(1, "%s: lseek", name);
+		}
+		doio(fd, name, dowrite);
+	}
+	us = timer_us();
+	close(fd);
+	return us;
+}
+
+/*
+ * Create, stat, then unlink NFILES files; times go in US[0..2].
+ */
+static
+void
+metapass(const char *dir, int id, unsigned long us[3])
+{
+	char name[PATH_MAX];
+	struct stat st;
+	int i, fd;
+
+	timer_start();
+	for (i=0; i<nfiles; i++) {
+		mkname(name, sizeof(name), dir, "meta", id * nfiles + i);
+		fd = openfile(name, O_WRONLY|O_CREAT|O_EXCL);
+		close(fd);
+	}
+	us[0] = timer_us();
+
+	timer_start();
+	for (i=0; i<nfiles; i++) {
+		mkname(name, sizeof(name), dir, "meta", id * nfiles + i);
+		if (stat(name, &st) < 0) {
+			err(1, "stat %s", name);
+		}
+	}
+	us[1] = timer_us();
+
+	timer_start();
+	for (i=0; i<nfiles; i++) {
+		mkname(name, sizeof(name), dir, "meta", id * nfiles + i);
+		if (remove(name) < 0) {
+			err(1, "remove %s", name);
+		}
+	}
+	us[2] = timer_us();
+}
+
+////////////////////////////////////////////////////////////
+// tests
+
+static
+void
+bench_data(const char *dir)
+{
+	char name[PATH_MAX];
+	unsigned long bytes = (unsigned long)filekb * 1024;
+	int ops = filekb * 1024 / blocksize;
+
+	mkname(name, sizeof(name), dir, "data", 0);
+	memset(buf, 'f', blocksize);
+
+	report(dir, "seqwrite", ops, seqpass(name, 1), bytes);
+	printf("\n");
+	report(dir, "seqread", ops, seqpass(name, 0), bytes);
+	printf("\n");
+	report(dir, "randwrite", ops, randpass(name, 1), bytes);
+	printf("\n");
+	report(dir, "randread", ops, randpass(name, 0), bytes);
+	printf("\n");
+
+	if (remove(name) < 0) {
+		err(1, "remove %s", name);
+	}
+}
+
+static
+void
+bench_fsync(const char *dir)
+{
+	char name[PATH_MAX];
+	unsigned long us, total = 0, max = 0;
+	int fd, i;
+
+	mkname(name, sizeof(name), dir, "fsync", 0);
+	fd = openfile(name, O_WRONLY|O_CREAT|O_TRUNC);
+	for (i=0; i<NFSYNC; i++) {
+		timer_start();
+		doio(fd, name, 1);
+		if (fsync(fd) < 0) {
+			err(1, "%s: fsync", name);
+		}
+		us = timer_us();
+		total += us;
+		if (us > max) {
+			max = us;
+		}
+	}
+	close(fd);
+	if (remove(name) < 0) {
+		err(1, "remove %s", name);
+	}
+
+	report(dir, "fsync", NFSYNC, total, 0);
+	printf(" max_us=%lu\n", max);
+}
+
+static
+void
+bench_meta(const char *dir)
+{
+	unsigned long us[3];
+
+	metapass(dir, 0, us);
+	report(dir, "create", nfiles, us[0], 0);
+	printf("\n");
+	report(dir, "stat", nfiles, us[1], 0);
+	printf("\n");
+	report(dir, "unlink", nfiles, us[2], 0);
+	printf("\n");
+}
+
+/*
+ * Run WHAT in NPROCS child processes at once and time them all.
+ * 0: sequential write, 1: sequential read, 2: create/stat/unlink.
+ */
+static
+unsigned long
+runprocs(const char *dir, int what)
+{
+	char name[PATH_MAX];
+	unsigned long us[3];
+	pid_t pids[MAXPROCS];
+	int i, status, failed = 0;
+
+	timer_start();
+	for (i=0; i<nprocs; i++) {
+		pids[i] = fork();
+		if (pids[i] < 0) {
+			err(1, "fork");
+		}
+		if (pids[i] == 0) {
+			mkname(name, sizeof(name), dir, "pdata", i);
+			if (what == 2) {
+				metapass(dir, i + 1, us);
+			}
+			else {
+				seqpass(name, what == 0);
+			}
+			_exit(0);
+		}
+	}
+	for (i=0; i<nprocs; i++) {
+		if (waitpid(pids[i], &status, 0) < 0) {
+			err(1, "waitpid");
+		}
+		if (status != 0) {
+			failed++;
+		}
+	}
+	if (failed > 0) {
+		errx(1, "%d of %d processes failed", failed, nprocs);
+	}
+	return timer_us();
+}
+
+static
+void
+bench_procs(const char *dir)
+{
+	char name[PATH_MAX];
+	unsigned long bytes = (unsigned long)filekb * 1024 * nprocs;
+	int ops = filekb * 1024 / blocksize * nprocs;
+	int i;
+
+	report(dir, "pseqwrite", ops, runprocs(dir, 0), bytes);
+	printf(" procs=%d\n", nprocs);
+	report(dir, "pseqread", ops, runprocs(dir, 1), bytes);
+	printf(" procs=%d\n", nprocs);
+	/* create + stat + unlink of each file */
+	report(dir, "pcreate", nfiles * 3 * nprocs, runprocs(dir, 2), 0);
+	printf(" procs=%d\n", nprocs);
+
+	for (i=0; i<nprocs; i++) {
+		mkname(name, sizeof(name), dir, "pdata", i);
+		if (remove(name) < 0) {
+			err(1, "remove %s", name);
+		}
+	}
+}
+
+static
+void
+usage(void)
+{
+	errx(1, "Usage: fsbench [-b blocksize] [-s filekb] [-n files] "
+	     "[-p procs] [dir...]");
+}
+
+int
+main(int argc, char *argv[])
+{
+	int i;
+
+	for (i=1; i<argc && argv[i][0] == '-'; i++) {
+		if (i+1 == argc) {
+			usage();
+		}
+		if (!strcmp(argv[i], "-b")) {
+			blocksize = atoi(argv[++i]);
+		}
+		else if (!strcmp(argv[i], "-s")) {
+			filekb = atoi(argv[++i]);
+		}
+		else if (!strcmp(argv[i], "-n")) {
+			nfiles = atoi(argv[++i]);
+		}
+		else if (!strcmp(argv[i], "-p")) {
+			nprocs = atoi(argv[++i]);
+		}
+		else {
+			usage();
+		}
+	}
+	if (blocksize < 1 || blocksize > MAXBLOCK) {
+		errx(1, "blocksize must be 1-%d", MAXBLOCK);
+	}
+	if (filekb < 1 || filekb * 1024 < blocksize) {
+		errx(1, "file must hold at least one block");
+	}
+	if (nfiles < 1 || nprocs < 1 || nprocs > MAXPROCS) {
+		errx(1, "need at least one file and 1-%d procs", MAXPROCS);
+	}
+
+	if (i == argc) {
+		argv[--i] = (char *)"emu0:";
+	}
+	for (; i<argc; i++) {
+		bench_data(argv[i]);
+		bench_fsync(argv[i]);
+		bench_meta(argv[i]);
+		bench_procs(argv[i]);
+	}
+	return 0;
+}
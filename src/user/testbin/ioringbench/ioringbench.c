@@ -0,0 +1,365 @@
+/*
+ * ioringbench - compare batched ioring I/O with plain read/write.
+ *
+ * Usage: ioringbench [nops [blocksize [batch]]]
+ *
+ * Writes and then reads back NOPS blocks of BLOCKSIZE bytes in a
+ * scratch file, first with one write()/read() call per block, then
+ * through an ioring with BATCH operations per ioring_enter, then (in
+ * a child process, since a process has only one ring) through an
+ * SQPOLL ring. Open/close pairs are timed the same way.
+ *
+ * The scratch file is left behind in the current directory.
+ */
+
+#include <sys/types.h>
+#include <kern/ioring.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <err.h>
+
+#define FILENAME	"ioringbench.tmp"
+#define MAXBLOCK	4096
+#define MAXOPENBATCH	32	/* stay well under OPEN_MAX */
+
+static char buf[MAXBLOCK];
+static int nops = 256;
+static int blocksize = 512;
+static int batch = 32;
+
+struct ring {
+	struct ioring_hdr *hdr;
+	struct ioring_sqe *sqes;
+	struct ioring_cqe *cqes;
+	unsigned sqmask;
+	unsigned cqmask;
+	int sqpoll;
+};
+
+static struct ring ring;
+
+/* Keep the compiler from moving ring stores across index updates */
+#define barrier() __asm volatile("" ::: "memory")
+
+////////////////////////////////////////////////////////////
+// timing
+
+static time_t startsecs;
+static unsigned long startnsecs;
+
+static
+void
+timer_start(void)
+{
+	__time(&startsecs, &startnsecs);
+}
+
+static
+void
+timer_report(const char *what, int ops)
+{
+	time_t endsecs;
+	unsigned long endnsecs, usecs, rate;
+
+	__time(&endsecs, &endnsecs);
+	if (endnsecs < startnsecs) {
+		endnsecs += 1000000000;
+		endsecs--;
+	}
+	usecs = (unsigned long)(endsecs - startsecs) * 1000000
+		+ (endnsecs - startnsecs) / 1000;
+	rate = usecs ? (unsigned long)ops * 1000000 / usecs : 0;
+
+	printf("%-22s %6d ops %10lu us %8lu ops/s\n", what, ops, usecs, rate);
+}
+
+////////////////////////////////////////////////////////////
+// ring helpers
+
+static
+void
+ring_init(int flags)
+{
+	void *base;
+
+	if (ioring_setup(batch, flags, &base)) {
+		err(1, "ioring_setup");
+	}
+	ring.hdr = base;
+	ring.sqes = (struct ioring_sqe *)((char *)base + ring.hdr->ir_sqoff);
+	ring.cqes = (struct ioring_cqe *)((char *)base + ring.hdr->ir_cqoff);
+	ring.sqmask = ring.hdr->ir_sqentries - 1;
+	ring.cqmask = ring.hdr->ir_cqentries - 1;
+	ring.sqpoll = (flags & IORING_SETUP_SQPOLL) != 0;
+}
+
+static
+void
+ring_queue(unsigned op, int fd, const void *addr, unsigned len, int oflags,
+	   unsigned userdata)
+{
+	struct ioring_sqe *sqe;
+	unsigned tail;
+
+	tail = ring.hdr->sq_tail;
+	if (tail - ring.hdr->sq_head > ring.sqmask) {
+		errx(1, "submission queue overflow");
+	}
+	sqe = &ring.sqes[tail & ring.sqmask];
+	sqe->sqe_op = op;
+	sqe->sqe_fd = fd;
+	sqe->sqe_addr = (__u32)addr;
+	sqe->sqe_len = len;
+	sqe->sqe_flags = oflags;
+	sqe->sqe_userdata = userdata;
+	barrier();
+	ring.hdr->sq_tail = tail + 1;
+}
+
+/*
+ * Submit N queued operations and wait for their completions. With
+ * SQPOLL the poller consumes the SQ; we only wake it if it went to
+ * sleep, and wait.
+ */
+static
+void
+ring_enter(unsigned n)
+{
+	int flags = IORING_ENTER_GETEVENTS;
+	unsigned submit = n;
+
+	if (ring.sqpoll) {
+		submit = 0;
+		if (ring.hdr->sq_flags & IORING_SQ_NEED_WAKEUP) {
+			flags |= IORING_ENTER_SQ_WAKEUP;
+		}
+	}
+	if (ioring_enter(submit, n, flags) < 0) {
+		err(1, "ioring_enter");
+	}
+}
+
+/*
+ * Reap one completion; returns its result.
+ */
+static
+int
+ring_reap(unsigned *userdata)
+{
+	struct ioring_cqe *cqe;
+	unsigned head;
+	int res;
+
+	head = ring.hdr->cq_head;
+	while (ring.hdr->cq_tail == head) {
+		if (ioring_enter(0, 1, IORING_ENTER_GETEVENTS) < 0) {
+			err(1, "ioring_enter");
+		}
+	}
+	barrier();
+	cqe = &ring.cqes[head & ring.cqmask];
+	res = cqe->cqe_res;
+	if (userdata != NULL) {
+		*userdata = cqe->cqe_userdata;
+	}
+	ring.hdr->cq_head = head + 1;
+	return res;
+}
+
+////////////////////////////////////////////////////////////
+// tests
+
+static
+int
+openfile(int flags)
+{
+	int fd;
+
+	fd = open(FILENAME, flags, 0664);
+	if (fd < 0) {
+		err(1, "%s", FILENAME);
+	}
+	return fd;
+}
+
+static
+void
+plain_rw(void)
+{
+	int fd, i, r;
+
+	fd = openfile(O_WRONLY|O_CREAT|O_TRUNC);
+	timer_start();
+	for (i=0; i<nops; i++) {
+		r = write(fd, buf, blocksize);
+		if (r != blocksize) {
+			err(1, "write");
+		}
+	}
+	timer_report("write()", nops);
+	close(fd);
+
+	fd = openfile(O_RDONLY);
+	timer_start();
+	for (i=0; i<nops; i++) {
+		r = read(fd, buf, blocksize);
+		if (r != blocksize) {
+			err(1, "read");
+		}
+	}
+	timer_report("read()", nops);
+	close(fd);
+}
+
+static
+void
+plain_openclose(void)
+{
+	int i;
+
+	timer_start();
+	for (i=0; i<nops; i++) {
+		close(openfile(O_RDONLY));
+	}
+	timer_report("open()+close()", nops);
+}
+
+static
+void
+ring_rw1(unsigned op, int fd)
+{
+	int done, n, i, r;
+
+	for (done = 0; done < nops; done += n) {
+		n = nops - done < batch ? nops - done : batch;
+		for (i=0; i<n; i++) {
+			ring_queue(op, fd, buf, blocksize, 0, done + i);
+		}
+		ring_enter(n);
+		for (i=0; i<n; i++) {
+			r = ring_reap(NULL);
+			if (r != blocksize) {
+				errx(1, "ring %s: result %d",
+				     op == IORING_OP_READ ? "read" : "write",
+				     r);
+			}
+		}
+	}
+}
+
+static
+void
+ring_rw(const char *tag)
+{
+	char what[32];
+	int fd;
+
+	fd = openfile(O_WRONLY|O_CREAT|O_TRUNC);
+	timer_start();
+	ring_rw1(IORING_OP_WRITE, fd);
+	snprintf(what, sizeof(what), "%s write", tag);
+	timer_report(what, nops);
+	close(fd);
+
+	fd = openfile(O_RDONLY);
+	timer_start();
+	ring_rw1(IORING_OP_READ, fd);
+	snprintf(what, sizeof(what), "%s read", tag);
+	timer_report(what, nops);
+	close(fd);
+}
+
+static
+void
+ring_openclose(const char *tag)
+{
+	char what[32];
+	int fds[MAXOPENBATCH];
+	int done, n, i, r;
+	unsigned ud;
+
+	timer_start();
+	for (done = 0; done < nops; done += n) {
+		n = nops - done;
+		if (n > batch) {
+			n = batch;
+		}
+		if (n > MAXOPENBATCH) {
+			n = MAXOPENBATCH;
+		}
+		for (i=0; i<n; i++) {
+			ring_queue(IORING_OP_OPEN, -1, FILENAME, 0, O_RDONLY, i);
+		}
+		ring_enter(n);
+		for (i=0; i<n; i++) {
+			r = ring_reap(&ud);
+			if (r < 0 || ud >= (unsigned)n) {
+				errx(1, "ring open: result %d", r);
+			}
+			fds[ud] = r;
+		}
+		for (i=0; i<n; i++) {
+			ring_queue(IORING_OP_CLOSE, fds[i], NULL, 0, 0, i);
+		}
+		ring_enter(n);
+		for (i=0; i<n; i++) {
+			r = ring_reap(NULL);
+			if (r != 0) {
+				errx(1, "ring close: result %d", r);
+			}
+		}
+	}
+	snprintf(what, sizeof(what), "%s open+close", tag);
+	timer_report(what, nops);
+}
+
+int
+main(int argc, char *argv[])
+{
+	pid_t pid;
+	int status;
+
+	if (argc > 1) {
+		nops = atoi(argv[1]);
+	}
+	if (argc > 2) {
+		blocksize = atoi(argv[2]);
+	}
+	if (argc > 3) {
+		batch = atoi(argv[3]);
+	}
+	if (nops <= 0 || blocksize <= 0 || blocksize > MAXBLOCK ||
+	    batch <= 0 || batch > IORING_MAX_ENTRIES) {
+		errx(1, "Usage: ioringbench [nops [blocksize [batch]]]");
+	}
+	memset(buf, 'r', sizeof(buf));
+
+	printf("ioringbench: %d ops, %d-byte blocks, batch %d\n",
+	       nops, blocksize, batch);
+
+	plain_rw();
+	plain_openclose();
+
+	ring_init(0);
+	ring_rw("ring");
+	ring_openclose("ring");
+
+	/* One ring per process: do the SQPOLL run in a child. */
+	pid = fork();
+	if (pid < 0) {
+		err(1, "fork");
+	}
+	if (pid == 0) {
+		ring_init(IORING_SETUP_SQPOLL);
+		ring_rw("sqpoll");
+		ring_openclose("sqpoll");
+		_exit(0);
+	}
+	if (waitpid(pid, &status, 0) < 0) {
+		err(1, "waitpid");
+	}
+
+	return 0;
+}
@@ -0,0 +1,215 @@
+/*
+ * mallocreplay - replay a malloc/free trace and measure the allocator.
+ *
+ * Usage: mallocreplay tracefile
+ *        mallocreplay -g ops tracefile
+ *
+ * Traces are in the format of <kern/mtrace.h>; record one by building
+ * libc with MALLOCTRACE defined in malloc.c and running any program,
+ * or use -g to write a synthetic one (a random mix of sizes with up
+ * to MAXLIVE blocks live) first.
+ *
+ * Reports, on one line:
+ *	ops		records replayed
+ *	ops_per_sec	malloc and free calls per second
+ *	peak_live	most bytes requested and not yet freed at once
+ *	heap		how far the heap grew (sbrk high-water mark)
+ *	frag_pct	share of the heap not holding live data at the peak
+ */
+
+#include <sys/types.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <err.h>
+#include <kern/mtrace.h>
+
+#define MAXRECS		4096
+#define HASHSIZE	(2 * MAXRECS)	/* a power of 2 */
+#define MAXLIVE		128		/* for -g */
+#define MAXGENSIZE	2048		/* for -g */
+
+#define OP_SKIP		0		/* free of a block we never saw */
+
+static struct mtrace_rec recs[MAXRECS];
+static void *ptrs[MAXRECS];
+static unsigned nrecs;
+
+/* address -> index of the malloc record that returned it */
+static struct {
+	uint32_t addr;
+	unsigned ix;
+} hashtab[HASHSIZE];
+
+////////////////////////////////////////////////////////////
+// trace files
+
+static
+void
+gentrace(const char *path, unsigned nops)
+{
+	struct mtrace_rec rec;
+	uint32_t live[MAXLIVE];
+	unsigned nlive = 0, i, j, nextaddr = 1;
+	int fd;
+
+	fd = open(path, O_WRONLY|O_CREAT|O_TRUNC, 0664);
+	if (fd < 0) {
+		err(1, "%s", path);
+	}
+	for (i=0; i<nops; i++) {
+		if (nlive == MAXLIVE || (nlive > 0 && random() % 3 == 0)) {
+			j = random() % nlive;
+			rec.mt_op = MTRACE_FREE;
+			rec.mt_addr = live[j];
+			rec.mt_size = 0;
+			live[j] = live[--nlive];
+		}
+		else {
+			rec.mt_op = MTRACE_MALLOC;
+			rec.mt_addr = nextaddr++;
+			/* mostly small, sometimes large */
+			rec.mt_size = random() % 4 == 0 ?
+				random() % MAXGENSIZE + 1 : random() % 64 + 1;
+			live[nlive++] = rec.mt_addr;
+		}
+		if (write(fd, &rec, sizeof(rec)) != sizeof(rec)) {
+			err(1, "%s: write", path);
+		}
+	}
+	close(fd);
+}
+
+static
+void
+readtrace(const char *path)
+{
+	int fd, r;
+
+	fd = open(path, O_RDONLY);
+	if (fd < 0) {
+		err(1, "%s", path);
+	}
+	r = read(fd, recs, sizeof(recs));
+	if (r < 0) {
+		err(1, "%s: read", path);
+	}
+	close(fd);
+	if (r == sizeof(recs)) {
+		warnx("%s: only replaying the first %d records", path,
+		      MAXRECS);
+	}
+	nrecs = r / sizeof(struct mtrace_rec);
+}
+
+/*
+ * Rewrite each record's address as a record index: a malloc gets its
+ * own index and a free the index of the malloc it undoes. This way
+ * the timed loop needs no lookups.
+ */
+static
+void
+maptrace(void)
+{
+	unsigned i, h;
+
+	for (i=0; i<nrecs; i++) {
+		h = (recs[i].mt_addr * 2654435761U) & (HASHSIZE - 1);
+		while (hashtab[h].addr != 0 &&
+		       hashtab[h].addr != recs[i].mt_addr) {
+			h = (h + 1) & (HASHSIZE - 1);
+		}
+
+		if (recs[i].mt_op == MTRACE_MALLOC) {
+			/* a reused address replaces the old entry */
+			hashtab[h].addr = recs[i].mt_addr;
+			hashtab[h].ix = i;
+			recs[i].mt_addr = i;
+		}
+		else if (recs[i].mt_op == MTRACE_FREE &&
+			 hashtab[h].addr != 0 &&
+			 ptrs[hashtab[h].ix] == NULL) {
+			recs[i].mt_addr = hashtab[h].ix;
+			/* mark it freed until reallocated */
+			ptrs[hashtab[h].ix] = (void *)1;
+		}
+		else {
+			recs[i].mt_op = OP_SKIP;
+		}
+	}
+	bzero(ptrs, sizeof(ptrs));
+}
+
+////////////////////////////////////////////////////////////
+// replay
+
+int
+main(int argc, char *argv[])
+{
+	time_t s1, s2;
+	unsigned long ns1, ns2, us, live = 0, peak = 0, heap;
+	uintptr_t base, top;
+	unsigned i, ix;
+
+	if (argc == 4 && !strcmp(argv[1], "-g")) {
+		gentrace(argv[3], atoi(argv[2]));
+		argv[1] = argv[3];
+	}
+	else if (argc != 2) {
+		errx(1, "Usage: mallocreplay [-g ops] tracefile");
+	}
+
+	readtrace(argv[1]);
+	maptrace();
+
+	base = (uintptr_t)sbrk(0);
+
+	__time(&s1, &ns1);
+	for (i=0; i<nrecs; i++) {
+		switch (recs[i].mt_op) {
+		    case MTRACE_MALLOC:
+			ptrs[i] = malloc(recs[i].mt_size);
+			if (ptrs[i] == NULL) {
+				errx(1, "malloc of %u failed at record %u",
+				     recs[i].mt_size, i);
+			}
+			live += recs[i].mt_size;
+			if (live > peak) {
+				peak = live;
+			}
+			break;
+		    case MTRACE_FREE:
+			ix = recs[i].mt_addr;
+			free(ptrs[ix]);
+			ptrs[ix] = NULL;
+			live -= recs[ix].mt_size;
+			break;
+		}
+	}
+	__time(&s2, &ns2);
+
+	/* The heap never shrinks, so this is the high-water mark */
+	top = (uintptr_t)sbrk(0);
+	heap = top - base;
+
+	if (ns2 < ns1) {
+		ns2 += 1000000000;
+		s2--;
+	}
+	us = (unsigned long)(s2 - s1) * 1000000 + (ns2 - ns1) / 1000;
+
+	printf("mallocreplay ops=%u total_us=%lu ops_per_sec=%lu "
+	       "peak_live=%lu heap=%lu frag_pct=%lu\n",
+	       nrecs, us, (unsigned long)nrecs * 1000 / (us / 1000 + 1),
+	       peak, heap, heap > peak ? (heap - peak) * 100 / heap : 0);
+
+	for (i=0; i<nrecs; i++) {
+		if (ptrs[i] != NULL) {
+			free(ptrs[i]);
+		}
+	}
+	return 0;
+}
@@ -0,0 +1,404 @@
+/*
+ * osbench - lmbench-style timings of OS primitives from user level.
+ *
+ * Usage: osbench [-n samples] [-f file] [test...]
+ *
+ * Tests: null fork exec fault write read console (default: all).
+ *
+ * Each test takes SAMPLES timings (batching cheap operations so that
+ * one timing is well above the clock's resolution) and prints the
+ * median and 99th percentile cost per operation, one line per test,
+ * so that runs on different kernel builds can be compared:
+ *
+ *	osbench NAME samples=N median_ns=M p99_ns=P [kb_per_sec=K]
+ *
+ * The file tests write and then read FILE (default emu0:osbench.tmp)
+ * FILEKB kilobytes at a time; the bandwidth is at the median.
+ */
+
+#include <sys/types.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <err.h>
+
+#define MAXSAMPLES	1000
+#define NULLBATCH	200		/* getpid calls per sample */
+#define FAULTPAGES	8		/* pages touched per sample */
+#define PAGESIZE	4096
+#define FILEKB		64		/* file size for read/write */
+#define IOSIZE		4096		/* bytes per read/write call */
+#define CONSOLELINE	64		/* bytes per console write */
+
+/*
+ * Kept small by default: dumbvm never frees memory, so each fork and
+ * exec sample (and every page of faultbuf, in each child) uses up RAM
+ * for good. Use -n for more samples on a VM that frees.
+ */
+static int nsamples = 11;
+static const char *filename = "emu0:osbench.tmp";
+static unsigned long samples[MAXSAMPLES];
+
+static char faultbuf[FAULTPAGES * PAGESIZE];
+static char iobuf[IOSIZE];
+
+////////////////////////////////////////////////////////////
+// timing
+
+static time_t startsecs;
+static unsigned long startnsecs;
+
+static
+void
+timer_start(void)
+{
+	__time(&startsecs, &startnsecs);
+}
+
+/*
+ * Nanoseconds since timer_start, divided by N operations.
+ */
+static
+unsigned long
+timer_read(int n)
+{
+	time_t endsecs;
+	unsigned long endnsecs, usecs;
+
+	__time(&endsecs, &endnsecs);
+	if (endnsecs < startnsecs) {
+		endnsecs += 1000000000;
+		endsecs--;
+	}
+	if (endsecs - startsecs < 4) {
+		/* fits in 32 bits */
+		return ((unsigned long)(endsecs - startsecs) * 1000000000
+			+ (endnsecs - startnsecs)) / n;
+	}
+	usecs = (unsigned long)(endsecs - startsecs) * 1000000
+		+ (endnsecs - startnsecs) / 1000;
+	return usecs / n * 1000;
+}
+
+////////////////////////////////////////////////////////////
+// reporting
+
+static
+void
+sortsamples(int n)
+{
+	unsigned long t;
+	int i, j;
+
+	for (i=1; i<n; i++) {
+		t = samples[i];
+		for (j=i; j>0 && samples[j-1] > t; j--) {
+			samples[j] = samples[j-1];
+		}
+		samples[j] = t;
+	}
+}
+
+/*
+ * Print the line for NAME. If BYTES is nonzero, each operation moved
+ * that many bytes, and the bandwidth at the median is printed too.
+ */
+static
+void
+report(const char *name, unsigned long bytes)
+{
+	unsigned long median, p99;
+
+	sortsamples(nsamples);
+	median = samples[nsamples / 2];
+	p99 = samples[(nsamples * 99) / 100];
+
+	printf("osbench %s samples=%d median_ns=%lu p99_ns=%lu", name,
+	       nsamples, median, p99);
+	if (bytes > 0 && median > 0) {
+		/* KB/s = (bytes/1024) / (median/1e9), kept in 32 bits */
+		printf(" kb_per_sec=%lu",
+		       (bytes / 1024) * 1000000 / (median / 1000 + 1));
+	}
+	printf("\n");
+}
+
+////////////////////////////////////////////////////////////
+// tests
+
+static
+void
+test_null(void)
+{
+	volatile pid_t sink;
+	int i, j;
+
+	for (i=0; i<nsamples; i++) {
+		timer_start();
+		for (j=0; j<NULLBATCH; j++) {
+			sink = __sys_getpid();
+		}
+		samples[i] = timer_read(NULLBATCH);
+	}
+	(void)sink;
+	report("null", 0);
+}
+
+/*
+ * Fork a child that runs PROG (or just exits if PROG is null) and
+ * wait for it.
+ */
+static
+void
+forkwait(const char *prog)
+{
+	char *args[2];
+	pid_t pid;
+	int status;
+
+	pid = fork();
+	if (pid < 0) {
+		err(1, "fork");
+	}
+	if (pid == 0) {
+		if (prog != NULL) {
+			args[0] = (char *)prog;
+			args[1] = NULL;
+			execv(prog, args);
+			_exit(1);
+		}
+		_exit(0);
+	}
+	if (waitpid(pid, &status, 0) < 0) {
+		err(1, "waitpid");
+	}
+}
+
+static
+void
+test_fork(void)
+{
+	int i;
+
+	for (i=0; i<nsamples; i++) {
+		timer_start();
+		forkwait(NULL);
+		samples[i] = timer_read(1);
+	}
+	report("fork", 0);
+}
+
+static
+void
+test_exec(void)
+{
+	int i;
+
+	for (i=0; i<nsamples; i++) {
+		timer_start();
+		forkwait("/bin/true");
+		samples[i] = timer_read(1);
+	}
+	report("exec", 0);
+}
+
+/*
+ * Touch one word in each of FAULTPAGES pages.
+ */
+static
+void
+touchpages(void)
+{
+	int i;
+
+	for (i=0; i<FAULTPAGES; i++) {
+		faultbuf[i * PAGESIZE]++;
+	}
+}
+
+/*
+ * Page fault cost: touch a set of pages right after a context switch
+ * (which empties the TLB), then again with the mappings loaded, and
+ * take the difference. Waiting for a child that exits at once gives
+ * us the context switch.
+ */
+static
+void
+test_fault(void)
+{
+	unsigned long cold, warm;
+	int i;
+
+	touchpages();
+	for (i=0; i<nsamples; i++) {
+		forkwait(NULL);
+		timer_start();
+		touchpages();
+		cold = timer_read(FAULTPAGES);
+
+		timer_start();
+		touchpages();
+		warm = timer_read(FAULTPAGES);
+
+		samples[i] = cold > warm ? cold - warm : 0;
+	}
+	report("fault", 0);
+}
+
+/*
+ * Time one pass over the file. The open and close are not timed.
+ */
+static
+unsigned long
+filepass(int dowrite)
+{
+	unsigned long ns;
+	int fd, i, r;
+
+	if (dowrite) {
+		fd = open(filename, O_WRONLY|O_CREAT|O_TRUNC, 0664);
+	}
+	else {
+		fd = open(filename, O_RDONLY);
+	}
+	if (fd < 0) {
+		err(1, "%s", filename);
+	}
+
+	timer_start();
+	for (i=0; i < FILEKB * 1024 / IOSIZE; i++) {
+		if (dowrite) {
+			r = write(fd, iobuf, IOSIZE);
+		}
+		else {
+			r = read(fd, iobuf, IOSIZE);
+		}
+		if (r < 0) {
+			err(1, "%s: %s", filename, dowrite ? "write" : "read");
+		}
+		if (r != IOSIZE) {
+			errx(1, "%s: short %s", filename,
+			     dowrite ? "write" : "read");
+		}
+	}
+	ns = timer_read(1);
+
+	close(fd);
+	return ns;
+}
+
+static
+void
+test_write(void)
+{
+	int i;
+
+	memset(iobuf, 'a', IOSIZE);
+	for (i=0; i<nsamples; i++) {
+		samples[i] = filepass(1);
+	}
+	report("write", FILEKB * 1024);
+}
+
+static
+void
+test_read(void)
+{
+	int i;
+
+	/* make sure the file is there */
+	filepass(1);
+	for (i=0; i<nsamples; i++) {
+		samples[i] = filepass(0);
+	}
+	report("read", FILEKB * 1024);
+}
+
+/*
+ * Console output: a line of spaces ended by a carriage return, so it
+ * leaves nothing on the screen.
+ */
+static
+void
+test_console(void)
+{
+	char line[CONSOLELINE];
+	int i;
+
+	memset(line, ' ', CONSOLELINE - 1);
+	line[CONSOLELINE - 1] = '\r';
+	for (i=0; i<nsamples; i++) {
+		timer_start();
+		if (write(STDOUT_FILENO, line, CONSOLELINE) != CONSOLELINE) {
+			err(1, "console write");
+		}
+		samples[i] = timer_read(1);
+	}
+	report("console", CONSOLELINE);
+}
+
+static const struct {
+	const char *name;
+	void (*func)(void);
+} tests[] = {
+	{ "null",    test_null },
+	{ "fork",    test_fork },
+	{ "exec",    test_exec },
+	{ "fault",   test_fault },
+	{ "write",   test_write },
+	{ "read",    test_read },
+	{ "console", test_console },
+	{ NULL, NULL }
+};
+
+static
+void
+usage(void)
+{
+	errx(1, "Usage: osbench [-n samples] [-f file] [test...]");
+}
+
+int
+main(int argc, char *argv[])
+{
+	int i, j, first;
+
+	for (i=1; i<argc && argv[i][0] == '-'; i++) {
+		if (!strcmp(argv[i], "-n") && i+1 < argc) {
+			nsamples = atoi(argv[++i]);
+		}
+		else if (!strcmp(argv[i], "-f") && i+1 < argc) {
+			filename = argv[++i];
+		}
+		else {
+			usage();
+		}
+	}
+	if (nsamples < 1 || nsamples > MAXSAMPLES) {
+		errx(1, "samples must be 1-%d", MAXSAMPLES);
+	}
+	first = i;
+
+	if (first == argc) {
+		for (j=0; tests[j].name != NULL; j++) {
+			tests[j].func();
+		}
+		return 0;
+	}
+
+	for (i=first; i<argc; i++) {
+		for (j=0; tests[j].name != NULL; j++) {
+			if (!strcmp(argv[i], tests[j].name)) {
+				break;
+			}
+		}
+		if (tests[j].name == NULL) {
+			warnx("no test %s", argv[i]);
+			usage();
+		}
+		tests[j].func();
+	}
+	return 0;
+}
@@ -0,0 +1,177 @@
+/*
+ * pmatmult - matmult split across threads sharing one address space.
+ *
+ * Usage: pmatmult [nthreads]
+ *
+ * Does the same computation as matmult, first in the main thread and
+ * then with the rows divided among NTHREADS threads made with
+ * threadfork(), and reports the time for each and the answer.
+ * Rows are dealt out round-robin, so threads never write the same
+ * row of T or C.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <err.h>
+
+#define Dim 	72		/* same size as matmult */
+#define RIGHT	8772192		/* correct answer */
+#define MAXTHREADS 16		/* kernel limit on thread stacks */
+
+int A[Dim][Dim];
+int B[Dim][Dim];
+int C[Dim][Dim];
+int T[Dim][Dim][Dim];
+
+static int nthreads = 4;
+
+/* Handshake for passing each new thread its index */
+static volatile int nextid;
+static volatile int started;
+
+////////////////////////////////////////////////////////////
+// timing
+
+static time_t startsecs;
+static unsigned long startnsecs;
+
+static
+void
+timer_start(void)
+{
+	__time(&startsecs, &startnsecs);
+}
+
+static
+void
+timer_report(const char *what)
+{
+	time_t endsecs;
+	unsigned long endnsecs, usecs;
+
+	__time(&endsecs, &endnsecs);
+	if (endnsecs < startnsecs) {
+		endnsecs += 1000000000;
+		endsecs--;
+	}
+	usecs = (unsigned long)(endsecs - startsecs) * 1000000
+		+ (endnsecs - startnsecs) / 1000;
+
+	printf("%-20s %10lu us\n", what, usecs);
+}
+
+////////////////////////////////////////////////////////////
+// the computation
+
+static
+void
+init(void)
+{
+	int i, j;
+
+	for (i = 0; i < Dim; i++) {
+		for (j = 0; j < Dim; j++) {
+			A[i][j] = i;
+			B[i][j] = j;
+			C[i][j] = 0;
+		}
+	}
+}
+
+/*
+ * Compute rows FIRST, FIRST+STRIDE, ... of C.
+ */
+static
+void
+rows(int first, int stride)
+{
+	int i, j, k;
+
+	for (i = first; i < Dim; i += stride) {
+		for (j = 0; j < Dim; j++) {
+			for (k = 0; k < Dim; k++) {
+				T[i][j][k] = A[i][k] * B[k][j];
+			}
+		}
+		for (j = 0; j < Dim; j++) {
+			for (k = 0; k < Dim; k++) {
+				C[i][j] += T[i][j][k];
+			}
+		}
+	}
+}
+
+static
+int
+check(void)
+{
+	int i, r = 0;
+
+	for (i = 0; i < Dim; i++) {
+		r += C[i][i];
+	}
+	printf("answer is: %d (should be %d)\n", r, RIGHT);
+	return r == RIGHT;
+}
+
+static
+void
+worker(void)
+{
+	int me;
+
+	me = nextid;
+	started = 1;
+	rows(me, nthreads);
+}
+
+int
+main(int argc, char *argv[])
+{
+	int tids[MAXTHREADS];
+	char what[32];
+	int i, status, ok;
+
+	if (argc > 1) {
+		nthreads = atoi(argv[1]);
+	}
+	if (nthreads <= 0 || nthreads > MAXTHREADS) {
+		errx(1, "Usage: pmatmult [nthreads], at most %d", MAXTHREADS);
+	}
+
+	init();
+	timer_start();
+	rows(0, 1);
+	timer_report("1 thread (main)");
+	ok = check();
+
+	init();
+	timer_start();
+	for (i = 0; i < nthreads; i++) {
+		nextid = i;
+		started = 0;
+		tids[i] = threadfork(worker);
+		if (tids[i] < 0) {
+			err(1, "threadfork");
+		}
+		while (!started) {
+			/* wait for it to pick up its index */
+		}
+	}
+	for (i = 0; i < nthreads; i++) {
+		if (threadjoin(tids[i], &status) < 0) {
+			err(1, "threadjoin");
+		}
+	}
+	snprintf(what, sizeof(what), "%d threads", nthreads);
+	timer_report(what);
+	ok = check() && ok;
+
+	if (!ok) {
+		printf("FAILED\n");
+		return 1;
+	}
+	printf("Passed.\n");
+	return 0;
+}
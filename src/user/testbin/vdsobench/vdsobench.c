@@ -0,0 +1,96 @@
+/*
+ * vdsobench - cost of getpid() and time() with and without a trap.
+ *
+ * Usage: vdsobench [iterations]
+ *
+ * Times ITERATIONS calls each of the trapping system calls
+ * (__sys_getpid, __time) and of the libc versions that read the
+ * kernel's read-only time/pid pages, and checks that the two agree.
+ */
+
+#include <sys/types.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <err.h>
+
+static time_t startsecs;
+static unsigned long startnsecs;
+
+static
+void
+timer_start(void)
+{
+	__time(&startsecs, &startnsecs);
+}
+
+static
+void
+timer_report(const char *what, int n)
+{
+	time_t endsecs;
+	unsigned long endnsecs, usecs;
+
+	__time(&endsecs, &endnsecs);
+	if (endnsecs < startnsecs) {
+		endnsecs += 1000000000;
+		endsecs--;
+	}
+	usecs = (unsigned long)(endsecs - startsecs) * 1000000
+		+ (endnsecs - startnsecs) / 1000;
+
+	printf("%-16s %8d calls %10lu us %8lu ns/call\n", what, n, usecs,
+	       n ? usecs * 1000 / n : 0);
+}
+
+int
+main(int argc, char *argv[])
+{
+	volatile int sink;
+	time_t t1, t2;
+	int i, n = 10000;
+
+	if (argc > 1) {
+		n = atoi(argv[1]);
+	}
+	if (n <= 0) {
+		errx(1, "Usage: vdsobench [iterations]");
+	}
+
+	/* Sanity checks */
+	if (getpid() != __sys_getpid()) {
+		errx(1, "getpid() %d != syscall %d", getpid(), __sys_getpid());
+	}
+	t1 = __time(NULL, NULL);
+	t2 = time(NULL);
+	if (t2 < t1 - 1 || t2 > t1 + 1) {
+		errx(1, "time() %ld != __time %ld", (long)t2, (long)t1);
+	}
+
+	timer_start();
+	for (i=0; i<n; i++) {
+		sink = __sys_getpid();
+	}
+	timer_report("getpid trap", n);
+
+	timer_start();
+	for (i=0; i<n; i++) {
+		sink = getpid();
+	}
+	timer_report("getpid vdso", n);
+
+	timer_start();
+	for (i=0; i<n; i++) {
+		sink = __time(NULL, NULL);
+	}
+	timer_report("time trap", n);
+
+	timer_start();
+	for (i=0; i<n; i++) {
+		sink = time(NULL);
+	}
+	timer_report("time vdso", n);
+
+	(void)sink;
+	return 0;
+}
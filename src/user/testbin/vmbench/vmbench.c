@@ -0,0 +1,265 @@
+/*
+ * vmbench - VM fault and TLB behavior under a chosen working set.
+ *
+ * Usage: vmbench [-s pages] [-n passes] [-p procs] [-k stride] [pattern...]
+ *
+ * Each of PROCS processes gets a working set of PAGES pages from sbrk
+ * and makes PASSES passes over it, touching one word per page, in one
+ * of these patterns (default: all three):
+ *
+ *	seq	pages in order
+ *	rand	as many pages, picked at random
+ *	stride	every STRIDE'th page, then the next offset, and so on
+ *
+ * and one line is printed per pattern:
+ *
+ *	vmbench PATTERN pages=P procs=N passes=K elapsed_us=T faults=F
+ *	  faults_per_sec=R tlbmisses=M tlbevicts=E tlbflushes=X
+ *	  misses_per_1k=Y
+ *
+ * The counts come from __vmstat(VMSTAT_SYSTEM), before and after, so
+ * they cover all the processes (and the little the parent does while
+ * it waits). misses_per_1k is TLB misses per thousand page touches.
+ * Under dumbvm, with its 1M of RAM, large working sets or many
+ * processes need a bigger ramsize in sys161.conf.
+ */
+
+#include <sys/types.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <err.h>
+#include <kern/vmstat.h>
+
+#define PAGESIZE	4096
+#define MAXPROCS	16
+
+static int npages = 32;
+static int npasses = 16;
+static int nprocs = 1;
+static int stride = 4;
+
+////////////////////////////////////////////////////////////
+// timing
+
+static time_t startsecs;
+static unsigned long startnsecs;
+
+static
+void
+timer_start(void)
+{
+	__time(&startsecs, &startnsecs);
+}
+
+/*
+ * Microseconds since timer_start.
+ */
+static
+unsigned long
+timer_us(void)
+{
+	time_t endsecs;
+	unsigned long endnsecs;
+
+	__time(&endsecs, &endnsecs);
+	if (endnsecs < startnsecs) {
+		endnsecs += 1000000000;
+		endsecs--;
+	}
+	return (unsigned long)(endsecs - startsecs) * 1000000
+		+ (endnsecs - startnsecs) / 1000;
+}
+
+////////////////////////////////////////////////////////////
+// workers
+
+static
+void
+touch_seq(volatile char *buf)
+{
+	int i;
+
+	for (i=0; i<npages; i++) {
+		buf[i * PAGESIZE]++;
+	}
+}
+
+static
+void
+touch_rand(volatile char *buf)
+{
+	int i;
+
+	for (i=0; i<npages; i++) {
+		buf[(random() % npages) * PAGESIZE]++;
+	}
+}
+
+static
+void
+touch_stride(volatile char *buf)
+{
+	int i, off;
+
+	for (off=0; off<stride; off++) {
+		for (i=off; i<npages; i+=stride) {
+			buf[i * PAGESIZE]++;
+		}
+	}
+}
+
+static const struct {
+	const char *name;
+	void (*touch)(volatile char *);
+} patterns[] = {
+	{ "seq",    touch_seq },
+	{ "rand",   touch_rand },
+	{ "stride", touch_stride },
+	{ NULL, NULL }
+};
+
+/*
+ * One worker process: get the working set and run the passes.
+ */
+static
+void
+worker(int pat, int id)
+{
+	volatile char *buf;
+	int i;
+
+	srandom(id + 1);
+	buf = sbrk(npages * PAGESIZE);
+	if (buf == (void *)-1) {
+		err(1, "sbrk of %d pages", npages);
+	}
+	for (i=0; i<npasses; i++) {
+		patterns[pat].touch(buf);
+	}
+}
+
+////////////////////////////////////////////////////////////
+// driver
+
+static
+void
+getstat(struct vmstat *vs)
+{
+	if (__vmstat(VMSTAT_SYSTEM, vs) < 0) {
+		err(1, "__vmstat");
+	}
+}
+
+static
+void
+run(int pat)
+{
+	struct vmstat before, after;
+	unsigned long us, faults, misses, touches;
+	pid_t pids[MAXPROCS];
+	int i, status, failed = 0;
+
+	getstat(&before);
+	timer_start();
+	for (i=0; i<nprocs; i++) {
+		pids[i] = fork();
+		if (pids[i] < 0) {
+			err(1, "fork");
+		}
+		if (pids[i] == 0) {
+			worker(pat, i);
+			_exit(0);
+		}
+	}
+	for (i=0; i<nprocs; i++) {
+		if (waitpid(pids[i], &status, 0) < 0) {
+			err(1, "waitpid");
+		}
+		if (status != 0) {
+			failed++;
+		}
+	}
+	us = timer_us();
+	getstat(&after);
+	if (failed > 0) {
+		errx(1, "%d of %d processes failed", failed, nprocs);
+	}
+
+	faults = after.vs_faults - before.vs_faults;
+	misses = after.vs_tlbfills - before.vs_tlbfills;
+	touches = (unsigned long)npages * npasses * nprocs;
+
+	printf("vmbench %s pages=%d procs=%d passes=%d elapsed_us=%lu "
+	       "faults=%lu faults_per_sec=%lu tlbmisses=%lu tlbevicts=%lu "
+	       "tlbflushes=%lu misses_per_1k=%lu\n",
+	       patterns[pat].name, npages, nprocs, npasses, us, faults,
+	       /* faults * 1e6 / us, ordered to stay in 32 bits */
+	       faults * 1000 / (us / 1000 + 1), misses,
+	       (unsigned long)(after.vs_tlbevicts - before.vs_tlbevicts),
+	       (unsigned long)(after.vs_tlbflushes - before.vs_tlbflushes),
+	       misses * 1000 / touches);
+}
+
+static
+void
+usage(void)
+{
+	errx(1, "Usage: vmbench [-s pages] [-n passes] [-p procs] "
+	     "[-k stride] [pattern...]");
+}
+
+int
+main(int argc, char *argv[])
+{
+	int i, j;
+
+	for (i=1; i<argc && argv[i][0] == '-'; i++) {
+		if (i+1 == argc) {
+			usage();
+		}
+		if (!strcmp(argv[i], "-s")) {
+			npages = atoi(argv[++i]);
+		}
+		else if (!strcmp(argv[i], "-n")) {
+			npasses = atoi(argv[++i]);
+		}
+		else if (!strcmp(argv[i], "-p")) {
+			nprocs = atoi(argv[++i]);
+		}
+		else if (!strcmp(argv[i], "-k")) {
+			stride = atoi(argv[++i]);
+		}
+		else {
+			usage();
+		}
+	}
+	if (npages < 1 || npasses < 1 || stride < 1) {
+		errx(1, "pages, passes and stride must be positive");
+	}
+	if (nprocs < 1 || nprocs > MAXPROCS) {
+		errx(1, "procs must be 1-%d", MAXPROCS);
+	}
+
+	if (i == argc) {
+		for (j=0; patterns[j].name != NULL; j++) {
+			run(j);
+		}
+		return 0;
+	}
+
+	for (; i<argc; i++) {
+		for (j=0; patterns[j].name != NULL; j++) {
+			if (!strcmp(argv[i], patterns[j].name)) {
+				break;
+			}
+		}
+		if (patterns[j].name == NULL) {
+			warnx("no pattern %s", argv[i]);
+			usage();
+		}
+		run(j);
+	}
+	return 0;
+}